@@ -80,6 +80,7 @@ typedef struct ConnCacheEntry
 static uint32 pgfdw_we_cleanup_result = 0;
 static uint32 pgfdw_we_connect = 0;
 static uint32 pgfdw_we_get_result = 0;
+static uint32 pgfdw_we_send_data = 0;
 
 #ifdef NOT_USED_IN_PGFDWPLUS
 /*
@@ -160,6 +161,7 @@ static bool pgfdw_exec_cleanup_query_end(PGconn *conn, const char *query,
 #endif	/* NOT_USED_IN_PGFDWPLUS */
 static bool pgfdw_get_cleanup_result(PGconn *conn, TimestampTz endtime,
 									 PGresult **result, bool *timed_out);
+static bool pgfdw_flush_output(PGconn *conn);
 #ifdef NOT_USED_IN_PGFDWPLUS
 static void pgfdw_abort_cleanup(ConnCacheEntry *entry, bool toplevel);
 static bool pgfdw_abort_cleanup_begin(ConnCacheEntry *entry, bool toplevel,
@@ -773,6 +775,8 @@ begin_remote_xact(ConnCacheEntry *entry)
 	if (entry->xact_depth <= 0)
 	{
 		const char *sql;
+		instr_time	start;
+		instr_time	duration;
 
 		elog(DEBUG3, "starting remote transaction on connection %p",
 			 entry->conn);
@@ -784,9 +788,19 @@ begin_remote_xact(ConnCacheEntry *entry)
 		if (pgfdw_use_read_committed_in_xact && !IsolationUsesXactSnapshot())
 			sql = "START TRANSACTION ISOLATION LEVEL READ COMMITTED";
 		entry->changing_xact_state = true;
+		INSTR_TIME_SET_CURRENT(start);
 		do_sql_command(entry->conn, sql);
+		INSTR_TIME_SET_CURRENT(duration);
 		entry->xact_depth = 1;
 		entry->changing_xact_state = false;
+
+		/*
+		 * Starting a transaction costs the remote server almost nothing, so
+		 * this is a round-trip time for the network cost model.
+		 */
+		INSTR_TIME_SUBTRACT(duration, start);
+		pgfdw_record_round_trip(entry->serverid,
+								INSTR_TIME_GET_MILLISEC(duration));
 	}
 
 	/*
@@ -882,6 +896,115 @@ pgfdw_get_result(PGconn *conn)
 	return libpqsrv_get_result_last(conn, pgfdw_we_get_result);
 }
 
+/*
+ * Wrap libpqsrv_get_result(), adding wait event.
+ *
+ * Unlike pgfdw_get_result(), this returns each result of the query in turn,
+ * and NULL after the last one, for callers sending multiple commands at
+ * once.  Caller is responsible for the error handling on the result.
+ */
+PGresult *
+pgfdw_get_next_result(PGconn *conn)
+{
+	return libpqsrv_get_result(conn, pgfdw_we_get_result);
+}
+
+/*
+ * Send data to the remote server during COPY FROM STDIN.
+ *
+ * The connection is put into nonblocking mode for the rest of the COPY, so
+ * that we can process interrupts while waiting for the remote server to take
+ * the data; pgfdw_put_copy_end() restores blocking mode.  The data is sent
+ * out before returning, so that we go no faster than the remote server.
+ *
+ * Returns false on failure; caller is responsible for the error handling.
+ */
+bool
+pgfdw_put_copy_data(PGconn *conn, const char *buffer, int nbytes)
+{
+	int			ret;
+
+	if (!PQisnonblocking(conn) && PQsetnonblocking(conn, 1) != 0)
+		return false;
+
+	/* Zero means libpq's buffer is full, so send its contents first */
+	while ((ret = PQputCopyData(conn, buffer, nbytes)) == 0)
+	{
+		if (!pgfdw_flush_output(conn))
+			return false;
+	}
+	if (ret < 0)
+		return false;
+
+	return pgfdw_flush_output(conn);
+}
+
+/*
+ * End COPY FROM STDIN, like PQputCopyEnd(), and put the connection back into
+ * blocking mode.
+ *
+ * Returns false on failure; caller is responsible for the error handling.
+ */
+bool
+pgfdw_put_copy_end(PGconn *conn, const char *errormsg)
+{
+	int			ret;
+
+	while ((ret = PQputCopyEnd(conn, errormsg)) == 0)
+	{
+		if (!pgfdw_flush_output(conn))
+			return false;
+	}
+	if (ret < 0)
+		return false;
+
+	if (PQisnonblocking(conn))
+	{
+		if (!pgfdw_flush_output(conn))
+			return false;
+		if (PQsetnonblocking(conn, 0) != 0)
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Wait until all the data queued on a connection in nonblocking mode has been
+ * sent, processing interrupts meanwhile.  Returns false on connection trouble.
+ */
+static bool
+pgfdw_flush_output(PGconn *conn)
+{
+	for (;;)
+	{
+		int			ret;
+		int			wc;
+
+		ret = PQflush(conn);
+		if (ret <= 0)
+			return (ret == 0);
+
+		/* first time, allocate or get the custom wait event */
+		if (pgfdw_we_send_data == 0)
+			pgfdw_we_send_data = WaitEventExtensionNew("PostgresFdwSendData");
+
+		/* Sleep until we can send more, or the server sent us something */
+		wc = WaitLatchOrSocket(MyLatch,
+							   WL_LATCH_SET | WL_SOCKET_READABLE |
+							   WL_SOCKET_WRITEABLE | WL_EXIT_ON_PM_DEATH,
+							   PQsocket(conn),
+							   -1L, pgfdw_we_send_data);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		/* Read what the server sent, lest it stop reading from us */
+		if ((wc & WL_SOCKET_READABLE) && !PQconsumeInput(conn))
+			return false;
+	}
+}
+
 /*
  * Report an error we got from the remote server.
  *
@@ -126,7 +126,10 @@ postgres_fdw_validator(PG_FUNCTION_ARGS)
 			strcmp(def->defname, "async_capable") == 0 ||
 			strcmp(def->defname, "parallel_commit") == 0 ||
 			strcmp(def->defname, "parallel_abort") == 0 ||
-			strcmp(def->defname, "keep_connections") == 0)
+			strcmp(def->defname, "keep_connections") == 0 ||
+			strcmp(def->defname, "verify_collations") == 0 ||
+			strcmp(def->defname, "use_network_cost") == 0 ||
+			strcmp(def->defname, "trust_remote_unique") == 0)
 		{
 			/* these accept only boolean values */
 			(void) defGetBoolean(def);
@@ -217,17 +220,55 @@ postgres_fdw_validator(PG_FUNCTION_ARGS)
 
 			value = defGetString(def);
 
-			/* we recognize off/auto/random/system/bernoulli */
+			/* we recognize off/auto/random/system/bernoulli/import */
 			if (strcmp(value, "off") != 0 &&
 				strcmp(value, "auto") != 0 &&
 				strcmp(value, "random") != 0 &&
 				strcmp(value, "system") != 0 &&
-				strcmp(value, "bernoulli") != 0)
+				strcmp(value, "bernoulli") != 0 &&
+				strcmp(value, "import") != 0)
 				ereport(ERROR,
 						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
 						 errmsg("invalid value for string option \"%s\": %s",
 								def->defname, value)));
 		}
+		else if (strcmp(def->defname, "batch_insert_method") == 0)
+		{
+			char	   *value;
+
+			value = defGetString(def);
+
+			/* we recognize insert/copy/binary_copy */
+			if (strcmp(value, "insert") != 0 &&
+				strcmp(value, "copy") != 0 &&
+				strcmp(value, "binary_copy") != 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid value for string option \"%s\": %s",
+								def->defname, value)));
+		}
+		else if (strcmp(def->defname, "batch_target_size") == 0)
+		{
+			char	   *value;
+			int			int_val;
+			const char *hintmsg;
+
+			value = defGetString(def);
+
+			/* accept memory units as for GUCs, like '1MB' */
+			if (!parse_int(value, &int_val, GUC_UNIT_BYTE, &hintmsg))
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("invalid value for integer option \"%s\": %s",
+								def->defname, value),
+						 hintmsg ? errhint("%s", _(hintmsg)) : 0));
+
+			if (int_val < 0)
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("\"%s\" must be an integer value greater than or equal to zero",
+								def->defname)));
+		}
 	}
 
 	PG_RETURN_VOID();
@@ -268,12 +309,23 @@ InitPgFdwOptions(void)
 		/* batch_size is available on both server and table */
 		{"batch_size", ForeignServerRelationId, false},
 		{"batch_size", ForeignTableRelationId, false},
+		/* batch_insert_method is available on both server and table */
+		{"batch_insert_method", ForeignServerRelationId, false},
+		{"batch_insert_method", ForeignTableRelationId, false},
+		/* batch_target_size is available on both server and table */
+		{"batch_target_size", ForeignServerRelationId, false},
+		{"batch_target_size", ForeignTableRelationId, false},
 		/* async_capable is available on both server and table */
 		{"async_capable", ForeignServerRelationId, false},
 		{"async_capable", ForeignTableRelationId, false},
 		{"parallel_commit", ForeignServerRelationId, false},
 		{"parallel_abort", ForeignServerRelationId, false},
 		{"keep_connections", ForeignServerRelationId, false},
+		{"verify_collations", ForeignServerRelationId, false},
+		{"use_network_cost", ForeignServerRelationId, false},
+		/* trust_remote_unique is available on both server and table */
+		{"trust_remote_unique", ForeignServerRelationId, false},
+		{"trust_remote_unique", ForeignTableRelationId, false},
 		{"password_required", UserMappingRelationId, false},
 
 		/* sampling is available on both server and table */
@@ -587,6 +639,12 @@ _PG_init(void)
 							   NULL);
 
 	DefineCustomVariablesForPgFdwPlus();
+	InstallJoinPathlistHookForPgFdwPlus();
+	InstallRelationInfoHookForPgFdwPlus();
+	InstallPlannerHookForPgFdwPlus();
+	InstallShmemHooksForPgFdwPlus();
+	InstallProcessUtilityHookForPgFdwPlus();
+	RegisterAutoAnalyzeWorkerForPgFdwPlus();
 
 	MarkGUCPrefixReserved("postgres_fdw");
 }
@@ -0,0 +1,12216 @@
+/*-------------------------------------------------------------------------
+ *
+ * postgres_fdw.c
+ *		  Foreign-data wrapper for remote PostgreSQL servers
+ *
+ * Portions Copyright (c) 2012-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		  contrib/postgres_fdw/postgres_fdw.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include <limits.h>
+
+#include "access/htup_details.h"
+#include "access/sysattr.h"
+#include "access/table.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_opfamily.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "commands/explain.h"
+#include "commands/extension.h"
+#include "commands/vacuum.h"
+#include "executor/execAsync.h"
+#include "foreign/fdwapi.h"
+#include "funcapi.h"
+#include "libpq/pqformat.h"
+#include "mb/pg_wchar.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/appendinfo.h"
+#include "optimizer/clauses.h"
+#include "optimizer/cost.h"
+#include "optimizer/inherit.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "optimizer/planmain.h"
+#include "optimizer/plancat.h"
+#include "optimizer/planner.h"
+#include "optimizer/prep.h"
+#include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
+#include "parser/parse_agg.h"
+#include "parser/parse_func.h"
+#include "parser/parsetree.h"
+#include "port/pg_bitutils.h"
+#include "portability/instr_time.h"
+#include "postgres_fdw_plus.h"
+#include "storage/latch.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/float.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/resowner.h"
+#include "utils/sampling.h"
+#include "utils/selfuncs.h"
+#include "utils/sortsupport.h"
+#include "utils/syscache.h"
+#include "utils/typcache.h"
+#include "utils/wait_event.h"
+
+PG_MODULE_MAGIC;
+
+/* Default CPU cost to start up a foreign query. */
+#define DEFAULT_FDW_STARTUP_COST	100.0
+
+/* Default CPU cost to process 1 row (above and beyond cpu_tuple_cost). */
+#define DEFAULT_FDW_TUPLE_COST		0.2
+
+/* If no remote estimates, assume a sort costs 20% extra */
+#define DEFAULT_FDW_SORT_MULTIPLIER 1.2
+
+/*
+ * Indexes of FDW-private information stored in fdw_private lists.
+ *
+ * These items are indexed with the enum FdwScanPrivateIndex, so an item
+ * can be fetched with list_nth().  For example, to get the SELECT statement:
+ *		sql = strVal(list_nth(fdw_private, FdwScanPrivateSelectSql));
+ */
+enum FdwScanPrivateIndex
+{
+	/* SQL statement to execute remotely (as a String node) */
+	FdwScanPrivateSelectSql,
+	/* Integer list of attribute numbers retrieved by the SELECT */
+	FdwScanPrivateRetrievedAttrs,
+	/* Integer representing the desired fetch_size */
+	FdwScanPrivateFetchSize,
+
+	/*
+	 * String describing join i.e. names of relations being joined and types
+	 * of join, added when the scan is join
+	 */
+	FdwScanPrivateRelations,
+
+	/*
+	 * Integer index of the key-set parameter in fdw_exprs, and Integer
+	 * attribute number of the join key in the outer plan's output, added
+	 * when the scan is the foreign side of a key-set semi-join (the Relations
+	 * item is NULL in that case)
+	 */
+	FdwScanPrivateKeySetParam,
+	FdwScanPrivateKeySetAttno,
+	/* Integer index of the Bloom filter parameter in fdw_exprs, or -1 */
+	FdwScanPrivateBloomParam,
+
+	/*
+	 * SQL statement to execute remotely instead if the key set can be staged
+	 * (as a String node), or NULL.  It takes the parameters preceding the
+	 * key-set parameter, and the ID of the staged key set in its place.
+	 */
+	FdwScanPrivateStagedSelectSql,
+
+	/*
+	 * Integer list of the numbers of remote EXPLAINs issued and skipped while
+	 * planning the query, added when a planning budget for remote estimates
+	 * is set (the preceding items are NULL if they don't apply)
+	 */
+	FdwScanPrivateRemoteEstimates,
+};
+
+/*
+ * Similarly, this enum describes what's kept in the fdw_private list for
+ * a ModifyTable node referencing a postgres_fdw foreign table.  We store:
+ *
+ * 1) INSERT/UPDATE/DELETE statement text to be sent to the remote server
+ * 2) Integer list of target attribute numbers for INSERT/UPDATE
+ *	  (NIL for a DELETE)
+ * 3) Length till the end of VALUES clause for INSERT
+ *	  (-1 for a DELETE/UPDATE)
+ * 4) Boolean flag showing if the remote query has a RETURNING clause
+ * 5) Integer list of attribute numbers retrieved by RETURNING, if any
+ */
+enum FdwModifyPrivateIndex
+{
+	/* SQL statement to execute remotely (as a String node) */
+	FdwModifyPrivateUpdateSql,
+	/* Integer list of target attribute numbers for INSERT/UPDATE */
+	FdwModifyPrivateTargetAttnums,
+	/* Length till the end of VALUES clause (as an Integer node) */
+	FdwModifyPrivateLen,
+	/* has-returning flag (as a Boolean node) */
+	FdwModifyPrivateHasReturning,
+	/* Integer list of attribute numbers retrieved by RETURNING */
+	FdwModifyPrivateRetrievedAttrs,
+};
+
+/*
+ * Similarly, this enum describes what's kept in the fdw_private list for
+ * a ForeignScan node that modifies a foreign table directly.  We store:
+ *
+ * 1) UPDATE/DELETE statement text to be sent to the remote server
+ * 2) Boolean flag showing if the remote query has a RETURNING clause
+ * 3) Integer list of attribute numbers retrieved by RETURNING, if any
+ * 4) Boolean flag showing if we set the command es_processed
+ */
+enum FdwDirectModifyPrivateIndex
+{
+	/* SQL statement to execute remotely (as a String node) */
+	FdwDirectModifyPrivateUpdateSql,
+	/* has-returning flag (as a Boolean node) */
+	FdwDirectModifyPrivateHasReturning,
+	/* Integer list of attribute numbers retrieved by RETURNING */
+	FdwDirectModifyPrivateRetrievedAttrs,
+	/* set-processed flag (as a Boolean node) */
+	FdwDirectModifyPrivateSetProcessed,
+};
+
+/*
+ * Execution state of a foreign scan using postgres_fdw.
+ */
+typedef struct PgFdwScanState
+{
+	Relation	rel;			/* relcache entry for the foreign table. NULL
+								 * for a foreign join scan. */
+	TupleDesc	tupdesc;		/* tuple descriptor of scan */
+	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
+
+	/* extracted fdw_private data */
+	char	   *query;			/* text of SELECT command */
+	List	   *retrieved_attrs;	/* list of retrieved attribute numbers */
+
+	/* for remote query execution */
+	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
+	unsigned int cursor_number; /* quasi-unique ID for my cursor */
+	bool		cursor_exists;	/* have we created the cursor? */
+	int			numParams;		/* number of parameters passed to query */
+	FmgrInfo   *param_flinfo;	/* output conversion functions for them */
+	List	   *param_exprs;	/* executable expressions for param values */
+	const char **param_values;	/* values of query parameters */
+	int		   *param_lengths;	/* lengths of binary values among them */
+	int		   *param_formats;	/* their formats, or NULL if all text */
+
+	/* for key-set semi-join scans */
+	int			keyset_param;	/* index of key-set param, or -1 if none */
+	AttrNumber	keyset_attno;	/* attno of join key in outer plan's output */
+	int			bloom_param;	/* index of Bloom filter param, or -1 */
+	char	   *staged_query;	/* query using a staged key set, or NULL */
+
+	/* for storing result tuples */
+	HeapTuple  *tuples;			/* array of currently-retrieved tuples */
+	int			num_tuples;		/* # of tuples in array */
+	int			next_tuple;		/* index of next one to return */
+
+	/* batch-level state, for optimizing rewinds and avoiding useless fetch */
+	int			fetch_ct_2;		/* Min(# of fetches done, 2) */
+	bool		eof_reached;	/* true if last fetch reached EOF */
+
+	/* for asynchronous execution */
+	bool		async_capable;	/* engage asynchronous-capable logic? */
+
+	/* working memory contexts */
+	MemoryContext batch_cxt;	/* context holding current batch of tuples */
+	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
+	MemoryContext keyset_cxt;	/* context for collected join keys, or NULL */
+
+	int			fetch_size;		/* number of tuples per fetch */
+} PgFdwScanState;
+
+/*
+ * Number of power-of-two sizes, from 1 to 32768 rows, that a statement of an
+ * INSERT batch may have when sized adaptively
+ */
+#define NUM_BATCH_SHAPES	16
+
+/*
+ * Execution state of a foreign insert/update/delete operation.
+ */
+typedef struct PgFdwModifyState
+{
+	Relation	rel;			/* relcache entry for the foreign table */
+	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
+
+	/* for remote query execution */
+	PGconn	   *conn;			/* connection for the scan */
+	PgFdwConnState *conn_state; /* extra per-connection state */
+	char	   *p_name;			/* name of prepared statement, if created */
+
+	/* extracted fdw_private data */
+	char	   *query;			/* text of INSERT/UPDATE/DELETE command */
+	char	   *orig_query;		/* original text of INSERT command */
+	List	   *target_attrs;	/* list of target attribute numbers */
+	int			values_end;		/* length up to the end of VALUES */
+	int			batch_size;		/* value of FDW option "batch_size" */
+	bool		has_returning;	/* is there a RETURNING clause? */
+	List	   *retrieved_attrs;	/* attr numbers retrieved by RETURNING */
+
+	/* for sending batches of an INSERT with COPY */
+	char	   *copy_query;		/* text of COPY command, or NULL if unused */
+	bool		copy_binary;	/* is COPY in binary format? */
+	FmgrInfo   *copy_flinfo;	/* send or output functions of copied columns */
+
+	/* info about parameters for prepared statement */
+	AttrNumber	ctidAttno;		/* attnum of input resjunk ctid column */
+	int			p_nums;			/* number of parameters to transmit */
+	FmgrInfo   *p_flinfo;		/* output conversion functions for them */
+	Oid		   *p_types;		/* their local data types */
+	int		   *p_formats;		/* their formats, or NULL if all text */
+	bool		p_formats_chosen;	/* have we chosen p_formats yet? */
+
+	/* batch operation stuff */
+	int			num_slots;		/* number of slots to insert */
+
+	/* for sizing the statements of INSERT batches adaptively */
+	int			batch_target_size;	/* value of "batch_target_size", or 0 */
+	int			batch_shape;	/* current number of rows per statement */
+	char	  **shape_p_names;	/* prepared statements of other sizes */
+	double	   *shape_usec_per_row; /* remote time per row for each size */
+
+	/* working memory context */
+	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
+
+	/* for update row movement if subplan result rel */
+	struct PgFdwModifyState *aux_fmstate;	/* foreign-insert state, if
+											 * created */
+} PgFdwModifyState;
+
+/*
+ * Execution state of a foreign scan that modifies a foreign table directly.
+ */
+typedef struct PgFdwDirectModifyState
+{
+	Relation	rel;			/* relcache entry for the foreign table */
+	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
+
+	/* extracted fdw_private data */
+	char	   *query;			/* text of UPDATE/DELETE command */
+	bool		has_returning;	/* is there a RETURNING clause? */
+	List	   *retrieved_attrs;	/* attr numbers retrieved by RETURNING */
+	bool		set_processed;	/* do we set the command es_processed? */
+
+	/* for remote query execution */
+	PGconn	   *conn;			/* connection for the update */
+	PgFdwConnState *conn_state; /* extra per-connection state */
+	int			numParams;		/* number of parameters passed to query */
+	FmgrInfo   *param_flinfo;	/* output conversion functions for them */
+	List	   *param_exprs;	/* executable expressions for param values */
+	const char **param_values;	/* values of query parameters */
+	int		   *param_lengths;	/* lengths of binary values among them */
+	int		   *param_formats;	/* their formats, or NULL if all text */
+
+	/* for storing result tuples */
+	PGresult   *result;			/* result for query */
+	int			num_tuples;		/* # of result tuples */
+	int			next_tuple;		/* index of next one to return */
+	Relation	resultRel;		/* relcache entry for the target relation */
+	AttrNumber *attnoMap;		/* array of attnums of input user columns */
+	AttrNumber	ctidAttno;		/* attnum of input ctid column */
+	AttrNumber	oidAttno;		/* attnum of input oid column */
+	bool		hasSystemCols;	/* are there system columns of resultRel? */
+
+	/* working memory context */
+	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
+} PgFdwDirectModifyState;
+
+/*
+ * Workspace for analyzing a foreign table.
+ */
+typedef struct PgFdwAnalyzeState
+{
+	Relation	rel;			/* relcache entry for the foreign table */
+	AttInMetadata *attinmeta;	/* attribute datatype conversion metadata */
+	List	   *retrieved_attrs;	/* attr numbers retrieved by query */
+
+	/* collected sample rows */
+	HeapTuple  *rows;			/* array of size targrows */
+	int			targrows;		/* target # of sample rows */
+	int			numrows;		/* # of sample rows collected */
+
+	/* for random sampling */
+	double		samplerows;		/* # of rows fetched */
+	double		rowstoskip;		/* # of rows to skip before next sample */
+	ReservoirStateData rstate;	/* state for reservoir sampling */
+
+	/* working memory contexts */
+	MemoryContext anl_cxt;		/* context for per-analyze lifespan data */
+	MemoryContext temp_cxt;		/* context for per-tuple temporary data */
+} PgFdwAnalyzeState;
+
+/*
+ * A foreign table analyzed as a child of a parent table, whose sample rows
+ * can be acquired concurrently with those of the other children while
+ * postgres_fdw.analyze_concurrently is enabled
+ */
+typedef struct PgFdwAnalyzeChild
+{
+	Oid			relid;			/* OID of the foreign table */
+	BlockNumber totalpages;		/* its size reported to ANALYZE */
+	bool		acquired;		/* sample rows acquired yet? */
+	HeapTuple  *rows;			/* sample rows acquired */
+	int			numrows;		/* # of sample rows acquired */
+	double		totalrows;		/* # of rows in the foreign table */
+} PgFdwAnalyzeChild;
+
+/*
+ * Workspace for acquiring the sample rows of a child concurrently
+ */
+typedef struct PgFdwAnalyzeChildScan
+{
+	PgFdwAnalyzeChild *child;
+	PgFdwAnalyzeState astate;
+	PGconn	   *conn;
+	char	   *sql;			/* query to get sample rows */
+	PgFdwSamplingMethod method; /* actual sampling method */
+	double		reltuples;		/* remote reltuples, if sampled */
+} PgFdwAnalyzeChildScan;
+
+/*
+ * This enum describes what's kept in the fdw_private list for a ForeignPath.
+ * We store:
+ *
+ * 1) Boolean flag showing if the remote query has the final sort
+ * 2) Boolean flag showing if the remote query has the LIMIT clause
+ * 3) Key-set condition of a key-set semi-join scan, if any
+ * 4) Local join key expression of a key-set semi-join scan, if any
+ * 5) Bloom filter condition of a key-set semi-join scan, if any
+ * 6) Staged key-set condition of a key-set semi-join scan, if any
+ */
+enum FdwPathPrivateIndex
+{
+	/* has-final-sort flag (as a Boolean node) */
+	FdwPathPrivateHasFinalSort,
+	/* has-limit flag (as a Boolean node) */
+	FdwPathPrivateHasLimit,
+	/* key-set condition to be sent to the remote server */
+	FdwPathPrivateKeySetClause,
+	/* join key expression evaluated over the fdw_outerpath */
+	FdwPathPrivateKeySetLocalKey,
+	/* Bloom filter condition to be sent to the remote server, or NULL */
+	FdwPathPrivateBloomClause,
+	/* staged key-set condition to be sent instead, if possible */
+	FdwPathPrivateStagedKeySetClause,
+};
+
+
+/* Struct for extra information passed to estimate_path_cost_size() */
+typedef struct
+{
+	PathTarget *target;
+	bool		has_final_sort;
+	bool		has_limit;
+	double		limit_tuples;
+	int64		count_est;
+	int64		offset_est;
+	Selectivity filter_sel;		/* fraction of rows passing a runtime join
+								 * filter evaluated remotely, or 0 if none */
+} PgFdwPathExtraData;
+
+/*
+ * A path of a foreign relation whose cost is estimated by
+ * estimate_path_costs_batch()
+ */
+typedef struct PgFdwPathCost
+{
+	List	   *param_join_conds;	/* join conditions of the path */
+	List	   *pathkeys;		/* pathkeys of the path */
+	bool		remote;			/* estimated remotely? */
+	double		rows;			/* estimated costs and size */
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+} PgFdwPathCost;
+
+/*
+ * A remote EXPLAIN command run for a batch of estimates, see
+ * estimate_path_costs_batch()
+ */
+typedef struct PgFdwRemoteEstimate
+{
+	UserMapping *user;			/* user mapping to run the command with */
+	char	   *sql;			/* EXPLAIN command */
+	bool		done;			/* are the estimates below obtained? */
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+} PgFdwRemoteEstimate;
+
+/*
+ * Remote EXPLAIN commands of the batch of estimates in progress, and whether
+ * the batch is still collecting them
+ */
+static List *batch_remote_estimates = NIL;
+static bool collecting_remote_estimates = false;
+
+/*
+ * Identify the attribute where data conversion fails.
+ */
+typedef struct ConversionLocation
+{
+	AttrNumber	cur_attno;		/* attribute number being processed, or 0 */
+	Relation	rel;			/* foreign table being processed, or NULL */
+	ForeignScanState *fsstate;	/* plan node being processed, or NULL */
+} ConversionLocation;
+
+/* Callback argument for ec_member_matches_foreign */
+typedef struct
+{
+	Expr	   *current;		/* current expr, or NULL if not yet found */
+	List	   *already_used;	/* expressions already dealt with */
+} ec_member_foreign_arg;
+
+/* Saved hook values in case of unload */
+static set_join_pathlist_hook_type prev_set_join_pathlist_hook = NULL;
+static get_relation_info_hook_type prev_get_relation_info_hook = NULL;
+static planner_hook_type prev_planner_hook = NULL;
+
+/*
+ * Numbers of the remote EXPLAINs issued and skipped, and the time spent on
+ * them, while planning the current query, to enforce the planning budget for
+ * remote estimates
+ */
+static int	remote_estimates_issued = 0;
+static int	remote_estimates_skipped = 0;
+static instr_time remote_estimates_time;
+
+/*
+ * How the batch of estimates in progress decided to estimate the current
+ * path, see want_remote_estimate()
+ */
+typedef enum
+{
+	BATCH_DECISION_NONE,		/* not decided by a batch */
+	BATCH_DECISION_REMOTE,		/* use remote estimates */
+	BATCH_DECISION_LOCAL,		/* estimate locally */
+} BatchDecision;
+
+static BatchDecision batch_decision = BATCH_DECISION_NONE;
+static bool last_remote_decision = false;
+
+/*
+ * How to send batches of rows inserted into a foreign table, as given by the
+ * "batch_insert_method" option.
+ */
+typedef enum PgFdwBatchInsertMethod
+{
+	BATCH_INSERT_INSERT,		/* multi-row INSERT ... VALUES */
+	BATCH_INSERT_COPY,			/* COPY ... FROM STDIN in text format */
+	BATCH_INSERT_BINARY_COPY,	/* same in binary format, where possible */
+} PgFdwBatchInsertMethod;
+
+/*
+ * FDW settings of a foreign table, resolved from the options of the table
+ * and its server and cached across queries, see get_relation_settings().
+ * Callers get copies of them, so that an invalidation arriving while they
+ * are in use can't pull the data out from under them.
+ */
+typedef struct PgFdwRelationSettings
+{
+	Oid			relid;			/* hash key (must be first) */
+	bool		valid;			/* false if catalogs changed while built */
+	uint32		hashvalue;		/* hash value of pg_foreign_table row */
+	MemoryContext cxt;			/* context holding the data below */
+	ForeignTable *table;
+	ForeignServer *server;
+	Oid			userid;			/* user of the cached user mapping */
+	UserMapping *user;			/* cached user mapping, or NULL */
+
+	/* Option values, see get_relation_settings() */
+	bool		use_remote_estimate;
+	Cost		fdw_startup_cost;
+	Cost		fdw_tuple_cost;
+	List	   *shippable_extensions;
+	int			fetch_size;
+	bool		async_capable;
+	bool		verify_collations;
+	bool		use_network_cost;
+	int			batch_size;
+	PgFdwBatchInsertMethod batch_insert_method;
+	int			batch_target_size;
+} PgFdwRelationSettings;
+
+static HTAB *relation_settings_hash = NULL;
+
+/* Number of invalidations seen, to detect ones arriving during a rebuild */
+static uint64 relation_settings_inval_count = 0;
+
+/*
+ * SQL functions
+ */
+PG_FUNCTION_INFO_V1(postgres_fdw_handler);
+
+/*
+ * FDW callback routines
+ */
+static void postgresGetForeignRelSize(PlannerInfo *root,
+									  RelOptInfo *baserel,
+									  Oid foreigntableid);
+static void postgresGetForeignPaths(PlannerInfo *root,
+									RelOptInfo *baserel,
+									Oid foreigntableid);
+static ForeignScan *postgresGetForeignPlan(PlannerInfo *root,
+										   RelOptInfo *foreignrel,
+										   Oid foreigntableid,
+										   ForeignPath *best_path,
+										   List *tlist,
+										   List *scan_clauses,
+										   Plan *outer_plan);
+static void postgresBeginForeignScan(ForeignScanState *node, int eflags);
+static TupleTableSlot *postgresIterateForeignScan(ForeignScanState *node);
+static void postgresReScanForeignScan(ForeignScanState *node);
+static void postgresEndForeignScan(ForeignScanState *node);
+static void postgresAddForeignUpdateTargets(PlannerInfo *root,
+											Index rtindex,
+											RangeTblEntry *target_rte,
+											Relation target_relation);
+static List *postgresPlanForeignModify(PlannerInfo *root,
+									   ModifyTable *plan,
+									   Index resultRelation,
+									   int subplan_index);
+static void postgresBeginForeignModify(ModifyTableState *mtstate,
+									   ResultRelInfo *resultRelInfo,
+									   List *fdw_private,
+									   int subplan_index,
+									   int eflags);
+static TupleTableSlot *postgresExecForeignInsert(EState *estate,
+												 ResultRelInfo *resultRelInfo,
+												 TupleTableSlot *slot,
+												 TupleTableSlot *planSlot);
+static TupleTableSlot **postgresExecForeignBatchInsert(EState *estate,
+													   ResultRelInfo *resultRelInfo,
+													   TupleTableSlot **slots,
+													   TupleTableSlot **planSlots,
+													   int *numSlots);
+static int	postgresGetForeignModifyBatchSize(ResultRelInfo *resultRelInfo);
+static TupleTableSlot *postgresExecForeignUpdate(EState *estate,
+												 ResultRelInfo *resultRelInfo,
+												 TupleTableSlot *slot,
+												 TupleTableSlot *planSlot);
+static TupleTableSlot *postgresExecForeignDelete(EState *estate,
+												 ResultRelInfo *resultRelInfo,
+												 TupleTableSlot *slot,
+												 TupleTableSlot *planSlot);
+static void postgresEndForeignModify(EState *estate,
+									 ResultRelInfo *resultRelInfo);
+static void postgresBeginForeignInsert(ModifyTableState *mtstate,
+									   ResultRelInfo *resultRelInfo);
+static void postgresEndForeignInsert(EState *estate,
+									 ResultRelInfo *resultRelInfo);
+static int	postgresIsForeignRelUpdatable(Relation rel);
+static bool postgresPlanDirectModify(PlannerInfo *root,
+									 ModifyTable *plan,
+									 Index resultRelation,
+									 int subplan_index);
+static void postgresBeginDirectModify(ForeignScanState *node, int eflags);
+static TupleTableSlot *postgresIterateDirectModify(ForeignScanState *node);
+static void postgresEndDirectModify(ForeignScanState *node);
+static void postgresExplainForeignScan(ForeignScanState *node,
+									   ExplainState *es);
+static void postgresExplainForeignModify(ModifyTableState *mtstate,
+										 ResultRelInfo *rinfo,
+										 List *fdw_private,
+										 int subplan_index,
+										 ExplainState *es);
+static void postgresExplainDirectModify(ForeignScanState *node,
+										ExplainState *es);
+static void postgresExecForeignTruncate(List *rels,
+										DropBehavior behavior,
+										bool restart_seqs);
+static bool postgresAnalyzeForeignTable(Relation relation,
+										AcquireSampleRowsFunc *func,
+										BlockNumber *totalpages);
+static List *postgresImportForeignSchema(ImportForeignSchemaStmt *stmt,
+										 Oid serverOid);
+static void postgresGetForeignJoinPaths(PlannerInfo *root,
+										RelOptInfo *joinrel,
+										RelOptInfo *outerrel,
+										RelOptInfo *innerrel,
+										JoinType jointype,
+										JoinPathExtraData *extra);
+static bool postgresRecheckForeignScan(ForeignScanState *node,
+									   TupleTableSlot *slot);
+static void postgresGetForeignUpperPaths(PlannerInfo *root,
+										 UpperRelationKind stage,
+										 RelOptInfo *input_rel,
+										 RelOptInfo *output_rel,
+										 void *extra);
+static bool postgresIsForeignPathAsyncCapable(ForeignPath *path);
+static void postgresForeignAsyncRequest(AsyncRequest *areq);
+static void postgresForeignAsyncConfigureWait(AsyncRequest *areq);
+static void postgresForeignAsyncNotify(AsyncRequest *areq);
+
+/*
+ * Helper functions
+ */
+static void estimate_path_cost_size(PlannerInfo *root,
+									RelOptInfo *foreignrel,
+									List *param_join_conds,
+									List *pathkeys,
+									PgFdwPathExtraData *fpextra,
+									double *p_rows, int *p_width,
+									Cost *p_startup_cost, Cost *p_total_cost);
+static void estimate_path_costs_batch(PlannerInfo *root,
+									  RelOptInfo *foreignrel,
+									  List *path_costs);
+static void fetch_remote_estimate(UserMapping *user,
+								  const char *sql,
+								  double *rows,
+								  int *width,
+								  Cost *startup_cost,
+								  Cost *total_cost);
+static void run_batch_remote_estimates(void);
+static void count_remote_estimates(RelOptInfo *foreignrel,
+								   int *issued, int *skipped);
+static bool want_remote_estimate(RelOptInfo *foreignrel,
+								 List *param_join_conds,
+								 List *pathkeys,
+								 PgFdwPathExtraData *fpextra);
+static void get_remote_estimate(const char *sql,
+								PGconn *conn,
+								double *rows,
+								int *width,
+								Cost *startup_cost,
+								Cost *total_cost);
+static void interpret_remote_estimate(PGresult *res,
+									  double *rows,
+									  int *width,
+									  Cost *startup_cost,
+									  Cost *total_cost);
+static double estimate_grouping_sets_groups(PlannerInfo *root,
+											List *grouped_tlist,
+											double input_rows);
+static void adjust_foreign_grouping_path_cost(PlannerInfo *root,
+											  List *pathkeys,
+											  double retrieved_rows,
+											  double width,
+											  double limit_tuples,
+											  Cost *p_startup_cost,
+											  Cost *p_run_cost);
+static bool ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
+									  EquivalenceClass *ec, EquivalenceMember *em,
+									  void *arg);
+static void create_cursor(ForeignScanState *node);
+static void fetch_more_data(ForeignScanState *node);
+static void close_cursor(PGconn *conn, unsigned int cursor_number,
+						 PgFdwConnState *conn_state);
+static PgFdwModifyState *create_foreign_modify(EState *estate,
+											   RangeTblEntry *rte,
+											   ResultRelInfo *resultRelInfo,
+											   CmdType operation,
+											   Plan *subplan,
+											   char *query,
+											   List *target_attrs,
+											   int values_end,
+											   bool has_returning,
+											   bool doNothing,
+											   List *retrieved_attrs);
+static TupleTableSlot **execute_foreign_modify(EState *estate,
+											   ResultRelInfo *resultRelInfo,
+											   CmdType operation,
+											   TupleTableSlot **slots,
+											   TupleTableSlot **planSlots,
+											   int *numSlots);
+static void prepare_foreign_modify(PgFdwModifyState *fmstate);
+static void prepare_and_describe(PgFdwModifyState *fmstate,
+								 const char *p_name);
+static void collect_pipeline_results(PGconn *conn, PGresult **results,
+									 int maxresults);
+static void choose_param_formats(PgFdwModifyState *fmstate, PGresult *res);
+static void prepare_copy_insert(PgFdwModifyState *fmstate,
+								RangeTblEntry *rte,
+								PgFdwBatchInsertMethod method);
+static bool remote_column_types_match(PgFdwModifyState *fmstate);
+static bool binary_transfer_ok(Oid typid);
+static int	execute_copy_insert(PgFdwModifyState *fmstate,
+								TupleTableSlot **slots,
+								int numSlots);
+static int	execute_adaptive_insert(PgFdwModifyState *fmstate,
+									TupleTableSlot **slots,
+									int numSlots);
+static int	next_batch_shape(PgFdwModifyState *fmstate, int limit);
+static void set_batch_shape(PgFdwModifyState *fmstate, int nrows);
+static const char **convert_prep_stmt_params(PgFdwModifyState *fmstate,
+											 ItemPointer tupleid,
+											 TupleTableSlot **slots,
+											 int numSlots,
+											 int **p_lengths,
+											 int **p_formats);
+static void store_returning_result(PgFdwModifyState *fmstate,
+								   TupleTableSlot *slot, PGresult *res);
+static void finish_foreign_modify(PgFdwModifyState *fmstate);
+static void deallocate_query(PgFdwModifyState *fmstate);
+static List *build_remote_returning(Index rtindex, Relation rel,
+									List *returningList);
+static void rebuild_fdw_scan_tlist(ForeignScan *fscan, List *tlist);
+static void execute_dml_stmt(ForeignScanState *node);
+static TupleTableSlot *get_returning_data(ForeignScanState *node);
+static void init_returning_filter(PgFdwDirectModifyState *dmstate,
+								  List *fdw_scan_tlist,
+								  Index rtindex);
+static TupleTableSlot *apply_returning_filter(PgFdwDirectModifyState *dmstate,
+											  ResultRelInfo *resultRelInfo,
+											  TupleTableSlot *slot,
+											  EState *estate);
+static void prepare_query_params(PlanState *node,
+								 List *fdw_exprs,
+								 int numParams,
+								 Bitmapset *text_params,
+								 FmgrInfo **param_flinfo,
+								 List **param_exprs,
+								 const char ***param_values,
+								 int **param_lengths,
+								 int **param_formats);
+static void process_query_params(ExprContext *econtext,
+								 FmgrInfo *param_flinfo,
+								 List *param_exprs,
+								 const char **param_values,
+								 int *param_lengths,
+								 int *param_formats);
+static int	postgresAcquireSampleRowsFunc(Relation relation, int elevel,
+										  HeapTuple *rows, int targrows,
+										  double *totalrows,
+										  double *totaldeadrows);
+static void analyze_row_processor(PGresult *res, int row,
+								  PgFdwAnalyzeState *astate);
+static void remember_analyze_child(Relation relation, BlockNumber totalpages);
+static void forget_analyze_children(void *arg);
+static PgFdwAnalyzeChild *find_analyze_child(Relation relation);
+static void acquire_children_sample_rows(PgFdwAnalyzeChild *first,
+										 int targrows);
+static void collect_children_sample_rows(List *round);
+static bool consume_child_sample_rows(PgFdwAnalyzeChildScan *scan);
+static int	return_child_sample_rows(PgFdwAnalyzeChild *child, int elevel,
+									 HeapTuple *rows, int targrows,
+									 double *totalrows,
+									 double *totaldeadrows);
+static PgFdwSamplingMethod get_analyze_sampling_method(ForeignServer *server,
+													   ForeignTable *table);
+static PgFdwSamplingMethod resolve_analyze_sampling_method(Relation relation,
+														   PGconn *conn,
+														   PgFdwSamplingMethod method,
+														   int targrows,
+														   double *sample_frac,
+														   double *reltuples);
+static void produce_tuple_asynchronously(AsyncRequest *areq, bool fetch);
+static void fetch_more_data_begin(AsyncRequest *areq);
+static void complete_pending_request(AsyncRequest *areq);
+static HeapTuple make_tuple_from_result_row(PGresult *res,
+											int row,
+											Relation rel,
+											AttInMetadata *attinmeta,
+											List *retrieved_attrs,
+											ForeignScanState *fsstate,
+											MemoryContext temp_context);
+static void conversion_error_callback(void *arg);
+static bool foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel,
+							JoinType jointype, RelOptInfo *outerrel, RelOptInfo *innerrel,
+							JoinPathExtraData *extra);
+static bool foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel,
+								Node *havingQual);
+static bool foreign_window_ok(PlannerInfo *root, RelOptInfo *window_rel);
+static bool foreign_distinct_ok(PlannerInfo *root, RelOptInfo *distinct_rel);
+static List *get_useful_pathkeys_for_relation(PlannerInfo *root,
+											  RelOptInfo *rel);
+static List *get_useful_ecs_for_relation(PlannerInfo *root, RelOptInfo *rel);
+static void add_paths_with_pathkeys_for_rel(PlannerInfo *root, RelOptInfo *rel,
+											Path *epq_path, List *restrictlist);
+static void add_foreign_grouping_paths(PlannerInfo *root,
+									   RelOptInfo *input_rel,
+									   RelOptInfo *grouped_rel,
+									   GroupPathExtraData *extra);
+static void add_foreign_window_paths(PlannerInfo *root,
+									 RelOptInfo *input_rel,
+									 RelOptInfo *window_rel);
+static void add_foreign_distinct_paths(PlannerInfo *root,
+									   RelOptInfo *input_rel,
+									   RelOptInfo *distinct_rel);
+static void add_foreign_ordered_paths(PlannerInfo *root,
+									  RelOptInfo *input_rel,
+									  RelOptInfo *ordered_rel);
+static void add_foreign_final_paths(PlannerInfo *root,
+									RelOptInfo *input_rel,
+									RelOptInfo *final_rel,
+									FinalPathExtraData *extra);
+static PlannedStmt *postgresPlanner(Query *parse,
+									const char *query_string,
+									int cursorOptions,
+									ParamListInfo boundParams);
+static void postgresGetRelationInfo(PlannerInfo *root,
+									Oid relationObjectId,
+									bool inhparent,
+									RelOptInfo *rel);
+static bool remote_index_provides_pathkeys(PlannerInfo *root,
+										   RelOptInfo *rel,
+										   List *pathkeys);
+static bool join_clause_matches_remote_index(RelOptInfo *baserel,
+											 RestrictInfo *rinfo);
+static void postgresSetJoinPathlist(PlannerInfo *root,
+									RelOptInfo *joinrel,
+									RelOptInfo *outerrel,
+									RelOptInfo *innerrel,
+									JoinType jointype,
+									JoinPathExtraData *extra);
+static void add_foreign_keyset_join_path(PlannerInfo *root,
+										 RelOptInfo *joinrel,
+										 RelOptInfo *outerrel,
+										 RelOptInfo *innerrel,
+										 JoinType jointype,
+										 JoinPathExtraData *extra);
+static bool keyset_local_rel_is_volatile(PlannerInfo *root,
+										 RelOptInfo *rel);
+static void add_keyset_hashjoin_path(PlannerInfo *root,
+									 RelOptInfo *joinrel,
+									 RelOptInfo *outerrel,
+									 JoinType jointype,
+									 JoinPathExtraData *extra,
+									 List *hashclauses,
+									 Path *local_path,
+									 Selectivity filter_sel,
+									 Cost shipping_cost,
+									 List *fdw_private);
+static Expr *make_bloom_filter_clause(PlannerInfo *root,
+									  RelOptInfo *baserel,
+									  Expr *foreign_key,
+									  Expr *local_key);
+static Datum *collect_keyset_values(ForeignScanState *node, int *nkeys);
+static void build_keyset_filter(ForeignScanState *node,
+								Datum *keys, int nkeys,
+								Datum *keyset, bool *keyset_isnull,
+								Datum *bloom, bool *bloom_isnull);
+static bool keyset_staging_allowed(PGconn *conn);
+static void stage_keyset_values(ForeignScanState *node,
+								Datum *keys, int nkeys);
+static void append_copy_text_value(StringInfo buf, const char *value);
+static int	keyset_value_cmp(const void *a, const void *b, void *arg);
+static int	sort_unique_keyset_values(Datum *keys, int nkeys,
+									  SortSupport ssup,
+									  bool typbyval, int16 typlen);
+static PgFdwRelationSettings *get_relation_settings(Oid relid);
+static void relation_settings_inval_callback(Datum arg, int cacheid,
+											 uint32 hashvalue);
+static void apply_relation_settings(PgFdwRelationInfo *fpinfo, Oid relid);
+static UserMapping *get_relation_user_mapping(Oid relid, Oid userid);
+static UserMapping *copy_user_mapping(const UserMapping *user);
+static void merge_fdw_options(PgFdwRelationInfo *fpinfo,
+							  const PgFdwRelationInfo *fpinfo_o,
+							  const PgFdwRelationInfo *fpinfo_i);
+static int	get_batch_size_option(Relation rel);
+static PgFdwBatchInsertMethod get_batch_insert_method(Relation rel);
+static int	get_batch_target_size(Relation rel);
+
+
+/*
+ * Foreign-data wrapper handler function: return a struct with pointers
+ * to my callback routines.
+ */
+Datum
+postgres_fdw_handler(PG_FUNCTION_ARGS)
+{
+	FdwRoutine *routine = makeNode(FdwRoutine);
+
+	/* Functions for scanning foreign tables */
+	routine->GetForeignRelSize = postgresGetForeignRelSize;
+	routine->GetForeignPaths = postgresGetForeignPaths;
+	routine->GetForeignPlan = postgresGetForeignPlan;
+	routine->BeginForeignScan = postgresBeginForeignScan;
+	routine->IterateForeignScan = postgresIterateForeignScan;
+	routine->ReScanForeignScan = postgresReScanForeignScan;
+	routine->EndForeignScan = postgresEndForeignScan;
+
+	/* Functions for updating foreign tables */
+	routine->AddForeignUpdateTargets = postgresAddForeignUpdateTargets;
+	routine->PlanForeignModify = postgresPlanForeignModify;
+	routine->BeginForeignModify = postgresBeginForeignModify;
+	routine->ExecForeignInsert = postgresExecForeignInsert;
+	routine->ExecForeignBatchInsert = postgresExecForeignBatchInsert;
+	routine->GetForeignModifyBatchSize = postgresGetForeignModifyBatchSize;
+	routine->ExecForeignUpdate = postgresExecForeignUpdate;
+	routine->ExecForeignDelete = postgresExecForeignDelete;
+	routine->EndForeignModify = postgresEndForeignModify;
+	routine->BeginForeignInsert = postgresBeginForeignInsert;
+	routine->EndForeignInsert = postgresEndForeignInsert;
+	routine->IsForeignRelUpdatable = postgresIsForeignRelUpdatable;
+	routine->PlanDirectModify = postgresPlanDirectModify;
+	routine->BeginDirectModify = postgresBeginDirectModify;
+	routine->IterateDirectModify = postgresIterateDirectModify;
+	routine->EndDirectModify = postgresEndDirectModify;
+
+	/* Function for EvalPlanQual rechecks */
+	routine->RecheckForeignScan = postgresRecheckForeignScan;
+	/* Support functions for EXPLAIN */
+	routine->ExplainForeignScan = postgresExplainForeignScan;
+	routine->ExplainForeignModify = postgresExplainForeignModify;
+	routine->ExplainDirectModify = postgresExplainDirectModify;
+
+	/* Support function for TRUNCATE */
+	routine->ExecForeignTruncate = postgresExecForeignTruncate;
+
+	/* Support functions for ANALYZE */
+	routine->AnalyzeForeignTable = postgresAnalyzeForeignTable;
+
+	/* Support functions for IMPORT FOREIGN SCHEMA */
+	routine->ImportForeignSchema = postgresImportForeignSchema;
+
+	/* Support functions for join push-down */
+	routine->GetForeignJoinPaths = postgresGetForeignJoinPaths;
+
+	/* Support functions for upper relation push-down */
+	routine->GetForeignUpperPaths = postgresGetForeignUpperPaths;
+
+	/* Support functions for asynchronous execution */
+	routine->IsForeignPathAsyncCapable = postgresIsForeignPathAsyncCapable;
+	routine->ForeignAsyncRequest = postgresForeignAsyncRequest;
+	routine->ForeignAsyncConfigureWait = postgresForeignAsyncConfigureWait;
+	routine->ForeignAsyncNotify = postgresForeignAsyncNotify;
+
+	PG_RETURN_POINTER(routine);
+}
+
+/*
+ * postgresGetForeignRelSize
+ *		Estimate # of rows and width of the result of the scan
+ *
+ * We should consider the effect of all baserestrictinfo clauses here, but
+ * not any join clauses.
+ */
+static void
+postgresGetForeignRelSize(PlannerInfo *root,
+						  RelOptInfo *baserel,
+						  Oid foreigntableid)
+{
+	PgFdwRelationInfo *fpinfo;
+	ListCell   *lc;
+
+	/*
+	 * We use PgFdwRelationInfo to pass various information to subsequent
+	 * functions.
+	 */
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	baserel->fdw_private = (void *) fpinfo;
+
+	/* Base foreign tables need to be pushed down always. */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Look up foreign-table catalog info and extract user-settable option
+	 * values.  These are cached across queries, since resolving them for
+	 * each of many foreign partitions adds up.
+	 */
+	apply_relation_settings(fpinfo, foreigntableid);
+
+	/*
+	 * If the table or the server is configured to use remote estimates,
+	 * identify which user to do remote access as during planning.  This
+	 * should match what ExecCheckPermissions() does.  If we fail due to lack
+	 * of permissions, the query would have failed at runtime anyway.
+	 */
+	if (fpinfo->use_remote_estimate)
+	{
+		Oid			userid;
+
+		userid = OidIsValid(baserel->userid) ? baserel->userid : GetUserId();
+		fpinfo->user = get_relation_user_mapping(foreigntableid, userid);
+	}
+	else
+		fpinfo->user = NULL;
+
+	/*
+	 * Identify which baserestrictinfo clauses can be sent to the remote
+	 * server and which can't.
+	 */
+	classifyConditions(root, baserel, baserel->baserestrictinfo,
+					   &fpinfo->remote_conds, &fpinfo->local_conds);
+
+	/*
+	 * Identify which attributes will need to be retrieved from the remote
+	 * server.  These include all attrs needed for joins or final output, plus
+	 * all attrs used in the local_conds.  (Note: if we end up using a
+	 * parameterized scan, it's possible that some of the join clauses will be
+	 * sent to the remote and thus we wouldn't really need to retrieve the
+	 * columns used in them.  Doesn't seem worth detecting that case though.)
+	 */
+	fpinfo->attrs_used = NULL;
+	pull_varattnos((Node *) baserel->reltarget->exprs, baserel->relid,
+				   &fpinfo->attrs_used);
+	foreach(lc, fpinfo->local_conds)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+		pull_varattnos((Node *) rinfo->clause, baserel->relid,
+					   &fpinfo->attrs_used);
+	}
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path.  The best we can do for these
+	 * conditions is to estimate selectivity on the basis of local statistics.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 baserel->relid,
+													 JOIN_INNER,
+													 NULL);
+
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/*
+	 * Set # of retrieved rows and cached relation costs to some negative
+	 * value, so that we can detect when they are set to some sensible values,
+	 * during one (usually the first) of the calls to estimate_path_cost_size.
+	 */
+	fpinfo->retrieved_rows = -1;
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * If the table or the server is configured to use remote estimates,
+	 * connect to the foreign server and execute EXPLAIN to estimate the
+	 * number of rows selected by the restriction clauses, as well as the
+	 * average row width.  Otherwise, estimate using whatever statistics we
+	 * have locally, in a way similar to ordinary tables.
+	 */
+	if (fpinfo->use_remote_estimate)
+	{
+		/*
+		 * Get cost/size estimates with help of remote server.  Save the
+		 * values in fpinfo so we don't need to do it again to generate the
+		 * basic foreign path.
+		 */
+		estimate_path_cost_size(root, baserel, NIL, NIL, NULL,
+								&fpinfo->rows, &fpinfo->width,
+								&fpinfo->startup_cost, &fpinfo->total_cost);
+
+		/* Report estimated baserel size to planner. */
+		baserel->rows = fpinfo->rows;
+		baserel->reltarget->width = fpinfo->width;
+	}
+	else
+	{
+		/*
+		 * If the foreign table has never been ANALYZEd, it will have
+		 * reltuples < 0, meaning "unknown".  We can't do much if we're not
+		 * allowed to consult the remote server, but we can use a hack similar
+		 * to plancat.c's treatment of empty relations: use a minimum size
+		 * estimate of 10 pages, and divide by the column-datatype-based width
+		 * estimate to get the corresponding number of tuples.
+		 */
+		if (baserel->tuples < 0)
+		{
+			baserel->pages = 10;
+			baserel->tuples =
+				(10 * BLCKSZ) / (baserel->reltarget->width +
+								 MAXALIGN(SizeofHeapTupleHeader));
+		}
+
+		/* Estimate baserel size as best we can with local statistics. */
+		set_baserel_size_estimates(root, baserel);
+
+		/* Fill in basically-bogus cost estimates for use later. */
+		estimate_path_cost_size(root, baserel, NIL, NIL, NULL,
+								&fpinfo->rows, &fpinfo->width,
+								&fpinfo->startup_cost, &fpinfo->total_cost);
+	}
+
+	/*
+	 * fpinfo->relation_name gets the numeric rangetable index of the foreign
+	 * table RTE.  (If this query gets EXPLAIN'd, we'll convert that to a
+	 * human-readable string at that time.)
+	 */
+	fpinfo->relation_name = psprintf("%u", baserel->relid);
+
+	/* No outer and inner relations. */
+	fpinfo->make_outerrel_subquery = false;
+	fpinfo->make_innerrel_subquery = false;
+	fpinfo->lower_subquery_rels = NULL;
+	fpinfo->hidden_subquery_rels = NULL;
+	/* Set the relation index. */
+	fpinfo->relation_index = baserel->relid;
+}
+
+/*
+ * get_useful_ecs_for_relation
+ *		Determine which EquivalenceClasses might be involved in useful
+ *		orderings of this relation.
+ *
+ * This function is in some respects a mirror image of the core function
+ * pathkeys_useful_for_merging: for a regular table, we know what indexes
+ * we have and want to test whether any of them are useful.  For a foreign
+ * table, we don't know what indexes are present on the remote side but
+ * want to speculate about which ones we'd like to use if they existed.
+ *
+ * This function returns a list of potentially-useful equivalence classes,
+ * but it does not guarantee that an EquivalenceMember exists which contains
+ * Vars only from the given relation.  For example, given ft1 JOIN t1 ON
+ * ft1.x + t1.x = 0, this function will say that the equivalence class
+ * containing ft1.x + t1.x is potentially useful.  Supposing ft1 is remote and
+ * t1 is local (or on a different server), it will turn out that no useful
+ * ORDER BY clause can be generated.  It's not our job to figure that out
+ * here; we're only interested in identifying relevant ECs.
+ */
+static List *
+get_useful_ecs_for_relation(PlannerInfo *root, RelOptInfo *rel)
+{
+	List	   *useful_eclass_list = NIL;
+	ListCell   *lc;
+	Relids		relids;
+
+	/*
+	 * First, consider whether any active EC is potentially useful for a merge
+	 * join against this relation.
+	 */
+	if (rel->has_eclass_joins)
+	{
+		foreach(lc, root->eq_classes)
+		{
+			EquivalenceClass *cur_ec = (EquivalenceClass *) lfirst(lc);
+
+			if (eclass_useful_for_merging(root, cur_ec, rel))
+				useful_eclass_list = lappend(useful_eclass_list, cur_ec);
+		}
+	}
+
+	/*
+	 * Next, consider whether there are any non-EC derivable join clauses that
+	 * are merge-joinable.  If the joininfo list is empty, we can exit
+	 * quickly.
+	 */
+	if (rel->joininfo == NIL)
+		return useful_eclass_list;
+
+	/* If this is a child rel, we must use the topmost parent rel to search. */
+	if (IS_OTHER_REL(rel))
+	{
+		Assert(!bms_is_empty(rel->top_parent_relids));
+		relids = rel->top_parent_relids;
+	}
+	else
+		relids = rel->relids;
+
+	/* Check each join clause in turn. */
+	foreach(lc, rel->joininfo)
+	{
+		RestrictInfo *restrictinfo = (RestrictInfo *) lfirst(lc);
+
+		/* Consider only mergejoinable clauses */
+		if (restrictinfo->mergeopfamilies == NIL)
+			continue;
+
+		/* Make sure we've got canonical ECs. */
+		update_mergeclause_eclasses(root, restrictinfo);
+
+		/*
+		 * restrictinfo->mergeopfamilies != NIL is sufficient to guarantee
+		 * that left_ec and right_ec will be initialized, per comments in
+		 * distribute_qual_to_rels.
+		 *
+		 * We want to identify which side of this merge-joinable clause
+		 * contains columns from the relation produced by this RelOptInfo. We
+		 * test for overlap, not containment, because there could be extra
+		 * relations on either side.  For example, suppose we've got something
+		 * like ((A JOIN B ON A.x = B.x) JOIN C ON A.y = C.y) LEFT JOIN D ON
+		 * A.y = D.y.  The input rel might be the joinrel between A and B, and
+		 * we'll consider the join clause A.y = D.y. relids contains a
+		 * relation not involved in the join class (B) and the equivalence
+		 * class for the left-hand side of the clause contains a relation not
+		 * involved in the input rel (C).  Despite the fact that we have only
+		 * overlap and not containment in either direction, A.y is potentially
+		 * useful as a sort column.
+		 *
+		 * Note that it's even possible that relids overlaps neither side of
+		 * the join clause.  For example, consider A LEFT JOIN B ON A.x = B.x
+		 * AND A.x = 1.  The clause A.x = 1 will appear in B's joininfo list,
+		 * but overlaps neither side of B.  In that case, we just skip this
+		 * join clause, since it doesn't suggest a useful sort order for this
+		 * relation.
+		 */
+		if (bms_overlap(relids, restrictinfo->right_ec->ec_relids))
+			useful_eclass_list = list_append_unique_ptr(useful_eclass_list,
+														restrictinfo->right_ec);
+		else if (bms_overlap(relids, restrictinfo->left_ec->ec_relids))
+			useful_eclass_list = list_append_unique_ptr(useful_eclass_list,
+														restrictinfo->left_ec);
+	}
+
+	return useful_eclass_list;
+}
+
+/*
+ * get_useful_pathkeys_for_relation
+ *		Determine which orderings of a relation might be useful.
+ *
+ * Getting data in sorted order can be useful either because the requested
+ * order matches the final output ordering for the overall query we're
+ * planning, or because it enables an efficient merge join.  Here, we try
+ * to figure out which pathkeys to consider.
+ */
+static List *
+get_useful_pathkeys_for_relation(PlannerInfo *root, RelOptInfo *rel)
+{
+	List	   *useful_pathkeys_list = NIL;
+	List	   *useful_eclass_list;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+	EquivalenceClass *query_ec = NULL;
+	ListCell   *lc;
+
+	/*
+	 * Pushing the query_pathkeys to the remote server is always worth
+	 * considering, because it might let us avoid a local sort.
+	 */
+	fpinfo->qp_is_pushdown_safe = false;
+	if (root->query_pathkeys)
+	{
+		bool		query_pathkeys_ok = true;
+
+		foreach(lc, root->query_pathkeys)
+		{
+			PathKey    *pathkey = (PathKey *) lfirst(lc);
+
+			/*
+			 * The planner and executor don't have any clever strategy for
+			 * taking data sorted by a prefix of the query's pathkeys and
+			 * getting it to be sorted by all of those pathkeys. We'll just
+			 * end up resorting the entire data set.  So, unless we can push
+			 * down all of the query pathkeys, forget it.
+			 */
+			if (!is_foreign_pathkey(root, rel, pathkey))
+			{
+				query_pathkeys_ok = false;
+				break;
+			}
+		}
+
+		if (query_pathkeys_ok)
+		{
+			useful_pathkeys_list = list_make1(list_copy(root->query_pathkeys));
+			fpinfo->qp_is_pushdown_safe = true;
+		}
+	}
+
+	/*
+	 * The sort orders that the remote indexes we know about can produce
+	 * without a sort (see pgfdw_get_remote_indexes()) are not speculative,
+	 * so consider them whenever they are useful for merge joins or for the
+	 * query's ordering, whether or not we're using remote estimates.
+	 */
+	foreach(lc, rel->indexlist)
+	{
+		IndexOptInfo *index = (IndexOptInfo *) lfirst(lc);
+		ScanDirection scandir;
+
+		for (scandir = BackwardScanDirection;
+			 scandir <= ForwardScanDirection;
+			 scandir += 2)
+		{
+			List	   *index_pathkeys;
+			bool		index_pathkeys_ok = true;
+			ListCell   *lc2;
+
+			index_pathkeys = build_index_pathkeys(root, index, scandir);
+			index_pathkeys = truncate_useless_pathkeys(root, rel,
+													   index_pathkeys);
+			if (index_pathkeys == NIL)
+				continue;
+
+			foreach(lc2, index_pathkeys)
+			{
+				if (!is_foreign_pathkey(root, rel, (PathKey *) lfirst(lc2)))
+				{
+					index_pathkeys_ok = false;
+					break;
+				}
+			}
+			foreach(lc2, useful_pathkeys_list)
+			{
+				if (compare_pathkeys((List *) lfirst(lc2),
+									 index_pathkeys) == PATHKEYS_EQUAL)
+				{
+					index_pathkeys_ok = false;
+					break;
+				}
+			}
+
+			if (index_pathkeys_ok)
+				useful_pathkeys_list = lappend(useful_pathkeys_list,
+											   index_pathkeys);
+		}
+	}
+
+	/*
+	 * Even if we're not using remote estimates, having the remote side do the
+	 * sort generally won't be any worse than doing it locally, and it might
+	 * be much better if the remote side can generate data in the right order
+	 * without needing a sort at all.  However, what we're going to do next is
+	 * try to generate pathkeys that seem promising for possible merge joins,
+	 * and that's more speculative.  A wrong choice might hurt quite a bit, so
+	 * bail out if we can't use remote estimates.
+	 */
+	if (!fpinfo->use_remote_estimate)
+		return useful_pathkeys_list;
+
+	/* Get the list of interesting EquivalenceClasses. */
+	useful_eclass_list = get_useful_ecs_for_relation(root, rel);
+
+	/* Extract unique EC for query, if any, so we don't consider it again. */
+	if (list_length(root->query_pathkeys) == 1)
+	{
+		PathKey    *query_pathkey = linitial(root->query_pathkeys);
+
+		query_ec = query_pathkey->pk_eclass;
+	}
+
+	/*
+	 * As a heuristic, the only pathkeys we consider here are those of length
+	 * one.  It's surely possible to consider more, but since each one we
+	 * choose to consider will generate a round-trip to the remote side, we
+	 * need to be a bit cautious here.  It would sure be nice to have a local
+	 * cache of information about remote index definitions...
+	 */
+	foreach(lc, useful_eclass_list)
+	{
+		EquivalenceClass *cur_ec = lfirst(lc);
+		PathKey    *pathkey;
+
+		/* If redundant with what we did above, skip it. */
+		if (cur_ec == query_ec)
+			continue;
+
+		/* Can't push down the sort if the EC's opfamily is not shippable. */
+		if (!is_shippable(linitial_oid(cur_ec->ec_opfamilies),
+						  OperatorFamilyRelationId, fpinfo))
+			continue;
+
+		/* If no pushable expression for this rel, skip it. */
+		if (find_em_for_rel(root, cur_ec, rel) == NULL)
+			continue;
+
+		/* Looks like we can generate a pathkey, so let's do it. */
+		pathkey = make_canonical_pathkey(root, cur_ec,
+										 linitial_oid(cur_ec->ec_opfamilies),
+										 BTLessStrategyNumber,
+										 false);
+		useful_pathkeys_list = lappend(useful_pathkeys_list,
+									   list_make1(pathkey));
+	}
+
+	return useful_pathkeys_list;
+}
+
+/*
+ * postgresGetForeignPaths
+ *		Create possible scan paths for a scan on the foreign table
+ */
+static void
+postgresGetForeignPaths(PlannerInfo *root,
+						RelOptInfo *baserel,
+						Oid foreigntableid)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) baserel->fdw_private;
+	ForeignPath *path;
+	List	   *ppi_list;
+	List	   *path_costs = NIL;
+	ListCell   *lc;
+	ListCell   *lc2;
+
+	/*
+	 * Create simplest ForeignScan path node and add it to baserel.  This path
+	 * corresponds to SeqScan path of regular tables (though depending on what
+	 * baserestrict conditions we were able to send to remote, there might
+	 * actually be an indexscan happening there).  We already did all the work
+	 * to estimate cost and size of this path.
+	 *
+	 * Although this path uses no join clauses, it could still have required
+	 * parameterization due to LATERAL refs in its tlist.
+	 */
+	path = create_foreignscan_path(root, baserel,
+								   NULL,	/* default pathtarget */
+								   fpinfo->rows,
+								   fpinfo->startup_cost,
+								   fpinfo->total_cost,
+								   NIL, /* no pathkeys */
+								   baserel->lateral_relids,
+								   NULL,	/* no extra plan */
+								   NIL, /* no fdw_restrictinfo list */
+								   NIL);	/* no fdw_private list */
+	add_path(baserel, (Path *) path);
+
+	/* Add paths with pathkeys */
+	add_paths_with_pathkeys_for_rel(root, baserel, NULL, NIL);
+
+	/*
+	 * If we're not using remote estimates, we have no way to estimate whether
+	 * any join clauses would be worth sending across, unless they match the
+	 * remote indexes we know about, in which case the remote server can
+	 * evaluate them by index lookups.  Stop here if there's none.
+	 */
+	if (!fpinfo->use_remote_estimate && baserel->indexlist == NIL)
+		return;
+
+	/*
+	 * Thumb through all join clauses for the rel to identify which outer
+	 * relations could supply one or more safe-to-send-to-remote join clauses.
+	 * We'll build a parameterized path for each such outer relation.
+	 *
+	 * It's convenient to manage this by representing each candidate outer
+	 * relation by the ParamPathInfo node for it.  We can then use the
+	 * ppi_clauses list in the ParamPathInfo node directly as a list of the
+	 * interesting join clauses for that rel.  This takes care of the
+	 * possibility that there are multiple safe join clauses for such a rel,
+	 * and also ensures that we account for unsafe join clauses that we'll
+	 * still have to enforce locally (since the parameterized-path machinery
+	 * insists that we handle all movable clauses).
+	 */
+	ppi_list = NIL;
+	foreach(lc, baserel->joininfo)
+	{
+		RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+		Relids		required_outer;
+		ParamPathInfo *param_info;
+
+		/* Check if clause can be moved to this rel */
+		if (!join_clause_is_movable_to(rinfo, baserel))
+			continue;
+
+		/* See if it is safe to send to remote */
+		if (!is_foreign_expr(root, baserel, rinfo->clause))
+			continue;
+
+		/* Without remote estimates, it must match a remote index */
+		if (!fpinfo->use_remote_estimate &&
+			!join_clause_matches_remote_index(baserel, rinfo))
+			continue;
+
+		/* Calculate required outer rels for the resulting path */
+		required_outer = bms_union(rinfo->clause_relids,
+								   baserel->lateral_relids);
+		/* We do not want the foreign rel itself listed in required_outer */
+		required_outer = bms_del_member(required_outer, baserel->relid);
+
+		/*
+		 * required_outer probably can't be empty here, but if it were, we
+		 * couldn't make a parameterized path.
+		 */
+		if (bms_is_empty(required_outer))
+			continue;
+
+		/* Get the ParamPathInfo */
+		param_info = get_baserel_parampathinfo(root, baserel,
+											   required_outer);
+		Assert(param_info != NULL);
+
+		/*
+		 * Add it to list unless we already have it.  Testing pointer equality
+		 * is OK since get_baserel_parampathinfo won't make duplicates.
+		 */
+		ppi_list = list_append_unique_ptr(ppi_list, param_info);
+	}
+
+	/*
+	 * The above scan examined only "generic" join clauses, not those that
+	 * were absorbed into EquivalenceClauses.  See if we can make anything out
+	 * of EquivalenceClauses.
+	 */
+	if (baserel->has_eclass_joins)
+	{
+		/*
+		 * We repeatedly scan the eclass list looking for column references
+		 * (or expressions) belonging to the foreign rel.  Each time we find
+		 * one, we generate a list of equivalence joinclauses for it, and then
+		 * see if any are safe to send to the remote.  Repeat till there are
+		 * no more candidate EC members.
+		 */
+		ec_member_foreign_arg arg;
+
+		arg.already_used = NIL;
+		for (;;)
+		{
+			List	   *clauses;
+
+			/* Make clauses, skipping any that join to lateral_referencers */
+			arg.current = NULL;
+			clauses = generate_implied_equalities_for_column(root,
+															 baserel,
+															 ec_member_matches_foreign,
+															 (void *) &arg,
+															 baserel->lateral_referencers);
+
+			/* Done if there are no more expressions in the foreign rel */
+			if (arg.current == NULL)
+			{
+				Assert(clauses == NIL);
+				break;
+			}
+
+			/* Scan the extracted join clauses */
+			foreach(lc, clauses)
+			{
+				RestrictInfo *rinfo = (RestrictInfo *) lfirst(lc);
+				Relids		required_outer;
+				ParamPathInfo *param_info;
+
+				/* Check if clause can be moved to this rel */
+				if (!join_clause_is_movable_to(rinfo, baserel))
+					continue;
+
+				/* See if it is safe to send to remote */
+				if (!is_foreign_expr(root, baserel, rinfo->clause))
+					continue;
+
+				/* Without remote estimates, it must match a remote index */
+				if (!fpinfo->use_remote_estimate &&
+					!join_clause_matches_remote_index(baserel, rinfo))
+					continue;
+
+				/* Calculate required outer rels for the resulting path */
+				required_outer = bms_union(rinfo->clause_relids,
+										   baserel->lateral_relids);
+				required_outer = bms_del_member(required_outer, baserel->relid);
+				if (bms_is_empty(required_outer))
+					continue;
+
+				/* Get the ParamPathInfo */
+				param_info = get_baserel_parampathinfo(root, baserel,
+													   required_outer);
+				Assert(param_info != NULL);
+
+				/* Add it to list unless we already have it */
+				ppi_list = list_append_unique_ptr(ppi_list, param_info);
+			}
+
+			/* Try again, now ignoring the expression we found this time */
+			arg.already_used = lappend(arg.already_used, arg.current);
+		}
+	}
+
+	/*
+	 * Get cost estimates for all the useful outer relations at once.
+	 */
+	foreach(lc, ppi_list)
+	{
+		ParamPathInfo *param_info = (ParamPathInfo *) lfirst(lc);
+		PgFdwPathCost *pc = (PgFdwPathCost *) palloc0(sizeof(PgFdwPathCost));
+
+		pc->param_join_conds = param_info->ppi_clauses;
+		path_costs = lappend(path_costs, pc);
+	}
+	estimate_path_costs_batch(root, baserel, path_costs);
+
+	/*
+	 * Now build a path for each useful outer relation.
+	 */
+	forboth(lc, ppi_list, lc2, path_costs)
+	{
+		ParamPathInfo *param_info = (ParamPathInfo *) lfirst(lc);
+		PgFdwPathCost *pc = (PgFdwPathCost *) lfirst(lc2);
+		double		rows = pc->rows;
+		Cost		startup_cost = pc->startup_cost;
+		Cost		total_cost = pc->total_cost;
+
+		/*
+		 * ppi_rows currently won't get looked at by anything, but still we
+		 * may as well ensure that it matches our idea of the rowcount.
+		 */
+		param_info->ppi_rows = rows;
+
+		/* Make the path */
+		path = create_foreignscan_path(root, baserel,
+									   NULL,	/* default pathtarget */
+									   rows,
+									   startup_cost,
+									   total_cost,
+									   NIL, /* no pathkeys */
+									   param_info->ppi_req_outer,
+									   NULL,
+									   NIL, /* no fdw_restrictinfo list */
+									   NIL);	/* no fdw_private list */
+		add_path(baserel, (Path *) path);
+	}
+}
+
+/*
+ * postgresGetForeignPlan
+ *		Create ForeignScan plan node which implements selected best path
+ */
+static ForeignScan *
+postgresGetForeignPlan(PlannerInfo *root,
+					   RelOptInfo *foreignrel,
+					   Oid foreigntableid,
+					   ForeignPath *best_path,
+					   List *tlist,
+					   List *scan_clauses,
+					   Plan *outer_plan)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	Index		scan_relid;
+	List	   *fdw_private;
+	List	   *remote_exprs = NIL;
+	List	   *local_exprs = NIL;
+	List	   *params_list = NIL;
+	List	   *fdw_scan_tlist = NIL;
+	List	   *fdw_recheck_quals = NIL;
+	List	   *retrieved_attrs;
+	StringInfoData sql;
+	bool		has_final_sort = false;
+	bool		has_limit = false;
+	Expr	   *keyset_clause = NULL;
+	Expr	   *keyset_local_key = NULL;
+	Expr	   *bloom_clause = NULL;
+	Expr	   *staged_clause = NULL;
+	List	   *deparse_exprs;
+	int			keyset_param = -1;
+	AttrNumber	keyset_attno = InvalidAttrNumber;
+	int			bloom_param = -1;
+	char	   *staged_sql = NULL;
+	ListCell   *lc;
+
+	/*
+	 * Get FDW private data created by postgresGetForeignUpperPaths() or
+	 * add_foreign_keyset_join_path(), if any.
+	 */
+	if (best_path->fdw_private)
+	{
+		has_final_sort = boolVal(list_nth(best_path->fdw_private,
+										  FdwPathPrivateHasFinalSort));
+		has_limit = boolVal(list_nth(best_path->fdw_private,
+									 FdwPathPrivateHasLimit));
+		if (list_length(best_path->fdw_private) > FdwPathPrivateKeySetClause)
+		{
+			keyset_clause = (Expr *) list_nth(best_path->fdw_private,
+											  FdwPathPrivateKeySetClause);
+			keyset_local_key = (Expr *) list_nth(best_path->fdw_private,
+												 FdwPathPrivateKeySetLocalKey);
+			bloom_clause = (Expr *) list_nth(best_path->fdw_private,
+											 FdwPathPrivateBloomClause);
+		}
+		if (list_length(best_path->fdw_private) >
+			FdwPathPrivateStagedKeySetClause)
+			staged_clause = (Expr *) list_nth(best_path->fdw_private,
+											  FdwPathPrivateStagedKeySetClause);
+	}
+
+	if (IS_SIMPLE_REL(foreignrel))
+	{
+		/*
+		 * For base relations, set scan_relid as the relid of the relation.
+		 */
+		scan_relid = foreignrel->relid;
+
+		/*
+		 * In a base-relation scan, we must apply the given scan_clauses.
+		 *
+		 * Separate the scan_clauses into those that can be executed remotely
+		 * and those that can't.  baserestrictinfo clauses that were
+		 * previously determined to be safe or unsafe by classifyConditions
+		 * are found in fpinfo->remote_conds and fpinfo->local_conds. Anything
+		 * else in the scan_clauses list will be a join clause, which we have
+		 * to check for remote-safety.
+		 *
+		 * Note: the join clauses we see here should be the exact same ones
+		 * previously examined by postgresGetForeignPaths.  Possibly it'd be
+		 * worth passing forward the classification work done then, rather
+		 * than repeating it here.
+		 *
+		 * This code must match "extract_actual_clauses(scan_clauses, false)"
+		 * except for the additional decision about remote versus local
+		 * execution.
+		 */
+		foreach(lc, scan_clauses)
+		{
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+			/* Ignore any pseudoconstants, they're dealt with elsewhere */
+			if (rinfo->pseudoconstant)
+				continue;
+
+			if (list_member_ptr(fpinfo->remote_conds, rinfo))
+				remote_exprs = lappend(remote_exprs, rinfo->clause);
+			else if (list_member_ptr(fpinfo->local_conds, rinfo))
+				local_exprs = lappend(local_exprs, rinfo->clause);
+			else if (is_foreign_expr(root, foreignrel, rinfo->clause))
+				remote_exprs = lappend(remote_exprs, rinfo->clause);
+			else
+				local_exprs = lappend(local_exprs, rinfo->clause);
+		}
+
+		/*
+		 * For a base-relation scan, we have to support EPQ recheck, which
+		 * should recheck all the remote quals.
+		 */
+		fdw_recheck_quals = remote_exprs;
+
+		/*
+		 * If this is the foreign side of a key-set semi-join, the outer plan
+		 * produces the local join keys.  Make sure the key expression is
+		 * available in its output, so that the executor can collect the keys
+		 * before sending the remote query.
+		 */
+		if (keyset_clause)
+		{
+			TargetEntry *tle;
+
+			Assert(outer_plan);
+			tle = tlist_member(keyset_local_key, outer_plan->targetlist);
+			if (tle == NULL)
+			{
+				List	   *newtlist = list_copy(outer_plan->targetlist);
+
+				tle = makeTargetEntry(copyObject(keyset_local_key),
+									  list_length(newtlist) + 1,
+									  NULL,
+									  true);
+				newtlist = lappend(newtlist, tle);
+				outer_plan = change_plan_targetlist(outer_plan, newtlist,
+													false);
+			}
+			keyset_attno = tle->resno;
+		}
+	}
+	else
+	{
+		/*
+		 * Join relation or upper relation - set scan_relid to 0.
+		 */
+		scan_relid = 0;
+
+		/*
+		 * For a join rel, baserestrictinfo is NIL and we are not considering
+		 * parameterization right now, so there should be no scan_clauses for
+		 * a joinrel or an upper rel either.
+		 */
+		Assert(!scan_clauses);
+
+		/*
+		 * Instead we get the conditions to apply from the fdw_private
+		 * structure.
+		 */
+		remote_exprs = extract_actual_clauses(fpinfo->remote_conds, false);
+		local_exprs = extract_actual_clauses(fpinfo->local_conds, false);
+
+		/*
+		 * We leave fdw_recheck_quals empty in this case, since we never need
+		 * to apply EPQ recheck clauses.  In the case of a joinrel, EPQ
+		 * recheck is handled elsewhere --- see postgresGetForeignJoinPaths().
+		 * If we're planning an upperrel (ie, remote grouping or aggregation)
+		 * then there's no EPQ to do because SELECT FOR UPDATE wouldn't be
+		 * allowed, and indeed we *can't* put the remote clauses into
+		 * fdw_recheck_quals because the unaggregated Vars won't be available
+		 * locally.
+		 */
+
+		/* Build the list of columns to be fetched from the foreign server. */
+		fdw_scan_tlist = build_tlist_to_deparse(foreignrel);
+
+		/*
+		 * Ensure that the outer plan produces a tuple whose descriptor
+		 * matches our scan tuple slot.  Also, remove the local conditions
+		 * from outer plan's quals, lest they be evaluated twice, once by the
+		 * local plan and once by the scan.
+		 */
+		if (outer_plan)
+		{
+			/*
+			 * Right now, we only consider grouping and aggregation beyond
+			 * joins. Queries involving aggregates or grouping do not require
+			 * EPQ mechanism, hence should not have an outer plan here.
+			 */
+			Assert(!IS_UPPER_REL(foreignrel));
+
+			/*
+			 * First, update the plan's qual list if possible.  In some cases
+			 * the quals might be enforced below the topmost plan level, in
+			 * which case we'll fail to remove them; it's not worth working
+			 * harder than this.
+			 */
+			foreach(lc, local_exprs)
+			{
+				Node	   *qual = lfirst(lc);
+
+				outer_plan->qual = list_delete(outer_plan->qual, qual);
+
+				/*
+				 * For an inner join the local conditions of foreign scan plan
+				 * can be part of the joinquals as well.  (They might also be
+				 * in the mergequals or hashquals, but we can't touch those
+				 * without breaking the plan.)
+				 */
+				if (IsA(outer_plan, NestLoop) ||
+					IsA(outer_plan, MergeJoin) ||
+					IsA(outer_plan, HashJoin))
+				{
+					Join	   *join_plan = (Join *) outer_plan;
+
+					if (join_plan->jointype == JOIN_INNER)
+						join_plan->joinqual = list_delete(join_plan->joinqual,
+														  qual);
+				}
+			}
+
+			/*
+			 * Now fix the subplan's tlist --- this might result in inserting
+			 * a Result node atop the plan tree.
+			 */
+			outer_plan = change_plan_targetlist(outer_plan, fdw_scan_tlist,
+												best_path->path.parallel_safe);
+		}
+	}
+
+	/*
+	 * Build the query string to be sent for execution, and identify
+	 * expressions to be sent as parameters.
+	 */
+	deparse_exprs = remote_exprs;
+	if (keyset_clause)
+	{
+		deparse_exprs = lappend(list_copy(deparse_exprs), keyset_clause);
+		if (bloom_clause)
+			deparse_exprs = lappend(deparse_exprs, bloom_clause);
+	}
+	initStringInfo(&sql);
+	deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
+							deparse_exprs, best_path->path.pathkeys,
+							has_final_sort, has_limit, false,
+							&retrieved_attrs, &params_list);
+
+	/*
+	 * The key-set and Bloom filter conditions refer to placeholder Params
+	 * whose values are computed by the scan itself at execution time.
+	 * Replace them with null constants of the same type in the parameter
+	 * list, and remember their positions so that the executor knows where to
+	 * put the key array and the Bloom filter.
+	 */
+	if (keyset_clause)
+	{
+		foreach(lc, params_list)
+		{
+			Param	   *param = (Param *) lfirst(lc);
+
+			if (!IsA(param, Param) || param->paramkind != PARAM_EXEC)
+				continue;
+			if (param->paramid == KEYSET_PLACEHOLDER_PARAMID)
+				keyset_param = foreach_current_index(lc);
+			else if (param->paramid == BLOOM_PLACEHOLDER_PARAMID)
+				bloom_param = foreach_current_index(lc);
+			else
+				continue;
+			lfirst(lc) = makeNullConst(param->paramtype, -1, InvalidOid);
+		}
+		Assert(keyset_param >= 0);
+		Assert(bloom_clause == NULL || bloom_param >= 0);
+	}
+
+	/*
+	 * If the key set can be staged, build the query that reads it from the
+	 * remote temporary table as well.  The ID of the key set takes the
+	 * place of the key-set parameter, so that both queries can share the
+	 * parameters preceding it.  The executor falls back to the query built
+	 * above when staging isn't possible.
+	 */
+	if (staged_clause)
+	{
+		List	   *staged_params = list_copy_head(params_list, keyset_param);
+		List	   *staged_attrs;
+		StringInfoData staged;
+
+		initStringInfo(&staged);
+		deparseSelectStmtForRel(&staged, root, foreignrel, fdw_scan_tlist,
+								lappend(list_copy(remote_exprs),
+										staged_clause),
+								best_path->path.pathkeys,
+								has_final_sort, has_limit, false,
+								&staged_attrs, &staged_params);
+		Assert(list_length(staged_params) == keyset_param + 1);
+		Assert(equal(staged_attrs, retrieved_attrs));
+		staged_sql = staged.data;
+	}
+
+	/* Remember remote_exprs for possible use by postgresPlanDirectModify */
+	fpinfo->final_remote_exprs = remote_exprs;
+
+	/*
+	 * Build the fdw_private list that will be available to the executor.
+	 * Items in the list must match order in enum FdwScanPrivateIndex.
+	 */
+	fdw_private = list_make3(makeString(sql.data),
+							 retrieved_attrs,
+							 makeInteger(fpinfo->fetch_size));
+	if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
+		fdw_private = lappend(fdw_private,
+							  makeString(fpinfo->relation_name));
+	else if (keyset_clause)
+		fdw_private = lappend(fdw_private, NULL);
+	if (keyset_clause)
+	{
+		fdw_private = lappend(fdw_private, makeInteger(keyset_param));
+		fdw_private = lappend(fdw_private, makeInteger(keyset_attno));
+		fdw_private = lappend(fdw_private, makeInteger(bloom_param));
+		fdw_private = lappend(fdw_private,
+							  staged_sql ? makeString(staged_sql) : NULL);
+	}
+	if (fpinfo->use_remote_estimate &&
+		(pgfdw_remote_estimate_max_count >= 0 ||
+		 pgfdw_remote_estimate_max_time >= 0))
+	{
+		int			issued = 0;
+		int			skipped = 0;
+
+		count_remote_estimates(foreignrel, &issued, &skipped);
+		while (list_length(fdw_private) < FdwScanPrivateRemoteEstimates)
+			fdw_private = lappend(fdw_private, NULL);
+		fdw_private = lappend(fdw_private, list_make2_int(issued, skipped));
+	}
+
+	/*
+	 * Create the ForeignScan node for the given relation.
+	 *
+	 * Note that the remote parameter expressions are stored in the fdw_exprs
+	 * field of the finished plan node; we can't keep them in private state
+	 * because then they wouldn't be subject to later planner processing.
+	 */
+	return make_foreignscan(tlist,
+							local_exprs,
+							scan_relid,
+							params_list,
+							fdw_private,
+							fdw_scan_tlist,
+							fdw_recheck_quals,
+							outer_plan);
+}
+
+/*
+ * Construct a tuple descriptor for the scan tuples handled by a foreign join.
+ */
+static TupleDesc
+get_tupdesc_for_join_scan_tuples(ForeignScanState *node)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	TupleDesc	tupdesc;
+
+	/*
+	 * The core code has already set up a scan tuple slot based on
+	 * fsplan->fdw_scan_tlist, and this slot's tupdesc is mostly good enough,
+	 * but there's one case where it isn't.  If we have any whole-row row
+	 * identifier Vars, they may have vartype RECORD, and we need to replace
+	 * that with the associated table's actual composite type.  This ensures
+	 * that when we read those ROW() expression values from the remote server,
+	 * we can convert them to a composite type the local server knows.
+	 */
+	tupdesc = CreateTupleDescCopy(node->ss.ss_ScanTupleSlot->tts_tupleDescriptor);
+	for (int i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute att = TupleDescAttr(tupdesc, i);
+		Var		   *var;
+		RangeTblEntry *rte;
+		Oid			reltype;
+
+		/* Nothing to do if it's not a generic RECORD attribute */
+		if (att->atttypid != RECORDOID || att->atttypmod >= 0)
+			continue;
+
+		/*
+		 * If we can't identify the referenced table, do nothing.  This'll
+		 * likely lead to failure later, but perhaps we can muddle through.
+		 */
+		var = (Var *) list_nth_node(TargetEntry, fsplan->fdw_scan_tlist,
+									i)->expr;
+		if (!IsA(var, Var) || var->varattno != 0)
+			continue;
+		rte = list_nth(estate->es_range_table, var->varno - 1);
+		if (rte->rtekind != RTE_RELATION)
+			continue;
+		reltype = get_rel_type_id(rte->relid);
+		if (!OidIsValid(reltype))
+			continue;
+		att->atttypid = reltype;
+		/* shouldn't need to change anything else */
+	}
+	return tupdesc;
+}
+
+/*
+ * postgresBeginForeignScan
+ *		Initiate an executor scan of a foreign PostgreSQL table.
+ */
+static void
+postgresBeginForeignScan(ForeignScanState *node, int eflags)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	PgFdwScanState *fsstate;
+	RangeTblEntry *rte;
+	Oid			userid;
+	ForeignTable *table;
+	UserMapping *user;
+	int			rtindex;
+	int			numParams;
+
+	/*
+	 * Do nothing in EXPLAIN (no ANALYZE) case.  node->fdw_state stays NULL.
+	 */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	/*
+	 * We'll save private state in node->fdw_state.
+	 */
+	fsstate = (PgFdwScanState *) palloc0(sizeof(PgFdwScanState));
+	node->fdw_state = (void *) fsstate;
+
+	/*
+	 * Identify which user to do the remote access as.  This should match what
+	 * ExecCheckPermissions() does.
+	 */
+	userid = OidIsValid(fsplan->checkAsUser) ? fsplan->checkAsUser : GetUserId();
+	if (fsplan->scan.scanrelid > 0)
+		rtindex = fsplan->scan.scanrelid;
+	else
+		rtindex = bms_next_member(fsplan->fs_base_relids, -1);
+	rte = exec_rt_fetch(rtindex, estate);
+
+	/* Get info about foreign table. */
+	table = GetForeignTable(rte->relid);
+	user = GetUserMapping(userid, table->serverid);
+
+	/*
+	 * Get connection to the foreign server.  Connection manager will
+	 * establish new connection if necessary.
+	 */
+	fsstate->conn = GetConnection(user, false, &fsstate->conn_state);
+
+	/* Assign a unique ID for my cursor */
+	fsstate->cursor_number = GetCursorNumber(fsstate->conn);
+	fsstate->cursor_exists = false;
+
+	/* Get private info created by planner functions. */
+	fsstate->query = strVal(list_nth(fsplan->fdw_private,
+									 FdwScanPrivateSelectSql));
+	fsstate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private,
+												 FdwScanPrivateRetrievedAttrs);
+	fsstate->fetch_size = intVal(list_nth(fsplan->fdw_private,
+										  FdwScanPrivateFetchSize));
+	if (list_length(fsplan->fdw_private) > FdwScanPrivateKeySetParam &&
+		list_nth(fsplan->fdw_private, FdwScanPrivateKeySetParam) != NULL)
+	{
+		fsstate->keyset_param = intVal(list_nth(fsplan->fdw_private,
+												FdwScanPrivateKeySetParam));
+		fsstate->keyset_attno = intVal(list_nth(fsplan->fdw_private,
+												FdwScanPrivateKeySetAttno));
+		fsstate->bloom_param = intVal(list_nth(fsplan->fdw_private,
+											   FdwScanPrivateBloomParam));
+		if (list_nth(fsplan->fdw_private,
+					 FdwScanPrivateStagedSelectSql) != NULL)
+			fsstate->staged_query =
+				strVal(list_nth(fsplan->fdw_private,
+								FdwScanPrivateStagedSelectSql));
+		else
+			fsstate->staged_query = NULL;
+	}
+	else
+	{
+		fsstate->keyset_param = -1;
+		fsstate->bloom_param = -1;
+		fsstate->staged_query = NULL;
+	}
+
+	/* Create contexts for batches of tuples and per-tuple temp workspace. */
+	fsstate->batch_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											   "postgres_fdw tuple data",
+											   ALLOCSET_DEFAULT_SIZES);
+	fsstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "postgres_fdw temporary data",
+											  ALLOCSET_SMALL_SIZES);
+	if (fsstate->keyset_param >= 0)
+		fsstate->keyset_cxt = AllocSetContextCreate(estate->es_query_cxt,
+													"postgres_fdw join keys",
+													ALLOCSET_DEFAULT_SIZES);
+	else
+		fsstate->keyset_cxt = NULL;
+
+	/*
+	 * Get info we'll need for converting data fetched from the foreign server
+	 * into local representation and error reporting during that process.
+	 */
+	if (fsplan->scan.scanrelid > 0)
+	{
+		fsstate->rel = node->ss.ss_currentRelation;
+		fsstate->tupdesc = RelationGetDescr(fsstate->rel);
+	}
+	else
+	{
+		fsstate->rel = NULL;
+		fsstate->tupdesc = get_tupdesc_for_join_scan_tuples(node);
+	}
+
+	fsstate->attinmeta = TupleDescGetAttInMetadata(fsstate->tupdesc);
+
+	/*
+	 * Prepare for processing of parameters used in remote query, if any.
+	 */
+	numParams = list_length(fsplan->fdw_exprs);
+	fsstate->numParams = numParams;
+	if (numParams > 0)
+	{
+		Bitmapset  *text_params = NULL;
+
+		/* create_cursor() fills in the key-set parameters in text format */
+		if (fsstate->keyset_param >= 0)
+			text_params = bms_add_member(text_params, fsstate->keyset_param);
+		if (fsstate->bloom_param >= 0)
+			text_params = bms_add_member(text_params, fsstate->bloom_param);
+
+		prepare_query_params((PlanState *) node,
+							 fsplan->fdw_exprs,
+							 numParams,
+							 text_params,
+							 &fsstate->param_flinfo,
+							 &fsstate->param_exprs,
+							 &fsstate->param_values,
+							 &fsstate->param_lengths,
+							 &fsstate->param_formats);
+	}
+
+	/* Set the async-capable flag */
+	fsstate->async_capable = node->ss.ps.async_capable;
+}
+
+/*
+ * postgresIterateForeignScan
+ *		Retrieve next row from the result set, or clear tuple slot to indicate
+ *		EOF.
+ */
+static TupleTableSlot *
+postgresIterateForeignScan(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+
+	/*
+	 * In sync mode, if this is the first call after Begin or ReScan, we need
+	 * to create the cursor on the remote side.  In async mode, we would have
+	 * already created the cursor before we get here, even if this is the
+	 * first call after Begin or ReScan.
+	 */
+	if (!fsstate->cursor_exists)
+		create_cursor(node);
+
+	/*
+	 * Get some more tuples, if we've run out.
+	 */
+	if (fsstate->next_tuple >= fsstate->num_tuples)
+	{
+		/* In async mode, just clear tuple slot. */
+		if (fsstate->async_capable)
+			return ExecClearTuple(slot);
+		/* No point in another fetch if we already detected EOF, though. */
+		if (!fsstate->eof_reached)
+			fetch_more_data(node);
+		/* If we didn't get any tuples, must be end of data. */
+		if (fsstate->next_tuple >= fsstate->num_tuples)
+			return ExecClearTuple(slot);
+	}
+
+	/*
+	 * Return the next tuple.
+	 */
+	ExecStoreHeapTuple(fsstate->tuples[fsstate->next_tuple++],
+					   slot,
+					   false);
+
+	return slot;
+}
+
+/*
+ * postgresReScanForeignScan
+ *		Restart the scan.
+ */
+static void
+postgresReScanForeignScan(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	char		sql[64];
+	PGresult   *res;
+
+	/* If we haven't created the cursor yet, nothing to do. */
+	if (!fsstate->cursor_exists)
+		return;
+
+	/*
+	 * If the node is async-capable, and an asynchronous fetch for it has
+	 * begun, the asynchronous fetch might not have yet completed.  Check if
+	 * the node is async-capable, and an asynchronous fetch for it is still in
+	 * progress; if so, complete the asynchronous fetch before restarting the
+	 * scan.
+	 */
+	if (fsstate->async_capable &&
+		fsstate->conn_state->pendingAreq &&
+		fsstate->conn_state->pendingAreq->requestee == (PlanState *) node)
+		fetch_more_data(node);
+
+	/*
+	 * If any internal parameters affecting this node have changed, we'd
+	 * better destroy and recreate the cursor.  Otherwise, rewinding it should
+	 * be good enough.  If we've only fetched zero or one batch, we needn't
+	 * even rewind the cursor, just rescan what we have.
+	 */
+	if (node->ss.ps.chgParam != NULL)
+	{
+		fsstate->cursor_exists = false;
+		snprintf(sql, sizeof(sql), "CLOSE c%u",
+				 fsstate->cursor_number);
+	}
+	else if (fsstate->fetch_ct_2 > 1)
+	{
+		snprintf(sql, sizeof(sql), "MOVE BACKWARD ALL IN c%u",
+				 fsstate->cursor_number);
+	}
+	else
+	{
+		/* Easy: just rescan what we already have in memory, if anything */
+		fsstate->next_tuple = 0;
+		return;
+	}
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_query(fsstate->conn, sql, fsstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fsstate->conn, true, sql);
+	PQclear(res);
+
+	/* Now force a fresh FETCH. */
+	fsstate->tuples = NULL;
+	fsstate->num_tuples = 0;
+	fsstate->next_tuple = 0;
+	fsstate->fetch_ct_2 = 0;
+	fsstate->eof_reached = false;
+}
+
+/*
+ * postgresEndForeignScan
+ *		Finish scanning foreign table and dispose objects used for this scan
+ */
+static void
+postgresEndForeignScan(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* if fsstate is NULL, we are in EXPLAIN; nothing to do */
+	if (fsstate == NULL)
+		return;
+
+	/* Close the cursor if open, to prevent accumulation of cursors */
+	if (fsstate->cursor_exists)
+		close_cursor(fsstate->conn, fsstate->cursor_number,
+					 fsstate->conn_state);
+
+	/* Release remote connection */
+	ReleaseConnection(fsstate->conn);
+	fsstate->conn = NULL;
+
+	/* MemoryContexts will be deleted automatically. */
+}
+
+/*
+ * postgresAddForeignUpdateTargets
+ *		Add resjunk column(s) needed for update/delete on a foreign table
+ */
+static void
+postgresAddForeignUpdateTargets(PlannerInfo *root,
+								Index rtindex,
+								RangeTblEntry *target_rte,
+								Relation target_relation)
+{
+	Var		   *var;
+
+	/*
+	 * In postgres_fdw, what we need is the ctid, same as for a regular table.
+	 */
+
+	/* Make a Var representing the desired value */
+	var = makeVar(rtindex,
+				  SelfItemPointerAttributeNumber,
+				  TIDOID,
+				  -1,
+				  InvalidOid,
+				  0);
+
+	/* Register it as a row-identity column needed by this target rel */
+	add_row_identity_var(root, var, rtindex, "ctid");
+}
+
+/*
+ * postgresPlanForeignModify
+ *		Plan an insert/update/delete operation on a foreign table
+ */
+static List *
+postgresPlanForeignModify(PlannerInfo *root,
+						  ModifyTable *plan,
+						  Index resultRelation,
+						  int subplan_index)
+{
+	CmdType		operation = plan->operation;
+	RangeTblEntry *rte = planner_rt_fetch(resultRelation, root);
+	Relation	rel;
+	StringInfoData sql;
+	List	   *targetAttrs = NIL;
+	List	   *withCheckOptionList = NIL;
+	List	   *returningList = NIL;
+	List	   *retrieved_attrs = NIL;
+	bool		doNothing = false;
+	int			values_end_len = -1;
+
+	initStringInfo(&sql);
+
+	/*
+	 * Core code already has some lock on each rel being planned, so we can
+	 * use NoLock here.
+	 */
+	rel = table_open(rte->relid, NoLock);
+
+	/*
+	 * In an INSERT, we transmit all columns that are defined in the foreign
+	 * table.  In an UPDATE, if there are BEFORE ROW UPDATE triggers on the
+	 * foreign table, we transmit all columns like INSERT; else we transmit
+	 * only columns that were explicitly targets of the UPDATE, so as to avoid
+	 * unnecessary data transmission.  (We can't do that for INSERT since we
+	 * would miss sending default values for columns not listed in the source
+	 * statement, and for UPDATE if there are BEFORE ROW UPDATE triggers since
+	 * those triggers might change values for non-target columns, in which
+	 * case we would miss sending changed values for those columns.)
+	 */
+	if (operation == CMD_INSERT ||
+		(operation == CMD_UPDATE &&
+		 rel->trigdesc &&
+		 rel->trigdesc->trig_update_before_row))
+	{
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+		int			attnum;
+
+		for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+
+			if (!attr->attisdropped)
+				targetAttrs = lappend_int(targetAttrs, attnum);
+		}
+	}
+	else if (operation == CMD_UPDATE)
+	{
+		int			col;
+		RelOptInfo *rel = find_base_rel(root, resultRelation);
+		Bitmapset  *allUpdatedCols = get_rel_all_updated_cols(root, rel);
+
+		col = -1;
+		while ((col = bms_next_member(allUpdatedCols, col)) >= 0)
+		{
+			/* bit numbers are offset by FirstLowInvalidHeapAttributeNumber */
+			AttrNumber	attno = col + FirstLowInvalidHeapAttributeNumber;
+
+			if (attno <= InvalidAttrNumber) /* shouldn't happen */
+				elog(ERROR, "system-column update is not supported");
+			targetAttrs = lappend_int(targetAttrs, attno);
+		}
+	}
+
+	/*
+	 * Extract the relevant WITH CHECK OPTION list if any.
+	 */
+	if (plan->withCheckOptionLists)
+		withCheckOptionList = (List *) list_nth(plan->withCheckOptionLists,
+												subplan_index);
+
+	/*
+	 * Extract the relevant RETURNING list if any.
+	 */
+	if (plan->returningLists)
+		returningList = (List *) list_nth(plan->returningLists, subplan_index);
+
+	/*
+	 * ON CONFLICT DO UPDATE and DO NOTHING case with inference specification
+	 * should have already been rejected in the optimizer, as presently there
+	 * is no way to recognize an arbiter index on a foreign table.  Only DO
+	 * NOTHING is supported without an inference specification.
+	 */
+	if (plan->onConflictAction == ONCONFLICT_NOTHING)
+		doNothing = true;
+	else if (plan->onConflictAction != ONCONFLICT_NONE)
+		elog(ERROR, "unexpected ON CONFLICT specification: %d",
+			 (int) plan->onConflictAction);
+
+	/*
+	 * Construct the SQL command string.
+	 */
+	switch (operation)
+	{
+		case CMD_INSERT:
+			deparseInsertSql(&sql, rte, resultRelation, rel,
+							 targetAttrs, doNothing,
+							 withCheckOptionList, returningList,
+							 &retrieved_attrs, &values_end_len);
+			break;
+		case CMD_UPDATE:
+			deparseUpdateSql(&sql, rte, resultRelation, rel,
+							 targetAttrs,
+							 withCheckOptionList, returningList,
+							 &retrieved_attrs);
+			break;
+		case CMD_DELETE:
+			deparseDeleteSql(&sql, rte, resultRelation, rel,
+							 returningList,
+							 &retrieved_attrs);
+			break;
+		default:
+			elog(ERROR, "unexpected operation: %d", (int) operation);
+			break;
+	}
+
+	table_close(rel, NoLock);
+
+	/*
+	 * Build the fdw_private list that will be available to the executor.
+	 * Items in the list must match enum FdwModifyPrivateIndex, above.
+	 */
+	return list_make5(makeString(sql.data),
+					  targetAttrs,
+					  makeInteger(values_end_len),
+					  makeBoolean((retrieved_attrs != NIL)),
+					  retrieved_attrs);
+}
+
+/*
+ * postgresBeginForeignModify
+ *		Begin an insert/update/delete operation on a foreign table
+ */
+static void
+postgresBeginForeignModify(ModifyTableState *mtstate,
+						   ResultRelInfo *resultRelInfo,
+						   List *fdw_private,
+						   int subplan_index,
+						   int eflags)
+{
+	PgFdwModifyState *fmstate;
+	char	   *query;
+	List	   *target_attrs;
+	bool		has_returning;
+	int			values_end_len;
+	List	   *retrieved_attrs;
+	RangeTblEntry *rte;
+	ModifyTable *plan = castNode(ModifyTable, mtstate->ps.plan);
+
+	/*
+	 * Do nothing in EXPLAIN (no ANALYZE) case.  resultRelInfo->ri_FdwState
+	 * stays NULL.
+	 */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	/* Deconstruct fdw_private data. */
+	query = strVal(list_nth(fdw_private,
+							FdwModifyPrivateUpdateSql));
+	target_attrs = (List *) list_nth(fdw_private,
+									 FdwModifyPrivateTargetAttnums);
+	values_end_len = intVal(list_nth(fdw_private,
+									 FdwModifyPrivateLen));
+	has_returning = boolVal(list_nth(fdw_private,
+									 FdwModifyPrivateHasReturning));
+	retrieved_attrs = (List *) list_nth(fdw_private,
+										FdwModifyPrivateRetrievedAttrs);
+
+	/* Find RTE. */
+	rte = exec_rt_fetch(resultRelInfo->ri_RangeTableIndex,
+						mtstate->ps.state);
+
+	/* Construct an execution state. */
+	fmstate = create_foreign_modify(mtstate->ps.state,
+									rte,
+									resultRelInfo,
+									mtstate->operation,
+									outerPlanState(mtstate)->plan,
+									query,
+									target_attrs,
+									values_end_len,
+									has_returning,
+									plan->onConflictAction == ONCONFLICT_NOTHING,
+									retrieved_attrs);
+
+	resultRelInfo->ri_FdwState = fmstate;
+}
+
+/*
+ * postgresExecForeignInsert
+ *		Insert one row into a foreign table
+ */
+static TupleTableSlot *
+postgresExecForeignInsert(EState *estate,
+						  ResultRelInfo *resultRelInfo,
+						  TupleTableSlot *slot,
+						  TupleTableSlot *planSlot)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	/*
+	 * If the fmstate has aux_fmstate set, use the aux_fmstate (see
+	 * postgresBeginForeignInsert())
+	 */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate->aux_fmstate;
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_INSERT,
+								   &slot, &planSlot, &numSlots);
+	/* Revert that change */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate;
+
+	return rslot ? *rslot : NULL;
+}
+
+/*
+ * postgresExecForeignBatchInsert
+ *		Insert multiple rows into a foreign table
+ */
+static TupleTableSlot **
+postgresExecForeignBatchInsert(EState *estate,
+							   ResultRelInfo *resultRelInfo,
+							   TupleTableSlot **slots,
+							   TupleTableSlot **planSlots,
+							   int *numSlots)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+	TupleTableSlot **rslot;
+
+	/*
+	 * If the fmstate has aux_fmstate set, use the aux_fmstate (see
+	 * postgresBeginForeignInsert())
+	 */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate->aux_fmstate;
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_INSERT,
+								   slots, planSlots, numSlots);
+	/* Revert that change */
+	if (fmstate->aux_fmstate)
+		resultRelInfo->ri_FdwState = fmstate;
+
+	return rslot;
+}
+
+/*
+ * postgresGetForeignModifyBatchSize
+ *		Determine the maximum number of tuples that can be inserted in bulk
+ *
+ * Returns the batch size specified for server or table. When batching is not
+ * allowed (e.g. for tables with BEFORE/AFTER ROW triggers or with RETURNING
+ * clause), returns 1.
+ */
+static int
+postgresGetForeignModifyBatchSize(ResultRelInfo *resultRelInfo)
+{
+	int			batch_size;
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+
+	/* should be called only once */
+	Assert(resultRelInfo->ri_BatchSize == 0);
+
+	/*
+	 * Should never get called when the insert is being performed on a table
+	 * that is also among the target relations of an UPDATE operation, because
+	 * postgresBeginForeignInsert() currently rejects such insert attempts.
+	 */
+	Assert(fmstate == NULL || fmstate->aux_fmstate == NULL);
+
+	/*
+	 * In EXPLAIN without ANALYZE, ri_FdwState is NULL, so we have to lookup
+	 * the option directly in server/table options. Otherwise just use the
+	 * value we determined earlier.
+	 */
+	if (fmstate)
+		batch_size = fmstate->batch_size;
+	else
+		batch_size = get_batch_size_option(resultRelInfo->ri_RelationDesc);
+
+	/*
+	 * Disable batching when we have to use RETURNING, there are any
+	 * BEFORE/AFTER ROW INSERT triggers on the foreign table, or there are any
+	 * WITH CHECK OPTION constraints from parent views.
+	 *
+	 * When there are any BEFORE ROW INSERT triggers on the table, we can't
+	 * support it, because such triggers might query the table we're inserting
+	 * into and act differently if the tuples that have already been processed
+	 * and prepared for insertion are not there.
+	 */
+	if (resultRelInfo->ri_projectReturning != NULL ||
+		resultRelInfo->ri_WithCheckOptions != NIL ||
+		(resultRelInfo->ri_TrigDesc &&
+		 (resultRelInfo->ri_TrigDesc->trig_insert_before_row ||
+		  resultRelInfo->ri_TrigDesc->trig_insert_after_row)))
+		return 1;
+
+	/*
+	 * If the foreign table has no columns, disable batching as the INSERT
+	 * syntax doesn't allow batching multiple empty rows into a zero-column
+	 * table in a single statement.  This is needed for COPY FROM, in which
+	 * case fmstate must be non-NULL.
+	 */
+	if (fmstate && list_length(fmstate->target_attrs) == 0)
+		return 1;
+
+	/*
+	 * Otherwise use the batch size specified for server/table. The number of
+	 * parameters in a batch is limited to 65535 (uint16), so make sure we
+	 * don't exceed this limit by using the maximum batch_size possible.  COPY
+	 * has no such limit, and adaptively sized batches are split into
+	 * statements within it.
+	 */
+	if (fmstate && fmstate->p_nums > 0 && fmstate->copy_query == NULL &&
+		fmstate->batch_target_size == 0)
+		batch_size = Min(batch_size, PQ_QUERY_PARAM_MAX_LIMIT / fmstate->p_nums);
+
+	return batch_size;
+}
+
+/*
+ * postgresExecForeignUpdate
+ *		Update one row in a foreign table
+ */
+static TupleTableSlot *
+postgresExecForeignUpdate(EState *estate,
+						  ResultRelInfo *resultRelInfo,
+						  TupleTableSlot *slot,
+						  TupleTableSlot *planSlot)
+{
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_UPDATE,
+								   &slot, &planSlot, &numSlots);
+
+	return rslot ? rslot[0] : NULL;
+}
+
+/*
+ * postgresExecForeignDelete
+ *		Delete one row from a foreign table
+ */
+static TupleTableSlot *
+postgresExecForeignDelete(EState *estate,
+						  ResultRelInfo *resultRelInfo,
+						  TupleTableSlot *slot,
+						  TupleTableSlot *planSlot)
+{
+	TupleTableSlot **rslot;
+	int			numSlots = 1;
+
+	rslot = execute_foreign_modify(estate, resultRelInfo, CMD_DELETE,
+								   &slot, &planSlot, &numSlots);
+
+	return rslot ? rslot[0] : NULL;
+}
+
+/*
+ * postgresEndForeignModify
+ *		Finish an insert/update/delete operation on a foreign table
+ */
+static void
+postgresEndForeignModify(EState *estate,
+						 ResultRelInfo *resultRelInfo)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+
+	/* If fmstate is NULL, we are in EXPLAIN; nothing to do */
+	if (fmstate == NULL)
+		return;
+
+	/* Destroy the execution state */
+	finish_foreign_modify(fmstate);
+}
+
+/*
+ * postgresBeginForeignInsert
+ *		Begin an insert operation on a foreign table
+ */
+static void
+postgresBeginForeignInsert(ModifyTableState *mtstate,
+						   ResultRelInfo *resultRelInfo)
+{
+	PgFdwModifyState *fmstate;
+	ModifyTable *plan = castNode(ModifyTable, mtstate->ps.plan);
+	EState	   *estate = mtstate->ps.state;
+	Index		resultRelation;
+	Relation	rel = resultRelInfo->ri_RelationDesc;
+	RangeTblEntry *rte;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	int			attnum;
+	int			values_end_len;
+	StringInfoData sql;
+	List	   *targetAttrs = NIL;
+	List	   *retrieved_attrs = NIL;
+	bool		doNothing = false;
+
+	/*
+	 * If the foreign table we are about to insert routed rows into is also an
+	 * UPDATE subplan result rel that will be updated later, proceeding with
+	 * the INSERT will result in the later UPDATE incorrectly modifying those
+	 * routed rows, so prevent the INSERT --- it would be nice if we could
+	 * handle this case; but for now, throw an error for safety.
+	 */
+	if (plan && plan->operation == CMD_UPDATE &&
+		(resultRelInfo->ri_usesFdwDirectModify ||
+		 resultRelInfo->ri_FdwState))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot route tuples into foreign table to be updated \"%s\"",
+						RelationGetRelationName(rel))));
+
+	initStringInfo(&sql);
+
+	/* We transmit all columns that are defined in the foreign table. */
+	for (attnum = 1; attnum <= tupdesc->natts; attnum++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+
+		if (!attr->attisdropped)
+			targetAttrs = lappend_int(targetAttrs, attnum);
+	}
+
+	/* Check if we add the ON CONFLICT clause to the remote query. */
+	if (plan)
+	{
+		OnConflictAction onConflictAction = plan->onConflictAction;
+
+		/* We only support DO NOTHING without an inference specification. */
+		if (onConflictAction == ONCONFLICT_NOTHING)
+			doNothing = true;
+		else if (onConflictAction != ONCONFLICT_NONE)
+			elog(ERROR, "unexpected ON CONFLICT specification: %d",
+				 (int) onConflictAction);
+	}
+
+	/*
+	 * If the foreign table is a partition that doesn't have a corresponding
+	 * RTE entry, we need to create a new RTE describing the foreign table for
+	 * use by deparseInsertSql and create_foreign_modify() below, after first
+	 * copying the parent's RTE and modifying some fields to describe the
+	 * foreign partition to work on. However, if this is invoked by UPDATE,
+	 * the existing RTE may already correspond to this partition if it is one
+	 * of the UPDATE subplan target rels; in that case, we can just use the
+	 * existing RTE as-is.
+	 */
+	if (resultRelInfo->ri_RangeTableIndex == 0)
+	{
+		ResultRelInfo *rootResultRelInfo = resultRelInfo->ri_RootResultRelInfo;
+
+		rte = exec_rt_fetch(rootResultRelInfo->ri_RangeTableIndex, estate);
+		rte = copyObject(rte);
+		rte->relid = RelationGetRelid(rel);
+		rte->relkind = RELKIND_FOREIGN_TABLE;
+
+		/*
+		 * For UPDATE, we must use the RT index of the first subplan target
+		 * rel's RTE, because the core code would have built expressions for
+		 * the partition, such as RETURNING, using that RT index as varno of
+		 * Vars contained in those expressions.
+		 */
+		if (plan && plan->operation == CMD_UPDATE &&
+			rootResultRelInfo->ri_RangeTableIndex == plan->rootRelation)
+			resultRelation = mtstate->resultRelInfo[0].ri_RangeTableIndex;
+		else
+			resultRelation = rootResultRelInfo->ri_RangeTableIndex;
+	}
+	else
+	{
+		resultRelation = resultRelInfo->ri_RangeTableIndex;
+		rte = exec_rt_fetch(resultRelation, estate);
+	}
+
+	/* Construct the SQL command string. */
+	deparseInsertSql(&sql, rte, resultRelation, rel, targetAttrs, doNothing,
+					 resultRelInfo->ri_WithCheckOptions,
+					 resultRelInfo->ri_returningList,
+					 &retrieved_attrs, &values_end_len);
+
+	/* Construct an execution state. */
+	fmstate = create_foreign_modify(mtstate->ps.state,
+									rte,
+									resultRelInfo,
+									CMD_INSERT,
+									NULL,
+									sql.data,
+									targetAttrs,
+									values_end_len,
+									retrieved_attrs != NIL,
+									doNothing,
+									retrieved_attrs);
+
+	/*
+	 * If the given resultRelInfo already has PgFdwModifyState set, it means
+	 * the foreign table is an UPDATE subplan result rel; in which case, store
+	 * the resulting state into the aux_fmstate of the PgFdwModifyState.
+	 */
+	if (resultRelInfo->ri_FdwState)
+	{
+		Assert(plan && plan->operation == CMD_UPDATE);
+		Assert(resultRelInfo->ri_usesFdwDirectModify == false);
+		((PgFdwModifyState *) resultRelInfo->ri_FdwState)->aux_fmstate = fmstate;
+	}
+	else
+		resultRelInfo->ri_FdwState = fmstate;
+}
+
+/*
+ * postgresEndForeignInsert
+ *		Finish an insert operation on a foreign table
+ */
+static void
+postgresEndForeignInsert(EState *estate,
+						 ResultRelInfo *resultRelInfo)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+
+	Assert(fmstate != NULL);
+
+	/*
+	 * If the fmstate has aux_fmstate set, get the aux_fmstate (see
+	 * postgresBeginForeignInsert())
+	 */
+	if (fmstate->aux_fmstate)
+		fmstate = fmstate->aux_fmstate;
+
+	/* Destroy the execution state */
+	finish_foreign_modify(fmstate);
+}
+
+/*
+ * postgresIsForeignRelUpdatable
+ *		Determine whether a foreign table supports INSERT, UPDATE and/or
+ *		DELETE.
+ */
+static int
+postgresIsForeignRelUpdatable(Relation rel)
+{
+	bool		updatable;
+	ForeignTable *table;
+	ForeignServer *server;
+	ListCell   *lc;
+
+	/*
+	 * By default, all postgres_fdw foreign tables are assumed updatable. This
+	 * can be overridden by a per-server setting, which in turn can be
+	 * overridden by a per-table setting.
+	 */
+	updatable = true;
+
+	table = GetForeignTable(RelationGetRelid(rel));
+	server = GetForeignServer(table->serverid);
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "updatable") == 0)
+			updatable = defGetBoolean(def);
+	}
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "updatable") == 0)
+			updatable = defGetBoolean(def);
+	}
+
+	/*
+	 * Currently "updatable" means support for INSERT, UPDATE and DELETE.
+	 */
+	return updatable ?
+		(1 << CMD_INSERT) | (1 << CMD_UPDATE) | (1 << CMD_DELETE) : 0;
+}
+
+/*
+ * postgresRecheckForeignScan
+ *		Execute a local join execution plan for a foreign join
+ */
+static bool
+postgresRecheckForeignScan(ForeignScanState *node, TupleTableSlot *slot)
+{
+	Index		scanrelid = ((Scan *) node->ss.ps.plan)->scanrelid;
+	PlanState  *outerPlan = outerPlanState(node);
+	TupleTableSlot *result;
+
+	/* For base foreign relations, it suffices to set fdw_recheck_quals */
+	if (scanrelid > 0)
+		return true;
+
+	Assert(outerPlan != NULL);
+
+	/* Execute a local join execution plan */
+	result = ExecProcNode(outerPlan);
+	if (TupIsNull(result))
+		return false;
+
+	/* Store result in the given slot */
+	ExecCopySlot(slot, result);
+
+	return true;
+}
+
+/*
+ * find_modifytable_subplan
+ *		Helper routine for postgresPlanDirectModify to find the
+ *		ModifyTable subplan node that scans the specified RTI.
+ *
+ * Returns NULL if the subplan couldn't be identified.  That's not a fatal
+ * error condition, we just abandon trying to do the update directly.
+ */
+static ForeignScan *
+find_modifytable_subplan(PlannerInfo *root,
+						 ModifyTable *plan,
+						 Index rtindex,
+						 int subplan_index)
+{
+	Plan	   *subplan = outerPlan(plan);
+
+	/*
+	 * The cases we support are (1) the desired ForeignScan is the immediate
+	 * child of ModifyTable, or (2) it is the subplan_index'th child of an
+	 * Append node that is the immediate child of ModifyTable.  There is no
+	 * point in looking further down, as that would mean that local joins are
+	 * involved, so we can't do the update directly.
+	 *
+	 * There could be a Result atop the Append too, acting to compute the
+	 * UPDATE targetlist values.  We ignore that here; the tlist will be
+	 * checked by our caller.
+	 *
+	 * In principle we could examine all the children of the Append, but it's
+	 * currently unlikely that the core planner would generate such a plan
+	 * with the children out-of-order.  Moreover, such a search risks costing
+	 * O(N^2) time when there are a lot of children.
+	 */
+	if (IsA(subplan, Append))
+	{
+		Append	   *appendplan = (Append *) subplan;
+
+		if (subplan_index < list_length(appendplan->appendplans))
+			subplan = (Plan *) list_nth(appendplan->appendplans, subplan_index);
+	}
+	else if (IsA(subplan, Result) &&
+			 outerPlan(subplan) != NULL &&
+			 IsA(outerPlan(subplan), Append))
+	{
+		Append	   *appendplan = (Append *) outerPlan(subplan);
+
+		if (subplan_index < list_length(appendplan->appendplans))
+			subplan = (Plan *) list_nth(appendplan->appendplans, subplan_index);
+	}
+
+	/* Now, have we got a ForeignScan on the desired rel? */
+	if (IsA(subplan, ForeignScan))
+	{
+		ForeignScan *fscan = (ForeignScan *) subplan;
+
+		if (bms_is_member(rtindex, fscan->fs_base_relids))
+			return fscan;
+	}
+
+	return NULL;
+}
+
+/*
+ * postgresPlanDirectModify
+ *		Consider a direct foreign table modification
+ *
+ * Decide whether it is safe to modify a foreign table directly, and if so,
+ * rewrite subplan accordingly.
+ */
+static bool
+postgresPlanDirectModify(PlannerInfo *root,
+						 ModifyTable *plan,
+						 Index resultRelation,
+						 int subplan_index)
+{
+	CmdType		operation = plan->operation;
+	RelOptInfo *foreignrel;
+	RangeTblEntry *rte;
+	PgFdwRelationInfo *fpinfo;
+	Relation	rel;
+	StringInfoData sql;
+	ForeignScan *fscan;
+	List	   *processed_tlist = NIL;
+	List	   *targetAttrs = NIL;
+	List	   *remote_exprs;
+	List	   *params_list = NIL;
+	List	   *returningList = NIL;
+	List	   *retrieved_attrs = NIL;
+
+	/*
+	 * Decide whether it is safe to modify a foreign table directly.
+	 */
+
+	/*
+	 * The table modification must be an UPDATE or DELETE.
+	 */
+	if (operation != CMD_UPDATE && operation != CMD_DELETE)
+		return false;
+
+	/*
+	 * Try to locate the ForeignScan subplan that's scanning resultRelation.
+	 */
+	fscan = find_modifytable_subplan(root, plan, resultRelation, subplan_index);
+	if (!fscan)
+		return false;
+
+	/*
+	 * It's unsafe to modify a foreign table directly if there are any quals
+	 * that should be evaluated locally.
+	 */
+	if (fscan->scan.plan.qual != NIL)
+		return false;
+
+	/* Safe to fetch data about the target foreign rel */
+	if (fscan->scan.scanrelid == 0)
+	{
+		foreignrel = find_join_rel(root, fscan->fs_relids);
+		/* We should have a rel for this foreign join. */
+		Assert(foreignrel);
+	}
+	else
+		foreignrel = root->simple_rel_array[resultRelation];
+	rte = root->simple_rte_array[resultRelation];
+	fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+
+	/*
+	 * It's unsafe to update a foreign table directly, if any expressions to
+	 * assign to the target columns are unsafe to evaluate remotely.
+	 */
+	if (operation == CMD_UPDATE)
+	{
+		ListCell   *lc,
+				   *lc2;
+
+		/*
+		 * The expressions of concern are the first N columns of the processed
+		 * targetlist, where N is the length of the rel's update_colnos.
+		 */
+		get_translated_update_targetlist(root, resultRelation,
+										 &processed_tlist, &targetAttrs);
+		forboth(lc, processed_tlist, lc2, targetAttrs)
+		{
+			TargetEntry *tle = lfirst_node(TargetEntry, lc);
+			AttrNumber	attno = lfirst_int(lc2);
+
+			/* update's new-value expressions shouldn't be resjunk */
+			Assert(!tle->resjunk);
+
+			if (attno <= InvalidAttrNumber) /* shouldn't happen */
+				elog(ERROR, "system-column update is not supported");
+
+			if (!is_foreign_expr(root, foreignrel, (Expr *) tle->expr))
+				return false;
+		}
+	}
+
+	/*
+	 * Ok, rewrite subplan so as to modify the foreign table directly.
+	 */
+	initStringInfo(&sql);
+
+	/*
+	 * Core code already has some lock on each rel being planned, so we can
+	 * use NoLock here.
+	 */
+	rel = table_open(rte->relid, NoLock);
+
+	/*
+	 * Recall the qual clauses that must be evaluated remotely.  (These are
+	 * bare clauses not RestrictInfos, but deparse.c's appendConditions()
+	 * doesn't care.)
+	 */
+	remote_exprs = fpinfo->final_remote_exprs;
+
+	/*
+	 * Extract the relevant RETURNING list if any.
+	 */
+	if (plan->returningLists)
+	{
+		returningList = (List *) list_nth(plan->returningLists, subplan_index);
+
+		/*
+		 * When performing an UPDATE/DELETE .. RETURNING on a join directly,
+		 * we fetch from the foreign server any Vars specified in RETURNING
+		 * that refer not only to the target relation but to non-target
+		 * relations.  So we'll deparse them into the RETURNING clause of the
+		 * remote query; use a targetlist consisting of them instead, which
+		 * will be adjusted to be new fdw_scan_tlist of the foreign-scan plan
+		 * node below.
+		 */
+		if (fscan->scan.scanrelid == 0)
+			returningList = build_remote_returning(resultRelation, rel,
+												   returningList);
+	}
+
+	/*
+	 * Construct the SQL command string.
+	 */
+	switch (operation)
+	{
+		case CMD_UPDATE:
+			deparseDirectUpdateSql(&sql, root, resultRelation, rel,
+								   foreignrel,
+								   processed_tlist,
+								   targetAttrs,
+								   remote_exprs, &params_list,
+								   returningList, &retrieved_attrs);
+			break;
+		case CMD_DELETE:
+			deparseDirectDeleteSql(&sql, root, resultRelation, rel,
+								   foreignrel,
+								   remote_exprs, &params_list,
+								   returningList, &retrieved_attrs);
+			break;
+		default:
+			elog(ERROR, "unexpected operation: %d", (int) operation);
+			break;
+	}
+
+	/*
+	 * Update the operation and target relation info.
+	 */
+	fscan->operation = operation;
+	fscan->resultRelation = resultRelation;
+
+	/*
+	 * Update the fdw_exprs list that will be available to the executor.
+	 */
+	fscan->fdw_exprs = params_list;
+
+	/*
+	 * Update the fdw_private list that will be available to the executor.
+	 * Items in the list must match enum FdwDirectModifyPrivateIndex, above.
+	 */
+	fscan->fdw_private = list_make4(makeString(sql.data),
+									makeBoolean((retrieved_attrs != NIL)),
+									retrieved_attrs,
+									makeBoolean(plan->canSetTag));
+
+	/*
+	 * Update the foreign-join-related fields.
+	 */
+	if (fscan->scan.scanrelid == 0)
+	{
+		/* No need for the outer subplan. */
+		fscan->scan.plan.lefttree = NULL;
+
+		/* Build new fdw_scan_tlist if UPDATE/DELETE .. RETURNING. */
+		if (returningList)
+			rebuild_fdw_scan_tlist(fscan, returningList);
+	}
+
+	/*
+	 * Finally, unset the async-capable flag if it is set, as we currently
+	 * don't support asynchronous execution of direct modifications.
+	 */
+	if (fscan->scan.plan.async_capable)
+		fscan->scan.plan.async_capable = false;
+
+	table_close(rel, NoLock);
+	return true;
+}
+
+/*
+ * postgresBeginDirectModify
+ *		Prepare a direct foreign table modification
+ */
+static void
+postgresBeginDirectModify(ForeignScanState *node, int eflags)
+{
+	ForeignScan *fsplan = (ForeignScan *) node->ss.ps.plan;
+	EState	   *estate = node->ss.ps.state;
+	PgFdwDirectModifyState *dmstate;
+	Index		rtindex;
+	Oid			userid;
+	ForeignTable *table;
+	UserMapping *user;
+	int			numParams;
+
+	/*
+	 * Do nothing in EXPLAIN (no ANALYZE) case.  node->fdw_state stays NULL.
+	 */
+	if (eflags & EXEC_FLAG_EXPLAIN_ONLY)
+		return;
+
+	/*
+	 * We'll save private state in node->fdw_state.
+	 */
+	dmstate = (PgFdwDirectModifyState *) palloc0(sizeof(PgFdwDirectModifyState));
+	node->fdw_state = (void *) dmstate;
+
+	/*
+	 * Identify which user to do the remote access as.  This should match what
+	 * ExecCheckPermissions() does.
+	 */
+	userid = OidIsValid(fsplan->checkAsUser) ? fsplan->checkAsUser : GetUserId();
+
+	/* Get info about foreign table. */
+	rtindex = node->resultRelInfo->ri_RangeTableIndex;
+	if (fsplan->scan.scanrelid == 0)
+		dmstate->rel = ExecOpenScanRelation(estate, rtindex, eflags);
+	else
+		dmstate->rel = node->ss.ss_currentRelation;
+	table = GetForeignTable(RelationGetRelid(dmstate->rel));
+	user = GetUserMapping(userid, table->serverid);
+
+	/*
+	 * Get connection to the foreign server.  Connection manager will
+	 * establish new connection if necessary.
+	 */
+	dmstate->conn = GetConnection(user, false, &dmstate->conn_state);
+
+	/* Update the foreign-join-related fields. */
+	if (fsplan->scan.scanrelid == 0)
+	{
+		/* Save info about foreign table. */
+		dmstate->resultRel = dmstate->rel;
+
+		/*
+		 * Set dmstate->rel to NULL to teach get_returning_data() and
+		 * make_tuple_from_result_row() that columns fetched from the remote
+		 * server are described by fdw_scan_tlist of the foreign-scan plan
+		 * node, not the tuple descriptor for the target relation.
+		 */
+		dmstate->rel = NULL;
+	}
+
+	/* Initialize state variable */
+	dmstate->num_tuples = -1;	/* -1 means not set yet */
+
+	/* Get private info created by planner functions. */
+	dmstate->query = strVal(list_nth(fsplan->fdw_private,
+									 FdwDirectModifyPrivateUpdateSql));
+	dmstate->has_returning = boolVal(list_nth(fsplan->fdw_private,
+											  FdwDirectModifyPrivateHasReturning));
+	dmstate->retrieved_attrs = (List *) list_nth(fsplan->fdw_private,
+												 FdwDirectModifyPrivateRetrievedAttrs);
+	dmstate->set_processed = boolVal(list_nth(fsplan->fdw_private,
+											  FdwDirectModifyPrivateSetProcessed));
+
+	/* Create context for per-tuple temp workspace. */
+	dmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "postgres_fdw temporary data",
+											  ALLOCSET_SMALL_SIZES);
+
+	/* Prepare for input conversion of RETURNING results. */
+	if (dmstate->has_returning)
+	{
+		TupleDesc	tupdesc;
+
+		if (fsplan->scan.scanrelid == 0)
+			tupdesc = get_tupdesc_for_join_scan_tuples(node);
+		else
+			tupdesc = RelationGetDescr(dmstate->rel);
+
+		dmstate->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+		/*
+		 * When performing an UPDATE/DELETE .. RETURNING on a join directly,
+		 * initialize a filter to extract an updated/deleted tuple from a scan
+		 * tuple.
+		 */
+		if (fsplan->scan.scanrelid == 0)
+			init_returning_filter(dmstate, fsplan->fdw_scan_tlist, rtindex);
+	}
+
+	/*
+	 * Prepare for processing of parameters used in remote query, if any.
+	 */
+	numParams = list_length(fsplan->fdw_exprs);
+	dmstate->numParams = numParams;
+	if (numParams > 0)
+		prepare_query_params((PlanState *) node,
+							 fsplan->fdw_exprs,
+							 numParams,
+							 NULL,
+							 &dmstate->param_flinfo,
+							 &dmstate->param_exprs,
+							 &dmstate->param_values,
+							 &dmstate->param_lengths,
+							 &dmstate->param_formats);
+}
+
+/*
+ * postgresIterateDirectModify
+ *		Execute a direct foreign table modification
+ */
+static TupleTableSlot *
+postgresIterateDirectModify(ForeignScanState *node)
+{
+	PgFdwDirectModifyState *dmstate = (PgFdwDirectModifyState *) node->fdw_state;
+	EState	   *estate = node->ss.ps.state;
+	ResultRelInfo *resultRelInfo = node->resultRelInfo;
+
+	/*
+	 * If this is the first call after Begin, execute the statement.
+	 */
+	if (dmstate->num_tuples == -1)
+		execute_dml_stmt(node);
+
+	/*
+	 * If the local query doesn't specify RETURNING, just clear tuple slot.
+	 */
+	if (!resultRelInfo->ri_projectReturning)
+	{
+		TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+		Instrumentation *instr = node->ss.ps.instrument;
+
+		Assert(!dmstate->has_returning);
+
+		/* Increment the command es_processed count if necessary. */
+		if (dmstate->set_processed)
+			estate->es_processed += dmstate->num_tuples;
+
+		/* Increment the tuple count for EXPLAIN ANALYZE if necessary. */
+		if (instr)
+			instr->tuplecount += dmstate->num_tuples;
+
+		return ExecClearTuple(slot);
+	}
+
+	/*
+	 * Get the next RETURNING tuple.
+	 */
+	return get_returning_data(node);
+}
+
+/*
+ * postgresEndDirectModify
+ *		Finish a direct foreign table modification
+ */
+static void
+postgresEndDirectModify(ForeignScanState *node)
+{
+	PgFdwDirectModifyState *dmstate = (PgFdwDirectModifyState *) node->fdw_state;
+
+	/* if dmstate is NULL, we are in EXPLAIN; nothing to do */
+	if (dmstate == NULL)
+		return;
+
+	/* Release PGresult */
+	PQclear(dmstate->result);
+
+	/* Release remote connection */
+	ReleaseConnection(dmstate->conn);
+	dmstate->conn = NULL;
+
+	/* MemoryContext will be deleted automatically. */
+}
+
+/*
+ * postgresExplainForeignScan
+ *		Produce extra output for EXPLAIN of a ForeignScan on a foreign table
+ */
+static void
+postgresExplainForeignScan(ForeignScanState *node, ExplainState *es)
+{
+	ForeignScan *plan = castNode(ForeignScan, node->ss.ps.plan);
+	List	   *fdw_private = plan->fdw_private;
+
+	/*
+	 * Identify foreign scans that are really joins or upper relations.  The
+	 * input looks something like "(1) LEFT JOIN (2)", and we must replace the
+	 * digit string(s), which are RT indexes, with the correct relation names.
+	 * We do that here, not when the plan is created, because we can't know
+	 * what aliases ruleutils.c will assign at plan creation time.
+	 */
+	if (list_length(fdw_private) > FdwScanPrivateRelations &&
+		list_nth(fdw_private, FdwScanPrivateRelations) != NULL)
+	{
+		StringInfo	relations;
+		char	   *rawrelations;
+		char	   *ptr;
+		int			minrti,
+					rtoffset;
+
+		rawrelations = strVal(list_nth(fdw_private, FdwScanPrivateRelations));
+
+		/*
+		 * A difficulty with using a string representation of RT indexes is
+		 * that setrefs.c won't update the string when flattening the
+		 * rangetable.  To find out what rtoffset was applied, identify the
+		 * minimum RT index appearing in the string and compare it to the
+		 * minimum member of plan->fs_base_relids.  (We expect all the relids
+		 * in the join will have been offset by the same amount; the Asserts
+		 * below should catch it if that ever changes.)
+		 */
+		minrti = INT_MAX;
+		ptr = rawrelations;
+		while (*ptr)
+		{
+			if (isdigit((unsigned char) *ptr))
+			{
+				int			rti = strtol(ptr, &ptr, 10);
+
+				if (rti < minrti)
+					minrti = rti;
+			}
+			else
+				ptr++;
+		}
+		rtoffset = bms_next_member(plan->fs_base_relids, -1) - minrti;
+
+		/* Now we can translate the string */
+		relations = makeStringInfo();
+		ptr = rawrelations;
+		while (*ptr)
+		{
+			if (isdigit((unsigned char) *ptr))
+			{
+				int			rti = strtol(ptr, &ptr, 10);
+				RangeTblEntry *rte;
+				char	   *relname;
+				char	   *refname;
+
+				rti += rtoffset;
+				Assert(bms_is_member(rti, plan->fs_base_relids));
+				rte = rt_fetch(rti, es->rtable);
+				Assert(rte->rtekind == RTE_RELATION);
+				/* This logic should agree with explain.c's ExplainTargetRel */
+				relname = get_rel_name(rte->relid);
+				if (es->verbose)
+				{
+					char	   *namespace;
+
+					namespace = get_namespace_name_or_temp(get_rel_namespace(rte->relid));
+					appendStringInfo(relations, "%s.%s",
+									 quote_identifier(namespace),
+									 quote_identifier(relname));
+				}
+				else
+					appendStringInfoString(relations,
+										   quote_identifier(relname));
+				refname = (char *) list_nth(es->rtable_names, rti - 1);
+				if (refname == NULL)
+					refname = rte->eref->aliasname;
+				if (strcmp(refname, relname) != 0)
+					appendStringInfo(relations, " %s",
+									 quote_identifier(refname));
+			}
+			else
+				appendStringInfoChar(relations, *ptr++);
+		}
+		ExplainPropertyText("Relations", relations->data, es);
+	}
+
+	/*
+	 * Add the numbers of remote EXPLAINs issued and skipped for the paths of
+	 * the relations this scan covers, if the planning budget for them was
+	 * set.
+	 */
+	if (list_length(fdw_private) > FdwScanPrivateRemoteEstimates)
+	{
+		List	   *counts = (List *) list_nth(fdw_private,
+											   FdwScanPrivateRemoteEstimates);
+
+		ExplainPropertyInteger("Remote Estimates Issued", NULL,
+							   linitial_int(counts), es);
+		ExplainPropertyInteger("Remote Estimates Skipped", NULL,
+							   lsecond_int(counts), es);
+	}
+
+	/*
+	 * Add remote query, when VERBOSE option is specified.
+	 */
+	if (es->verbose)
+	{
+		char	   *sql;
+
+		sql = strVal(list_nth(fdw_private, FdwScanPrivateSelectSql));
+		ExplainPropertyText("Remote SQL", sql, es);
+
+		if (list_length(fdw_private) > FdwScanPrivateStagedSelectSql &&
+			list_nth(fdw_private, FdwScanPrivateStagedSelectSql) != NULL)
+		{
+			sql = strVal(list_nth(fdw_private,
+								  FdwScanPrivateStagedSelectSql));
+			ExplainPropertyText("Staged Remote SQL", sql, es);
+		}
+	}
+}
+
+/*
+ * postgresExplainForeignModify
+ *		Produce extra output for EXPLAIN of a ModifyTable on a foreign table
+ */
+static void
+postgresExplainForeignModify(ModifyTableState *mtstate,
+							 ResultRelInfo *rinfo,
+							 List *fdw_private,
+							 int subplan_index,
+							 ExplainState *es)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) rinfo->ri_FdwState;
+
+	if (es->verbose)
+	{
+		char	   *sql = strVal(list_nth(fdw_private,
+										  FdwModifyPrivateUpdateSql));
+
+		ExplainPropertyText("Remote SQL", sql, es);
+
+		/*
+		 * For INSERT we should always have batch size >= 1, but UPDATE and
+		 * DELETE don't support batching so don't show the property.
+		 */
+		if (rinfo->ri_BatchSize > 0)
+			ExplainPropertyInteger("Batch Size", NULL, rinfo->ri_BatchSize, es);
+
+		/* Show the COPY command used for batches, if any (EXPLAIN ANALYZE) */
+		if (fmstate && fmstate->copy_query && rinfo->ri_BatchSize > 1)
+			ExplainPropertyText("Remote Batch SQL", fmstate->copy_query, es);
+	}
+}
+
+/*
+ * postgresExplainDirectModify
+ *		Produce extra output for EXPLAIN of a ForeignScan that modifies a
+ *		foreign table directly
+ */
+static void
+postgresExplainDirectModify(ForeignScanState *node, ExplainState *es)
+{
+	List	   *fdw_private;
+	char	   *sql;
+
+	if (es->verbose)
+	{
+		fdw_private = ((ForeignScan *) node->ss.ps.plan)->fdw_private;
+		sql = strVal(list_nth(fdw_private, FdwDirectModifyPrivateUpdateSql));
+		ExplainPropertyText("Remote SQL", sql, es);
+	}
+}
+
+/*
+ * postgresExecForeignTruncate
+ *		Truncate one or more foreign tables
+ */
+static void
+postgresExecForeignTruncate(List *rels,
+							DropBehavior behavior,
+							bool restart_seqs)
+{
+	Oid			serverid = InvalidOid;
+	UserMapping *user = NULL;
+	PGconn	   *conn = NULL;
+	StringInfoData sql;
+	ListCell   *lc;
+	bool		server_truncatable = true;
+
+	/*
+	 * By default, all postgres_fdw foreign tables are assumed truncatable.
+	 * This can be overridden by a per-server setting, which in turn can be
+	 * overridden by a per-table setting.
+	 */
+	foreach(lc, rels)
+	{
+		ForeignServer *server = NULL;
+		Relation	rel = lfirst(lc);
+		ForeignTable *table = GetForeignTable(RelationGetRelid(rel));
+		ListCell   *cell;
+		bool		truncatable;
+
+		/*
+		 * First time through, determine whether the foreign server allows
+		 * truncates. Since all specified foreign tables are assumed to belong
+		 * to the same foreign server, this result can be used for other
+		 * foreign tables.
+		 */
+		if (!OidIsValid(serverid))
+		{
+			serverid = table->serverid;
+			server = GetForeignServer(serverid);
+
+			foreach(cell, server->options)
+			{
+				DefElem    *defel = (DefElem *) lfirst(cell);
+
+				if (strcmp(defel->defname, "truncatable") == 0)
+				{
+					server_truncatable = defGetBoolean(defel);
+					break;
+				}
+			}
+		}
+
+		/*
+		 * Confirm that all specified foreign tables belong to the same
+		 * foreign server.
+		 */
+		Assert(table->serverid == serverid);
+
+		/* Determine whether this foreign table allows truncations */
+		truncatable = server_truncatable;
+		foreach(cell, table->options)
+		{
+			DefElem    *defel = (DefElem *) lfirst(cell);
+
+			if (strcmp(defel->defname, "truncatable") == 0)
+			{
+				truncatable = defGetBoolean(defel);
+				break;
+			}
+		}
+
+		if (!truncatable)
+			ereport(ERROR,
+					(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+					 errmsg("foreign table \"%s\" does not allow truncates",
+							RelationGetRelationName(rel))));
+	}
+	Assert(OidIsValid(serverid));
+
+	/*
+	 * Get connection to the foreign server.  Connection manager will
+	 * establish new connection if necessary.
+	 */
+	user = GetUserMapping(GetUserId(), serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/* Construct the TRUNCATE command string */
+	initStringInfo(&sql);
+	deparseTruncateSql(&sql, rels, behavior, restart_seqs);
+
+	/* Issue the TRUNCATE command to remote server */
+	do_sql_command(conn, sql.data);
+
+	pfree(sql.data);
+}
+
+/*
+ * estimate_path_cost_size
+ *		Get cost and size estimates for a foreign scan on given foreign relation
+ *		either a base relation or a join between foreign relations or an upper
+ *		relation containing foreign relations.
+ *
+ * param_join_conds are the parameterization clauses with outer relations.
+ * pathkeys specify the expected sort order if any for given path being costed.
+ * fpextra specifies additional post-scan/join-processing steps such as the
+ * final sort and the LIMIT restriction.
+ *
+ * The function returns the cost and size estimates in p_rows, p_width,
+ * p_startup_cost and p_total_cost variables.
+ */
+static void
+estimate_path_cost_size(PlannerInfo *root,
+						RelOptInfo *foreignrel,
+						List *param_join_conds,
+						List *pathkeys,
+						PgFdwPathExtraData *fpextra,
+						double *p_rows, int *p_width,
+						Cost *p_startup_cost, Cost *p_total_cost)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	bool		use_remote;
+	double		rows;
+	double		retrieved_rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	Cost		network_startup_cost;
+	Cost		network_run_cost;
+	int			save_issued = remote_estimates_issued;
+	int			save_skipped = remote_estimates_skipped;
+
+	/* Make sure the core code has set up the relation's reltarget */
+	Assert(foreignrel->reltarget);
+
+	/*
+	 * If the table or the server is configured to use remote estimates,
+	 * connect to the foreign server and execute EXPLAIN to estimate the
+	 * number of rows selected by the restriction+join clauses.  Otherwise,
+	 * estimate rows using whatever statistics we have locally, in a way
+	 * similar to ordinary tables.  We also estimate locally once the planning
+	 * budget for remote estimates is exhausted.
+	 */
+	use_remote = fpinfo->use_remote_estimate &&
+		want_remote_estimate(foreignrel, param_join_conds, pathkeys, fpextra);
+	if (use_remote)
+	{
+		List	   *remote_param_join_conds;
+		List	   *local_param_join_conds;
+		StringInfoData sql;
+		Selectivity local_sel;
+		QualCost	local_cost;
+		List	   *fdw_scan_tlist = NIL;
+		List	   *remote_conds;
+
+		/* Required only to be passed to deparseSelectStmtForRel */
+		List	   *retrieved_attrs;
+
+		/*
+		 * param_join_conds might contain both clauses that are safe to send
+		 * across, and clauses that aren't.
+		 */
+		classifyConditions(root, foreignrel, param_join_conds,
+						   &remote_param_join_conds, &local_param_join_conds);
+
+		/* Build the list of columns to be fetched from the foreign server. */
+		if (IS_JOIN_REL(foreignrel) || IS_UPPER_REL(foreignrel))
+			fdw_scan_tlist = build_tlist_to_deparse(foreignrel);
+		else
+			fdw_scan_tlist = NIL;
+
+		/*
+		 * The complete list of remote conditions includes everything from
+		 * baserestrictinfo plus any extra join_conds relevant to this
+		 * particular path.
+		 */
+		remote_conds = list_concat(remote_param_join_conds,
+								   fpinfo->remote_conds);
+
+		/*
+		 * Construct EXPLAIN query including the desired SELECT, FROM, and
+		 * WHERE clauses. Params and other-relation Vars are replaced by dummy
+		 * values, so don't request params_list.
+		 */
+		initStringInfo(&sql);
+		appendStringInfoString(&sql, "EXPLAIN ");
+		deparseSelectStmtForRel(&sql, root, foreignrel, fdw_scan_tlist,
+								remote_conds, pathkeys,
+								fpextra ? fpextra->has_final_sort : false,
+								fpextra ? fpextra->has_limit : false,
+								false, &retrieved_attrs, NULL);
+
+		/* Get the remote estimate */
+		fetch_remote_estimate(fpinfo->user, sql.data, &rows, &width,
+							  &startup_cost, &total_cost);
+
+		retrieved_rows = rows;
+
+		/* Factor in the selectivity of the locally-checked quals */
+		local_sel = clauselist_selectivity(root,
+										   local_param_join_conds,
+										   foreignrel->relid,
+										   JOIN_INNER,
+										   NULL);
+		local_sel *= fpinfo->local_conds_sel;
+
+		rows = clamp_row_est(rows * local_sel);
+
+		/* Add in the eval cost of the locally-checked quals */
+		startup_cost += fpinfo->local_conds_cost.startup;
+		total_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
+		cost_qual_eval(&local_cost, local_param_join_conds, root);
+		startup_cost += local_cost.startup;
+		total_cost += local_cost.per_tuple * retrieved_rows;
+
+		/*
+		 * Add in tlist eval cost for each output row.  In case of an
+		 * aggregate, some of the tlist expressions such as grouping
+		 * expressions will be evaluated remotely, so adjust the costs.
+		 */
+		startup_cost += foreignrel->reltarget->cost.startup;
+		total_cost += foreignrel->reltarget->cost.startup;
+		total_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		if (IS_UPPER_REL(foreignrel))
+		{
+			QualCost	tlist_cost;
+
+			cost_qual_eval(&tlist_cost, fdw_scan_tlist, root);
+			startup_cost -= tlist_cost.startup;
+			total_cost -= tlist_cost.startup;
+			total_cost -= tlist_cost.per_tuple * rows;
+		}
+	}
+	else
+	{
+		Cost		run_cost = 0;
+
+		/*
+		 * Join conditions are supported in this mode only for base relations
+		 * whose join clauses match a remote index (see
+		 * join_clause_matches_remote_index()).
+		 */
+		Assert(param_join_conds == NIL || IS_SIMPLE_REL(foreignrel));
+
+		if (param_join_conds != NIL)
+		{
+			QualCost	join_cost;
+
+			/* Use rows/width estimates made by the core code. */
+			rows = get_parameterized_baserel_size(root, foreignrel,
+												  param_join_conds);
+			width = foreignrel->reltarget->width;
+
+			retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+			if (foreignrel->tuples >= 0)
+				retrieved_rows = Min(retrieved_rows, foreignrel->tuples);
+
+			/*
+			 * Cost as though the remote server did an index scan driven by
+			 * the join conditions, fetching one random page per retrieved
+			 * row, but no more pages than the relation has.
+			 */
+			cost_qual_eval(&join_cost, param_join_conds, root);
+			startup_cost = join_cost.startup +
+				foreignrel->baserestrictcost.startup;
+			run_cost = random_page_cost *
+				Max(Min(retrieved_rows, foreignrel->pages), 1);
+			run_cost += (cpu_tuple_cost + join_cost.per_tuple +
+						 foreignrel->baserestrictcost.per_tuple) * retrieved_rows;
+
+			/* Add in tlist eval cost for each output row */
+			startup_cost += foreignrel->reltarget->cost.startup;
+			run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		}
+
+		/*
+		 * We will come here again and again with different set of pathkeys or
+		 * additional post-scan/join-processing steps that caller wants to
+		 * cost.  We don't need to calculate the cost/size estimates for the
+		 * underlying scan, join, or grouping each time.  Instead, use those
+		 * estimates if we have cached them already.
+		 */
+		else if (fpinfo->rel_startup_cost >= 0 && fpinfo->rel_total_cost >= 0)
+		{
+			Assert(fpinfo->retrieved_rows >= 0);
+
+			rows = fpinfo->rows;
+			retrieved_rows = fpinfo->retrieved_rows;
+			width = fpinfo->width;
+			startup_cost = fpinfo->rel_startup_cost;
+			run_cost = fpinfo->rel_total_cost - fpinfo->rel_startup_cost;
+
+			/*
+			 * If we estimate the costs of a foreign scan or a foreign join
+			 * with additional post-scan/join-processing steps, the scan or
+			 * join costs obtained from the cache wouldn't yet contain the
+			 * eval costs for the final scan/join target, which would've been
+			 * updated by apply_scanjoin_target_to_paths(); add the eval costs
+			 * now.
+			 */
+			if (fpextra && fpextra->has_limit && !IS_UPPER_REL(foreignrel))
+			{
+				Assert(foreignrel->reloptkind == RELOPT_BASEREL ||
+					   foreignrel->reloptkind == RELOPT_JOINREL);
+				startup_cost += foreignrel->reltarget->cost.startup;
+				run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+			}
+		}
+		else if (IS_JOIN_REL(foreignrel))
+		{
+			PgFdwRelationInfo *fpinfo_i;
+			PgFdwRelationInfo *fpinfo_o;
+			QualCost	join_cost;
+			QualCost	remote_conds_cost;
+			double		nrows;
+
+			/* Use rows/width estimates made by the core code. */
+			rows = foreignrel->rows;
+			width = foreignrel->reltarget->width;
+
+			/* For join we expect inner and outer relations set */
+			Assert(fpinfo->innerrel && fpinfo->outerrel);
+
+			fpinfo_i = (PgFdwRelationInfo *) fpinfo->innerrel->fdw_private;
+			fpinfo_o = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+			/* Estimate of number of rows in cross product */
+			nrows = fpinfo_i->rows * fpinfo_o->rows;
+
+			/*
+			 * Back into an estimate of the number of retrieved rows.  Just in
+			 * case this is nuts, clamp to at most nrows.
+			 */
+			retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+			retrieved_rows = Min(retrieved_rows, nrows);
+
+			/*
+			 * The cost of foreign join is estimated as cost of generating
+			 * rows for the joining relations + cost for applying quals on the
+			 * rows.
+			 */
+
+			/*
+			 * Calculate the cost of clauses pushed down to the foreign server
+			 */
+			cost_qual_eval(&remote_conds_cost, fpinfo->remote_conds, root);
+			/* Calculate the cost of applying join clauses */
+			cost_qual_eval(&join_cost, fpinfo->joinclauses, root);
+
+			/*
+			 * Startup cost includes startup cost of joining relations and the
+			 * startup cost for join and other clauses. We do not include the
+			 * startup cost specific to join strategy (e.g. setting up hash
+			 * tables) since we do not know what strategy the foreign server
+			 * is going to use.
+			 */
+			startup_cost = fpinfo_i->rel_startup_cost + fpinfo_o->rel_startup_cost;
+			startup_cost += join_cost.startup;
+			startup_cost += remote_conds_cost.startup;
+			startup_cost += fpinfo->local_conds_cost.startup;
+
+			/*
+			 * Run time cost includes:
+			 *
+			 * 1. Run time cost (total_cost - startup_cost) of relations being
+			 * joined
+			 *
+			 * 2. Run time cost of applying join clauses on the cross product
+			 * of the joining relations.
+			 *
+			 * 3. Run time cost of applying pushed down other clauses on the
+			 * result of join
+			 *
+			 * 4. Run time cost of applying nonpushable other clauses locally
+			 * on the result fetched from the foreign server.
+			 */
+			run_cost = fpinfo_i->rel_total_cost - fpinfo_i->rel_startup_cost;
+			run_cost += fpinfo_o->rel_total_cost - fpinfo_o->rel_startup_cost;
+			run_cost += nrows * join_cost.per_tuple;
+			nrows = clamp_row_est(nrows * fpinfo->joinclause_sel);
+			run_cost += nrows * remote_conds_cost.per_tuple;
+			run_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
+
+			/* Add in tlist eval cost for each output row */
+			startup_cost += foreignrel->reltarget->cost.startup;
+			run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		}
+		else if (IS_UPPER_REL(foreignrel) &&
+				 (fpinfo->stage == UPPERREL_GROUP_AGG ||
+				  fpinfo->stage == UPPERREL_PARTIAL_GROUP_AGG))
+		{
+			RelOptInfo *outerrel = fpinfo->outerrel;
+			PgFdwRelationInfo *ofpinfo;
+			AggSplit	aggsplit;
+			AggClauseCosts aggcosts;
+			double		input_rows;
+			int			numGroupCols;
+			double		numGroups = 1;
+
+			/* The upper relation should have its outer relation set */
+			Assert(outerrel);
+			/* and that outer relation should have its reltarget set */
+			Assert(outerrel->reltarget);
+
+			/*
+			 * This cost model is mixture of costing done for sorted and
+			 * hashed aggregates in cost_agg().  We are not sure which
+			 * strategy will be considered at remote side, thus for
+			 * simplicity, we put all startup related costs in startup_cost
+			 * and all finalization and run cost are added in total_cost.
+			 */
+
+			ofpinfo = (PgFdwRelationInfo *) outerrel->fdw_private;
+
+			/* Get rows from input rel */
+			input_rows = ofpinfo->rows;
+
+			/* Collect statistics about aggregates for estimating costs. */
+			aggsplit = (fpinfo->stage == UPPERREL_PARTIAL_GROUP_AGG) ?
+				AGGSPLIT_INITIAL_SERIAL : AGGSPLIT_SIMPLE;
+			MemSet(&aggcosts, 0, sizeof(AggClauseCosts));
+			if (root->parse->hasAggs)
+			{
+				get_agg_clause_costs(root, aggsplit, &aggcosts);
+			}
+
+			/* Get number of grouping columns and possible number of groups */
+			if (root->parse->groupingSets)
+			{
+				numGroupCols = list_length(root->parse->groupClause);
+				numGroups = estimate_grouping_sets_groups(root,
+														  fpinfo->grouped_tlist,
+														  input_rows);
+			}
+			else
+			{
+				numGroupCols = list_length(root->processed_groupClause);
+				numGroups = estimate_num_groups(root,
+												get_sortgrouplist_exprs(root->processed_groupClause,
+																		fpinfo->grouped_tlist),
+												input_rows, NULL, NULL);
+			}
+
+			/*
+			 * Get the retrieved_rows and rows estimates.  If there are HAVING
+			 * quals, account for their selectivity.
+			 */
+			if (root->hasHavingQual)
+			{
+				/* Factor in the selectivity of the remotely-checked quals */
+				retrieved_rows =
+					clamp_row_est(numGroups *
+								  clauselist_selectivity(root,
+														 fpinfo->remote_conds,
+														 0,
+														 JOIN_INNER,
+														 NULL));
+				/* Factor in the selectivity of the locally-checked quals */
+				rows = clamp_row_est(retrieved_rows * fpinfo->local_conds_sel);
+			}
+			else
+			{
+				rows = retrieved_rows = numGroups;
+			}
+
+			/* Use width estimate made by the core code. */
+			width = foreignrel->reltarget->width;
+
+			/*-----
+			 * Startup cost includes:
+			 *	  1. Startup cost for underneath input relation, adjusted for
+			 *	     tlist replacement by apply_scanjoin_target_to_paths()
+			 *	  2. Cost of performing aggregation, per cost_agg()
+			 *-----
+			 */
+			startup_cost = ofpinfo->rel_startup_cost;
+			startup_cost += outerrel->reltarget->cost.startup;
+			startup_cost += aggcosts.transCost.startup;
+			startup_cost += aggcosts.transCost.per_tuple * input_rows;
+			startup_cost += aggcosts.finalCost.startup;
+			startup_cost += (cpu_operator_cost * numGroupCols) * input_rows;
+
+			/*-----
+			 * Run time cost includes:
+			 *	  1. Run time cost of underneath input relation, adjusted for
+			 *	     tlist replacement by apply_scanjoin_target_to_paths()
+			 *	  2. Run time cost of performing aggregation, per cost_agg()
+			 *-----
+			 */
+			run_cost = ofpinfo->rel_total_cost - ofpinfo->rel_startup_cost;
+			run_cost += outerrel->reltarget->cost.per_tuple * input_rows;
+			run_cost += aggcosts.finalCost.per_tuple * numGroups;
+			run_cost += cpu_tuple_cost * numGroups;
+
+			/* Account for the eval cost of HAVING quals, if any */
+			if (root->hasHavingQual)
+			{
+				QualCost	remote_cost;
+
+				/* Add in the eval cost of the remotely-checked quals */
+				cost_qual_eval(&remote_cost, fpinfo->remote_conds, root);
+				startup_cost += remote_cost.startup;
+				run_cost += remote_cost.per_tuple * numGroups;
+				/* Add in the eval cost of the locally-checked quals */
+				startup_cost += fpinfo->local_conds_cost.startup;
+				run_cost += fpinfo->local_conds_cost.per_tuple * retrieved_rows;
+			}
+
+			/* Add in tlist eval cost for each output row */
+			startup_cost += foreignrel->reltarget->cost.startup;
+			run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		}
+		else if (IS_UPPER_REL(foreignrel))
+		{
+			RelOptInfo *outerrel = fpinfo->outerrel;
+			PgFdwRelationInfo *ofpinfo;
+			double		input_rows;
+
+			/* The upper relation should have its outer relation set */
+			Assert(outerrel);
+			/* and that outer relation should have its reltarget set */
+			Assert(outerrel->reltarget);
+			Assert(fpinfo->stage == UPPERREL_WINDOW ||
+				   fpinfo->stage == UPPERREL_DISTINCT);
+
+			ofpinfo = (PgFdwRelationInfo *) outerrel->fdw_private;
+
+			/* Get rows from input rel */
+			input_rows = ofpinfo->rows;
+
+			/*
+			 * Start from the costs of the underneath input relation, adjusted
+			 * for tlist replacement by apply_scanjoin_target_to_paths().
+			 */
+			startup_cost = ofpinfo->rel_startup_cost;
+			startup_cost += outerrel->reltarget->cost.startup;
+			run_cost = ofpinfo->rel_total_cost - ofpinfo->rel_startup_cost;
+			run_cost += outerrel->reltarget->cost.per_tuple * input_rows;
+
+			if (fpinfo->stage == UPPERREL_WINDOW)
+			{
+				List	   *wfuncs;
+
+				/*
+				 * Window functions don't change the number of rows.  Charge
+				 * one operator eval per window function per input row, per
+				 * cost_windowagg(); we don't know the sort strategy the
+				 * remote side will use, so we don't charge for sorting.
+				 */
+				wfuncs = pull_var_clause((Node *) fpinfo->grouped_tlist,
+										 PVC_INCLUDE_WINDOWFUNCS |
+										 PVC_RECURSE_PLACEHOLDERS);
+				rows = retrieved_rows = input_rows;
+				run_cost += (cpu_operator_cost * list_length(wfuncs) +
+							 cpu_tuple_cost) * input_rows;
+			}
+			else
+			{
+				List	   *distinctExprs;
+				int			numDistinctCols;
+
+				/*
+				 * Estimate the number of distinct rows as cost_agg() would,
+				 * putting the cost of comparing the DISTINCT columns into
+				 * startup_cost.
+				 */
+				distinctExprs = get_sortgrouplist_exprs(root->parse->distinctClause,
+														fpinfo->grouped_tlist);
+				numDistinctCols = list_length(distinctExprs);
+				rows = retrieved_rows =
+					estimate_num_groups(root, distinctExprs, input_rows,
+										NULL, NULL);
+				startup_cost += (cpu_operator_cost * numDistinctCols) * input_rows;
+				run_cost += cpu_tuple_cost * rows;
+			}
+
+			/* Use width estimate made by the core code. */
+			width = foreignrel->reltarget->width;
+
+			/* Add in tlist eval cost for each output row */
+			startup_cost += foreignrel->reltarget->cost.startup;
+			run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		}
+		else
+		{
+			Cost		cpu_per_tuple;
+
+			/* Use rows/width estimates made by set_baserel_size_estimates. */
+			rows = foreignrel->rows;
+			width = foreignrel->reltarget->width;
+
+			/*
+			 * Back into an estimate of the number of retrieved rows.  Just in
+			 * case this is nuts, clamp to at most foreignrel->tuples.
+			 */
+			retrieved_rows = clamp_row_est(rows / fpinfo->local_conds_sel);
+			retrieved_rows = Min(retrieved_rows, foreignrel->tuples);
+
+			/*
+			 * Cost as though this were a seqscan, which is pessimistic.  We
+			 * effectively imagine the local_conds are being evaluated
+			 * remotely, too.
+			 */
+			startup_cost = 0;
+			run_cost = 0;
+			run_cost += seq_page_cost * foreignrel->pages;
+
+			startup_cost += foreignrel->baserestrictcost.startup;
+			cpu_per_tuple = cpu_tuple_cost + foreignrel->baserestrictcost.per_tuple;
+			run_cost += cpu_per_tuple * foreignrel->tuples;
+
+			/* Add in tlist eval cost for each output row */
+			startup_cost += foreignrel->reltarget->cost.startup;
+			run_cost += foreignrel->reltarget->cost.per_tuple * rows;
+		}
+
+		/*
+		 * Without remote estimates, we have no real way to estimate the cost
+		 * of generating sorted output.  It could be free if the query plan
+		 * the remote side would have chosen generates properly-sorted output
+		 * anyway, but in most cases it will cost something.  Estimate a value
+		 * high enough that we won't pick the sorted path when the ordering
+		 * isn't locally useful, but low enough that we'll err on the side of
+		 * pushing down the ORDER BY clause when it's useful to do so.  The
+		 * exception is an ordering that a remote index we know about
+		 * provides, which we assume to be free.
+		 */
+		if (pathkeys != NIL)
+		{
+			if (IS_UPPER_REL(foreignrel) &&
+				fpinfo->stage == UPPERREL_GROUP_AGG)
+			{
+				Assert(foreignrel->reloptkind == RELOPT_UPPER_REL);
+				adjust_foreign_grouping_path_cost(root, pathkeys,
+												  retrieved_rows, width,
+												  fpextra->limit_tuples,
+												  &startup_cost, &run_cost);
+			}
+			else if (!remote_index_provides_pathkeys(root, foreignrel,
+													 pathkeys))
+			{
+				startup_cost *= DEFAULT_FDW_SORT_MULTIPLIER;
+				run_cost *= DEFAULT_FDW_SORT_MULTIPLIER;
+			}
+		}
+
+		total_cost = startup_cost + run_cost;
+
+		/* Adjust the cost estimates if we have LIMIT */
+		if (fpextra && fpextra->has_limit)
+		{
+			adjust_limit_rows_costs(&rows, &startup_cost, &total_cost,
+									fpextra->offset_est, fpextra->count_est);
+			retrieved_rows = rows;
+		}
+	}
+
+	/*
+	 * If this includes the final sort step, the given target, which will be
+	 * applied to the resulting path, might have different expressions from
+	 * the foreignrel's reltarget (see make_sort_input_target()); adjust tlist
+	 * eval costs.
+	 */
+	if (fpextra && fpextra->has_final_sort &&
+		fpextra->target != foreignrel->reltarget)
+	{
+		QualCost	oldcost = foreignrel->reltarget->cost;
+		QualCost	newcost = fpextra->target->cost;
+
+		startup_cost += newcost.startup - oldcost.startup;
+		total_cost += newcost.startup - oldcost.startup;
+		total_cost += (newcost.per_tuple - oldcost.per_tuple) * rows;
+	}
+
+	/*
+	 * Cache the retrieved rows and cost estimates for scans, joins, or
+	 * groupings without any parameterization, pathkeys, or additional
+	 * post-scan/join-processing steps, before adding the costs for
+	 * transferring data from the foreign server.  These estimates are useful
+	 * for costing remote joins involving this relation or costing other
+	 * remote operations on this relation such as remote sorts and remote
+	 * LIMIT restrictions, when the costs can not be obtained from the foreign
+	 * server.  This function will be called at least once for every foreign
+	 * relation without any parameterization, pathkeys, or additional
+	 * post-scan/join-processing steps.
+	 */
+	if (pathkeys == NIL && param_join_conds == NIL && fpextra == NULL)
+	{
+		fpinfo->retrieved_rows = retrieved_rows;
+		fpinfo->rel_startup_cost = startup_cost;
+		fpinfo->rel_total_cost = total_cost;
+	}
+
+	/*
+	 * If the remote query is filtered by a runtime join filter, such as the
+	 * key-set condition of a key-set semi-join, only the rows passing it are
+	 * transferred.  We don't try to model how the filter could change the
+	 * remote plan.
+	 */
+	if (fpextra && fpextra->filter_sel > 0)
+	{
+		rows = clamp_row_est(rows * fpextra->filter_sel);
+		retrieved_rows = clamp_row_est(retrieved_rows * fpextra->filter_sel);
+	}
+
+	/*
+	 * Add some additional cost factors to account for connection overhead
+	 * (fdw_startup_cost), transferring data across the network
+	 * (fdw_tuple_cost per retrieved row), and local manipulation of the data
+	 * (cpu_tuple_cost per retrieved row).  If use_network_cost is enabled and
+	 * the network statistics of the foreign server are known, the costs of
+	 * the round trips and the transfer are estimated from them instead.
+	 */
+	if (fpinfo->use_network_cost &&
+		pgfdw_network_cost(fpinfo->server->serverid, retrieved_rows, width,
+						   fpinfo->fetch_size, fpinfo->fdw_tuple_cost,
+						   &network_startup_cost, &network_run_cost))
+	{
+		startup_cost += network_startup_cost;
+		total_cost += network_startup_cost + network_run_cost;
+	}
+	else
+	{
+		startup_cost += fpinfo->fdw_startup_cost;
+		total_cost += fpinfo->fdw_startup_cost;
+		total_cost += fpinfo->fdw_tuple_cost * retrieved_rows;
+	}
+	total_cost += cpu_tuple_cost * retrieved_rows;
+
+	/*
+	 * If we have LIMIT, we should prefer performing the restriction remotely
+	 * rather than locally, as the former avoids extra row fetches from the
+	 * remote that the latter might cause.  But since the core code doesn't
+	 * account for such fetches when estimating the costs of the local
+	 * restriction (see create_limit_path()), there would be no difference
+	 * between the costs of the local restriction and the costs of the remote
+	 * restriction estimated above if we don't use remote estimates (except
+	 * for the case where the foreignrel is a grouping relation, the given
+	 * pathkeys is not NIL, and the effects of a bounded sort for that rel is
+	 * accounted for in costing the remote restriction).  Tweak the costs of
+	 * the remote restriction to ensure we'll prefer it if LIMIT is a useful
+	 * one.
+	 */
+	if (!use_remote &&
+		fpextra && fpextra->has_limit &&
+		fpextra->limit_tuples > 0 &&
+		fpextra->limit_tuples < fpinfo->rows)
+	{
+		Assert(fpinfo->rows > 0);
+		total_cost -= (total_cost - startup_cost) * 0.05 *
+			(fpinfo->rows - fpextra->limit_tuples) / fpinfo->rows;
+	}
+
+	/* Charge the remote EXPLAINs issued or skipped above to the relation */
+	fpinfo->remote_estimates_issued += remote_estimates_issued - save_issued;
+	fpinfo->remote_estimates_skipped += remote_estimates_skipped - save_skipped;
+
+	/* Return results. */
+	*p_rows = rows;
+	*p_width = width;
+	*p_startup_cost = startup_cost;
+	*p_total_cost = total_cost;
+}
+
+/*
+ * estimate_path_costs_batch
+ *		Get cost and size estimates for the given paths of a foreign relation,
+ *		which are PgFdwPathCost structs.
+ *
+ * This is the same as calling estimate_path_cost_size() for each path,
+ * except that with remote estimates, the remote EXPLAIN commands for all
+ * the paths are collected first, and run together by
+ * run_batch_remote_estimates(), instead of one after another.
+ *
+ * Only the paths the caller passes, that is, the parameterized paths of a
+ * base relation or the sorted paths of a relation, are batched; paths of
+ * different relations are still estimated one relation at a time, as the
+ * planner asks for them.
+ */
+static void
+estimate_path_costs_batch(PlannerInfo *root, RelOptInfo *foreignrel,
+						  List *path_costs)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+	int			save_issued;
+	ListCell   *lc;
+
+	Assert(batch_remote_estimates == NIL);
+
+	PG_TRY();
+	{
+		if (fpinfo->use_remote_estimate && list_length(path_costs) > 1)
+		{
+			/*
+			 * Collect the remote EXPLAIN commands, discarding the results.
+			 * Remember which paths are to be estimated remotely within the
+			 * planning budget, to follow the same decisions below.
+			 */
+			collecting_remote_estimates = true;
+			foreach(lc, path_costs)
+			{
+				PgFdwPathCost *pc = (PgFdwPathCost *) lfirst(lc);
+
+				estimate_path_cost_size(root, foreignrel,
+										pc->param_join_conds, pc->pathkeys,
+										NULL,
+										&pc->rows, &pc->width,
+										&pc->startup_cost, &pc->total_cost);
+				pc->remote = last_remote_decision;
+			}
+			collecting_remote_estimates = false;
+
+			save_issued = remote_estimates_issued;
+			run_batch_remote_estimates();
+			fpinfo->remote_estimates_issued +=
+				remote_estimates_issued - save_issued;
+		}
+
+		/* Now estimate for real, using the remote estimates obtained above */
+		foreach(lc, path_costs)
+		{
+			PgFdwPathCost *pc = (PgFdwPathCost *) lfirst(lc);
+
+			if (batch_remote_estimates != NIL)
+				batch_decision = pc->remote ? BATCH_DECISION_REMOTE :
+					BATCH_DECISION_LOCAL;
+			estimate_path_cost_size(root, foreignrel,
+									pc->param_join_conds, pc->pathkeys, NULL,
+									&pc->rows, &pc->width,
+									&pc->startup_cost, &pc->total_cost);
+		}
+	}
+	PG_FINALLY();
+	{
+		collecting_remote_estimates = false;
+		batch_decision = BATCH_DECISION_NONE;
+		batch_remote_estimates = NIL;
+	}
+	PG_END_TRY();
+}
+
+/*
+ * fetch_remote_estimate
+ *		Get the estimates of a remote EXPLAIN command.
+ *
+ * The estimates obtained by the batch in progress or cached in shared memory
+ * are used if available.  While the batch is collecting the commands, the
+ * command is just added to it, and dummy estimates are returned.
+ */
+static void
+fetch_remote_estimate(UserMapping *user, const char *sql,
+					  double *rows, int *width,
+					  Cost *startup_cost, Cost *total_cost)
+{
+	PgFdwRemoteEstimate *est = NULL;
+	PGconn	   *conn;
+	uint64		epoch;
+	instr_time	start;
+	instr_time	end;
+	ListCell   *lc;
+
+	foreach(lc, batch_remote_estimates)
+	{
+		PgFdwRemoteEstimate *e = (PgFdwRemoteEstimate *) lfirst(lc);
+
+		if (e->user->umid == user->umid && strcmp(e->sql, sql) == 0)
+		{
+			est = e;
+			break;
+		}
+	}
+
+	if (collecting_remote_estimates)
+	{
+		if (est == NULL)
+		{
+			est = (PgFdwRemoteEstimate *) palloc0(sizeof(PgFdwRemoteEstimate));
+			est->user = user;
+			est->sql = pstrdup(sql);
+			est->done = pgfdw_lookup_remote_estimate(user, sql,
+													 &est->rows, &est->width,
+													 &est->startup_cost,
+													 &est->total_cost);
+			batch_remote_estimates = lappend(batch_remote_estimates, est);
+		}
+		*rows = 1;
+		*width = 0;
+		*startup_cost = 0;
+		*total_cost = 0;
+		return;
+	}
+
+	if (est != NULL && est->done)
+	{
+		*rows = est->rows;
+		*width = est->width;
+		*startup_cost = est->startup_cost;
+		*total_cost = est->total_cost;
+		return;
+	}
+
+	if (pgfdw_lookup_remote_estimate(user, sql, rows, width,
+									 startup_cost, total_cost))
+		return;
+
+	epoch = pgfdw_remote_estimate_epoch();
+	INSTR_TIME_SET_CURRENT(start);
+	conn = GetConnection(user, false, NULL);
+	get_remote_estimate(sql, conn, rows, width, startup_cost, total_cost);
+	ReleaseConnection(conn);
+	INSTR_TIME_SET_CURRENT(end);
+	INSTR_TIME_ACCUM_DIFF(remote_estimates_time, end, start);
+	remote_estimates_issued++;
+
+	pgfdw_store_remote_estimate(user, sql, epoch, rows, width,
+								startup_cost, total_cost);
+}
+
+/*
+ * run_batch_remote_estimates
+ *		Run the remote EXPLAIN commands collected by the batch in progress.
+ *
+ * A batch covers the paths of a single foreign relation, which are all
+ * estimated as the same user on the same server, so the commands are sent as
+ * one multi-statement query, and take about one round trip altogether.
+ */
+static void
+run_batch_remote_estimates(void)
+{
+	UserMapping *user = NULL;
+	PGconn	   *conn;
+	StringInfoData sql;
+	PGresult   *volatile res = NULL;
+	int			ncommands = 0;
+	ListCell   *lc;
+	uint64		epoch = pgfdw_remote_estimate_epoch();
+	instr_time	start;
+	instr_time	end;
+
+	/* Build the query of the commands that have no estimates yet */
+	initStringInfo(&sql);
+	foreach(lc, batch_remote_estimates)
+	{
+		PgFdwRemoteEstimate *est = (PgFdwRemoteEstimate *) lfirst(lc);
+
+		if (est->done)
+			continue;
+		Assert(user == NULL || est->user->umid == user->umid);
+		user = est->user;
+		if (sql.len > 0)
+			appendStringInfoString(&sql, "; ");
+		appendStringInfoString(&sql, est->sql);
+		ncommands++;
+	}
+	if (ncommands == 0)
+	{
+		pfree(sql.data);
+		return;
+	}
+
+	INSTR_TIME_SET_CURRENT(start);
+	remote_estimates_issued += ncommands;
+
+	elog(DEBUG1, "sending %d remote EXPLAIN commands together", ncommands);
+
+	conn = GetConnection(user, false, NULL);
+	do_sql_command_begin(conn, sql.data);
+
+	/* Collect the results in the same order; do not leak any PGresults */
+	PG_TRY();
+	{
+		foreach(lc, batch_remote_estimates)
+		{
+			PgFdwRemoteEstimate *est = (PgFdwRemoteEstimate *) lfirst(lc);
+
+			if (est->done)
+				continue;
+
+			res = pgfdw_get_next_result(conn);
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, est->sql);
+			interpret_remote_estimate(res, &est->rows, &est->width,
+									  &est->startup_cost, &est->total_cost);
+			PQclear(res);
+			res = NULL;
+			est->done = true;
+
+			pgfdw_store_remote_estimate(user, est->sql, epoch,
+										est->rows, est->width,
+										est->startup_cost, est->total_cost);
+		}
+
+		/* Consume the end of the results */
+		while ((res = pgfdw_get_next_result(conn)) != NULL)
+		{
+			PQclear(res);
+			res = NULL;
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	ReleaseConnection(conn);
+	pfree(sql.data);
+
+	INSTR_TIME_SET_CURRENT(end);
+	INSTR_TIME_ACCUM_DIFF(remote_estimates_time, end, start);
+}
+
+/*
+ * count_remote_estimates
+ *		Add up the numbers of remote EXPLAINs issued and skipped for the paths
+ *		of the given relation and of the relations it's built on.
+ */
+static void
+count_remote_estimates(RelOptInfo *foreignrel, int *issued, int *skipped)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) foreignrel->fdw_private;
+
+	if (fpinfo == NULL)
+		return;
+
+	*issued += fpinfo->remote_estimates_issued;
+	*skipped += fpinfo->remote_estimates_skipped;
+
+	if (IS_JOIN_REL(foreignrel))
+	{
+		count_remote_estimates(fpinfo->outerrel, issued, skipped);
+		count_remote_estimates(fpinfo->innerrel, issued, skipped);
+	}
+	else if (IS_UPPER_REL(foreignrel))
+		count_remote_estimates(fpinfo->outerrel, issued, skipped);
+}
+
+/*
+ * want_remote_estimate
+ *		Decide whether to estimate the given path with remote estimates,
+ *		within the planning budget for them.
+ *
+ * The scans of base relations without any pathkeys, parameterization, or
+ * additional post-scan steps are always estimated remotely, since the other
+ * estimates are built on them.  The remaining paths are estimated remotely
+ * in the order the planner considers them, that is, joins of fewer
+ * relations, which are the more likely to be pushed down, first, until the
+ * budget is exhausted, and locally after that.
+ *
+ * The sorted or limited scans of base relations gain the least from remote
+ * estimates, since they return the same rows as the plain scan, which has
+ * been estimated remotely, and the local estimates just add the costs of
+ * the sort or the limit to that.  They get only half of the budget, so that
+ * they don't use it up before the parameterized scans, joins and
+ * aggregations are considered.
+ */
+static bool
+want_remote_estimate(RelOptInfo *foreignrel, List *param_join_conds,
+					 List *pathkeys, PgFdwPathExtraData *fpextra)
+{
+	int			max_count = pgfdw_remote_estimate_max_count;
+	int			max_time = pgfdw_remote_estimate_max_time;
+	int			npending = 0;
+	ListCell   *lc;
+
+	if (IS_SIMPLE_REL(foreignrel) && param_join_conds == NIL &&
+		pathkeys == NIL && fpextra == NULL)
+	{
+		last_remote_decision = true;
+		return true;
+	}
+
+	/* Follow the decision the batch in progress made when collecting */
+	if (batch_decision != BATCH_DECISION_NONE)
+	{
+		if (batch_decision == BATCH_DECISION_REMOTE)
+			return true;
+		remote_estimates_skipped++;
+		return false;
+	}
+
+	/* Count the commands the batch in progress is going to issue */
+	foreach(lc, batch_remote_estimates)
+	{
+		if (!((PgFdwRemoteEstimate *) lfirst(lc))->done)
+			npending++;
+	}
+
+	if (IS_SIMPLE_REL(foreignrel) && param_join_conds == NIL)
+	{
+		if (max_count > 0)
+			max_count /= 2;
+		if (max_time > 0)
+			max_time /= 2;
+	}
+
+	if ((max_count >= 0 &&
+		 remote_estimates_issued + npending >= max_count) ||
+		(max_time >= 0 &&
+		 INSTR_TIME_GET_MILLISEC(remote_estimates_time) >= max_time))
+	{
+		/* The batch in progress counts it when estimating for real */
+		if (!collecting_remote_estimates)
+			remote_estimates_skipped++;
+		last_remote_decision = false;
+		return false;
+	}
+
+	last_remote_decision = true;
+	return true;
+}
+
+/*
+ * Estimate costs of executing a SQL statement remotely.
+ * The given "sql" must be an EXPLAIN command.
+ */
+static void
+get_remote_estimate(const char *sql, PGconn *conn,
+					double *rows, int *width,
+					Cost *startup_cost, Cost *total_cost)
+{
+	PGresult   *volatile res = NULL;
+
+	/* PGresult must be released before leaving this function. */
+	PG_TRY();
+	{
+		/*
+		 * Execute EXPLAIN remotely.
+		 */
+		res = pgfdw_exec_query(conn, sql, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, sql);
+
+		interpret_remote_estimate(res, rows, width, startup_cost, total_cost);
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+}
+
+/*
+ * Extract cost numbers for topmost plan node from the result of a remote
+ * EXPLAIN.
+ */
+static void
+interpret_remote_estimate(PGresult *res,
+						  double *rows, int *width,
+						  Cost *startup_cost, Cost *total_cost)
+{
+	char	   *line;
+	char	   *p;
+	int			n;
+
+	/*
+	 * Note we search for a left paren from the end of the line to avoid
+	 * being confused by other uses of parentheses.
+	 */
+	line = PQgetvalue(res, 0, 0);
+	p = strrchr(line, '(');
+	if (p == NULL)
+		elog(ERROR, "could not interpret EXPLAIN output: \"%s\"", line);
+	n = sscanf(p, "(cost=%lf..%lf rows=%lf width=%d)",
+			   startup_cost, total_cost, rows, width);
+	if (n != 4)
+		elog(ERROR, "could not interpret EXPLAIN output: \"%s\"", line);
+}
+
+/*
+ * Estimate the number of groups produced by a query with grouping sets.
+ *
+ * This is the sum of the number of groups of each grouping set, as in
+ * get_number_of_groups() in planner.c.  An empty grouping set produces one
+ * group.
+ */
+static double
+estimate_grouping_sets_groups(PlannerInfo *root, List *grouped_tlist,
+							  double input_rows)
+{
+	Query	   *query = root->parse;
+	List	   *sets;
+	ListCell   *lc;
+	double		numGroups = 0;
+
+	sets = expand_grouping_sets(query->groupingSets, query->groupDistinct, -1);
+	foreach(lc, sets)
+	{
+		List	   *set = (List *) lfirst(lc);
+		List	   *groupExprs = NIL;
+		ListCell   *lc2;
+
+		foreach(lc2, set)
+		{
+			TargetEntry *tle = get_sortgroupref_tle(lfirst_int(lc2),
+													grouped_tlist);
+
+			groupExprs = lappend(groupExprs, tle->expr);
+		}
+
+		if (groupExprs == NIL)
+			numGroups += 1;
+		else
+			numGroups += estimate_num_groups(root, groupExprs, input_rows,
+											 NULL, NULL);
+	}
+
+	return numGroups;
+}
+
+/*
+ * Adjust the cost estimates of a foreign grouping path to include the cost of
+ * generating properly-sorted output.
+ */
+static void
+adjust_foreign_grouping_path_cost(PlannerInfo *root,
+								  List *pathkeys,
+								  double retrieved_rows,
+								  double width,
+								  double limit_tuples,
+								  Cost *p_startup_cost,
+								  Cost *p_run_cost)
+{
+	/*
+	 * If the GROUP BY clause isn't sort-able, the plan chosen by the remote
+	 * side is unlikely to generate properly-sorted output, so it would need
+	 * an explicit sort; adjust the given costs with cost_sort().  Likewise,
+	 * if the GROUP BY clause is sort-able but isn't a superset of the given
+	 * pathkeys, adjust the costs with that function.  The output for grouping
+	 * sets is a concatenation of the output for each set, so it needs an
+	 * explicit sort too.  Otherwise, adjust the costs by applying the same
+	 * heuristic as for the scan or join case.
+	 */
+	if (root->parse->groupingSets ||
+		!grouping_is_sortable(root->processed_groupClause) ||
+		!pathkeys_contained_in(pathkeys, root->group_pathkeys))
+	{
+		Path		sort_path;	/* dummy for result of cost_sort */
+
+		cost_sort(&sort_path,
+				  root,
+				  pathkeys,
+				  *p_startup_cost + *p_run_cost,
+				  retrieved_rows,
+				  width,
+				  0.0,
+				  work_mem,
+				  limit_tuples);
+
+		*p_startup_cost = sort_path.startup_cost;
+		*p_run_cost = sort_path.total_cost - sort_path.startup_cost;
+	}
+	else
+	{
+		/*
+		 * The default extra cost seems too large for foreign-grouping cases;
+		 * add 1/4th of that default.
+		 */
+		double		sort_multiplier = 1.0 + (DEFAULT_FDW_SORT_MULTIPLIER
+											 - 1.0) * 0.25;
+
+		*p_startup_cost *= sort_multiplier;
+		*p_run_cost *= sort_multiplier;
+	}
+}
+
+/*
+ * Detect whether we want to process an EquivalenceClass member.
+ *
+ * This is a callback for use by generate_implied_equalities_for_column.
+ */
+static bool
+ec_member_matches_foreign(PlannerInfo *root, RelOptInfo *rel,
+						  EquivalenceClass *ec, EquivalenceMember *em,
+						  void *arg)
+{
+	ec_member_foreign_arg *state = (ec_member_foreign_arg *) arg;
+	Expr	   *expr = em->em_expr;
+
+	/*
+	 * If we've identified what we're processing in the current scan, we only
+	 * want to match that expression.
+	 */
+	if (state->current != NULL)
+		return equal(expr, state->current);
+
+	/*
+	 * Otherwise, ignore anything we've already processed.
+	 */
+	if (list_member(state->already_used, expr))
+		return false;
+
+	/* This is the new target to process. */
+	state->current = expr;
+	return true;
+}
+
+/*
+ * Create cursor for node's query with current parameter values.
+ */
+static void
+create_cursor(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	int			numParams = fsstate->numParams;
+	const char **values = fsstate->param_values;
+	PGconn	   *conn = fsstate->conn;
+	const char *query = fsstate->query;
+	Datum	   *keys = NULL;
+	int			nkeys = 0;
+	StringInfoData buf;
+	PGresult   *res;
+
+	/* First, process a pending asynchronous request, if any. */
+	if (fsstate->conn_state->pendingAreq)
+		process_pending_request(fsstate->conn_state->pendingAreq);
+
+	/*
+	 * For a key-set semi-join, run the outer plan to collect the local join
+	 * keys.  The outer plan's nodes may allocate state that must survive
+	 * until they are rescanned, so this must not happen in the per-tuple
+	 * context; the keys themselves go into a context of their own that is
+	 * emptied on each rescan.
+	 */
+	if (fsstate->keyset_cxt)
+	{
+		MemoryContextReset(fsstate->keyset_cxt);
+		keys = collect_keyset_values(node, &nkeys);
+	}
+
+	/*
+	 * Construct array of query parameter values.  We do the conversions in
+	 * the short-lived per-tuple context, so as not to cause a memory leak
+	 * over repeated scans.
+	 */
+	if (numParams > 0)
+	{
+		MemoryContext oldcontext;
+
+		oldcontext = MemoryContextSwitchTo(econtext->ecxt_per_tuple_memory);
+
+		process_query_params(econtext,
+							 fsstate->param_flinfo,
+							 fsstate->param_exprs,
+							 values,
+							 fsstate->param_lengths,
+							 fsstate->param_formats);
+
+		/*
+		 * If the key set can be staged, upload all the keys to the remote
+		 * temporary table under our cursor number, and pass that number as
+		 * the ID of the key set in place of the key-set parameter; the
+		 * staged query doesn't take the parameters after it.
+		 */
+		if (fsstate->staged_query && keyset_staging_allowed(conn))
+		{
+			stage_keyset_values(node, keys, nkeys);
+			values[fsstate->keyset_param] = psprintf("%u",
+													 fsstate->cursor_number);
+			query = fsstate->staged_query;
+			numParams = fsstate->keyset_param + 1;
+		}
+
+		/*
+		 * Otherwise, send the collected keys as an array or a Bloom filter.
+		 * Null values tell the remote server not to filter by them.
+		 */
+		else if (fsstate->keyset_param >= 0)
+		{
+			Datum		keyset;
+			bool		keyset_isnull;
+			Datum		bloom;
+			bool		bloom_isnull;
+			int			nestlevel;
+
+			build_keyset_filter(node, keys, nkeys,
+								&keyset, &keyset_isnull,
+								&bloom, &bloom_isnull);
+
+			nestlevel = set_transmission_modes();
+			values[fsstate->keyset_param] = keyset_isnull ? NULL :
+				OutputFunctionCall(&fsstate->param_flinfo[fsstate->keyset_param],
+								   keyset);
+			if (fsstate->bloom_param >= 0)
+				values[fsstate->bloom_param] = bloom_isnull ? NULL :
+					OutputFunctionCall(&fsstate->param_flinfo[fsstate->bloom_param],
+									   bloom);
+			reset_transmission_modes(nestlevel);
+		}
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+
+	/* Construct the DECLARE CURSOR command */
+	initStringInfo(&buf);
+	appendStringInfo(&buf, "DECLARE c%u CURSOR FOR\n%s",
+					 fsstate->cursor_number, query);
+
+	/*
+	 * Notice that we pass NULL for paramTypes, thus forcing the remote server
+	 * to infer types for all parameters.  Since we explicitly cast every
+	 * parameter (see deparse.c), the "inference" is trivial and will produce
+	 * the desired result.  This allows us to avoid assuming that the remote
+	 * server has the same OIDs we do for the parameters' types.  It also
+	 * makes sure that parameters in binary format are read as the types we
+	 * sent.
+	 */
+	if (!PQsendQueryParams(conn, buf.data, numParams,
+						   NULL, values, fsstate->param_lengths,
+						   fsstate->param_formats, 0))
+		pgfdw_report_error(ERROR, NULL, conn, false, buf.data);
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(conn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, conn, true, query);
+	PQclear(res);
+
+	/* Mark the cursor as created, and show no tuples have been retrieved */
+	fsstate->cursor_exists = true;
+	fsstate->tuples = NULL;
+	fsstate->num_tuples = 0;
+	fsstate->next_tuple = 0;
+	fsstate->fetch_ct_2 = 0;
+	fsstate->eof_reached = false;
+
+	/* Clean up */
+	pfree(buf.data);
+}
+
+/*
+ * qsort_arg comparator for join keys collected by collect_keyset_values.
+ */
+static int
+keyset_value_cmp(const void *a, const void *b, void *arg)
+{
+	return ApplySortComparator(*(const Datum *) a, false,
+							   *(const Datum *) b, false,
+							   (SortSupport) arg);
+}
+
+/*
+ * Sort the given join keys and remove duplicates; returns the new count.
+ *
+ * Keys are only merged if they are binary-equal, so that we never lose a
+ * value that might match differently on the remote side.
+ */
+static int
+sort_unique_keyset_values(Datum *keys, int nkeys, SortSupport ssup,
+						  bool typbyval, int16 typlen)
+{
+	int			i;
+	int			j = 0;
+
+	if (nkeys <= 1)
+		return nkeys;
+
+	qsort_arg(keys, nkeys, sizeof(Datum), keyset_value_cmp, ssup);
+
+	for (i = 1; i < nkeys; i++)
+	{
+		if (!datumIsEqual(keys[i], keys[j], typbyval, typlen))
+			keys[++j] = keys[i];
+	}
+	return j + 1;
+}
+
+/*
+ * Compute the hash value of a join key to be added to a Bloom filter; this
+ * must match what pgfdw_plus_bloom_match() computes on the remote server.
+ */
+static inline uint64
+hash_keyset_value(TypeCacheEntry *typentry, Oid collation, Datum value)
+{
+	return DatumGetUInt64(FunctionCall2Coll(&typentry->hash_extended_proc_finfo,
+											collation,
+											value,
+											UInt64GetDatum(0)));
+}
+
+/*
+ * Run the outer plan of a key-set semi-join scan, and return the distinct
+ * non-null join keys it produces, sorted, in an array allocated in the
+ * scan's keyset_cxt.  The number of keys is returned in *nkeys.
+ *
+ * The outer plan is run in the query context, since its nodes may keep
+ * state allocated in the current context across calls.
+ */
+static Datum *
+collect_keyset_values(ForeignScanState *node, int *nkeys)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PlanState  *outerPlan = outerPlanState(node);
+	MemoryContext query_cxt = node->ss.ps.state->es_query_cxt;
+	MemoryContext oldcontext;
+	Form_pg_attribute attr;
+	TypeCacheEntry *typentry;
+	SortSupportData ssup;
+	Datum	   *values;
+	int			nvalues = 0;
+	int			capacity = 64;
+
+	oldcontext = MemoryContextSwitchTo(fsstate->keyset_cxt);
+
+	attr = TupleDescAttr(ExecGetResultType(outerPlan),
+						 fsstate->keyset_attno - 1);
+	typentry = lookup_type_cache(attr->atttypid, TYPECACHE_LT_OPR);
+
+	memset(&ssup, 0, sizeof(SortSupportData));
+	ssup.ssup_cxt = fsstate->keyset_cxt;
+	ssup.ssup_collation = attr->attcollation;
+	ssup.ssup_nulls_first = false;
+	PrepareSortSupportFromOrderingOp(typentry->lt_opr, &ssup);
+
+	values = (Datum *) palloc(capacity * sizeof(Datum));
+
+	for (;;)
+	{
+		TupleTableSlot *slot;
+		Datum		value;
+		bool		isnull;
+
+		CHECK_FOR_INTERRUPTS();
+
+		MemoryContextSwitchTo(query_cxt);
+		slot = ExecProcNode(outerPlan);
+		MemoryContextSwitchTo(fsstate->keyset_cxt);
+		if (TupIsNull(slot))
+			break;
+
+		value = slot_getattr(slot, fsstate->keyset_attno, &isnull);
+		if (isnull)
+			continue;
+
+		if (nvalues >= capacity)
+		{
+			/* Get rid of duplicates before deciding to enlarge the array */
+			nvalues = sort_unique_keyset_values(values, nvalues, &ssup,
+												attr->attbyval, attr->attlen);
+			if (nvalues >= capacity / 2)
+			{
+				capacity *= 2;
+				values = (Datum *) repalloc_huge(values,
+												 capacity * sizeof(Datum));
+			}
+		}
+
+		values[nvalues++] = datumCopy(value, attr->attbyval, attr->attlen);
+	}
+
+	*nkeys = sort_unique_keyset_values(values, nvalues, &ssup,
+									   attr->attbyval, attr->attlen);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	return values;
+}
+
+/*
+ * Build the filter for the given distinct join keys of a key-set semi-join
+ * scan: an array of the keys in *keyset, or, if there are more of them than
+ * postgres_fdw.keyset_join_max_keys, a Bloom filter in *bloom.  If the scan
+ * can't use a Bloom filter, both are returned as null in that case, and the
+ * remote query is not filtered.
+ *
+ * The results are allocated in the current memory context.
+ */
+static void
+build_keyset_filter(ForeignScanState *node, Datum *keys, int nkeys,
+					Datum *keyset, bool *keyset_isnull,
+					Datum *bloom, bool *bloom_isnull)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	Form_pg_attribute attr;
+	TypeCacheEntry *typentry;
+	uint64	   *hashvals;
+	int			i;
+
+	*keyset_isnull = true;
+	*bloom_isnull = true;
+
+	attr = TupleDescAttr(ExecGetResultType(outerPlanState(node)),
+						 fsstate->keyset_attno - 1);
+
+	if (nkeys <= pgfdw_keyset_join_max_keys)
+	{
+		*keyset = PointerGetDatum(construct_array(keys, nkeys,
+												  attr->atttypid,
+												  attr->attlen,
+												  attr->attbyval,
+												  attr->attalign));
+		*keyset_isnull = false;
+		return;
+	}
+
+	if (fsstate->bloom_param < 0)
+		return;
+
+	typentry = lookup_type_cache(attr->atttypid,
+								 TYPECACHE_HASH_EXTENDED_PROC_FINFO);
+	hashvals = (uint64 *) palloc(Max(nkeys, 1) * sizeof(uint64));
+	for (i = 0; i < nkeys; i++)
+		hashvals[i] = hash_keyset_value(typentry, attr->attcollation,
+										keys[i]);
+
+	*bloom = PointerGetDatum(pgfdw_bloom_filter_create(hashvals, nkeys));
+	*bloom_isnull = false;
+}
+
+/*
+ * Can a key-set semi-join scan stage its keys in a remote temporary table?
+ *
+ * Staging writes to the remote server, which read-only transactions and
+ * hot standbys don't allow, and PREPARE TRANSACTION refuses transactions
+ * that have touched temporary tables, so we don't stage if two-phase commit
+ * is enabled either.  The scan sends the keys as an array or a Bloom filter
+ * in these cases.  The remote server reports whether it is in hot standby
+ * or read-only by default only if it's version 14 or later.
+ */
+static bool
+keyset_staging_allowed(PGconn *conn)
+{
+	const char *value;
+
+	if (XactReadOnly || pgfdw_two_phase_commit)
+		return false;
+
+	value = PQparameterStatus(conn, "in_hot_standby");
+	if (value && strcmp(value, "on") == 0)
+		return false;
+	value = PQparameterStatus(conn, "default_transaction_read_only");
+	if (value && strcmp(value, "on") == 0)
+		return false;
+
+	return true;
+}
+
+/*
+ * Stage the given join keys of a key-set semi-join scan in the remote
+ * temporary table, as the key set identified by the scan's cursor number.
+ *
+ * The table is created on first use in the remote session, and its rows go
+ * away at the end of the remote transaction.  The keys are loaded with COPY
+ * in text format, and the table is analyzed afterwards so that the remote
+ * planner knows how many keys the query will look up.
+ */
+static void
+stage_keyset_values(ForeignScanState *node, Datum *keys, int nkeys)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PGconn	   *conn = fsstate->conn;
+	Oid			elemtype;
+	Oid			typoutput;
+	bool		typisvarlena;
+	FmgrInfo	outfunc;
+	StringInfoData sql;
+	StringInfoData buf;
+	PGresult   *res;
+	int			nestlevel;
+	int			i;
+
+	/*
+	 * Create the table if this remote session doesn't have it yet, and get
+	 * rid of the keys left by a previous scan with our cursor number.
+	 */
+	initStringInfo(&sql);
+	appendStringInfo(&sql,
+					 "DO $$BEGIN "
+					 "IF pg_catalog.to_regclass('pg_temp.%s') IS NULL THEN "
+					 "CREATE TEMP TABLE %s (setid int, k text) "
+					 "ON COMMIT DELETE ROWS; "
+					 "END IF; END$$; "
+					 "DELETE FROM pg_temp.%s WHERE setid = %u",
+					 PGFDW_PLUS_KEYSET_TABLE, PGFDW_PLUS_KEYSET_TABLE,
+					 PGFDW_PLUS_KEYSET_TABLE, fsstate->cursor_number);
+	do_sql_command(conn, sql.data);
+
+	resetStringInfo(&sql);
+	appendStringInfo(&sql, "COPY pg_temp.%s FROM STDIN",
+					 PGFDW_PLUS_KEYSET_TABLE);
+	res = pgfdw_exec_query(conn, sql.data, fsstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+		pgfdw_report_error(ERROR, res, conn, true, sql.data);
+	PQclear(res);
+
+	elemtype = TupleDescAttr(ExecGetResultType(outerPlanState(node)),
+							 fsstate->keyset_attno - 1)->atttypid;
+	getTypeOutputInfo(elemtype, &typoutput, &typisvarlena);
+	fmgr_info(typoutput, &outfunc);
+
+	/* Send the keys in chunks of about 64kB */
+	initStringInfo(&buf);
+	nestlevel = set_transmission_modes();
+	for (i = 0; i < nkeys; i++)
+	{
+		appendStringInfo(&buf, "%u\t", fsstate->cursor_number);
+		append_copy_text_value(&buf, OutputFunctionCall(&outfunc, keys[i]));
+		appendStringInfoChar(&buf, '\n');
+
+		if (buf.len >= 65536 || i == nkeys - 1)
+		{
+			if (!pgfdw_put_copy_data(conn, buf.data, buf.len))
+				pgfdw_report_error(ERROR, NULL, conn, false, sql.data);
+			resetStringInfo(&buf);
+		}
+	}
+	reset_transmission_modes(nestlevel);
+
+	if (!pgfdw_put_copy_end(conn, NULL))
+		pgfdw_report_error(ERROR, NULL, conn, false, sql.data);
+	res = pgfdw_get_result(conn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, conn, true, sql.data);
+	PQclear(res);
+
+	resetStringInfo(&sql);
+	appendStringInfo(&sql, "ANALYZE pg_temp.%s", PGFDW_PLUS_KEYSET_TABLE);
+	do_sql_command(conn, sql.data);
+
+	pfree(sql.data);
+	pfree(buf.data);
+}
+
+/*
+ * Append the given value to buf, escaped as a column of COPY text format.
+ */
+static void
+append_copy_text_value(StringInfo buf, const char *value)
+{
+	const char *p;
+
+	for (p = value; *p; p++)
+	{
+		switch (*p)
+		{
+			case '\\':
+				appendStringInfoString(buf, "\\\\");
+				break;
+			case '\n':
+				appendStringInfoString(buf, "\\n");
+				break;
+			case '\r':
+				appendStringInfoString(buf, "\\r");
+				break;
+			case '\t':
+				appendStringInfoString(buf, "\\t");
+				break;
+			default:
+				appendStringInfoChar(buf, *p);
+				break;
+		}
+	}
+}
+
+/*
+ * Fetch some more rows from the node's cursor.
+ */
+static void
+fetch_more_data(ForeignScanState *node)
+{
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	PGresult   *volatile res = NULL;
+	MemoryContext oldcontext;
+
+	/*
+	 * We'll store the tuples in the batch_cxt.  First, flush the previous
+	 * batch.
+	 */
+	fsstate->tuples = NULL;
+	MemoryContextReset(fsstate->batch_cxt);
+	oldcontext = MemoryContextSwitchTo(fsstate->batch_cxt);
+
+	/* PGresult must be released before leaving this function. */
+	PG_TRY();
+	{
+		PGconn	   *conn = fsstate->conn;
+		int			numrows;
+		int			i;
+
+		if (fsstate->async_capable)
+		{
+			Assert(fsstate->conn_state->pendingAreq);
+
+			/*
+			 * The query was already sent by an earlier call to
+			 * fetch_more_data_begin.  So now we just fetch the result.
+			 */
+			res = pgfdw_get_result(conn);
+			/* On error, report the original query, not the FETCH. */
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+
+			/* Reset per-connection state */
+			fsstate->conn_state->pendingAreq = NULL;
+		}
+		else
+		{
+			char		sql[64];
+
+			/* This is a regular synchronous fetch. */
+			snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+					 fsstate->fetch_size, fsstate->cursor_number);
+
+			res = pgfdw_exec_query(conn, sql, fsstate->conn_state);
+			/* On error, report the original query, not the FETCH. */
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, fsstate->query);
+		}
+
+		/* Convert the data into HeapTuples */
+		numrows = PQntuples(res);
+		fsstate->tuples = (HeapTuple *) palloc0(numrows * sizeof(HeapTuple));
+		fsstate->num_tuples = numrows;
+		fsstate->next_tuple = 0;
+
+		for (i = 0; i < numrows; i++)
+		{
+			Assert(IsA(node->ss.ps.plan, ForeignScan));
+
+			fsstate->tuples[i] =
+				make_tuple_from_result_row(res, i,
+										   fsstate->rel,
+										   fsstate->attinmeta,
+										   fsstate->retrieved_attrs,
+										   node,
+										   fsstate->temp_cxt);
+		}
+
+		/* Update fetch_ct_2 */
+		if (fsstate->fetch_ct_2 < 2)
+			fsstate->fetch_ct_2++;
+
+		/* Must be EOF if we didn't get as many tuples as we asked for. */
+		fsstate->eof_reached = (numrows < fsstate->fetch_size);
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(oldcontext);
+}
+
+/*
+ * Force assorted GUC parameters to settings that ensure that we'll output
+ * data values in a form that is unambiguous to the remote server.
+ *
+ * This is rather expensive and annoying to do once per row, but there's
+ * little choice if we want to be sure values are transmitted accurately;
+ * we can't leave the settings in place between rows for fear of affecting
+ * user-visible computations.
+ *
+ * We use the equivalent of a function SET option to allow the settings to
+ * persist only until the caller calls reset_transmission_modes().  If an
+ * error is thrown in between, guc.c will take care of undoing the settings.
+ *
+ * The return value is the nestlevel that must be passed to
+ * reset_transmission_modes() to undo things.
+ */
+int
+set_transmission_modes(void)
+{
+	int			nestlevel = NewGUCNestLevel();
+
+	/*
+	 * The values set here should match what pg_dump does.  See also
+	 * configure_remote_session in connection.c.
+	 */
+	if (DateStyle != USE_ISO_DATES)
+		(void) set_config_option("datestyle", "ISO",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+	if (IntervalStyle != INTSTYLE_POSTGRES)
+		(void) set_config_option("intervalstyle", "postgres",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+	if (extra_float_digits < 3)
+		(void) set_config_option("extra_float_digits", "3",
+								 PGC_USERSET, PGC_S_SESSION,
+								 GUC_ACTION_SAVE, true, 0, false);
+
+	/*
+	 * In addition force restrictive search_path, in case there are any
+	 * regproc or similar constants to be printed.
+	 */
+	(void) set_config_option("search_path", "pg_catalog",
+							 PGC_USERSET, PGC_S_SESSION,
+							 GUC_ACTION_SAVE, true, 0, false);
+
+	return nestlevel;
+}
+
+/*
+ * Undo the effects of set_transmission_modes().
+ */
+void
+reset_transmission_modes(int nestlevel)
+{
+	AtEOXact_GUC(true, nestlevel);
+}
+
+/*
+ * Utility routine to close a cursor.
+ */
+static void
+close_cursor(PGconn *conn, unsigned int cursor_number,
+			 PgFdwConnState *conn_state)
+{
+	char		sql[64];
+	PGresult   *res;
+
+	snprintf(sql, sizeof(sql), "CLOSE c%u", cursor_number);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_query(conn, sql, conn_state);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, conn, true, sql);
+	PQclear(res);
+}
+
+/*
+ * create_foreign_modify
+ *		Construct an execution state of a foreign insert/update/delete
+ *		operation
+ */
+static PgFdwModifyState *
+create_foreign_modify(EState *estate,
+					  RangeTblEntry *rte,
+					  ResultRelInfo *resultRelInfo,
+					  CmdType operation,
+					  Plan *subplan,
+					  char *query,
+					  List *target_attrs,
+					  int values_end,
+					  bool has_returning,
+					  bool doNothing,
+					  List *retrieved_attrs)
+{
+	PgFdwModifyState *fmstate;
+	Relation	rel = resultRelInfo->ri_RelationDesc;
+	TupleDesc	tupdesc = RelationGetDescr(rel);
+	Oid			userid;
+	ForeignTable *table;
+	UserMapping *user;
+	AttrNumber	n_params;
+	Oid			typefnoid;
+	bool		isvarlena;
+	ListCell   *lc;
+
+	/* Begin constructing PgFdwModifyState. */
+	fmstate = (PgFdwModifyState *) palloc0(sizeof(PgFdwModifyState));
+	fmstate->rel = rel;
+
+	/* Identify which user to do the remote access as. */
+	userid = ExecGetResultRelCheckAsUser(resultRelInfo, estate);
+
+	/* Get info about foreign table. */
+	table = GetForeignTable(RelationGetRelid(rel));
+	user = GetUserMapping(userid, table->serverid);
+
+	/* Open connection; report that we'll create a prepared statement. */
+	fmstate->conn = GetConnection(user, true, &fmstate->conn_state);
+	fmstate->p_name = NULL;		/* prepared statement not made yet */
+
+	/* Set up remote query information. */
+	fmstate->query = query;
+	if (operation == CMD_INSERT)
+	{
+		fmstate->query = pstrdup(fmstate->query);
+		fmstate->orig_query = pstrdup(fmstate->query);
+	}
+	fmstate->target_attrs = target_attrs;
+	fmstate->values_end = values_end;
+	fmstate->has_returning = has_returning;
+	fmstate->retrieved_attrs = retrieved_attrs;
+
+	/* Create context for per-tuple temp workspace. */
+	fmstate->temp_cxt = AllocSetContextCreate(estate->es_query_cxt,
+											  "postgres_fdw temporary data",
+											  ALLOCSET_SMALL_SIZES);
+
+	/* Prepare for input conversion of RETURNING results. */
+	if (fmstate->has_returning)
+		fmstate->attinmeta = TupleDescGetAttInMetadata(tupdesc);
+
+	/* Prepare for output conversion of parameters used in prepared stmt. */
+	n_params = list_length(fmstate->target_attrs) + 1;
+	fmstate->p_flinfo = (FmgrInfo *) palloc0(sizeof(FmgrInfo) * n_params);
+	fmstate->p_types = (Oid *) palloc0(sizeof(Oid) * n_params);
+	fmstate->p_nums = 0;
+
+	if (operation == CMD_UPDATE || operation == CMD_DELETE)
+	{
+		Assert(subplan != NULL);
+
+		/* Find the ctid resjunk column in the subplan's result */
+		fmstate->ctidAttno = ExecFindJunkAttributeInTlist(subplan->targetlist,
+														  "ctid");
+		if (!AttributeNumberIsValid(fmstate->ctidAttno))
+			elog(ERROR, "could not find junk ctid column");
+
+		/* First transmittable parameter will be ctid */
+		getTypeOutputInfo(TIDOID, &typefnoid, &isvarlena);
+		fmgr_info(typefnoid, &fmstate->p_flinfo[fmstate->p_nums]);
+		fmstate->p_types[fmstate->p_nums] = TIDOID;
+		fmstate->p_nums++;
+	}
+
+	if (operation == CMD_INSERT || operation == CMD_UPDATE)
+	{
+		/* Set up for remaining transmittable parameters */
+		foreach(lc, fmstate->target_attrs)
+		{
+			int			attnum = lfirst_int(lc);
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+
+			Assert(!attr->attisdropped);
+
+			/* Ignore generated columns; they are set to DEFAULT */
+			if (attr->attgenerated)
+				continue;
+			getTypeOutputInfo(attr->atttypid, &typefnoid, &isvarlena);
+			fmgr_info(typefnoid, &fmstate->p_flinfo[fmstate->p_nums]);
+			fmstate->p_types[fmstate->p_nums] = attr->atttypid;
+			fmstate->p_nums++;
+		}
+	}
+
+	Assert(fmstate->p_nums <= n_params);
+
+	/* Set batch_size from foreign server/table options. */
+	if (operation == CMD_INSERT)
+		fmstate->batch_size = get_batch_size_option(rel);
+
+	/*
+	 * Set up for sending batches with COPY, if so requested.  COPY can't send
+	 * back the inserted rows nor skip conflicting ones, so we can't use it if
+	 * the INSERT has RETURNING (which also covers WITH CHECK OPTION and AFTER
+	 * ROW triggers) or ON CONFLICT DO NOTHING.  It also needs some column to
+	 * copy.
+	 */
+	if (operation == CMD_INSERT && fmstate->batch_size > 1 &&
+		!has_returning && !doNothing && fmstate->p_nums > 0)
+	{
+		PgFdwBatchInsertMethod method = get_batch_insert_method(rel);
+
+		if (method != BATCH_INSERT_INSERT)
+			prepare_copy_insert(fmstate, rte, method);
+	}
+
+	/* Set up for sizing the statements of batches adaptively, if requested */
+	if (operation == CMD_INSERT && fmstate->batch_size > 1 &&
+		fmstate->copy_query == NULL)
+	{
+		fmstate->batch_target_size = get_batch_target_size(rel);
+		if (fmstate->batch_target_size > 0)
+		{
+			fmstate->batch_shape = 1;
+			fmstate->shape_p_names = (char **)
+				palloc0(sizeof(char *) * NUM_BATCH_SHAPES);
+			fmstate->shape_usec_per_row = (double *)
+				palloc0(sizeof(double) * NUM_BATCH_SHAPES);
+		}
+	}
+
+	fmstate->num_slots = 1;
+
+	/* Initialize auxiliary state */
+	fmstate->aux_fmstate = NULL;
+
+	return fmstate;
+}
+
+/*
+ * execute_foreign_modify
+ *		Perform foreign-table modification as required, and fetch RETURNING
+ *		result if any.  (This is the shared guts of postgresExecForeignInsert,
+ *		postgresExecForeignBatchInsert, postgresExecForeignUpdate, and
+ *		postgresExecForeignDelete.)
+ */
+static TupleTableSlot **
+execute_foreign_modify(EState *estate,
+					   ResultRelInfo *resultRelInfo,
+					   CmdType operation,
+					   TupleTableSlot **slots,
+					   TupleTableSlot **planSlots,
+					   int *numSlots)
+{
+	PgFdwModifyState *fmstate = (PgFdwModifyState *) resultRelInfo->ri_FdwState;
+	ItemPointer ctid = NULL;
+	const char **p_values;
+	int		   *p_lengths;
+	int		   *p_formats;
+	PGresult   *res;
+	int			n_rows;
+	StringInfoData sql;
+
+	/* The operation should be INSERT, UPDATE, or DELETE */
+	Assert(operation == CMD_INSERT ||
+		   operation == CMD_UPDATE ||
+		   operation == CMD_DELETE);
+
+	/* First, process a pending asynchronous request, if any. */
+	if (fmstate->conn_state->pendingAreq)
+		process_pending_request(fmstate->conn_state->pendingAreq);
+
+	/*
+	 * Send the rows with COPY if we're set up to.  The core code inserts rows
+	 * one at a time if it decided against batching, though, in which case a
+	 * prepared INSERT is cheaper.
+	 */
+	if (operation == CMD_INSERT && fmstate->copy_query &&
+		resultRelInfo->ri_BatchSize > 1)
+	{
+		n_rows = execute_copy_insert(fmstate, slots, *numSlots);
+		*numSlots = n_rows;
+		return (n_rows > 0) ? slots : NULL;
+	}
+
+	/* Likewise if the statements are to be sized adaptively */
+	if (operation == CMD_INSERT && fmstate->batch_target_size > 0)
+	{
+		n_rows = execute_adaptive_insert(fmstate, slots, *numSlots);
+		*numSlots = n_rows;
+		return (n_rows > 0) ? slots : NULL;
+	}
+
+	/*
+	 * If the existing query was deparsed and prepared for a different number
+	 * of rows, rebuild it for the proper number.
+	 */
+	if (operation == CMD_INSERT && fmstate->num_slots != *numSlots)
+	{
+		/* Destroy the prepared statement created previously */
+		if (fmstate->p_name)
+			deallocate_query(fmstate);
+
+		/* Build INSERT string with numSlots records in its VALUES clause. */
+		initStringInfo(&sql);
+		rebuildInsertSql(&sql, fmstate->rel,
+						 fmstate->orig_query, fmstate->target_attrs,
+						 fmstate->values_end, fmstate->p_nums,
+						 *numSlots - 1);
+		pfree(fmstate->query);
+		fmstate->query = sql.data;
+		fmstate->num_slots = *numSlots;
+	}
+
+	/* Set up the prepared statement on the remote server, if we didn't yet */
+	if (!fmstate->p_name)
+		prepare_foreign_modify(fmstate);
+
+	/*
+	 * For UPDATE/DELETE, get the ctid that was passed up as a resjunk column
+	 */
+	if (operation == CMD_UPDATE || operation == CMD_DELETE)
+	{
+		Datum		datum;
+		bool		isNull;
+
+		datum = ExecGetJunkAttribute(planSlots[0],
+									 fmstate->ctidAttno,
+									 &isNull);
+		/* shouldn't ever get a null result... */
+		if (isNull)
+			elog(ERROR, "ctid is NULL");
+		ctid = (ItemPointer) DatumGetPointer(datum);
+	}
+
+	/* Convert parameters needed by prepared statement to text/binary form */
+	p_values = convert_prep_stmt_params(fmstate, ctid, slots, *numSlots,
+										&p_lengths, &p_formats);
+
+	/*
+	 * Execute the prepared statement.
+	 */
+	if (!PQsendQueryPrepared(fmstate->conn,
+							 fmstate->p_name,
+							 fmstate->p_nums * (*numSlots),
+							 p_values,
+							 p_lengths,
+							 p_formats,
+							 0))
+		pgfdw_report_error(ERROR, NULL, fmstate->conn, false, fmstate->query);
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(fmstate->conn);
+	if (PQresultStatus(res) !=
+		(fmstate->has_returning ? PGRES_TUPLES_OK : PGRES_COMMAND_OK))
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, fmstate->query);
+
+	/* Check number of rows affected, and fetch RETURNING tuple if any */
+	if (fmstate->has_returning)
+	{
+		Assert(*numSlots == 1);
+		n_rows = PQntuples(res);
+		if (n_rows > 0)
+			store_returning_result(fmstate, slots[0], res);
+	}
+	else
+		n_rows = atoi(PQcmdTuples(res));
+
+	/* And clean up */
+	PQclear(res);
+
+	MemoryContextReset(fmstate->temp_cxt);
+
+	*numSlots = n_rows;
+
+	/*
+	 * Return NULL if nothing was inserted/updated/deleted on the remote end
+	 */
+	return (n_rows > 0) ? slots : NULL;
+}
+
+/*
+ * prepare_foreign_modify
+ *		Establish a prepared statement for execution of INSERT/UPDATE/DELETE
+ */
+static void
+prepare_foreign_modify(PgFdwModifyState *fmstate)
+{
+	char		prep_name[NAMEDATALEN];
+	char	   *p_name;
+	PGresult   *res;
+
+	/*
+	 * The caller would already have processed a pending asynchronous request
+	 * if any, so no need to do it here.
+	 */
+
+	/* Construct name we'll use for the prepared statement. */
+	snprintf(prep_name, sizeof(prep_name), "pgsql_fdw_prep_%u",
+			 GetPrepStmtNumber(fmstate->conn));
+	p_name = pstrdup(prep_name);
+
+	/*
+	 * The first time through, see which parameters can be sent in binary,
+	 * which needs a Describe along with the Prepare.
+	 */
+	if (!fmstate->p_formats_chosen && fmstate->p_nums > 0)
+	{
+		prepare_and_describe(fmstate, p_name);
+
+		/* This action shows that the prepare has been done. */
+		fmstate->p_name = p_name;
+		return;
+	}
+	fmstate->p_formats_chosen = true;
+
+	/*
+	 * We intentionally do not specify parameter types here, but leave the
+	 * remote server to derive them by default.  This avoids possible problems
+	 * with the remote server using different type OIDs than we do.  All of
+	 * the prepared statements we use in this module are simple enough that
+	 * the remote server will make the right choices.
+	 */
+	if (!PQsendPrepare(fmstate->conn,
+					   p_name,
+					   fmstate->query,
+					   0,
+					   NULL))
+		pgfdw_report_error(ERROR, NULL, fmstate->conn, false, fmstate->query);
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_get_result(fmstate->conn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, fmstate->query);
+	PQclear(res);
+
+	/* This action shows that the prepare has been done. */
+	fmstate->p_name = p_name;
+}
+
+/*
+ * prepare_and_describe
+ *		Establish a prepared statement as prepare_foreign_modify() does, and
+ *		choose the formats of its parameters from its description
+ *
+ * The Describe is sent in a pipeline with the Prepare, so that it costs no
+ * extra round trip.  All the results are read, and pipeline mode is left,
+ * before any error is reported, so that the connection remains usable for
+ * the abort cleanup.
+ */
+static void
+prepare_and_describe(PgFdwModifyState *fmstate, const char *p_name)
+{
+	PGconn	   *conn = fmstate->conn;
+	PGresult   *results[2] = {NULL, NULL};
+
+	/* As prepare_foreign_modify(), we don't specify parameter types. */
+	if (!PQenterPipelineMode(conn))
+		pgfdw_report_error(ERROR, NULL, conn, false, fmstate->query);
+	if (!PQsendPrepare(conn, p_name, fmstate->query, 0, NULL) ||
+		!PQsendDescribePrepared(conn, p_name) ||
+		!PQpipelineSync(conn))
+	{
+		/*
+		 * Whatever was queued must be drained, and pipeline mode left, before
+		 * we report the failure.  A sync is needed to end the pipeline if we
+		 * didn't get to send it; if that fails too, the connection is broken
+		 * and there's nothing to drain anyway.
+		 */
+		(void) PQpipelineSync(conn);
+		collect_pipeline_results(conn, NULL, 0);
+		pgfdw_report_error(ERROR, NULL, conn, false, fmstate->query);
+	}
+
+	collect_pipeline_results(conn, results, lengthof(results));
+
+	if (PQresultStatus(results[0]) != PGRES_COMMAND_OK)
+	{
+		PQclear(results[1]);
+		pgfdw_report_error(ERROR, results[0], conn, true, fmstate->query);
+	}
+	PQclear(results[0]);
+
+	choose_param_formats(fmstate, results[1]);
+}
+
+/*
+ * collect_pipeline_results
+ *		Read the results of the commands sent in pipeline mode up to the
+ *		pipeline sync, and leave pipeline mode
+ *
+ * The first maxresults results are stored into results, and the rest are
+ * discarded.  Each command's result is followed by a NULL; two NULLs in a
+ * row mean that nothing more is coming, e.g., because the connection has
+ * been lost.
+ *
+ * We don't use a PG_TRY block here, so be careful not to throw error
+ * without releasing the PGresults.
+ */
+static void
+collect_pipeline_results(PGconn *conn, PGresult **results, int maxresults)
+{
+	int			nresults = 0;
+	bool		separated = false;
+
+	for (;;)
+	{
+		PGresult   *res = pgfdw_get_next_result(conn);
+
+		if (res == NULL)
+		{
+			if (separated)
+				break;
+			separated = true;
+			continue;
+		}
+		separated = false;
+
+		if (PQresultStatus(res) == PGRES_PIPELINE_SYNC)
+		{
+			PQclear(res);
+			break;
+		}
+		if (nresults < maxresults)
+			results[nresults++] = res;
+		else
+			PQclear(res);
+	}
+	(void) PQexitPipelineMode(conn);
+}
+
+/*
+ * choose_param_formats
+ *		Decide which parameters of a prepared INSERT/UPDATE/DELETE to send in
+ *		binary format, given the result of describing the statement
+ *
+ * As the remote server infers the types of the parameters from the columns
+ * they go into, they can differ from ours; text values are converted by the
+ * remote input functions, but binary ones would be misread.  So use the
+ * inferred types, and use binary format only for parameters of the same
+ * built-in types as ours.  res is released here.
+ */
+static void
+choose_param_formats(PgFdwModifyState *fmstate, PGresult *res)
+{
+	Oid		   *remote_types;
+	int		   *formats;
+	bool		any_binary = false;
+	int			i;
+
+	fmstate->p_formats_chosen = true;
+
+	/*
+	 * Check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, fmstate->query);
+	remote_types = (Oid *) palloc(sizeof(Oid) * fmstate->p_nums);
+	for (i = 0; i < fmstate->p_nums; i++)
+		remote_types[i] = PQparamtype(res, i);
+	PQclear(res);
+
+	formats = (int *) palloc0(sizeof(int) * fmstate->p_nums);
+	for (i = 0; i < fmstate->p_nums; i++)
+	{
+		Oid			typid = fmstate->p_types[i];
+		Oid			typsend;
+		bool		isvarlena;
+
+		if (remote_types[i] != typid || !binary_transfer_ok(typid))
+			continue;
+
+		getTypeBinaryOutputInfo(typid, &typsend, &isvarlena);
+		fmgr_info(typsend, &fmstate->p_flinfo[i]);
+		formats[i] = 1;
+		any_binary = true;
+	}
+	pfree(remote_types);
+
+	if (any_binary)
+		fmstate->p_formats = formats;
+	else
+		pfree(formats);
+}
+
+/*
+ * prepare_copy_insert
+ *		Set up for sending batches of an INSERT with COPY FROM STDIN
+ *
+ * Binary format is used if requested and if the remote server can read what
+ * our send functions produce into the remote columns, else text format.
+ */
+static void
+prepare_copy_insert(PgFdwModifyState *fmstate, RangeTblEntry *rte,
+					PgFdwBatchInsertMethod method)
+{
+	TupleDesc	tupdesc = RelationGetDescr(fmstate->rel);
+	bool		binary = (method == BATCH_INSERT_BINARY_COPY);
+	StringInfoData sql;
+	int			j = 0;
+	ListCell   *lc;
+
+	foreach(lc, fmstate->target_attrs)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+
+		if (!attr->attgenerated && !binary_transfer_ok(attr->atttypid))
+		{
+			binary = false;
+			break;
+		}
+	}
+
+	/*
+	 * COPY doesn't convert binary values to the types of the columns, so the
+	 * remote columns must be of the same types as ours.
+	 */
+	if (binary)
+		binary = remote_column_types_match(fmstate);
+
+	/*
+	 * We keep our own functions rather than use p_flinfo, whose output
+	 * functions choose_param_formats() replaces with send functions for the
+	 * parameters of the INSERT sent in binary format.
+	 */
+	fmstate->copy_binary = binary;
+	fmstate->copy_flinfo = (FmgrInfo *)
+		palloc0(sizeof(FmgrInfo) * fmstate->p_nums);
+	foreach(lc, fmstate->target_attrs)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+		Oid			typfunc;
+		bool		isvarlena;
+
+		/* Ignore generated columns; they aren't copied */
+		if (attr->attgenerated)
+			continue;
+		if (binary)
+			getTypeBinaryOutputInfo(attr->atttypid, &typfunc, &isvarlena);
+		else
+			getTypeOutputInfo(attr->atttypid, &typfunc, &isvarlena);
+		fmgr_info(typfunc, &fmstate->copy_flinfo[j]);
+		j++;
+	}
+	Assert(j == fmstate->p_nums);
+
+	initStringInfo(&sql);
+	deparseCopyFromSql(&sql, rte, fmstate->rel, fmstate->target_attrs, binary);
+	fmstate->copy_query = sql.data;
+}
+
+/*
+ * Are the remote columns that an INSERT sets of the same types as the local
+ * ones?  Since binary format is only used for built-in types, whose OIDs are
+ * the same on the remote server, we can compare the type OIDs.
+ */
+static bool
+remote_column_types_match(PgFdwModifyState *fmstate)
+{
+	TupleDesc	tupdesc = RelationGetDescr(fmstate->rel);
+	StringInfoData sql;
+	PGresult   *res;
+	bool		match = true;
+	int			i = 0;
+	ListCell   *lc;
+
+	initStringInfo(&sql);
+	deparseColumnTypesSql(&sql, fmstate->rel, fmstate->target_attrs);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_query(fmstate->conn, sql.data, fmstate->conn_state);
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql.data);
+
+	foreach(lc, fmstate->target_attrs)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, lfirst_int(lc) - 1);
+
+		if (attr->attgenerated)
+			continue;
+
+		if (i >= PQntuples(res) || PQgetisnull(res, i, 0) ||
+			strtoul(PQgetvalue(res, i, 0), NULL, 10) != attr->atttypid)
+		{
+			match = false;
+			break;
+		}
+		i++;
+	}
+	PQclear(res);
+	pfree(sql.data);
+
+	return match;
+}
+
+/*
+ * Can values of the given type be sent to the remote server in binary format,
+ * by COPY or as query parameters?
+ *
+ * We only trust built-in types to have the same binary format and the same
+ * OIDs (which the binary format of arrays includes) on the remote server.
+ * OID alias types are excluded, since their values would be looked up in the
+ * remote catalogs by OID rather than by name, and so are composite types,
+ * whose binary format includes the OIDs of their column types.  Also, send
+ * functions of text types convert to the local client_encoding, whereas the
+ * remote session expects our database encoding, so we can't use binary
+ * format at all unless they are the same.
+ */
+static bool
+binary_transfer_ok(Oid typid)
+{
+	Oid			elemtype;
+
+	if (!is_builtin(typid))
+		return false;
+
+	if (pg_get_client_encoding() != GetDatabaseEncoding())
+		return false;
+
+	elemtype = get_element_type(typid);
+	if (OidIsValid(elemtype))
+		typid = elemtype;
+
+	switch (typid)
+	{
+		case REGPROCOID:
+		case REGPROCEDUREOID:
+		case REGOPEROID:
+		case REGOPERATOROID:
+		case REGCLASSOID:
+		case REGCOLLATIONOID:
+		case REGTYPEOID:
+		case REGROLEOID:
+		case REGNAMESPACEOID:
+		case REGCONFIGOID:
+		case REGDICTIONARYOID:
+			return false;
+		default:
+			break;
+	}
+
+	return get_typtype(typid) != TYPTYPE_COMPOSITE;
+}
+
+/*
+ * execute_copy_insert
+ *		Insert a batch of rows with COPY FROM STDIN, and return the number of
+ *		rows inserted
+ *
+ * The rows are sent in chunks of about 64kB, each of which we wait for the
+ * remote server to take before building the next, so we go no faster than it
+ * does; interrupts are processed meanwhile.
+ */
+static int
+execute_copy_insert(PgFdwModifyState *fmstate,
+					TupleTableSlot **slots,
+					int numSlots)
+{
+	TupleDesc	tupdesc = RelationGetDescr(fmstate->rel);
+	PGconn	   *conn = fmstate->conn;
+	bool		binary = fmstate->copy_binary;
+	PGresult   *res;
+	MemoryContext oldcontext;
+	int			n_rows;
+
+	res = pgfdw_exec_query(conn, fmstate->copy_query, fmstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COPY_IN)
+		pgfdw_report_error(ERROR, res, conn, true, fmstate->copy_query);
+	PQclear(res);
+
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+
+	PG_TRY();
+	{
+		StringInfoData buf;
+		int			nestlevel;
+		int			i;
+
+		initStringInfo(&buf);
+		if (binary)
+		{
+			/* Signature, flags field and header extension area length */
+			appendBinaryStringInfo(&buf, "PGCOPY\n\377\r\n\0", 11);
+			pq_sendint32(&buf, 0);
+			pq_sendint32(&buf, 0);
+		}
+
+		nestlevel = set_transmission_modes();
+		for (i = 0; i < numSlots; i++)
+		{
+			ListCell   *lc;
+			int			j = 0;
+
+			if (binary)
+				pq_sendint16(&buf, fmstate->p_nums);
+
+			foreach(lc, fmstate->target_attrs)
+			{
+				int			attnum = lfirst_int(lc);
+				Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+				Datum		value;
+				bool		isnull;
+
+				/* Ignore generated columns; they aren't copied */
+				if (attr->attgenerated)
+					continue;
+				value = slot_getattr(slots[i], attnum, &isnull);
+
+				if (binary)
+				{
+					if (isnull)
+						pq_sendint32(&buf, -1);
+					else
+					{
+						bytea	   *outputbytes;
+
+						outputbytes = SendFunctionCall(&fmstate->copy_flinfo[j],
+													   value);
+						pq_sendint32(&buf, VARSIZE(outputbytes) - VARHDRSZ);
+						appendBinaryStringInfo(&buf, VARDATA(outputbytes),
+											   VARSIZE(outputbytes) - VARHDRSZ);
+					}
+				}
+				else
+				{
+					if (j > 0)
+						appendStringInfoChar(&buf, '\t');
+					if (isnull)
+						appendStringInfoString(&buf, "\\N");
+					else
+						append_copy_text_value(&buf,
+											   OutputFunctionCall(&fmstate->copy_flinfo[j],
+																  value));
+				}
+				j++;
+			}
+
+			if (!binary)
+				appendStringInfoChar(&buf, '\n');
+			else if (i == numSlots - 1)
+				pq_sendint16(&buf, -1); /* file trailer */
+
+			if (buf.len >= 65536 || i == numSlots - 1)
+			{
+				if (!pgfdw_put_copy_data(conn, buf.data, buf.len))
+					pgfdw_report_error(ERROR, NULL, conn, false,
+									   fmstate->copy_query);
+				resetStringInfo(&buf);
+			}
+		}
+		reset_transmission_modes(nestlevel);
+	}
+	PG_CATCH();
+	{
+		/*
+		 * Make the remote server abandon the COPY, so that the connection is
+		 * in a state the abort cleanup knows how to deal with, and go back to
+		 * blocking mode if we can without waiting.
+		 */
+		(void) PQputCopyEnd(conn, "aborted by postgres_fdw");
+		(void) PQsetnonblocking(conn, 0);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(oldcontext);
+
+	if (!pgfdw_put_copy_end(conn, NULL))
+		pgfdw_report_error(ERROR, NULL, conn, false, fmstate->copy_query);
+	res = pgfdw_get_result(conn);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, conn, true, fmstate->copy_query);
+	n_rows = atoi(PQcmdTuples(res));
+	PQclear(res);
+
+	MemoryContextReset(fmstate->temp_cxt);
+
+	return n_rows;
+}
+
+/*
+ * execute_adaptive_insert
+ *		Insert a batch of rows with prepared INSERTs of adaptive sizes
+ *
+ * The rows are split into statements whose numbers of rows are powers of
+ * two, so that only a few distinct statements get prepared, and we keep them
+ * for reuse.  The statements are kept within the "batch_target_size" option
+ * in terms of the size of their parameters, and the number of rows is grown
+ * as long as doing so makes the remote execution cheaper per row, see
+ * next_batch_shape().
+ *
+ * Returns the number of rows inserted, after storing their RETURNING results
+ * into slots, if any.
+ */
+static int
+execute_adaptive_insert(PgFdwModifyState *fmstate,
+						TupleTableSlot **slots,
+						int numSlots)
+{
+	const char **p_values;
+	int		   *p_lengths;
+	int		   *p_formats;
+	double		total_bytes = 0;
+	double		row_bytes;
+	double		usec;
+	int			limit;
+	int			offset;
+	int			nrows;
+	int			n_rows = 0;
+	int			i;
+
+	/* The formats of the parameters are chosen when we first prepare */
+	if (!fmstate->p_name)
+		set_batch_shape(fmstate, fmstate->batch_shape);
+
+	/* Convert parameters of all the rows to text/binary form */
+	p_values = convert_prep_stmt_params(fmstate, NULL, slots, numSlots,
+										&p_lengths, &p_formats);
+
+	/* See how many rows of this width fit in the target size */
+	for (i = 0; i < fmstate->p_nums * numSlots; i++)
+	{
+		if (p_values[i] == NULL)
+			continue;
+		if (p_formats && p_formats[i] == 1)
+			total_bytes += p_lengths[i];
+		else
+			total_bytes += strlen(p_values[i]);
+	}
+	row_bytes = total_bytes / numSlots;
+	limit = 1 << (NUM_BATCH_SHAPES - 1);
+	if (row_bytes > 0 && fmstate->batch_target_size / row_bytes < limit)
+		limit = (int) (fmstate->batch_target_size / row_bytes);
+	if (fmstate->p_nums > 0)
+		limit = Min(limit, PQ_QUERY_PARAM_MAX_LIMIT / fmstate->p_nums);
+	limit = Max(limit, 1);
+
+	for (offset = 0; offset < numSlots; offset += nrows)
+	{
+		int			pindex = offset * fmstate->p_nums;
+		instr_time	start;
+		instr_time	duration;
+		PGresult   *res;
+		int			n;
+
+		nrows = pg_prevpower2_32(Min(next_batch_shape(fmstate, limit),
+									 numSlots - offset));
+		set_batch_shape(fmstate, nrows);
+
+		INSTR_TIME_SET_CURRENT(start);
+
+		/*
+		 * Execute the prepared statement.
+		 */
+		if (!PQsendQueryPrepared(fmstate->conn,
+								 fmstate->p_name,
+								 fmstate->p_nums * nrows,
+								 &p_values[pindex],
+								 p_lengths ? &p_lengths[pindex] : NULL,
+								 p_formats ? &p_formats[pindex] : NULL,
+								 0))
+			pgfdw_report_error(ERROR, NULL, fmstate->conn, false,
+							   fmstate->query);
+
+		/*
+		 * Get the result, and check for success.
+		 *
+		 * We don't use a PG_TRY block here, so be careful not to throw error
+		 * without releasing the PGresult.
+		 */
+		res = pgfdw_get_result(fmstate->conn);
+		if (PQresultStatus(res) !=
+			(fmstate->has_returning ? PGRES_TUPLES_OK : PGRES_COMMAND_OK))
+			pgfdw_report_error(ERROR, res, fmstate->conn, true,
+							   fmstate->query);
+
+		INSTR_TIME_SET_CURRENT(duration);
+		INSTR_TIME_SUBTRACT(duration, start);
+
+		/* Check number of rows affected, and fetch RETURNING tuple if any */
+		if (fmstate->has_returning)
+		{
+			Assert(numSlots == 1);
+			n = PQntuples(res);
+			if (n > 0)
+				store_returning_result(fmstate, slots[offset], res);
+		}
+		else
+			n = atoi(PQcmdTuples(res));
+		PQclear(res);
+		n_rows += n;
+
+		/* Remember the remote time per row for this size; zero means unknown */
+		usec = Max(INSTR_TIME_GET_DOUBLE(duration) * 1000000.0 / nrows, 0.001);
+		i = pg_leftmost_one_pos32(nrows);
+		if (fmstate->shape_usec_per_row[i] > 0)
+			fmstate->shape_usec_per_row[i] =
+				(fmstate->shape_usec_per_row[i] + usec) / 2;
+		else
+			fmstate->shape_usec_per_row[i] = usec;
+	}
+
+	MemoryContextReset(fmstate->temp_cxt);
+
+	return n_rows;
+}
+
+/*
+ * next_batch_shape
+ *		Decide how many rows the next statement of an adaptively sized batch
+ *		should have, at most limit
+ *
+ * Much like TCP slow start, we begin with a single row and double the size
+ * as long as that makes the remote execution at least 10% cheaper per row,
+ * and halve it again if it turned out costlier per row than the half.
+ */
+static int
+next_batch_shape(PgFdwModifyState *fmstate, int limit)
+{
+	double	   *usec = fmstate->shape_usec_per_row;
+	int			i = pg_leftmost_one_pos32(fmstate->batch_shape);
+
+	if (usec[i] > 0 &&
+		(i == 0 || usec[i - 1] <= 0 || usec[i] < usec[i - 1] * 0.9) &&
+		i + 1 < NUM_BATCH_SHAPES &&
+		(usec[i + 1] <= 0 || usec[i + 1] < usec[i] * 0.9))
+		i++;
+	else if (i > 0 && usec[i] > 0 && usec[i - 1] > 0 &&
+			 usec[i] > usec[i - 1])
+		i--;
+
+	while (i > 0 && (1 << i) > limit)
+		i--;
+
+	fmstate->batch_shape = 1 << i;
+	return fmstate->batch_shape;
+}
+
+/*
+ * set_batch_shape
+ *		Switch to the prepared INSERT of an adaptively sized batch for the
+ *		given power-of-two number of rows, preparing it if not done yet
+ */
+static void
+set_batch_shape(PgFdwModifyState *fmstate, int nrows)
+{
+	StringInfoData sql;
+
+	Assert(nrows == pg_prevpower2_32(nrows));
+	Assert(fmstate->num_slots == pg_prevpower2_32(fmstate->num_slots));
+
+	if (fmstate->num_slots == nrows && fmstate->p_name)
+		return;
+
+	/* Keep the current statement for reuse, and take any for the new size */
+	if (fmstate->p_name)
+		fmstate->shape_p_names[pg_leftmost_one_pos32(fmstate->num_slots)] =
+			fmstate->p_name;
+	fmstate->p_name = fmstate->shape_p_names[pg_leftmost_one_pos32(nrows)];
+	fmstate->shape_p_names[pg_leftmost_one_pos32(nrows)] = NULL;
+
+	/* Build INSERT string with nrows records in its VALUES clause */
+	initStringInfo(&sql);
+	rebuildInsertSql(&sql, fmstate->rel,
+					 fmstate->orig_query, fmstate->target_attrs,
+					 fmstate->values_end, fmstate->p_nums,
+					 nrows - 1);
+	pfree(fmstate->query);
+	fmstate->query = sql.data;
+	fmstate->num_slots = nrows;
+
+	if (!fmstate->p_name)
+		prepare_foreign_modify(fmstate);
+}
+
+/*
+ * convert_prep_stmt_params
+ *		Create array of text strings or binary values representing parameter
+ *		values
+ *
+ * tupleid is ctid to send, or NULL if none
+ * slot is slot to get remaining parameters from, or NULL if none
+ *
+ * If some parameters are to be sent in binary format, arrays of the lengths
+ * and formats of all parameters are returned to *p_lengths and *p_formats,
+ * else they are set to NULL.
+ *
+ * Data is constructed in temp_cxt; caller should reset that after use.
+ */
+static const char **
+convert_prep_stmt_params(PgFdwModifyState *fmstate,
+						 ItemPointer tupleid,
+						 TupleTableSlot **slots,
+						 int numSlots,
+						 int **p_lengths,
+						 int **p_formats)
+{
+	const char **p_values;
+	int		   *lengths = NULL;
+	int		   *formats = NULL;
+	int			i;
+	int			j;
+	int			pindex = 0;
+	MemoryContext oldcontext;
+
+	oldcontext = MemoryContextSwitchTo(fmstate->temp_cxt);
+
+	p_values = (const char **) palloc(sizeof(char *) * fmstate->p_nums * numSlots);
+
+	/* Each row's parameters have the same formats */
+	if (fmstate->p_formats)
+	{
+		lengths = (int *) palloc0(sizeof(int) * fmstate->p_nums * numSlots);
+		formats = (int *) palloc(sizeof(int) * fmstate->p_nums * numSlots);
+		for (i = 0; i < numSlots; i++)
+			memcpy(&formats[i * fmstate->p_nums], fmstate->p_formats,
+				   sizeof(int) * fmstate->p_nums);
+	}
+
+	/* ctid is provided only for UPDATE/DELETE, which don't allow batching */
+	Assert(!(tupleid != NULL && numSlots > 1));
+
+	/* 1st parameter should be ctid, if it's in use */
+	if (tupleid != NULL)
+	{
+		Assert(numSlots == 1);
+		/* don't need set_transmission_modes for TID output */
+		if (formats && formats[pindex] == 1)
+		{
+			bytea	   *outputbytes;
+
+			outputbytes = SendFunctionCall(&fmstate->p_flinfo[pindex],
+										   PointerGetDatum(tupleid));
+			p_values[pindex] = VARDATA(outputbytes);
+			lengths[pindex] = VARSIZE(outputbytes) - VARHDRSZ;
+		}
+		else
+			p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[pindex],
+												  PointerGetDatum(tupleid));
+		pindex++;
+	}
+
+	/* get following parameters from slots */
+	if (slots != NULL && fmstate->target_attrs != NIL)
+	{
+		TupleDesc	tupdesc = RelationGetDescr(fmstate->rel);
+		int			nestlevel = -1;
+		ListCell   *lc;
+
+		/*
+		 * The transmission modes only matter to output functions, so we
+		 * don't bother to set them unless some parameter is in text format.
+		 */
+		for (i = 0; i < numSlots; i++)
+		{
+			j = (tupleid != NULL) ? 1 : 0;
+			foreach(lc, fmstate->target_attrs)
+			{
+				int			attnum = lfirst_int(lc);
+				Form_pg_attribute attr = TupleDescAttr(tupdesc, attnum - 1);
+				Datum		value;
+				bool		isnull;
+
+				/* Ignore generated columns; they are set to DEFAULT */
+				if (attr->attgenerated)
+					continue;
+				value = slot_getattr(slots[i], attnum, &isnull);
+				if (isnull)
+					p_values[pindex] = NULL;
+				else if (formats && formats[pindex] == 1)
+				{
+					bytea	   *outputbytes;
+
+					outputbytes = SendFunctionCall(&fmstate->p_flinfo[j],
+												   value);
+					p_values[pindex] = VARDATA(outputbytes);
+					lengths[pindex] = VARSIZE(outputbytes) - VARHDRSZ;
+				}
+				else
+				{
+					if (nestlevel < 0)
+						nestlevel = set_transmission_modes();
+					p_values[pindex] = OutputFunctionCall(&fmstate->p_flinfo[j],
+														  value);
+				}
+				pindex++;
+				j++;
+			}
+		}
+
+		if (nestlevel >= 0)
+			reset_transmission_modes(nestlevel);
+	}
+
+	Assert(pindex == fmstate->p_nums * numSlots);
+
+	MemoryContextSwitchTo(oldcontext);
+
+	*p_lengths = lengths;
+	*p_formats = formats;
+
+	return p_values;
+}
+
+/*
+ * store_returning_result
+ *		Store the result of a RETURNING clause
+ *
+ * On error, be sure to release the PGresult on the way out.  Callers do not
+ * have PG_TRY blocks to ensure this happens.
+ */
+static void
+store_returning_result(PgFdwModifyState *fmstate,
+					   TupleTableSlot *slot, PGresult *res)
+{
+	PG_TRY();
+	{
+		HeapTuple	newtup;
+
+		newtup = make_tuple_from_result_row(res, 0,
+											fmstate->rel,
+											fmstate->attinmeta,
+											fmstate->retrieved_attrs,
+											NULL,
+											fmstate->temp_cxt);
+
+		/*
+		 * The returning slot will not necessarily be suitable to store
+		 * heaptuples directly, so allow for conversion.
+		 */
+		ExecForceStoreHeapTuple(newtup, slot, true);
+	}
+	PG_CATCH();
+	{
+		PQclear(res);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+/*
+ * finish_foreign_modify
+ *		Release resources for a foreign insert/update/delete operation
+ */
+static void
+finish_foreign_modify(PgFdwModifyState *fmstate)
+{
+	Assert(fmstate != NULL);
+
+	/* If we created a prepared statement, destroy it */
+	deallocate_query(fmstate);
+
+	/* Likewise for those kept for other sizes of batches */
+	if (fmstate->shape_p_names)
+	{
+		int			i;
+
+		for (i = 0; i < NUM_BATCH_SHAPES; i++)
+		{
+			fmstate->p_name = fmstate->shape_p_names[i];
+			deallocate_query(fmstate);
+		}
+	}
+
+	/* Release remote connection */
+	ReleaseConnection(fmstate->conn);
+	fmstate->conn = NULL;
+}
+
+/*
+ * deallocate_query
+ *		Deallocate a prepared statement for a foreign insert/update/delete
+ *		operation
+ */
+static void
+deallocate_query(PgFdwModifyState *fmstate)
+{
+	char		sql[64];
+	PGresult   *res;
+
+	/* do nothing if the query is not allocated */
+	if (!fmstate->p_name)
+		return;
+
+	snprintf(sql, sizeof(sql), "DEALLOCATE %s", fmstate->p_name);
+
+	/*
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	res = pgfdw_exec_query(fmstate->conn, sql, fmstate->conn_state);
+	if (PQresultStatus(res) != PGRES_COMMAND_OK)
+		pgfdw_report_error(ERROR, res, fmstate->conn, true, sql);
+	PQclear(res);
+	pfree(fmstate->p_name);
+	fmstate->p_name = NULL;
+}
+
+/*
+ * build_remote_returning
+ *		Build a RETURNING targetlist of a remote query for performing an
+ *		UPDATE/DELETE .. RETURNING on a join directly
+ */
+static List *
+build_remote_returning(Index rtindex, Relation rel, List *returningList)
+{
+	bool		have_wholerow = false;
+	List	   *tlist = NIL;
+	List	   *vars;
+	ListCell   *lc;
+
+	Assert(returningList);
+
+	vars = pull_var_clause((Node *) returningList, PVC_INCLUDE_PLACEHOLDERS);
+
+	/*
+	 * If there's a whole-row reference to the target relation, then we'll
+	 * need all the columns of the relation.
+	 */
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (IsA(var, Var) &&
+			var->varno == rtindex &&
+			var->varattno == InvalidAttrNumber)
+		{
+			have_wholerow = true;
+			break;
+		}
+	}
+
+	if (have_wholerow)
+	{
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+		int			i;
+
+		for (i = 1; i <= tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i - 1);
+			Var		   *var;
+
+			/* Ignore dropped attributes. */
+			if (attr->attisdropped)
+				continue;
+
+			var = makeVar(rtindex,
+						  i,
+						  attr->atttypid,
+						  attr->atttypmod,
+						  attr->attcollation,
+						  0);
+
+			tlist = lappend(tlist,
+							makeTargetEntry((Expr *) var,
+											list_length(tlist) + 1,
+											NULL,
+											false));
+		}
+	}
+
+	/* Now add any remaining columns to tlist. */
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		/*
+		 * No need for whole-row references to the target relation.  We don't
+		 * need system columns other than ctid and oid either, since those are
+		 * set locally.
+		 */
+		if (IsA(var, Var) &&
+			var->varno == rtindex &&
+			var->varattno <= InvalidAttrNumber &&
+			var->varattno != SelfItemPointerAttributeNumber)
+			continue;			/* don't need it */
+
+		if (tlist_member((Expr *) var, tlist))
+			continue;			/* already got it */
+
+		tlist = lappend(tlist,
+						makeTargetEntry((Expr *) var,
+										list_length(tlist) + 1,
+										NULL,
+										false));
+	}
+
+	list_free(vars);
+
+	return tlist;
+}
+
+/*
+ * rebuild_fdw_scan_tlist
+ *		Build new fdw_scan_tlist of given foreign-scan plan node from given
+ *		tlist
+ *
+ * There might be columns that the fdw_scan_tlist of the given foreign-scan
+ * plan node contains that the given tlist doesn't.  The fdw_scan_tlist would
+ * have contained resjunk columns such as 'ctid' of the target relation and
+ * 'wholerow' of non-target relations, but the tlist might not contain them,
+ * for example.  So, adjust the tlist so it contains all the columns specified
+ * in the fdw_scan_tlist; else setrefs.c will get confused.
+ */
+static void
+rebuild_fdw_scan_tlist(ForeignScan *fscan, List *tlist)
+{
+	List	   *new_tlist = tlist;
+	List	   *old_tlist = fscan->fdw_scan_tlist;
+	ListCell   *lc;
+
+	foreach(lc, old_tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+
+		if (tlist_member(tle->expr, new_tlist))
+			continue;			/* already got it */
+
+		new_tlist = lappend(new_tlist,
+							makeTargetEntry(tle->expr,
+											list_length(new_tlist) + 1,
+											NULL,
+											false));
+	}
+	fscan->fdw_scan_tlist = new_tlist;
+}
+
+/*
+ * Execute a direct UPDATE/DELETE statement.
+ */
+static void
+execute_dml_stmt(ForeignScanState *node)
+{
+	PgFdwDirectModifyState *dmstate = (PgFdwDirectModifyState *) node->fdw_state;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	int			numParams = dmstate->numParams;
+	const char **values = dmstate->param_values;
+
+	/* First, process a pending asynchronous request, if any. */
+	if (dmstate->conn_state->pendingAreq)
+		process_pending_request(dmstate->conn_state->pendingAreq);
+
+	/*
+	 * Construct array of query parameter values.
+	 */
+	if (numParams > 0)
+		process_query_params(econtext,
+							 dmstate->param_flinfo,
+							 dmstate->param_exprs,
+							 values,
+							 dmstate->param_lengths,
+							 dmstate->param_formats);
+
+	/*
+	 * Notice that we pass NULL for paramTypes, thus forcing the remote server
+	 * to infer types for all parameters.  Since we explicitly cast every
+	 * parameter (see deparse.c), the "inference" is trivial and will produce
+	 * the desired result.  This allows us to avoid assuming that the remote
+	 * server has the same OIDs we do for the parameters' types.  It also
+	 * makes sure that parameters in binary format are read as the types we
+	 * sent.
+	 */
+	if (!PQsendQueryParams(dmstate->conn, dmstate->query, numParams,
+						   NULL, values, dmstate->param_lengths,
+						   dmstate->param_formats, 0))
+		pgfdw_report_error(ERROR, NULL, dmstate->conn, false, dmstate->query);
+
+	/*
+	 * Get the result, and check for success.
+	 *
+	 * We don't use a PG_TRY block here, so be careful not to throw error
+	 * without releasing the PGresult.
+	 */
+	dmstate->result = pgfdw_get_result(dmstate->conn);
+	if (PQresultStatus(dmstate->result) !=
+		(dmstate->has_returning ? PGRES_TUPLES_OK : PGRES_COMMAND_OK))
+		pgfdw_report_error(ERROR, dmstate->result, dmstate->conn, true,
+						   dmstate->query);
+
+	/* Get the number of rows affected. */
+	if (dmstate->has_returning)
+		dmstate->num_tuples = PQntuples(dmstate->result);
+	else
+		dmstate->num_tuples = atoi(PQcmdTuples(dmstate->result));
+}
+
+/*
+ * Get the result of a RETURNING clause.
+ */
+static TupleTableSlot *
+get_returning_data(ForeignScanState *node)
+{
+	PgFdwDirectModifyState *dmstate = (PgFdwDirectModifyState *) node->fdw_state;
+	EState	   *estate = node->ss.ps.state;
+	ResultRelInfo *resultRelInfo = node->resultRelInfo;
+	TupleTableSlot *slot = node->ss.ss_ScanTupleSlot;
+	TupleTableSlot *resultSlot;
+
+	Assert(resultRelInfo->ri_projectReturning);
+
+	/* If we didn't get any tuples, must be end of data. */
+	if (dmstate->next_tuple >= dmstate->num_tuples)
+		return ExecClearTuple(slot);
+
+	/* Increment the command es_processed count if necessary. */
+	if (dmstate->set_processed)
+		estate->es_processed += 1;
+
+	/*
+	 * Store a RETURNING tuple.  If has_returning is false, just emit a dummy
+	 * tuple.  (has_returning is false when the local query is of the form
+	 * "UPDATE/DELETE .. RETURNING 1" for example.)
+	 */
+	if (!dmstate->has_returning)
+	{
+		ExecStoreAllNullTuple(slot);
+		resultSlot = slot;
+	}
+	else
+	{
+		/*
+		 * On error, be sure to release the PGresult on the way out.  Callers
+		 * do not have PG_TRY blocks to ensure this happens.
+		 */
+		PG_TRY();
+		{
+			HeapTuple	newtup;
+
+			newtup = make_tuple_from_result_row(dmstate->result,
+												dmstate->next_tuple,
+												dmstate->rel,
+												dmstate->attinmeta,
+												dmstate->retrieved_attrs,
+												node,
+												dmstate->temp_cxt);
+			ExecStoreHeapTuple(newtup, slot, false);
+		}
+		PG_CATCH();
+		{
+			PQclear(dmstate->result);
+			PG_RE_THROW();
+		}
+		PG_END_TRY();
+
+		/* Get the updated/deleted tuple. */
+		if (dmstate->rel)
+			resultSlot = slot;
+		else
+			resultSlot = apply_returning_filter(dmstate, resultRelInfo, slot, estate);
+	}
+	dmstate->next_tuple++;
+
+	/* Make slot available for evaluation of the local query RETURNING list. */
+	resultRelInfo->ri_projectReturning->pi_exprContext->ecxt_scantuple =
+		resultSlot;
+
+	return slot;
+}
+
+/*
+ * Initialize a filter to extract an updated/deleted tuple from a scan tuple.
+ */
+static void
+init_returning_filter(PgFdwDirectModifyState *dmstate,
+					  List *fdw_scan_tlist,
+					  Index rtindex)
+{
+	TupleDesc	resultTupType = RelationGetDescr(dmstate->resultRel);
+	ListCell   *lc;
+	int			i;
+
+	/*
+	 * Calculate the mapping between the fdw_scan_tlist's entries and the
+	 * result tuple's attributes.
+	 *
+	 * The "map" is an array of indexes of the result tuple's attributes in
+	 * fdw_scan_tlist, i.e., one entry for every attribute of the result
+	 * tuple.  We store zero for any attributes that don't have the
+	 * corresponding entries in that list, marking that a NULL is needed in
+	 * the result tuple.
+	 *
+	 * Also get the indexes of the entries for ctid and oid if any.
+	 */
+	dmstate->attnoMap = (AttrNumber *)
+		palloc0(resultTupType->natts * sizeof(AttrNumber));
+
+	dmstate->ctidAttno = dmstate->oidAttno = 0;
+
+	i = 1;
+	dmstate->hasSystemCols = false;
+	foreach(lc, fdw_scan_tlist)
+	{
+		TargetEntry *tle = (TargetEntry *) lfirst(lc);
+		Var		   *var = (Var *) tle->expr;
+
+		Assert(IsA(var, Var));
+
+		/*
+		 * If the Var is a column of the target relation to be retrieved from
+		 * the foreign server, get the index of the entry.
+		 */
+		if (var->varno == rtindex &&
+			list_member_int(dmstate->retrieved_attrs, i))
+		{
+			int			attrno = var->varattno;
+
+			if (attrno < 0)
+			{
+				/*
+				 * We don't retrieve system columns other than ctid and oid.
+				 */
+				if (attrno == SelfItemPointerAttributeNumber)
+					dmstate->ctidAttno = i;
+				else
+					Assert(false);
+				dmstate->hasSystemCols = true;
+			}
+			else
+			{
+				/*
+				 * We don't retrieve whole-row references to the target
+				 * relation either.
+				 */
+				Assert(attrno > 0);
+
+				dmstate->attnoMap[attrno - 1] = i;
+			}
+		}
+		i++;
+	}
+}
+
+/*
+ * Extract and return an updated/deleted tuple from a scan tuple.
+ */
+static TupleTableSlot *
+apply_returning_filter(PgFdwDirectModifyState *dmstate,
+					   ResultRelInfo *resultRelInfo,
+					   TupleTableSlot *slot,
+					   EState *estate)
+{
+	TupleDesc	resultTupType = RelationGetDescr(dmstate->resultRel);
+	TupleTableSlot *resultSlot;
+	Datum	   *values;
+	bool	   *isnull;
+	Datum	   *old_values;
+	bool	   *old_isnull;
+	int			i;
+
+	/*
+	 * Use the return tuple slot as a place to store the result tuple.
+	 */
+	resultSlot = ExecGetReturningSlot(estate, resultRelInfo);
+
+	/*
+	 * Extract all the values of the scan tuple.
+	 */
+	slot_getallattrs(slot);
+	old_values = slot->tts_values;
+	old_isnull = slot->tts_isnull;
+
+	/*
+	 * Prepare to build the result tuple.
+	 */
+	ExecClearTuple(resultSlot);
+	values = resultSlot->tts_values;
+	isnull = resultSlot->tts_isnull;
+
+	/*
+	 * Transpose data into proper fields of the result tuple.
+	 */
+	for (i = 0; i < resultTupType->natts; i++)
+	{
+		int			j = dmstate->attnoMap[i];
+
+		if (j == 0)
+		{
+			values[i] = (Datum) 0;
+			isnull[i] = true;
+		}
+		else
+		{
+			values[i] = old_values[j - 1];
+			isnull[i] = old_isnull[j - 1];
+		}
+	}
+
+	/*
+	 * Build the virtual tuple.
+	 */
+	ExecStoreVirtualTuple(resultSlot);
+
+	/*
+	 * If we have any system columns to return, materialize a heap tuple in
+	 * the slot from column values set above and install system columns in
+	 * that tuple.
+	 */
+	if (dmstate->hasSystemCols)
+	{
+		HeapTuple	resultTup = ExecFetchSlotHeapTuple(resultSlot, true, NULL);
+
+		/* ctid */
+		if (dmstate->ctidAttno)
+		{
+			ItemPointer ctid = NULL;
+
+			ctid = (ItemPointer) DatumGetPointer(old_values[dmstate->ctidAttno - 1]);
+			resultTup->t_self = *ctid;
+		}
+
+		/*
+		 * And remaining columns
+		 *
+		 * Note: since we currently don't allow the target relation to appear
+		 * on the nullable side of an outer join, any system columns wouldn't
+		 * go to NULL.
+		 *
+		 * Note: no need to care about tableoid here because it will be
+		 * initialized in ExecProcessReturning().
+		 */
+		HeapTupleHeaderSetXmin(resultTup->t_data, InvalidTransactionId);
+		HeapTupleHeaderSetXmax(resultTup->t_data, InvalidTransactionId);
+		HeapTupleHeaderSetCmin(resultTup->t_data, InvalidTransactionId);
+	}
+
+	/*
+	 * And return the result tuple.
+	 */
+	return resultSlot;
+}
+
+/*
+ * Prepare for processing of parameters used in remote query.
+ *
+ * Parameters of types that can be safely sent in binary format are converted
+ * with their send functions, except the ones in text_params.  If there are
+ * none, *param_lengths and *param_formats are set to NULL.
+ */
+static void
+prepare_query_params(PlanState *node,
+					 List *fdw_exprs,
+					 int numParams,
+					 Bitmapset *text_params,
+					 FmgrInfo **param_flinfo,
+					 List **param_exprs,
+					 const char ***param_values,
+					 int **param_lengths,
+					 int **param_formats)
+{
+	int		   *formats;
+	bool		any_binary = false;
+	int			i;
+	ListCell   *lc;
+
+	Assert(numParams > 0);
+
+	/* Prepare for output conversion of parameters used in remote query. */
+	*param_flinfo = (FmgrInfo *) palloc0(sizeof(FmgrInfo) * numParams);
+	formats = (int *) palloc0(sizeof(int) * numParams);
+
+	i = 0;
+	foreach(lc, fdw_exprs)
+	{
+		Node	   *param_expr = (Node *) lfirst(lc);
+		Oid			typid = exprType(param_expr);
+		Oid			typefnoid;
+		bool		isvarlena;
+
+		if (!bms_is_member(i, text_params) && binary_transfer_ok(typid))
+		{
+			getTypeBinaryOutputInfo(typid, &typefnoid, &isvarlena);
+			formats[i] = 1;
+			any_binary = true;
+		}
+		else
+			getTypeOutputInfo(typid, &typefnoid, &isvarlena);
+		fmgr_info(typefnoid, &(*param_flinfo)[i]);
+		i++;
+	}
+
+	if (any_binary)
+	{
+		*param_lengths = (int *) palloc0(sizeof(int) * numParams);
+		*param_formats = formats;
+	}
+	else
+	{
+		*param_lengths = NULL;
+		*param_formats = NULL;
+		pfree(formats);
+	}
+
+	/*
+	 * Prepare remote-parameter expressions for evaluation.  (Note: in
+	 * practice, we expect that all these expressions will be just Params, so
+	 * we could possibly do something more efficient than using the full
+	 * expression-eval machinery for this.  But probably there would be little
+	 * benefit, and it'd require postgres_fdw to know more than is desirable
+	 * about Param evaluation.)
+	 */
+	*param_exprs = ExecInitExprList(fdw_exprs, node);
+
+	/* Allocate buffer for converted query parameters. */
+	*param_values = (const char **) palloc0(numParams * sizeof(char *));
+}
+
+/*
+ * Construct array of query parameter values in text or binary format.
+ *
+ * The transmission modes only matter to output functions, so we don't bother
+ * to set them if all the parameters are in binary format.
+ */
+static void
+process_query_params(ExprContext *econtext,
+					 FmgrInfo *param_flinfo,
+					 List *param_exprs,
+					 const char **param_values,
+					 int *param_lengths,
+					 int *param_formats)
+{
+	int			nestlevel = -1;
+	int			i;
+	ListCell   *lc;
+
+	i = 0;
+	foreach(lc, param_exprs)
+	{
+		ExprState  *expr_state = (ExprState *) lfirst(lc);
+		Datum		expr_value;
+		bool		isNull;
+
+		/* Evaluate the parameter expression */
+		expr_value = ExecEvalExpr(expr_state, econtext, &isNull);
+
+		/*
+		 * Get string or binary representation of each parameter value by
+		 * invoking type-specific output or send function, unless the value is
+		 * null.
+		 */
+		if (isNull)
+			param_values[i] = NULL;
+		else if (param_formats && param_formats[i] == 1)
+		{
+			bytea	   *outputbytes;
+
+			outputbytes = SendFunctionCall(&param_flinfo[i], expr_value);
+			param_values[i] = VARDATA(outputbytes);
+			param_lengths[i] = VARSIZE(outputbytes) - VARHDRSZ;
+		}
+		else
+		{
+			if (nestlevel < 0)
+				nestlevel = set_transmission_modes();
+			param_values[i] = OutputFunctionCall(&param_flinfo[i], expr_value);
+		}
+
+		i++;
+	}
+
+	if (nestlevel >= 0)
+		reset_transmission_modes(nestlevel);
+}
+
+/*
+ * Foreign tables analyzed as the children of the parent table of the given
+ * OID, which are remembered in the ANALYZE memory context
+ */
+static Oid	analyze_children_parent = InvalidOid;
+static List *analyze_children = NIL;
+
+/* custom wait event for collecting their sample rows, once allocated */
+static uint32 pgfdw_we_analyze_sample = 0;
+
+/*
+ * postgresAnalyzeForeignTable
+ *		Test whether analyzing this foreign table is supported
+ */
+static bool
+postgresAnalyzeForeignTable(Relation relation,
+							AcquireSampleRowsFunc *func,
+							BlockNumber *totalpages)
+{
+	ForeignTable *table;
+	UserMapping *user;
+	PGconn	   *conn;
+	StringInfoData sql;
+	PGresult   *volatile res = NULL;
+
+	/* Return the row-analysis function pointer */
+	*func = postgresAcquireSampleRowsFunc;
+
+	/*
+	 * Now we have to get the number of pages.  It's annoying that the ANALYZE
+	 * API requires us to return that now, because it forces some duplication
+	 * of effort between this routine and postgresAcquireSampleRowsFunc.  But
+	 * it's probably not worth redefining that API at this point.
+	 */
+
+	/*
+	 * Get the connection to use.  We do the remote access as the table's
+	 * owner, even if the ANALYZE was started by some other user.
+	 */
+	table = GetForeignTable(RelationGetRelid(relation));
+	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/*
+	 * Analyzing a foreign table suggests that the remote data have changed,
+	 * so don't keep using the remote estimates cached before.
+	 */
+	pgfdw_invalidate_remote_estimates();
+
+	/*
+	 * Construct command to get page count for relation.
+	 */
+	initStringInfo(&sql);
+	deparseAnalyzeSizeSql(&sql, relation);
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		res = pgfdw_exec_query(conn, sql.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, sql.data);
+
+		if (PQntuples(res) != 1 || PQnfields(res) != 1)
+			elog(ERROR, "unexpected result from deparseAnalyzeSizeSql query");
+		*totalpages = strtoul(PQgetvalue(res, 0, 0), NULL, 10);
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	ReleaseConnection(conn);
+
+	if (pgfdw_analyze_concurrently)
+		remember_analyze_child(relation, *totalpages);
+
+	return true;
+}
+
+/*
+ * postgresGetAnalyzeInfoForForeignTable
+ *		Count tuples in foreign table (just get pg_class.reltuples).
+ *
+ * can_tablesample determines if the remote relation supports acquiring the
+ * sample using TABLESAMPLE.
+ */
+static double
+postgresGetAnalyzeInfoForForeignTable(Relation relation, bool *can_tablesample)
+{
+	ForeignTable *table;
+	UserMapping *user;
+	PGconn	   *conn;
+	StringInfoData sql;
+	PGresult   *volatile res = NULL;
+	volatile double reltuples = -1;
+	volatile char relkind = 0;
+
+	/* assume the remote relation does not support TABLESAMPLE */
+	*can_tablesample = false;
+
+	/*
+	 * Get the connection to use.  We do the remote access as the table's
+	 * owner, even if the ANALYZE was started by some other user.
+	 */
+	table = GetForeignTable(RelationGetRelid(relation));
+	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/*
+	 * Construct command to get page count for relation.
+	 */
+	initStringInfo(&sql);
+	deparseAnalyzeInfoSql(&sql, relation);
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		res = pgfdw_exec_query(conn, sql.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, sql.data);
+
+		if (PQntuples(res) != 1 || PQnfields(res) != 2)
+			elog(ERROR, "unexpected result from deparseAnalyzeInfoSql query");
+		reltuples = strtod(PQgetvalue(res, 0, 0), NULL);
+		relkind = *(PQgetvalue(res, 0, 1));
+	}
+	PG_FINALLY();
+	{
+		if (res)
+			PQclear(res);
+	}
+	PG_END_TRY();
+
+	ReleaseConnection(conn);
+
+	/* TABLESAMPLE is supported only for regular tables and matviews */
+	*can_tablesample = (relkind == RELKIND_RELATION ||
+						relkind == RELKIND_MATVIEW ||
+						relkind == RELKIND_PARTITIONED_TABLE);
+
+	return reltuples;
+}
+
+/*
+ * Acquire a random sample of rows from foreign table managed by postgres_fdw.
+ *
+ * Selected rows are returned in the caller-allocated array rows[],
+ * which must have at least targrows entries.
+ * The actual number of rows selected is returned as the function result.
+ * We also count the total number of rows in the table and return it into
+ * *totalrows.  Note that *totaldeadrows is always set to 0.
+ *
+ * Note that the returned list of rows is not always in order by physical
+ * position in the table.  Therefore, correlation estimates derived later
+ * may be meaningless, but it's OK because we don't use the estimates
+ * currently (the planner only pays attention to correlation for indexscans).
+ */
+static int
+postgresAcquireSampleRowsFunc(Relation relation, int elevel,
+							  HeapTuple *rows, int targrows,
+							  double *totalrows,
+							  double *totaldeadrows)
+{
+	PgFdwAnalyzeState astate;
+	ForeignTable *table;
+	ForeignServer *server;
+	UserMapping *user;
+	PGconn	   *conn;
+	PgFdwSamplingMethod method;
+	double		sample_frac;
+	double		reltuples;
+	unsigned int cursor_number;
+	StringInfoData sql;
+	PGresult   *volatile res = NULL;
+	ListCell   *lc;
+	PgFdwAnalyzeChild *child;
+
+	/*
+	 * If this is one of the foreign children of the table being analyzed,
+	 * acquire the sample rows of all of them at once, if not yet.
+	 */
+	child = find_analyze_child(relation);
+	if (child != NULL)
+	{
+		if (!child->acquired)
+			acquire_children_sample_rows(child, targrows);
+		return return_child_sample_rows(child, elevel, rows, targrows,
+										totalrows, totaldeadrows);
+	}
+
+	/* Initialize workspace state */
+	astate.rel = relation;
+	astate.attinmeta = TupleDescGetAttInMetadata(RelationGetDescr(relation));
+
+	astate.rows = rows;
+	astate.targrows = targrows;
+	astate.numrows = 0;
+	astate.samplerows = 0;
+	astate.rowstoskip = -1;		/* -1 means not set yet */
+	reservoir_init_selection_state(&astate.rstate, targrows);
+
+	/* Remember ANALYZE context, and create a per-tuple temp context */
+	astate.anl_cxt = CurrentMemoryContext;
+	astate.temp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											"postgres_fdw temporary data",
+											ALLOCSET_SMALL_SIZES);
+
+	/*
+	 * Get the connection to use.  We do the remote access as the table's
+	 * owner, even if the ANALYZE was started by some other user.
+	 */
+	table = GetForeignTable(RelationGetRelid(relation));
+	server = GetForeignServer(table->serverid);
+	user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/*
+	 * What sampling method should we use?
+	 */
+	method = get_analyze_sampling_method(server, table);
+
+	/*
+	 * If requested, import the statistics of the remote table instead of
+	 * acquiring sample rows.  If that's impossible, fall back to sampling.
+	 */
+	if (method == ANALYZE_SAMPLE_IMPORT)
+	{
+		if (pgfdw_import_remote_stats(relation, conn, elevel, totalrows))
+		{
+			ReleaseConnection(conn);
+			MemoryContextDelete(astate.temp_cxt);
+			*totaldeadrows = 0.0;
+			return 0;
+		}
+		method = ANALYZE_SAMPLE_AUTO;
+	}
+
+	method = resolve_analyze_sampling_method(relation, conn, method, targrows,
+											 &sample_frac, &reltuples);
+
+	/*
+	 * Construct cursor that retrieves whole rows from remote.
+	 */
+	cursor_number = GetCursorNumber(conn);
+	initStringInfo(&sql);
+	appendStringInfo(&sql, "DECLARE c%u CURSOR FOR ", cursor_number);
+
+	deparseAnalyzeSql(&sql, relation, method, sample_frac, &astate.retrieved_attrs);
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		char		fetch_sql[64];
+		int			fetch_size;
+
+		res = pgfdw_exec_query(conn, sql.data, NULL);
+		if (PQresultStatus(res) != PGRES_COMMAND_OK)
+			pgfdw_report_error(ERROR, res, conn, false, sql.data);
+		PQclear(res);
+		res = NULL;
+
+		/*
+		 * Determine the fetch size.  The default is arbitrary, but shouldn't
+		 * be enormous.
+		 */
+		fetch_size = 100;
+		foreach(lc, server->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "fetch_size") == 0)
+			{
+				(void) parse_int(defGetString(def), &fetch_size, 0, NULL);
+				break;
+			}
+		}
+		foreach(lc, table->options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "fetch_size") == 0)
+			{
+				(void) parse_int(defGetString(def), &fetch_size, 0, NULL);
+				break;
+			}
+		}
+
+		/* Construct command to fetch rows from remote. */
+		snprintf(fetch_sql, sizeof(fetch_sql), "FETCH %d FROM c%u",
+				 fetch_size, cursor_number);
+
+		/* Retrieve and process rows a batch at a time. */
+		for (;;)
+		{
+			int			numrows;
+			int			i;
+
+			/* Allow users to cancel long query */
+			CHECK_FOR_INTERRUPTS();
+
+			/*
+			 * XXX possible future improvement: if rowstoskip is large, we
+			 * could issue a MOVE rather than physically fetching the rows,
+			 * then just adjust rowstoskip and samplerows appropriately.
+			 */
+
+			/* Fetch some rows */
+			res = pgfdw_exec_query(conn, fetch_sql, NULL);
+			/* On error, report the original query, not the FETCH. */
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, sql.data);
+
+			/* Process whatever we got. */
+			numrows = PQntuples(res);
+			for (i = 0; i < numrows; i++)
+				analyze_row_processor(res, i, &astate);
+
+			PQclear(res);
+			res = NULL;
+
+			/* Must be EOF if we didn't get all the rows requested. */
+			if (numrows < fetch_size)
+				break;
+		}
+
+		/* Close the cursor, just to be tidy. */
+		close_cursor(conn, cursor_number, NULL);
+	}
+	PG_CATCH();
+	{
+		PQclear(res);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	ReleaseConnection(conn);
+
+	/* We assume that we have no dead tuple. */
+	*totaldeadrows = 0.0;
+
+	/*
+	 * Without sampling, we've retrieved all living tuples from foreign
+	 * server, so report that as totalrows.  Otherwise use the reltuples
+	 * estimate we got from the remote side.
+	 */
+	if (method == ANALYZE_SAMPLE_OFF)
+		*totalrows = astate.samplerows;
+	else
+		*totalrows = reltuples;
+
+	/*
+	 * Emit some interesting relation info
+	 */
+	ereport(elevel,
+			(errmsg("\"%s\": table contains %.0f rows, %d rows in sample",
+					RelationGetRelationName(relation),
+					*totalrows, astate.numrows)));
+
+	return astate.numrows;
+}
+
+/*
+ * Remember the given foreign table if it's analyzed as a child of a parent
+ * table, so that its sample rows can be acquired concurrently with the other
+ * children.  ANALYZE asks the size of all the children before acquiring
+ * sample rows from any of them, so all of them are known by then.
+ *
+ * Children with analyze_sampling = 'import' are left to be sampled one at a
+ * time by postgresAcquireSampleRowsFunc(), which decides what to do for them.
+ */
+static void
+remember_analyze_child(Relation relation, BlockNumber totalpages)
+{
+	Oid			parent = pgfdw_analyze_target();
+	ForeignTable *table;
+	ForeignServer *server;
+	PgFdwAnalyzeChild *child;
+
+	if (!OidIsValid(parent) || parent == RelationGetRelid(relation))
+		return;
+
+	table = GetForeignTable(RelationGetRelid(relation));
+	server = GetForeignServer(table->serverid);
+	if (get_analyze_sampling_method(server, table) == ANALYZE_SAMPLE_IMPORT)
+		return;
+
+	/*
+	 * Start over for a new parent.  The list lives in the memory context of
+	 * the ANALYZE, so forget it when that goes away.
+	 */
+	if (parent != analyze_children_parent || analyze_children == NIL)
+	{
+		MemoryContextCallback *cb;
+
+		cb = (MemoryContextCallback *) palloc0(sizeof(MemoryContextCallback));
+		cb->func = forget_analyze_children;
+		MemoryContextRegisterResetCallback(CurrentMemoryContext, cb);
+
+		analyze_children_parent = parent;
+		analyze_children = NIL;
+	}
+
+	child = (PgFdwAnalyzeChild *) palloc0(sizeof(PgFdwAnalyzeChild));
+	child->relid = RelationGetRelid(relation);
+	child->totalpages = totalpages;
+	analyze_children = lappend(analyze_children, child);
+}
+
+/*
+ * Memory context callback to forget the remembered children
+ */
+static void
+forget_analyze_children(void *arg)
+{
+	analyze_children_parent = InvalidOid;
+	analyze_children = NIL;
+}
+
+/*
+ * Find the given foreign table among the remembered children of the table
+ * being analyzed.  Returns NULL if it's not there, or if it's the only one,
+ * which gains nothing from concurrency.
+ */
+static PgFdwAnalyzeChild *
+find_analyze_child(Relation relation)
+{
+	ListCell   *lc;
+
+	if (list_length(analyze_children) < 2 ||
+		analyze_children_parent != pgfdw_analyze_target())
+		return NULL;
+
+	foreach(lc, analyze_children)
+	{
+		PgFdwAnalyzeChild *child = (PgFdwAnalyzeChild *) lfirst(lc);
+
+		if (child->relid == RelationGetRelid(relation))
+			return child;
+	}
+	return NULL;
+}
+
+/*
+ * Acquire the sample rows of all the remembered children at once, when
+ * ANALYZE asks those of the given one for targrows rows.
+ *
+ * ANALYZE targets a number of rows proportional to the size of each child,
+ * so we target the same number of rows per page for the others.  The
+ * queries are sent to all the connections at once, and the rows are
+ * collected from whichever connection they arrive on first.  Children
+ * sharing a connection have to wait for each other, though.
+ */
+static void
+acquire_children_sample_rows(PgFdwAnalyzeChild *first, int targrows)
+{
+	double		rows_per_page = (double) targrows / Max(first->totalpages, 1);
+	List	   *pending = NIL;
+	List	   *scans = NIL;
+	ListCell   *lc;
+
+	/* Set up the queries for the children */
+	foreach(lc, analyze_children)
+	{
+		PgFdwAnalyzeChild *child = (PgFdwAnalyzeChild *) lfirst(lc);
+		PgFdwAnalyzeChildScan *scan;
+		Relation	relation;
+		ForeignTable *table;
+		ForeignServer *server;
+		UserMapping *user;
+		PgFdwSamplingMethod method;
+		double		sample_frac;
+		int			child_targrows;
+		StringInfoData sql;
+
+		/* ANALYZE skips empty children */
+		if (child->acquired || child->totalpages == 0)
+			continue;
+
+		child_targrows = (child == first) ? targrows :
+			Max((int) ceil(rows_per_page * child->totalpages), 1);
+
+		/* The children are already locked by ANALYZE */
+		relation = table_open(child->relid, NoLock);
+
+		scan = (PgFdwAnalyzeChildScan *) palloc0(sizeof(PgFdwAnalyzeChildScan));
+		scan->child = child;
+		scan->astate.rel = relation;
+		scan->astate.attinmeta =
+			TupleDescGetAttInMetadata(RelationGetDescr(relation));
+		scan->astate.rows =
+			(HeapTuple *) palloc(child_targrows * sizeof(HeapTuple));
+		scan->astate.targrows = child_targrows;
+		scan->astate.numrows = 0;
+		scan->astate.samplerows = 0;
+		scan->astate.rowstoskip = -1;
+		reservoir_init_selection_state(&scan->astate.rstate, child_targrows);
+		scan->astate.anl_cxt = CurrentMemoryContext;
+		scan->astate.temp_cxt = AllocSetContextCreate(CurrentMemoryContext,
+													  "postgres_fdw temporary data",
+													  ALLOCSET_SMALL_SIZES);
+
+		/*
+		 * As postgresAcquireSampleRowsFunc() does, with the child's own
+		 * sampling method; children that import statistics aren't here.
+		 */
+		table = GetForeignTable(child->relid);
+		server = GetForeignServer(table->serverid);
+		user = GetUserMapping(relation->rd_rel->relowner, table->serverid);
+		scan->conn = GetConnection(user, false, NULL);
+
+		method = get_analyze_sampling_method(server, table);
+		Assert(method != ANALYZE_SAMPLE_IMPORT);
+		scan->method = resolve_analyze_sampling_method(relation, scan->conn,
+													   method, child_targrows,
+													   &sample_frac,
+													   &scan->reltuples);
+
+		initStringInfo(&sql);
+		deparseAnalyzeSql(&sql, relation, scan->method, sample_frac,
+						  &scan->astate.retrieved_attrs);
+		scan->sql = sql.data;
+
+		scans = lappend(scans, scan);
+	}
+
+	/*
+	 * Run the queries in rounds, each of which runs at most one query on
+	 * each connection.
+	 */
+	pending = list_copy(scans);
+	while (pending != NIL)
+	{
+		List	   *round = NIL;
+		List	   *busy = NIL;
+		List	   *rest = NIL;
+
+		foreach(lc, pending)
+		{
+			PgFdwAnalyzeChildScan *scan = (PgFdwAnalyzeChildScan *) lfirst(lc);
+
+			if (list_member_ptr(busy, scan->conn))
+				rest = lappend(rest, scan);
+			else
+			{
+				round = lappend(round, scan);
+				busy = lappend(busy, scan->conn);
+			}
+		}
+
+		/* Send the queries, retrieving their results a row at a time */
+		foreach(lc, round)
+		{
+			PgFdwAnalyzeChildScan *scan = (PgFdwAnalyzeChildScan *) lfirst(lc);
+
+			do_sql_command_begin(scan->conn, scan->sql);
+			if (!PQsetSingleRowMode(scan->conn))
+				elog(ERROR, "could not set single-row mode");
+		}
+
+		collect_children_sample_rows(round);
+
+		list_free(round);
+		list_free(busy);
+		list_free(pending);
+		pending = rest;
+	}
+
+	/* Clean up, and remember the sample rows for the children */
+	foreach(lc, scans)
+	{
+		PgFdwAnalyzeChildScan *scan = (PgFdwAnalyzeChildScan *) lfirst(lc);
+		PgFdwAnalyzeChild *child = scan->child;
+
+		ReleaseConnection(scan->conn);
+		MemoryContextDelete(scan->astate.temp_cxt);
+		table_close(scan->astate.rel, NoLock);
+
+		child->rows = scan->astate.rows;
+		child->numrows = scan->astate.numrows;
+		if (scan->method == ANALYZE_SAMPLE_OFF)
+			child->totalrows = scan->astate.samplerows;
+		else
+			child->totalrows = scan->reltuples;
+		child->acquired = true;
+	}
+}
+
+/*
+ * Collect the sample rows of the children in the given round, whose queries
+ * are running on distinct connections, waiting for any of the connections
+ * to receive more rows rather than draining them one at a time.
+ */
+static void
+collect_children_sample_rows(List *round)
+{
+	List	   *running = list_copy(round);
+	WaitEventSet *set = NULL;
+	WaitEvent  *occurred;
+	ListCell   *lc;
+
+	occurred = (WaitEvent *) palloc(list_length(round) * sizeof(WaitEvent));
+
+	for (;;)
+	{
+		bool		finished = false;
+		int			nevents;
+		int			i;
+
+		/* Process the rows each connection has received so far */
+		foreach(lc, running)
+		{
+			PgFdwAnalyzeChildScan *scan = (PgFdwAnalyzeChildScan *) lfirst(lc);
+
+			if (consume_child_sample_rows(scan))
+			{
+				running = foreach_delete_current(running, lc);
+				finished = true;
+			}
+		}
+		if (running == NIL)
+			break;
+
+		/*
+		 * Wait for the connections whose queries are still running.  The
+		 * wait event set is owned by the current resource owner, so it's
+		 * released on error.
+		 */
+		if (finished && set != NULL)
+		{
+			FreeWaitEventSet(set);
+			set = NULL;
+		}
+		if (set == NULL)
+		{
+			/* first time, allocate or get the custom wait event */
+			if (pgfdw_we_analyze_sample == 0)
+				pgfdw_we_analyze_sample =
+					WaitEventExtensionNew("PostgresFdwAnalyzeSample");
+
+			set = CreateWaitEventSet(CurrentResourceOwner,
+									 list_length(running) + 2);
+			AddWaitEventToSet(set, WL_LATCH_SET, PGINVALID_SOCKET,
+							  MyLatch, NULL);
+			AddWaitEventToSet(set, WL_EXIT_ON_PM_DEATH, PGINVALID_SOCKET,
+							  NULL, NULL);
+			foreach(lc, running)
+			{
+				PgFdwAnalyzeChildScan *scan = (PgFdwAnalyzeChildScan *) lfirst(lc);
+
+				AddWaitEventToSet(set, WL_SOCKET_READABLE,
+								  PQsocket(scan->conn), NULL, scan);
+			}
+		}
+
+		nevents = WaitEventSetWait(set, -1, occurred, list_length(round),
+								   pgfdw_we_analyze_sample);
+		for (i = 0; i < nevents; i++)
+		{
+			PgFdwAnalyzeChildScan *scan;
+
+			if (occurred[i].events & WL_LATCH_SET)
+			{
+				ResetLatch(MyLatch);
+				CHECK_FOR_INTERRUPTS();
+			}
+			if (!(occurred[i].events & WL_SOCKET_READABLE))
+				continue;
+
+			scan = (PgFdwAnalyzeChildScan *) occurred[i].user_data;
+			if (!PQconsumeInput(scan->conn))
+				pgfdw_report_error(ERROR, NULL, scan->conn, false, scan->sql);
+		}
+	}
+
+	if (set != NULL)
+		FreeWaitEventSet(set);
+	pfree(occurred);
+}
+
+/*
+ * Process the rows of a child that its connection has received so far,
+ * without waiting for more.  Returns true if its query is complete.
+ */
+static bool
+consume_child_sample_rows(PgFdwAnalyzeChildScan *scan)
+{
+	PGresult   *volatile res = NULL;
+	volatile bool done = false;
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		while (!PQisBusy(scan->conn))
+		{
+			/* Allow users to cancel long query */
+			CHECK_FOR_INTERRUPTS();
+
+			res = PQgetResult(scan->conn);
+			if (res == NULL)
+			{
+				done = true;
+				break;
+			}
+
+			if (PQresultStatus(res) == PGRES_SINGLE_TUPLE)
+				analyze_row_processor(res, 0, &scan->astate);
+			else if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, scan->conn, false, scan->sql);
+
+			PQclear(res);
+			res = NULL;
+		}
+	}
+	PG_CATCH();
+	{
+		PQclear(res);
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	return done;
+}
+
+/*
+ * Return the sample rows acquired for the given child in advance, picking
+ * targrows of them at random if there are more.
+ */
+static int
+return_child_sample_rows(PgFdwAnalyzeChild *child, int elevel,
+						 HeapTuple *rows, int targrows,
+						 double *totalrows, double *totaldeadrows)
+{
+	int			numrows = Min(child->numrows, targrows);
+	int			i;
+
+	for (i = 0; i < numrows; i++)
+	{
+		/* Swap a randomly chosen row of the rest into this position */
+		if (child->numrows > targrows)
+		{
+			int			j;
+			HeapTuple	tmp;
+
+			j = i + (int) ((child->numrows - i) *
+						   pg_prng_double(&pg_global_prng_state));
+			tmp = child->rows[i];
+			child->rows[i] = child->rows[j];
+			child->rows[j] = tmp;
+		}
+		rows[i] = child->rows[i];
+	}
+
+	/* We assume that we have no dead tuple. */
+	*totaldeadrows = 0.0;
+	*totalrows = child->totalrows;
+
+	/*
+	 * Emit some interesting relation info
+	 */
+	ereport(elevel,
+			(errmsg("\"%s\": table contains %.0f rows, %d rows in sample",
+					get_rel_name(child->relid),
+					*totalrows, numrows)));
+
+	return numrows;
+}
+
+/*
+ * Get the sampling method specified by the analyze_sampling option of the
+ * given foreign table or its server.
+ */
+static PgFdwSamplingMethod
+get_analyze_sampling_method(ForeignServer *server, ForeignTable *table)
+{
+	PgFdwSamplingMethod method = ANALYZE_SAMPLE_AUTO;	/* auto is default */
+	ListCell   *lc;
+
+	foreach(lc, server->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "analyze_sampling") == 0)
+		{
+			char	   *value = defGetString(def);
+
+			if (strcmp(value, "off") == 0)
+				method = ANALYZE_SAMPLE_OFF;
+			else if (strcmp(value, "auto") == 0)
+				method = ANALYZE_SAMPLE_AUTO;
+			else if (strcmp(value, "random") == 0)
+				method = ANALYZE_SAMPLE_RANDOM;
+			else if (strcmp(value, "system") == 0)
+				method = ANALYZE_SAMPLE_SYSTEM;
+			else if (strcmp(value, "bernoulli") == 0)
+				method = ANALYZE_SAMPLE_BERNOULLI;
+			else if (strcmp(value, "import") == 0)
+				method = ANALYZE_SAMPLE_IMPORT;
+
+			break;
+		}
+	}
+
+	foreach(lc, table->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "analyze_sampling") == 0)
+		{
+			char	   *value = defGetString(def);
+
+			if (strcmp(value, "off") == 0)
+				method = ANALYZE_SAMPLE_OFF;
+			else if (strcmp(value, "auto") == 0)
+				method = ANALYZE_SAMPLE_AUTO;
+			else if (strcmp(value, "random") == 0)
+				method = ANALYZE_SAMPLE_RANDOM;
+			else if (strcmp(value, "system") == 0)
+				method = ANALYZE_SAMPLE_SYSTEM;
+			else if (strcmp(value, "bernoulli") == 0)
+				method = ANALYZE_SAMPLE_BERNOULLI;
+			else if (strcmp(value, "import") == 0)
+				method = ANALYZE_SAMPLE_IMPORT;
+
+			break;
+		}
+	}
+
+	return method;
+}
+
+/*
+ * Resolve the given sampling method into the actual one to acquire about
+ * targrows sample rows from the remote table, and compute the sampling rate
+ * into *sample_frac.  The remote reltuples is returned into *reltuples
+ * unless sampling is disabled.
+ */
+static PgFdwSamplingMethod
+resolve_analyze_sampling_method(Relation relation, PGconn *conn,
+								PgFdwSamplingMethod method, int targrows,
+								double *sample_frac, double *reltuples)
+{
+	int			server_version_num;
+
+	/* We'll need server version, so fetch it now. */
+	server_version_num = PQserverVersion(conn);
+	*sample_frac = -1.0;
+	*reltuples = -1;
+
+	/*
+	 * Error-out if explicitly required one of the TABLESAMPLE methods, but
+	 * the server does not support it.
+	 */
+	if ((server_version_num < 95000) &&
+		(method == ANALYZE_SAMPLE_SYSTEM ||
+		 method == ANALYZE_SAMPLE_BERNOULLI))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("remote server does not support TABLESAMPLE feature")));
+
+	/*
+	 * If we've decided to do remote sampling, calculate the sampling rate. We
+	 * need to get the number of tuples from the remote server, but skip that
+	 * network round-trip if not needed.
+	 */
+	if (method != ANALYZE_SAMPLE_OFF)
+	{
+		bool		can_tablesample;
+
+		*reltuples = postgresGetAnalyzeInfoForForeignTable(relation,
+														   &can_tablesample);
+
+		/*
+		 * Make sure we're not choosing TABLESAMPLE when the remote relation
+		 * does not support that. But only do this for "auto" - if the user
+		 * explicitly requested BERNOULLI/SYSTEM, it's better to fail.
+		 */
+		if (!can_tablesample && (method == ANALYZE_SAMPLE_AUTO))
+			method = ANALYZE_SAMPLE_RANDOM;
+
+		/*
+		 * Remote's reltuples could be 0 or -1 if the table has never been
+		 * vacuumed/analyzed.  In that case, disable sampling after all.
+		 */
+		if ((*reltuples <= 0) || (targrows >= *reltuples))
+			method = ANALYZE_SAMPLE_OFF;
+		else
+		{
+			/*
+			 * All supported sampling methods require sampling rate, not
+			 * target rows directly, so we calculate that using the remote
+			 * reltuples value. That's imperfect, because it might be off a
+			 * good deal, but that's not something we can (or should) address
+			 * here.
+			 *
+			 * If reltuples is too low (i.e. when table grew), we'll end up
+			 * sampling more rows - but then we'll apply the local sampling,
+			 * so we get the expected sample size. This is the same outcome as
+			 * without remote sampling.
+			 *
+			 * If reltuples is too high (e.g. after bulk DELETE), we will end
+			 * up sampling too few rows.
+			 *
+			 * We can't really do much better here - we could try sampling a
+			 * bit more rows, but we don't know how off the reltuples value is
+			 * so how much is "a bit more"?
+			 *
+			 * Furthermore, the targrows value for partitions is determined
+			 * based on table size (relpages), which can be off in different
+			 * ways too. Adjusting the sampling rate here might make the issue
+			 * worse.
+			 */
+			*sample_frac = targrows / *reltuples;
+
+			/*
+			 * We should never get sampling rate outside the valid range
+			 * (between 0.0 and 1.0), because those cases should be covered by
+			 * the previous branch that sets ANALYZE_SAMPLE_OFF.
+			 */
+			Assert(*sample_frac >= 0.0 && *sample_frac <= 1.0);
+		}
+	}
+
+	/*
+	 * For "auto" method, pick the one we believe is best. For servers with
+	 * TABLESAMPLE support we pick BERNOULLI, for old servers we fall-back to
+	 * random() to at least reduce network transfer.
+	 */
+	if (method == ANALYZE_SAMPLE_AUTO)
+	{
+		if (server_version_num < 95000)
+			method = ANALYZE_SAMPLE_RANDOM;
+		else
+			method = ANALYZE_SAMPLE_BERNOULLI;
+	}
+
+	return method;
+}
+
+/*
+ * Collect sample rows from the result of query.
+ *	 - Use all tuples in sample until target # of samples are collected.
+ *	 - Subsequently, replace already-sampled tuples randomly.
+ */
+static void
+analyze_row_processor(PGresult *res, int row, PgFdwAnalyzeState *astate)
+{
+	int			targrows = astate->targrows;
+	int			pos;			/* array index to store tuple in */
+	MemoryContext oldcontext;
+
+	/* Always increment sample row counter. */
+	astate->samplerows += 1;
+
+	/*
+	 * Determine the slot where this sample row should be stored.  Set pos to
+	 * negative value to indicate the row should be skipped.
+	 */
+	if (astate->numrows < targrows)
+	{
+		/* First targrows rows are always included into the sample */
+		pos = astate->numrows++;
+	}
+	else
+	{
+		/*
+		 * Now we start replacing tuples in the sample until we reach the end
+		 * of the relation.  Same algorithm as in acquire_sample_rows in
+		 * analyze.c; see Jeff Vitter's paper.
+		 */
+		if (astate->rowstoskip < 0)
+			astate->rowstoskip = reservoir_get_next_S(&astate->rstate, astate->samplerows, targrows);
+
+		if (astate->rowstoskip <= 0)
+		{
+			/* Choose a random reservoir element to replace. */
+			pos = (int) (targrows * sampler_random_fract(&astate->rstate.randstate));
+			Assert(pos >= 0 && pos < targrows);
+			heap_freetuple(astate->rows[pos]);
+		}
+		else
+		{
+			/* Skip this tuple. */
+			pos = -1;
+		}
+
+		astate->rowstoskip -= 1;
+	}
+
+	if (pos >= 0)
+	{
+		/*
+		 * Create sample tuple from current result row, and store it in the
+		 * position determined above.  The tuple has to be created in anl_cxt.
+		 */
+		oldcontext = MemoryContextSwitchTo(astate->anl_cxt);
+
+		astate->rows[pos] = make_tuple_from_result_row(res, row,
+													   astate->rel,
+													   astate->attinmeta,
+													   astate->retrieved_attrs,
+													   NULL,
+													   astate->temp_cxt);
+
+		MemoryContextSwitchTo(oldcontext);
+	}
+}
+
+/*
+ * Import a foreign schema
+ */
+static List *
+postgresImportForeignSchema(ImportForeignSchemaStmt *stmt, Oid serverOid)
+{
+	List	   *commands = NIL;
+	bool		import_collate = true;
+	bool		import_default = false;
+	bool		import_generated = true;
+	bool		import_not_null = true;
+	bool		import_statistics = false;
+	bool		import_indexes = false;
+	bool		import_partitions = false;
+	List	   *imported_tables = NIL;
+	ForeignServer *server;
+	UserMapping *mapping;
+	PGconn	   *conn;
+	StringInfoData buf;
+	PGresult   *volatile res = NULL;
+	int			numrows,
+				i;
+	ListCell   *lc;
+
+	/* Parse statement options */
+	foreach(lc, stmt->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "import_collate") == 0)
+			import_collate = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_default") == 0)
+			import_default = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_generated") == 0)
+			import_generated = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_not_null") == 0)
+			import_not_null = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_statistics") == 0)
+			import_statistics = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_indexes") == 0)
+			import_indexes = defGetBoolean(def);
+		else if (strcmp(def->defname, "import_partitions") == 0)
+			import_partitions = defGetBoolean(def);
+		else
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_INVALID_OPTION_NAME),
+					 errmsg("invalid option \"%s\"", def->defname)));
+	}
+
+	/*
+	 * Get connection to the foreign server.  Connection manager will
+	 * establish new connection if necessary.
+	 */
+	server = GetForeignServer(serverOid);
+	mapping = GetUserMapping(GetUserId(), server->serverid);
+	conn = GetConnection(mapping, false, NULL);
+
+	/* Don't attempt to import collation if remote server hasn't got it */
+	if (PQserverVersion(conn) < 90100)
+		import_collate = false;
+
+	/* Nor the partition layout if it hasn't got partitioning */
+	if (PQserverVersion(conn) < 100000)
+		import_partitions = false;
+
+	/* Create workspace for strings */
+	initStringInfo(&buf);
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		/* Check that the schema really exists */
+		appendStringInfoString(&buf, "SELECT 1 FROM pg_catalog.pg_namespace WHERE nspname = ");
+		deparseStringLiteral(&buf, stmt->remote_schema);
+
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+		if (PQntuples(res) != 1)
+			ereport(ERROR,
+					(errcode(ERRCODE_FDW_SCHEMA_NOT_FOUND),
+					 errmsg("schema \"%s\" is not present on foreign server \"%s\"",
+							stmt->remote_schema, server->servername)));
+
+		PQclear(res);
+		res = NULL;
+		resetStringInfo(&buf);
+
+		/*
+		 * Fetch all table data from this schema, possibly restricted by
+		 * EXCEPT or LIMIT TO.  (We don't actually need to pay any attention
+		 * to EXCEPT/LIMIT TO here, because the core code will filter the
+		 * statements we return according to those lists anyway.  But it
+		 * should save a few cycles to not process excluded tables in the
+		 * first place.)
+		 *
+		 * Import table data for partitions only when they are explicitly
+		 * specified in LIMIT TO clause. Otherwise ignore them and only
+		 * include the definitions of the root partitioned tables to allow
+		 * access to the complete remote data set locally in the schema
+		 * imported.
+		 *
+		 * Note: because we run the connection with search_path restricted to
+		 * pg_catalog, the format_type() and pg_get_expr() outputs will always
+		 * include a schema name for types/functions in other schemas, which
+		 * is what we want.
+		 */
+		appendStringInfoString(&buf,
+							   "SELECT relname, "
+							   "  attname, "
+							   "  format_type(atttypid, atttypmod), "
+							   "  attnotnull, "
+							   "  pg_get_expr(adbin, adrelid), ");
+
+		/* Generated columns are supported since Postgres 12 */
+		if (PQserverVersion(conn) >= 120000)
+			appendStringInfoString(&buf,
+								   "  attgenerated, ");
+		else
+			appendStringInfoString(&buf,
+								   "  NULL, ");
+
+		if (import_collate)
+			appendStringInfoString(&buf,
+								   "  collname, "
+								   "  collnsp.nspname, ");
+		else
+			appendStringInfoString(&buf,
+								   "  NULL, NULL, ");
+
+		/* Partitioned tables are imported as such if requested */
+		if (import_partitions)
+			appendStringInfoString(&buf,
+								   "  relkind, "
+								   "  pg_get_partkeydef(c.oid) ");
+		else
+			appendStringInfoString(&buf,
+								   "  NULL, NULL ");
+
+		appendStringInfoString(&buf,
+							   "FROM pg_class c "
+							   "  JOIN pg_namespace n ON "
+							   "    relnamespace = n.oid "
+							   "  LEFT JOIN pg_attribute a ON "
+							   "    attrelid = c.oid AND attnum > 0 "
+							   "      AND NOT attisdropped "
+							   "  LEFT JOIN pg_attrdef ad ON "
+							   "    adrelid = c.oid AND adnum = attnum ");
+
+		if (import_collate)
+			appendStringInfoString(&buf,
+								   "  LEFT JOIN pg_collation coll ON "
+								   "    coll.oid = attcollation "
+								   "  LEFT JOIN pg_namespace collnsp ON "
+								   "    collnsp.oid = collnamespace ");
+
+		appendStringInfoString(&buf,
+							   "WHERE c.relkind IN ("
+							   CppAsString2(RELKIND_RELATION) ","
+							   CppAsString2(RELKIND_VIEW) ","
+							   CppAsString2(RELKIND_FOREIGN_TABLE) ","
+							   CppAsString2(RELKIND_MATVIEW) ","
+							   CppAsString2(RELKIND_PARTITIONED_TABLE) ") "
+							   "  AND n.nspname = ");
+		deparseStringLiteral(&buf, stmt->remote_schema);
+
+		/*
+		 * Partitions are supported since Postgres 10.  With import_partitions,
+		 * they are imported only along with their partitioned tables.
+		 */
+		if (PQserverVersion(conn) >= 100000 &&
+			(stmt->list_type != FDW_IMPORT_SCHEMA_LIMIT_TO ||
+			 import_partitions))
+			appendStringInfoString(&buf, " AND NOT c.relispartition ");
+
+		/* Apply restrictions for LIMIT TO and EXCEPT */
+		if (stmt->list_type == FDW_IMPORT_SCHEMA_LIMIT_TO ||
+			stmt->list_type == FDW_IMPORT_SCHEMA_EXCEPT)
+		{
+			bool		first_item = true;
+
+			appendStringInfoString(&buf, " AND c.relname ");
+			if (stmt->list_type == FDW_IMPORT_SCHEMA_EXCEPT)
+				appendStringInfoString(&buf, "NOT ");
+			appendStringInfoString(&buf, "IN (");
+
+			/* Append list of table names within IN clause */
+			foreach(lc, stmt->table_list)
+			{
+				RangeVar   *rv = (RangeVar *) lfirst(lc);
+
+				if (first_item)
+					first_item = false;
+				else
+					appendStringInfoString(&buf, ", ");
+				deparseStringLiteral(&buf, rv->relname);
+			}
+			appendStringInfoChar(&buf, ')');
+		}
+
+		/* Append ORDER BY at the end of query to ensure output ordering */
+		appendStringInfoString(&buf, " ORDER BY c.relname, a.attnum");
+
+		/* Fetch the data */
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+		/* Process results */
+		numrows = PQntuples(res);
+		/* note: incrementation of i happens in inner loop's while() test */
+		for (i = 0; i < numrows;)
+		{
+			char	   *tablename = PQgetvalue(res, i, 0);
+			bool		partitioned;
+			bool		first_item = true;
+			List	   *colnames = NIL;
+
+			/*
+			 * A partitioned table imported with its partitions is created
+			 * as a local partitioned table, in the local schema.
+			 */
+			partitioned = (!PQgetisnull(res, i, 8) &&
+						   *PQgetvalue(res, i, 8) == RELKIND_PARTITIONED_TABLE);
+
+			resetStringInfo(&buf);
+			if (partitioned)
+				appendStringInfo(&buf, "CREATE TABLE %s.%s (\n",
+								 quote_identifier(stmt->local_schema),
+								 quote_identifier(tablename));
+			else
+				appendStringInfo(&buf, "CREATE FOREIGN TABLE %s (\n",
+								 quote_identifier(tablename));
+
+			/* Scan all rows for this table */
+			do
+			{
+				char	   *attname;
+				char	   *typename;
+				char	   *attnotnull;
+				char	   *attgenerated;
+				char	   *attdefault;
+				char	   *collname;
+				char	   *collnamespace;
+
+				/* If table has no columns, we'll see nulls here */
+				if (PQgetisnull(res, i, 1))
+					continue;
+
+				attname = PQgetvalue(res, i, 1);
+				typename = PQgetvalue(res, i, 2);
+				attnotnull = PQgetvalue(res, i, 3);
+				attdefault = PQgetisnull(res, i, 4) ? (char *) NULL :
+					PQgetvalue(res, i, 4);
+				attgenerated = PQgetisnull(res, i, 5) ? (char *) NULL :
+					PQgetvalue(res, i, 5);
+				collname = PQgetisnull(res, i, 6) ? (char *) NULL :
+					PQgetvalue(res, i, 6);
+				collnamespace = PQgetisnull(res, i, 7) ? (char *) NULL :
+					PQgetvalue(res, i, 7);
+
+				if (first_item)
+					first_item = false;
+				else
+					appendStringInfoString(&buf, ",\n");
+
+				/* Print column name and type */
+				appendStringInfo(&buf, "  %s %s",
+								 quote_identifier(attname),
+								 typename);
+
+				/*
+				 * Add column_name option so that renaming the foreign table's
+				 * column doesn't break the association to the underlying
+				 * column.
+				 */
+				if (!partitioned)
+				{
+					appendStringInfoString(&buf, " OPTIONS (column_name ");
+					deparseStringLiteral(&buf, attname);
+					appendStringInfoChar(&buf, ')');
+				}
+				colnames = lappend(colnames, pstrdup(attname));
+
+				/* Add COLLATE if needed */
+				if (import_collate && collname != NULL && collnamespace != NULL)
+					appendStringInfo(&buf, " COLLATE %s.%s",
+									 quote_identifier(collnamespace),
+									 quote_identifier(collname));
+
+				/* Add DEFAULT if needed */
+				if (import_default && attdefault != NULL &&
+					(!attgenerated || !attgenerated[0]))
+					appendStringInfo(&buf, " DEFAULT %s", attdefault);
+
+				/* Add GENERATED if needed */
+				if (import_generated && attgenerated != NULL &&
+					attgenerated[0] == ATTRIBUTE_GENERATED_STORED)
+				{
+					Assert(attdefault != NULL);
+					appendStringInfo(&buf,
+									 " GENERATED ALWAYS AS (%s) STORED",
+									 attdefault);
+				}
+
+				/* Add NOT NULL if needed */
+				if (import_not_null && attnotnull[0] == 't')
+					appendStringInfoString(&buf, " NOT NULL");
+			}
+			while (++i < numrows &&
+				   strcmp(PQgetvalue(res, i, 0), tablename) == 0);
+
+			/*
+			 * Remember the tables to import the metadata of.  The partitioned
+			 * tables are created later along with their partitions, whose
+			 * names are checked against all the tables imported.
+			 */
+			if (import_statistics || import_indexes || import_partitions)
+			{
+				PgFdwImportedTable *imported;
+
+				imported = (PgFdwImportedTable *) palloc0(sizeof(PgFdwImportedTable));
+				imported->relname = pstrdup(tablename);
+				imported->colnames = colnames;
+				if (partitioned)
+				{
+					appendStringInfo(&buf, "\n) PARTITION BY %s",
+									 PQgetvalue(res, i - 1, 9));
+					imported->command = pstrdup(buf.data);
+				}
+				imported_tables = lappend(imported_tables, imported);
+			}
+			if (partitioned)
+				continue;
+
+			/*
+			 * Add server name and table-level options.  We specify remote
+			 * schema and table name as options (the latter to ensure that
+			 * renaming the foreign table doesn't break the association).
+			 */
+			appendStringInfo(&buf, "\n) SERVER %s\nOPTIONS (",
+							 quote_identifier(server->servername));
+
+			appendStringInfoString(&buf, "schema_name ");
+			deparseStringLiteral(&buf, stmt->remote_schema);
+			appendStringInfoString(&buf, ", table_name ");
+			deparseStringLiteral(&buf, tablename);
+
+			appendStringInfoString(&buf, ");");
+
+			commands = lappend(commands, pstrdup(buf.data));
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	if (imported_tables != NIL)
+		pgfdw_import_schema_metadata(conn, stmt, server, imported_tables,
+									 import_statistics, import_indexes);
+
+	ReleaseConnection(conn);
+
+	return commands;
+}
+
+/*
+ * Check if reltarget is safe enough to push down semi-join.  Reltarget is not
+ * safe, if it contains references to inner rel relids, which do not belong to
+ * outer rel.
+ */
+static bool
+semijoin_target_ok(PlannerInfo *root, RelOptInfo *joinrel, RelOptInfo *outerrel, RelOptInfo *innerrel)
+{
+	List	   *vars;
+	ListCell   *lc;
+	bool		ok = true;
+
+	Assert(joinrel->reltarget);
+
+	vars = pull_var_clause((Node *) joinrel->reltarget->exprs, PVC_INCLUDE_PLACEHOLDERS);
+
+	foreach(lc, vars)
+	{
+		Var		   *var = (Var *) lfirst(lc);
+
+		if (!IsA(var, Var))
+			continue;
+
+		if (bms_is_member(var->varno, innerrel->relids) &&
+			!bms_is_member(var->varno, outerrel->relids))
+		{
+			/*
+			 * The planner can create semi-join, which refers to inner rel
+			 * vars in its target list. However, we deparse semi-join as an
+			 * exists() subquery, so can't handle references to inner rel in
+			 * the target list.
+			 */
+			ok = false;
+			break;
+		}
+	}
+	return ok;
+}
+
+/*
+ * Assess whether the join between inner and outer relations can be pushed down
+ * to the foreign server. As a side effect, save information we obtain in this
+ * function to PgFdwRelationInfo passed in.
+ */
+static bool
+foreign_join_ok(PlannerInfo *root, RelOptInfo *joinrel, JoinType jointype,
+				RelOptInfo *outerrel, RelOptInfo *innerrel,
+				JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	PgFdwRelationInfo *fpinfo_o;
+	PgFdwRelationInfo *fpinfo_i;
+	ListCell   *lc;
+	List	   *joinclauses;
+
+	/*
+	 * We support pushing down INNER, LEFT, RIGHT, FULL OUTER and SEMI joins.
+	 * Constructing queries representing ANTI joins is hard, hence not
+	 * considered right now.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_LEFT &&
+		jointype != JOIN_RIGHT && jointype != JOIN_FULL &&
+		jointype != JOIN_SEMI)
+		return false;
+
+	/*
+	 * We can't push down semi-join if its reltarget is not safe
+	 */
+	if ((jointype == JOIN_SEMI) && !semijoin_target_ok(root, joinrel, outerrel, innerrel))
+		return false;
+
+	/*
+	 * If either of the joining relations is marked as unsafe to pushdown, the
+	 * join can not be pushed down.
+	 */
+	fpinfo = (PgFdwRelationInfo *) joinrel->fdw_private;
+	fpinfo_o = (PgFdwRelationInfo *) outerrel->fdw_private;
+	fpinfo_i = (PgFdwRelationInfo *) innerrel->fdw_private;
+	if (!fpinfo_o || !fpinfo_o->pushdown_safe ||
+		!fpinfo_i || !fpinfo_i->pushdown_safe)
+		return false;
+
+	/*
+	 * If joining relations have local conditions, those conditions are
+	 * required to be applied before joining the relations. Hence the join can
+	 * not be pushed down.
+	 */
+	if (fpinfo_o->local_conds || fpinfo_i->local_conds)
+		return false;
+
+	/*
+	 * Merge FDW options.  We might be tempted to do this after we have deemed
+	 * the foreign join to be OK.  But we must do this beforehand so that we
+	 * know which quals can be evaluated on the foreign server, which might
+	 * depend on shippable_extensions.
+	 */
+	fpinfo->server = fpinfo_o->server;
+	merge_fdw_options(fpinfo, fpinfo_o, fpinfo_i);
+
+	/*
+	 * Separate restrict list into join quals and pushed-down (other) quals.
+	 *
+	 * Join quals belonging to an outer join must all be shippable, else we
+	 * cannot execute the join remotely.  Add such quals to 'joinclauses'.
+	 *
+	 * Add other quals to fpinfo->remote_conds if they are shippable, else to
+	 * fpinfo->local_conds.  In an inner join it's okay to execute conditions
+	 * either locally or remotely; the same is true for pushed-down conditions
+	 * at an outer join.
+	 *
+	 * Note we might return failure after having already scribbled on
+	 * fpinfo->remote_conds and fpinfo->local_conds.  That's okay because we
+	 * won't consult those lists again if we deem the join unshippable.
+	 */
+	joinclauses = NIL;
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+		bool		is_remote_clause = is_foreign_expr(root, joinrel,
+													   rinfo->clause);
+
+		if (IS_OUTER_JOIN(jointype) &&
+			!RINFO_IS_PUSHED_DOWN(rinfo, joinrel->relids))
+		{
+			if (!is_remote_clause)
+				return false;
+			joinclauses = lappend(joinclauses, rinfo);
+		}
+		else
+		{
+			if (is_remote_clause)
+				fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+			else
+				fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+		}
+	}
+
+	/*
+	 * deparseExplicitTargetList() isn't smart enough to handle anything other
+	 * than a Var.  In particular, if there's some PlaceHolderVar that would
+	 * need to be evaluated within this join tree (because there's an upper
+	 * reference to a quantity that may go to NULL as a result of an outer
+	 * join), then we can't try to push the join down because we'll fail when
+	 * we get to deparseExplicitTargetList().  However, a PlaceHolderVar that
+	 * needs to be evaluated *at the top* of this join tree is OK, because we
+	 * can do that locally after fetching the results from the remote side.
+	 */
+	foreach(lc, root->placeholder_list)
+	{
+		PlaceHolderInfo *phinfo = lfirst(lc);
+		Relids		relids;
+
+		/* PlaceHolderInfo refers to parent relids, not child relids. */
+		relids = IS_OTHER_REL(joinrel) ?
+			joinrel->top_parent_relids : joinrel->relids;
+
+		if (bms_is_subset(phinfo->ph_eval_at, relids) &&
+			bms_nonempty_difference(relids, phinfo->ph_eval_at))
+			return false;
+	}
+
+	/* Save the join clauses, for later use. */
+	fpinfo->joinclauses = joinclauses;
+
+	fpinfo->outerrel = outerrel;
+	fpinfo->innerrel = innerrel;
+	fpinfo->jointype = jointype;
+
+	/*
+	 * By default, both the input relations are not required to be deparsed as
+	 * subqueries, but there might be some relations covered by the input
+	 * relations that are required to be deparsed as subqueries, so save the
+	 * relids of those relations for later use by the deparser.
+	 */
+	fpinfo->make_outerrel_subquery = false;
+	fpinfo->make_innerrel_subquery = false;
+	Assert(bms_is_subset(fpinfo_o->lower_subquery_rels, outerrel->relids));
+	Assert(bms_is_subset(fpinfo_i->lower_subquery_rels, innerrel->relids));
+	fpinfo->lower_subquery_rels = bms_union(fpinfo_o->lower_subquery_rels,
+											fpinfo_i->lower_subquery_rels);
+	fpinfo->hidden_subquery_rels = bms_union(fpinfo_o->hidden_subquery_rels,
+											 fpinfo_i->hidden_subquery_rels);
+
+	/*
+	 * Pull the other remote conditions from the joining relations into join
+	 * clauses or other remote clauses (remote_conds) of this relation
+	 * wherever possible. This avoids building subqueries at every join step.
+	 *
+	 * For an inner join, clauses from both the relations are added to the
+	 * other remote clauses. For LEFT and RIGHT OUTER join, the clauses from
+	 * the outer side are added to remote_conds since those can be evaluated
+	 * after the join is evaluated. The clauses from inner side are added to
+	 * the joinclauses, since they need to be evaluated while constructing the
+	 * join.
+	 *
+	 * For SEMI-JOIN clauses from inner relation can not be added to
+	 * remote_conds, but should be treated as join clauses (as they are
+	 * deparsed to EXISTS subquery, where inner relation can be referred). A
+	 * list of relation ids, which can't be referred to from higher levels, is
+	 * preserved as a hidden_subquery_rels list.
+	 *
+	 * For a FULL OUTER JOIN, the other clauses from either relation can not
+	 * be added to the joinclauses or remote_conds, since each relation acts
+	 * as an outer relation for the other.
+	 *
+	 * The joining sides can not have local conditions, thus no need to test
+	 * shippability of the clauses being pulled up.
+	 */
+	switch (jointype)
+	{
+		case JOIN_INNER:
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   fpinfo_i->remote_conds);
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   fpinfo_o->remote_conds);
+			break;
+
+		case JOIN_LEFT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  fpinfo_i->remote_conds);
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   fpinfo_o->remote_conds);
+			break;
+
+		case JOIN_RIGHT:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  fpinfo_o->remote_conds);
+			fpinfo->remote_conds = list_concat(fpinfo->remote_conds,
+											   fpinfo_i->remote_conds);
+			break;
+
+		case JOIN_SEMI:
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  fpinfo_i->remote_conds);
+			fpinfo->joinclauses = list_concat(fpinfo->joinclauses,
+											  fpinfo->remote_conds);
+			fpinfo->remote_conds = list_copy(fpinfo_o->remote_conds);
+			fpinfo->hidden_subquery_rels = bms_union(fpinfo->hidden_subquery_rels,
+													 innerrel->relids);
+			break;
+
+		case JOIN_FULL:
+
+			/*
+			 * In this case, if any of the input relations has conditions, we
+			 * need to deparse that relation as a subquery so that the
+			 * conditions can be evaluated before the join.  Remember it in
+			 * the fpinfo of this relation so that the deparser can take
+			 * appropriate action.  Also, save the relids of base relations
+			 * covered by that relation for later use by the deparser.
+			 */
+			if (fpinfo_o->remote_conds)
+			{
+				fpinfo->make_outerrel_subquery = true;
+				fpinfo->lower_subquery_rels =
+					bms_add_members(fpinfo->lower_subquery_rels,
+									outerrel->relids);
+			}
+			if (fpinfo_i->remote_conds)
+			{
+				fpinfo->make_innerrel_subquery = true;
+				fpinfo->lower_subquery_rels =
+					bms_add_members(fpinfo->lower_subquery_rels,
+									innerrel->relids);
+			}
+			break;
+
+		default:
+			/* Should not happen, we have just checked this above */
+			elog(ERROR, "unsupported join type %d", jointype);
+	}
+
+	/*
+	 * For an inner join, all restrictions can be treated alike. Treating the
+	 * pushed down conditions as join conditions allows a top level full outer
+	 * join to be deparsed without requiring subqueries.
+	 */
+	if (jointype == JOIN_INNER)
+	{
+		Assert(!fpinfo->joinclauses);
+		fpinfo->joinclauses = fpinfo->remote_conds;
+		fpinfo->remote_conds = NIL;
+	}
+	else if (jointype == JOIN_LEFT || jointype == JOIN_RIGHT || jointype == JOIN_FULL)
+	{
+		/*
+		 * Conditions, generated from semi-joins, should be evaluated before
+		 * LEFT/RIGHT/FULL join.
+		 */
+		if (!bms_is_empty(fpinfo_o->hidden_subquery_rels))
+		{
+			fpinfo->make_outerrel_subquery = true;
+			fpinfo->lower_subquery_rels = bms_add_members(fpinfo->lower_subquery_rels, outerrel->relids);
+		}
+
+		if (!bms_is_empty(fpinfo_i->hidden_subquery_rels))
+		{
+			fpinfo->make_innerrel_subquery = true;
+			fpinfo->lower_subquery_rels = bms_add_members(fpinfo->lower_subquery_rels, innerrel->relids);
+		}
+	}
+
+	/* Mark that this join can be pushed down safely */
+	fpinfo->pushdown_safe = true;
+
+	/* Get user mapping */
+	if (fpinfo->use_remote_estimate)
+	{
+		if (fpinfo_o->use_remote_estimate)
+			fpinfo->user = fpinfo_o->user;
+		else
+			fpinfo->user = fpinfo_i->user;
+	}
+	else
+		fpinfo->user = NULL;
+
+	/*
+	 * Set # of retrieved rows and cached relation costs to some negative
+	 * value, so that we can detect when they are set to some sensible values,
+	 * during one (usually the first) of the calls to estimate_path_cost_size.
+	 */
+	fpinfo->retrieved_rows = -1;
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this join relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.  Note that the decoration we add
+	 * to the base relation names mustn't include any digits, or it'll confuse
+	 * postgresExplainForeignScan.
+	 */
+	fpinfo->relation_name = psprintf("(%s) %s JOIN (%s)",
+									 fpinfo_o->relation_name,
+									 get_jointype_name(fpinfo->jointype),
+									 fpinfo_i->relation_name);
+
+	/*
+	 * Set the relation index.  This is defined as the position of this
+	 * joinrel in the join_rel_list list plus the length of the rtable list.
+	 * Note that since this joinrel is at the end of the join_rel_list list
+	 * when we are called, we can get the position by list_length.
+	 */
+	Assert(fpinfo->relation_index == 0);	/* shouldn't be set yet */
+	fpinfo->relation_index =
+		list_length(root->parse->rtable) + list_length(root->join_rel_list);
+
+	return true;
+}
+
+static void
+add_paths_with_pathkeys_for_rel(PlannerInfo *root, RelOptInfo *rel,
+								Path *epq_path, List *restrictlist)
+{
+	List	   *useful_pathkeys_list = NIL; /* List of all pathkeys */
+	List	   *path_costs = NIL;
+	ListCell   *lc;
+
+	useful_pathkeys_list = get_useful_pathkeys_for_relation(root, rel);
+
+	/*
+	 * Before creating sorted paths, arrange for the passed-in EPQ path, if
+	 * any, to return columns needed by the parent ForeignScan node so that
+	 * they will propagate up through Sort nodes injected below, if necessary.
+	 */
+	if (epq_path != NULL && useful_pathkeys_list != NIL)
+	{
+		PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+		PathTarget *target = copy_pathtarget(epq_path->pathtarget);
+
+		/* Include columns required for evaluating PHVs in the tlist. */
+		add_new_columns_to_pathtarget(target,
+									  pull_var_clause((Node *) target->exprs,
+													  PVC_RECURSE_PLACEHOLDERS));
+
+		/* Include columns required for evaluating the local conditions. */
+		foreach(lc, fpinfo->local_conds)
+		{
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+			add_new_columns_to_pathtarget(target,
+										  pull_var_clause((Node *) rinfo->clause,
+														  PVC_RECURSE_PLACEHOLDERS));
+		}
+
+		/*
+		 * If we have added any new columns, adjust the tlist of the EPQ path.
+		 *
+		 * Note: the plan created using this path will only be used to execute
+		 * EPQ checks, where accuracy of the plan cost and width estimates
+		 * would not be important, so we do not do set_pathtarget_cost_width()
+		 * for the new pathtarget here.  See also postgresGetForeignPlan().
+		 */
+		if (list_length(target->exprs) > list_length(epq_path->pathtarget->exprs))
+		{
+			/* The EPQ path is a join path, so it is projection-capable. */
+			Assert(is_projection_capable_path(epq_path));
+
+			/*
+			 * Use create_projection_path() here, so as to avoid modifying it
+			 * in place.
+			 */
+			epq_path = (Path *) create_projection_path(root,
+													   rel,
+													   epq_path,
+													   target);
+		}
+	}
+
+	/* Estimate the costs of the paths for all the pathkeys at once. */
+	foreach(lc, useful_pathkeys_list)
+	{
+		PgFdwPathCost *pc = (PgFdwPathCost *) palloc0(sizeof(PgFdwPathCost));
+
+		pc->pathkeys = (List *) lfirst(lc);
+		path_costs = lappend(path_costs, pc);
+	}
+	estimate_path_costs_batch(root, rel, path_costs);
+
+	/* Create one path for each set of pathkeys we found above. */
+	foreach(lc, path_costs)
+	{
+		PgFdwPathCost *pc = (PgFdwPathCost *) lfirst(lc);
+		double		rows = pc->rows;
+		Cost		startup_cost = pc->startup_cost;
+		Cost		total_cost = pc->total_cost;
+		List	   *useful_pathkeys = pc->pathkeys;
+		Path	   *sorted_epq_path;
+
+		/*
+		 * The EPQ path must be at least as well sorted as the path itself, in
+		 * case it gets used as input to a mergejoin.
+		 */
+		sorted_epq_path = epq_path;
+		if (sorted_epq_path != NULL &&
+			!pathkeys_contained_in(useful_pathkeys,
+								   sorted_epq_path->pathkeys))
+			sorted_epq_path = (Path *)
+				create_sort_path(root,
+								 rel,
+								 sorted_epq_path,
+								 useful_pathkeys,
+								 -1.0);
+
+		if (IS_SIMPLE_REL(rel))
+			add_path(rel, (Path *)
+					 create_foreignscan_path(root, rel,
+											 NULL,
+											 rows,
+											 startup_cost,
+											 total_cost,
+											 useful_pathkeys,
+											 rel->lateral_relids,
+											 sorted_epq_path,
+											 NIL,	/* no fdw_restrictinfo
+													 * list */
+											 NIL));
+		else
+			add_path(rel, (Path *)
+					 create_foreign_join_path(root, rel,
+											  NULL,
+											  rows,
+											  startup_cost,
+											  total_cost,
+											  useful_pathkeys,
+											  rel->lateral_relids,
+											  sorted_epq_path,
+											  restrictlist,
+											  NIL));
+	}
+}
+
+/*
+ * Get the cached FDW settings of the given foreign table, (re)building them
+ * if needed.
+ *
+ * The result points into cache memory, which is freed when the entry is
+ * invalidated, so callers should copy what they keep before doing any
+ * catalog access.
+ */
+static PgFdwRelationSettings *
+get_relation_settings(Oid relid)
+{
+	PgFdwRelationSettings *entry;
+	PgFdwRelationSettings settings;
+	PgFdwRelationInfo fpinfo;
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+	uint64		inval_count;
+	ListCell   *lc;
+	bool		found;
+
+	/* First time through, initialize the cache */
+	if (relation_settings_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(PgFdwRelationSettings);
+		relation_settings_hash = hash_create("postgres_fdw relation settings",
+											 256, &ctl,
+											 HASH_ELEM | HASH_BLOBS);
+
+		CacheRegisterSyscacheCallback(FOREIGNTABLEREL,
+									  relation_settings_inval_callback,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+									  relation_settings_inval_callback,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(USERMAPPINGOID,
+									  relation_settings_inval_callback,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(PROCOID,
+									  relation_settings_inval_callback,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TYPEOID,
+									  relation_settings_inval_callback,
+									  (Datum) 0);
+	}
+
+	entry = (PgFdwRelationSettings *) hash_search(relation_settings_hash,
+												  &relid, HASH_FIND, NULL);
+	if (entry != NULL && entry->valid)
+		return entry;
+
+	/*
+	 * Build the settings in a context of their own.  It's created under the
+	 * current context and only reparented to CacheMemoryContext on success,
+	 * so that it's cleaned up if we fail partway through.
+	 */
+	inval_count = relation_settings_inval_count;
+	cxt = AllocSetContextCreate(CurrentMemoryContext,
+								"postgres_fdw relation settings",
+								ALLOCSET_SMALL_SIZES);
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	/*
+	 * Extract user-settable option values, in a single pass over the server
+	 * options followed by the table options, so that the ones specified for
+	 * the table override the ones for the server.  We use a batch size of 1
+	 * by default, which means "no batching".
+	 *
+	 * New options might also require tweaking merge_fdw_options().
+	 */
+	memset(&fpinfo, 0, sizeof(fpinfo));
+	fpinfo.table = GetForeignTable(relid);
+	fpinfo.server = GetForeignServer(fpinfo.table->serverid);
+	fpinfo.use_remote_estimate = false;
+	fpinfo.fdw_startup_cost = DEFAULT_FDW_STARTUP_COST;
+	fpinfo.fdw_tuple_cost = DEFAULT_FDW_TUPLE_COST;
+	fpinfo.shippable_extensions = NIL;
+	fpinfo.fetch_size = 100;
+	fpinfo.async_capable = false;
+	fpinfo.verify_collations = false;
+	fpinfo.use_network_cost = false;
+	settings.batch_size = 1;
+	settings.batch_insert_method = BATCH_INSERT_INSERT;
+	settings.batch_target_size = 0;
+
+	foreach(lc, list_concat_copy(fpinfo.server->options,
+								 fpinfo.table->options))
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "use_remote_estimate") == 0)
+			fpinfo.use_remote_estimate = defGetBoolean(def);
+		else if (strcmp(def->defname, "fdw_startup_cost") == 0)
+			(void) parse_real(defGetString(def), &fpinfo.fdw_startup_cost, 0,
+							  NULL);
+		else if (strcmp(def->defname, "fdw_tuple_cost") == 0)
+			(void) parse_real(defGetString(def), &fpinfo.fdw_tuple_cost, 0,
+							  NULL);
+		else if (strcmp(def->defname, "extensions") == 0)
+			fpinfo.shippable_extensions =
+				ExtractExtensionList(defGetString(def), false);
+		else if (strcmp(def->defname, "fetch_size") == 0)
+			(void) parse_int(defGetString(def), &fpinfo.fetch_size, 0, NULL);
+		else if (strcmp(def->defname, "async_capable") == 0)
+			fpinfo.async_capable = defGetBoolean(def);
+		else if (strcmp(def->defname, "verify_collations") == 0)
+			fpinfo.verify_collations = defGetBoolean(def);
+		else if (strcmp(def->defname, "use_network_cost") == 0)
+			fpinfo.use_network_cost = defGetBoolean(def);
+		else if (strcmp(def->defname, "batch_size") == 0)
+			(void) parse_int(defGetString(def), &settings.batch_size, 0,
+							 NULL);
+		else if (strcmp(def->defname, "batch_insert_method") == 0)
+		{
+			char	   *value = defGetString(def);
+
+			if (strcmp(value, "copy") == 0)
+				settings.batch_insert_method = BATCH_INSERT_COPY;
+			else if (strcmp(value, "binary_copy") == 0)
+				settings.batch_insert_method = BATCH_INSERT_BINARY_COPY;
+			else
+				settings.batch_insert_method = BATCH_INSERT_INSERT;
+		}
+		else if (strcmp(def->defname, "batch_target_size") == 0)
+			(void) parse_int(defGetString(def), &settings.batch_target_size,
+							 GUC_UNIT_BYTE, NULL);
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	/*
+	 * Success; discard the old data and install the new.  The entry is looked
+	 * up again, as invalidations processed while we were reading the catalogs
+	 * may have removed it.
+	 */
+	entry = (PgFdwRelationSettings *) hash_search(relation_settings_hash,
+												  &relid, HASH_ENTER, &found);
+	if (found && entry->cxt)
+		MemoryContextDelete(entry->cxt);
+	MemoryContextSetParent(cxt, CacheMemoryContext);
+	entry->cxt = cxt;
+	entry->table = fpinfo.table;
+	entry->server = fpinfo.server;
+	entry->userid = InvalidOid;
+	entry->user = NULL;
+	entry->use_remote_estimate = fpinfo.use_remote_estimate;
+	entry->fdw_startup_cost = fpinfo.fdw_startup_cost;
+	entry->fdw_tuple_cost = fpinfo.fdw_tuple_cost;
+	entry->shippable_extensions = fpinfo.shippable_extensions;
+	entry->fetch_size = fpinfo.fetch_size;
+	entry->async_capable = fpinfo.async_capable;
+	entry->verify_collations = fpinfo.verify_collations;
+	entry->use_network_cost = fpinfo.use_network_cost;
+	entry->batch_size = settings.batch_size;
+	entry->batch_insert_method = settings.batch_insert_method;
+	entry->batch_target_size = settings.batch_target_size;
+	entry->hashvalue = GetSysCacheHashValue1(FOREIGNTABLEREL,
+											 ObjectIdGetDatum(relid));
+
+	/*
+	 * If an invalidation arrived while we were reading the catalogs, what we
+	 * read might already be stale.  Use it for this call anyway, as a fresh
+	 * lookup would have, but rebuild it next time.  This is the only case an
+	 * invalid entry is left in the cache.
+	 */
+	entry->valid = (inval_count == relation_settings_inval_count);
+
+	return entry;
+}
+
+/*
+ * Syscache invalidation callback for the cached FDW settings.
+ *
+ * Affected entries are removed here and rebuilt on their next use, since we
+ * can't do catalog access in this callback.  Nothing outside the cache
+ * points into their memory, since get_relation_settings() callers copy what
+ * they keep.
+ *
+ * The OIDs of the extensions listed in the extensions option go stale if
+ * an extension is dropped and created again.  There's no syscache on
+ * pg_extension to watch, but creating or dropping an extension creates or
+ * drops its member functions and types, so we watch those instead.
+ */
+static void
+relation_settings_inval_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS scan;
+	PgFdwRelationSettings *entry;
+
+	Assert(cacheid == FOREIGNTABLEREL ||
+		   cacheid == FOREIGNSERVEROID ||
+		   cacheid == USERMAPPINGOID ||
+		   cacheid == PROCOID ||
+		   cacheid == TYPEOID);
+
+	relation_settings_inval_count++;
+
+	hash_seq_init(&scan, relation_settings_hash);
+	while ((entry = (PgFdwRelationSettings *) hash_seq_search(&scan)))
+	{
+		/*
+		 * A change of a foreign table only affects its own entry.  Changes of
+		 * servers and user mappings are rare, so just invalidate everything.
+		 */
+		if (cacheid == FOREIGNTABLEREL && hashvalue != 0 &&
+			entry->hashvalue != hashvalue)
+			continue;
+
+		/* Functions and types only matter to the extension OIDs */
+		if ((cacheid == PROCOID || cacheid == TYPEOID) &&
+			entry->shippable_extensions == NIL)
+			continue;
+
+		if (entry->cxt)
+			MemoryContextDelete(entry->cxt);
+		(void) hash_search(relation_settings_hash, &entry->relid,
+						   HASH_REMOVE, NULL);
+	}
+}
+
+/*
+ * Fill in the catalog info and option values of the given foreign table in
+ * fpinfo, from copies of its cached FDW settings.
+ */
+static void
+apply_relation_settings(PgFdwRelationInfo *fpinfo, Oid relid)
+{
+	PgFdwRelationSettings *settings = get_relation_settings(relid);
+	ForeignTable *table;
+	ForeignServer *server;
+
+	table = (ForeignTable *) palloc(sizeof(ForeignTable));
+	*table = *settings->table;
+	table->options = copyObject(settings->table->options);
+	fpinfo->table = table;
+
+	server = (ForeignServer *) palloc(sizeof(ForeignServer));
+	*server = *settings->server;
+	server->servername = pstrdup(settings->server->servername);
+	if (settings->server->servertype)
+		server->servertype = pstrdup(settings->server->servertype);
+	if (settings->server->serverversion)
+		server->serverversion = pstrdup(settings->server->serverversion);
+	server->options = copyObject(settings->server->options);
+	fpinfo->server = server;
+
+	fpinfo->use_remote_estimate = settings->use_remote_estimate;
+	fpinfo->fdw_startup_cost = settings->fdw_startup_cost;
+	fpinfo->fdw_tuple_cost = settings->fdw_tuple_cost;
+	fpinfo->shippable_extensions = list_copy(settings->shippable_extensions);
+	fpinfo->fetch_size = settings->fetch_size;
+	fpinfo->async_capable = settings->async_capable;
+	fpinfo->verify_collations = settings->verify_collations;
+	fpinfo->use_network_cost = settings->use_network_cost;
+}
+
+/*
+ * Get the user mapping to access the given foreign table as the given user,
+ * caching the one of the last user along with the table's FDW settings.
+ */
+static UserMapping *
+get_relation_user_mapping(Oid relid, Oid userid)
+{
+	PgFdwRelationSettings *settings = get_relation_settings(relid);
+
+	if (settings->user == NULL || settings->userid != userid)
+	{
+		UserMapping *user;
+		MemoryContext oldcxt;
+
+		/*
+		 * This throws an error if there's no mapping, so look it up first.
+		 * The lookup may process invalidations that remove our entry, so get
+		 * it again.
+		 */
+		user = GetUserMapping(userid, settings->server->serverid);
+		settings = get_relation_settings(relid);
+
+		oldcxt = MemoryContextSwitchTo(settings->cxt);
+		settings->user = copy_user_mapping(user);
+		settings->userid = userid;
+		MemoryContextSwitchTo(oldcxt);
+	}
+
+	return copy_user_mapping(settings->user);
+}
+
+/*
+ * Make a copy of a UserMapping in the current memory context.
+ */
+static UserMapping *
+copy_user_mapping(const UserMapping *user)
+{
+	UserMapping *copy = (UserMapping *) palloc(sizeof(UserMapping));
+
+	*copy = *user;
+	copy->options = copyObject(user->options);
+
+	return copy;
+}
+
+/*
+ * Merge FDW options from input relations into a new set of options for a join
+ * or an upper rel.
+ *
+ * For a join relation, FDW-specific information about the inner and outer
+ * relations is provided using fpinfo_i and fpinfo_o.  For an upper relation,
+ * fpinfo_o provides the information for the input relation; fpinfo_i is
+ * expected to NULL.
+ */
+static void
+merge_fdw_options(PgFdwRelationInfo *fpinfo,
+				  const PgFdwRelationInfo *fpinfo_o,
+				  const PgFdwRelationInfo *fpinfo_i)
+{
+	/* We must always have fpinfo_o. */
+	Assert(fpinfo_o);
+
+	/* fpinfo_i may be NULL, but if present the servers must both match. */
+	Assert(!fpinfo_i ||
+		   fpinfo_i->server->serverid == fpinfo_o->server->serverid);
+
+	/*
+	 * Copy the server specific FDW options.  (For a join, both relations come
+	 * from the same server, so the server options should have the same value
+	 * for both relations.)
+	 */
+	fpinfo->fdw_startup_cost = fpinfo_o->fdw_startup_cost;
+	fpinfo->fdw_tuple_cost = fpinfo_o->fdw_tuple_cost;
+	fpinfo->shippable_extensions = fpinfo_o->shippable_extensions;
+	fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate;
+	fpinfo->fetch_size = fpinfo_o->fetch_size;
+	fpinfo->async_capable = fpinfo_o->async_capable;
+	fpinfo->verify_collations = fpinfo_o->verify_collations;
+	fpinfo->use_network_cost = fpinfo_o->use_network_cost;
+
+	/* Merge the table level options from either side of the join. */
+	if (fpinfo_i)
+	{
+		/*
+		 * We'll prefer to use remote estimates for this join if any table
+		 * from either side of the join is using remote estimates.  This is
+		 * most likely going to be preferred since they're already willing to
+		 * pay the price of a round trip to get the remote EXPLAIN.  In any
+		 * case it's not entirely clear how we might otherwise handle this
+		 * best.
+		 */
+		fpinfo->use_remote_estimate = fpinfo_o->use_remote_estimate ||
+			fpinfo_i->use_remote_estimate;
+
+		/*
+		 * Set fetch size to maximum of the joining sides, since we are
+		 * expecting the rows returned by the join to be proportional to the
+		 * relation sizes.
+		 */
+		fpinfo->fetch_size = Max(fpinfo_o->fetch_size, fpinfo_i->fetch_size);
+
+		/*
+		 * We'll prefer to consider this join async-capable if any table from
+		 * either side of the join is considered async-capable.  This would be
+		 * reasonable because in that case the foreign server would have its
+		 * own resources to scan that table asynchronously, and the join could
+		 * also be computed asynchronously using the resources.
+		 */
+		fpinfo->async_capable = fpinfo_o->async_capable ||
+			fpinfo_i->async_capable;
+	}
+}
+
+/*
+ * postgresGetForeignJoinPaths
+ *		Add possible ForeignPath to joinrel, if join is safe to push down.
+ */
+static void
+postgresGetForeignJoinPaths(PlannerInfo *root,
+							RelOptInfo *joinrel,
+							RelOptInfo *outerrel,
+							RelOptInfo *innerrel,
+							JoinType jointype,
+							JoinPathExtraData *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+	ForeignPath *joinpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	Path	   *epq_path;		/* Path to create plan to be executed when
+								 * EvalPlanQual gets triggered. */
+
+	/*
+	 * Skip if this join combination has been considered already.
+	 */
+	if (joinrel->fdw_private)
+		return;
+
+	/*
+	 * This code does not work for joins with lateral references, since those
+	 * must have parameterized paths, which we don't generate yet.
+	 */
+	if (!bms_is_empty(joinrel->lateral_relids))
+		return;
+
+	/*
+	 * Create unfinished PgFdwRelationInfo entry which is used to indicate
+	 * that the join relation is already considered, so that we won't waste
+	 * time in judging safety of join pushdown and adding the same paths again
+	 * if found safe. Once we know that this join can be pushed down, we fill
+	 * the entry.
+	 */
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	joinrel->fdw_private = fpinfo;
+	/* attrs_used is only for base relations. */
+	fpinfo->attrs_used = NULL;
+
+	/*
+	 * If there is a possibility that EvalPlanQual will be executed, we need
+	 * to be able to reconstruct the row using scans of the base relations.
+	 * GetExistingLocalJoinPath will find a suitable path for this purpose in
+	 * the path list of the joinrel, if one exists.  We must be careful to
+	 * call it before adding any ForeignPath, since the ForeignPath might
+	 * dominate the only suitable local path available.  We also do it before
+	 * calling foreign_join_ok(), since that function updates fpinfo and marks
+	 * it as pushable if the join is found to be pushable.
+	 */
+	if (root->parse->commandType == CMD_DELETE ||
+		root->parse->commandType == CMD_UPDATE ||
+		root->rowMarks)
+	{
+		epq_path = GetExistingLocalJoinPath(joinrel);
+		if (!epq_path)
+		{
+			elog(DEBUG3, "could not push down foreign join because a local path suitable for EPQ checks was not found");
+			return;
+		}
+	}
+	else
+		epq_path = NULL;
+
+	if (!foreign_join_ok(root, joinrel, jointype, outerrel, innerrel, extra))
+	{
+		/* Free path required for EPQ if we copied one; we don't need it now */
+		if (epq_path)
+			pfree(epq_path);
+		return;
+	}
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path. The best we can do for these
+	 * conditions is to estimate selectivity on the basis of local statistics.
+	 * The local conditions are applied after the join has been computed on
+	 * the remote side like quals in WHERE clause, so pass jointype as
+	 * JOIN_INNER.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 0,
+													 JOIN_INNER,
+													 NULL);
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/*
+	 * If we may estimate costs locally, which we do even with remote
+	 * estimates once their planning budget is exhausted, estimate the join
+	 * clause selectivity here while we have special join info.
+	 */
+	if (!fpinfo->use_remote_estimate ||
+		pgfdw_remote_estimate_max_count >= 0 ||
+		pgfdw_remote_estimate_max_time >= 0)
+		fpinfo->joinclause_sel = clauselist_selectivity(root, fpinfo->joinclauses,
+														0, fpinfo->jointype,
+														extra->sjinfo);
+
+	/* Estimate costs for bare join relation */
+	estimate_path_cost_size(root, joinrel, NIL, NIL, NULL,
+							&rows, &width, &startup_cost, &total_cost);
+	/* Now update this information in the joinrel */
+	joinrel->rows = rows;
+	joinrel->reltarget->width = width;
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/*
+	 * Create a new join path and add it to the joinrel which represents a
+	 * join between foreign tables.
+	 */
+	joinpath = create_foreign_join_path(root,
+										joinrel,
+										NULL,	/* default pathtarget */
+										rows,
+										startup_cost,
+										total_cost,
+										NIL,	/* no pathkeys */
+										joinrel->lateral_relids,
+										epq_path,
+										extra->restrictlist,
+										NIL);	/* no fdw_private */
+
+	/* Add generated path into joinrel by add_path(). */
+	add_path(joinrel, (Path *) joinpath);
+
+	/* Consider pathkeys for the join relation */
+	add_paths_with_pathkeys_for_rel(root, joinrel, epq_path,
+									extra->restrictlist);
+
+	/* XXX Consider parameterized paths for the join relation */
+}
+
+/*
+ * InstallJoinPathlistHookForPgFdwPlus
+ *		Install the join pathlist hook used by key-set semi-joins.
+ */
+void
+InstallJoinPathlistHookForPgFdwPlus(void)
+{
+	prev_set_join_pathlist_hook = set_join_pathlist_hook;
+	set_join_pathlist_hook = postgresSetJoinPathlist;
+}
+
+/*
+ * InstallRelationInfoHookForPgFdwPlus
+ *		Install the hook that adds the imported remote indexes of foreign
+ *		tables to the planner's information.
+ */
+void
+InstallRelationInfoHookForPgFdwPlus(void)
+{
+	prev_get_relation_info_hook = get_relation_info_hook;
+	get_relation_info_hook = postgresGetRelationInfo;
+}
+
+/*
+ * InstallPlannerHookForPgFdwPlus
+ *		Install the hook that resets the planning budget for remote estimates
+ *		for each query.
+ */
+void
+InstallPlannerHookForPgFdwPlus(void)
+{
+	prev_planner_hook = planner_hook;
+	planner_hook = postgresPlanner;
+}
+
+/*
+ * postgresPlanner
+ *		Plan a query with a fresh planning budget for remote estimates.
+ */
+static PlannedStmt *
+postgresPlanner(Query *parse, const char *query_string, int cursorOptions,
+				ParamListInfo boundParams)
+{
+	int			save_issued = remote_estimates_issued;
+	int			save_skipped = remote_estimates_skipped;
+	instr_time	save_time = remote_estimates_time;
+	PlannedStmt *volatile result = NULL;
+
+	remote_estimates_issued = 0;
+	remote_estimates_skipped = 0;
+	INSTR_TIME_SET_ZERO(remote_estimates_time);
+
+	PG_TRY();
+	{
+		if (prev_planner_hook)
+			result = prev_planner_hook(parse, query_string, cursorOptions,
+									   boundParams);
+		else
+			result = standard_planner(parse, query_string, cursorOptions,
+									  boundParams);
+	}
+	PG_FINALLY();
+	{
+		/*
+		 * Restore the budget of the outer query, if we're planning nested,
+		 * even if planning fails, as the error might be caught by the outer
+		 * query, e.g., in a PL/pgSQL exception block.
+		 */
+		remote_estimates_issued = save_issued;
+		remote_estimates_skipped = save_skipped;
+		remote_estimates_time = save_time;
+	}
+	PG_END_TRY();
+
+	return result;
+}
+
+/*
+ * postgresGetRelationInfo
+ *		Add the remote indexes imported by pgfdw_plus_import_remote_indexes()
+ *		to the index list of a foreign table of ours.
+ *
+ * This must be done here, rather than in postgresGetForeignRelSize, as
+ * the planner checks the uniqueness of relations for join removal before
+ * estimating their sizes.
+ */
+static void
+postgresGetRelationInfo(PlannerInfo *root,
+						Oid relationObjectId,
+						bool inhparent,
+						RelOptInfo *rel)
+{
+	if (prev_get_relation_info_hook)
+		prev_get_relation_info_hook(root, relationObjectId, inhparent, rel);
+
+	if (!inhparent && rel->fdwroutine &&
+		rel->fdwroutine->GetForeignRelSize == postgresGetForeignRelSize)
+		rel->indexlist = list_concat(rel->indexlist,
+									 pgfdw_get_remote_indexes(rel,
+															  relationObjectId));
+}
+
+/*
+ * remote_index_provides_pathkeys
+ *		Check whether a scan of one of the remote indexes of the given
+ *		relation would produce rows sorted by the given pathkeys.
+ */
+static bool
+remote_index_provides_pathkeys(PlannerInfo *root, RelOptInfo *rel,
+							   List *pathkeys)
+{
+	ListCell   *lc;
+
+	foreach(lc, rel->indexlist)
+	{
+		IndexOptInfo *index = (IndexOptInfo *) lfirst(lc);
+
+		if (pathkeys_contained_in(pathkeys,
+								  build_index_pathkeys(root, index,
+													   ForwardScanDirection)) ||
+			pathkeys_contained_in(pathkeys,
+								  build_index_pathkeys(root, index,
+													   BackwardScanDirection)))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * join_clause_matches_remote_index
+ *		Check whether the given join clause could be used by the remote server
+ *		to look up rows of the given base relation using one of its remote
+ *		indexes.
+ *
+ * Only mergejoinable clauses comparing the leading column of an index are
+ * accepted, which is enough for the typical parameterized foreign scan
+ * on the inner side of a nested loop.
+ */
+static bool
+join_clause_matches_remote_index(RelOptInfo *baserel, RestrictInfo *rinfo)
+{
+	Node	   *operand;
+	ListCell   *lc;
+
+	if (!is_opclause(rinfo->clause) || rinfo->mergeopfamilies == NIL)
+		return false;
+
+	if (bms_equal(rinfo->left_relids, baserel->relids))
+		operand = get_leftop(rinfo->clause);
+	else if (bms_equal(rinfo->right_relids, baserel->relids))
+		operand = get_rightop(rinfo->clause);
+	else
+		return false;
+
+	foreach(lc, baserel->indexlist)
+	{
+		IndexOptInfo *index = (IndexOptInfo *) lfirst(lc);
+
+		if (list_member_oid(rinfo->mergeopfamilies, index->opfamily[0]) &&
+			match_index_to_operand(operand, 0, index))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * postgresSetJoinPathlist
+ *		Add key-set semi-join paths for joins between a foreign table and
+ *		local relations.
+ *
+ * Unlike postgresGetForeignJoinPaths, this is called for every join
+ * relation, not only for joins between foreign tables on the same server.
+ */
+static void
+postgresSetJoinPathlist(PlannerInfo *root,
+						RelOptInfo *joinrel,
+						RelOptInfo *outerrel,
+						RelOptInfo *innerrel,
+						JoinType jointype,
+						JoinPathExtraData *extra)
+{
+	if (prev_set_join_pathlist_hook)
+		prev_set_join_pathlist_hook(root, joinrel, outerrel, innerrel,
+									jointype, extra);
+
+	if (pgfdw_keyset_join_max_keys > 0 || pgfdw_keyset_join_staging)
+		add_foreign_keyset_join_path(root, joinrel, outerrel, innerrel,
+									 jointype, extra);
+}
+
+/*
+ * add_foreign_keyset_join_path
+ *		Add hash join paths whose outer side is a scan of the foreign table
+ *		outerrel restricted to the join keys produced by innerrel.
+ *
+ * The foreign scan first runs the cheapest local plan for innerrel (as its
+ * fdw_outerpath), collects the distinct join keys it produces, and ships
+ * them to the remote server as an array parameter of a condition like
+ *
+ *		(($1 IS NULL) OR (remote_key = ANY ($1)))
+ *
+ * so that only the remote rows that can possibly join are transferred.  If
+ * there turn out to be more keys than postgres_fdw.keyset_join_max_keys at
+ * execution time, the parameter is sent as NULL, and the keys are instead
+ * shipped as a Bloom filter probed by a second condition
+ *
+ *		(($2 IS NULL) OR pgfdw_plus_bloom_match($2, remote_key))
+ *
+ * if that's possible (see make_bloom_filter_clause); otherwise the scan is
+ * unfiltered.
+ *
+ * If postgres_fdw.keyset_join_staging is on, we also consider staging all
+ * the keys in a remote temporary table (see stage_keyset_values) and
+ * filtering by
+ *
+ *		(remote_key = ANY (SELECT k::keytype FROM pg_temp.pgfdw_plus_keysets
+ *						   WHERE setid = $1))
+ *
+ * which filters exactly whatever the number of keys is, at the price of
+ * extra round trips and of uploading the keys.  add_path() keeps whichever
+ * is cheaper.  Either way the hash join above applies the actual join
+ * condition, so these conditions never need to be rechecked locally.
+ */
+static void
+add_foreign_keyset_join_path(PlannerInfo *root,
+							 RelOptInfo *joinrel,
+							 RelOptInfo *outerrel,
+							 RelOptInfo *innerrel,
+							 JoinType jointype,
+							 JoinPathExtraData *extra)
+{
+	Path	   *foreign_path;
+	Path	   *local_path;
+	List	   *hashclauses = NIL;
+	RestrictInfo *keyrinfo = NULL;
+	OpExpr	   *opexpr;
+	Expr	   *foreign_key;
+	Expr	   *local_key;
+	Oid			opno;
+	Oid			arraytype;
+	Param	   *param;
+	NullTest   *nulltest;
+	ScalarArrayOpExpr *saop;
+	Expr	   *keyset_clause;
+	Expr	   *bloom_clause;
+	double		nkeys;
+	double		ndistinct;
+	Selectivity frac;
+	ListCell   *lc;
+
+	/*
+	 * We only handle inner joins and semi-joins whose outer side is a plain
+	 * postgres_fdw foreign table.
+	 */
+	if (jointype != JOIN_INNER && jointype != JOIN_SEMI)
+		return;
+	if (outerrel->reloptkind != RELOPT_BASEREL ||
+		outerrel->fdwroutine == NULL ||
+		outerrel->fdwroutine->GetForeignPaths != postgresGetForeignPaths)
+		return;
+	if (!enable_hashjoin)
+		return;
+
+	/*
+	 * Running the local plan inside the foreign scan doesn't mix well with
+	 * EvalPlanQual rechecks or lateral references, so skip those cases.
+	 */
+	if (root->parse->commandType != CMD_SELECT || root->rowMarks)
+		return;
+	if (!bms_is_empty(joinrel->lateral_relids) ||
+		!bms_is_empty(outerrel->lateral_relids) ||
+		!bms_is_empty(innerrel->lateral_relids))
+		return;
+
+	/*
+	 * The local plan runs twice, once to collect the keys and once more
+	 * under the hash join, so both runs must produce the same rows.
+	 */
+	if (keyset_local_rel_is_volatile(root, innerrel))
+		return;
+
+	foreign_path = outerrel->cheapest_total_path;
+	local_path = innerrel->cheapest_total_path;
+	if (foreign_path == NULL || !IsA(foreign_path, ForeignPath) ||
+		foreign_path->param_info != NULL ||
+		local_path == NULL || local_path->param_info != NULL)
+		return;
+
+	/*
+	 * Collect the hashable join clauses.  The first one whose local side
+	 * can be shipped as an array of values is used as the key.
+	 */
+	foreach(lc, extra->restrictlist)
+	{
+		RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+		if (!rinfo->can_join || !OidIsValid(rinfo->hashjoinoperator))
+			continue;
+
+		if (bms_is_subset(rinfo->left_relids, outerrel->relids) &&
+			bms_is_subset(rinfo->right_relids, innerrel->relids))
+			rinfo->outer_is_left = true;
+		else if (bms_is_subset(rinfo->left_relids, innerrel->relids) &&
+				 bms_is_subset(rinfo->right_relids, outerrel->relids))
+			rinfo->outer_is_left = false;
+		else
+			continue;
+
+		hashclauses = lappend(hashclauses, rinfo);
+		if (keyrinfo == NULL)
+			keyrinfo = rinfo;
+	}
+	if (keyrinfo == NULL)
+		return;
+
+	opexpr = (OpExpr *) keyrinfo->clause;
+	Assert(IsA(opexpr, OpExpr) && list_length(opexpr->args) == 2);
+	if (keyrinfo->outer_is_left)
+	{
+		foreign_key = (Expr *) linitial(opexpr->args);
+		local_key = (Expr *) lsecond(opexpr->args);
+		opno = opexpr->opno;
+	}
+	else
+	{
+		foreign_key = (Expr *) lsecond(opexpr->args);
+		local_key = (Expr *) linitial(opexpr->args);
+		opno = get_commutator(opexpr->opno);
+		if (!OidIsValid(opno))
+			return;
+	}
+
+	/*
+	 * The local keys are sorted to remove duplicates, so we need an array
+	 * type and a sort operator for them.
+	 */
+	if (contain_volatile_functions((Node *) local_key))
+		return;
+	arraytype = get_array_type(exprType((Node *) local_key));
+	if (!OidIsValid(arraytype))
+		return;
+	if (!OidIsValid(lookup_type_cache(exprType((Node *) local_key),
+									  TYPECACHE_LT_OPR)->lt_opr))
+		return;
+
+	/*
+	 * Estimate the fraction of the remote rows matching the keys: each key
+	 * matches its share of the distinct remote keys.
+	 */
+	nkeys = estimate_num_groups(root, list_make1(local_key),
+								local_path->rows, NULL, NULL);
+	ndistinct = estimate_num_groups(root, list_make1(foreign_key),
+									foreign_path->rows, NULL, NULL);
+	frac = Min(1.0, nkeys / ndistinct);
+
+	/*
+	 * Build the key-set condition.  The Param is only a placeholder for
+	 * deparsing; postgresGetForeignPlan replaces it with a null constant,
+	 * whose value the executor overwrites with the collected keys.
+	 */
+	param = makeNode(Param);
+	param->paramkind = PARAM_EXEC;
+	param->paramid = KEYSET_PLACEHOLDER_PARAMID;
+	param->paramtype = arraytype;
+	param->paramtypmod = -1;
+	param->paramcollid = exprCollation((Node *) local_key);
+	param->location = -1;
+
+	nulltest = makeNode(NullTest);
+	nulltest->arg = (Expr *) param;
+	nulltest->nulltesttype = IS_NULL;
+	nulltest->argisrow = false;
+	nulltest->location = -1;
+
+	saop = makeNode(ScalarArrayOpExpr);
+	saop->opno = opno;
+	saop->opfuncid = get_opcode(opno);
+	saop->hashfuncid = InvalidOid;
+	saop->negfuncid = InvalidOid;
+	saop->useOr = true;
+	saop->inputcollid = opexpr->inputcollid;
+	saop->args = list_make2(copyObject(foreign_key), param);
+	saop->location = -1;
+
+	keyset_clause = make_orclause(list_make2(nulltest, saop));
+	if (!is_foreign_expr(root, outerrel, keyset_clause))
+		return;
+	bloom_clause = make_bloom_filter_clause(root, outerrel,
+											foreign_key, local_key);
+
+	if (pgfdw_keyset_join_max_keys > 0)
+	{
+		Selectivity keyset_frac = frac;
+
+		/*
+		 * If we expect more keys than can be shipped as an array, the false
+		 * positives of the Bloom filter pass as well, and we give up if
+		 * there's no Bloom filter.
+		 */
+		if (nkeys <= pgfdw_keyset_join_max_keys || bloom_clause != NULL)
+		{
+			if (nkeys > pgfdw_keyset_join_max_keys)
+				keyset_frac += (1.0 - keyset_frac) *
+					pgfdw_bloom_filter_false_positive_rate(nkeys);
+
+			add_keyset_hashjoin_path(root, joinrel, outerrel, jointype, extra,
+									 hashclauses, local_path, keyset_frac, 0.0,
+									 list_make5(makeBoolean(false),
+												makeBoolean(false),
+												keyset_clause,
+												local_key,
+												bloom_clause));
+		}
+	}
+
+	/*
+	 * Build the staged key-set condition.  Its Param is deparsed as a
+	 * sub-SELECT from the remote temporary table, with the ID of the key set
+	 * as the parameter (see deparseParam).  The conditions built above are
+	 * kept as well, for use when the keys can't be staged at execution time
+	 * (see keyset_staging_allowed).
+	 */
+	if (pgfdw_keyset_join_staging)
+	{
+		PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) outerrel->fdw_private;
+		ScalarArrayOpExpr *staged_clause;
+		Cost		staging_cost;
+
+		param = copyObject(param);
+		param->paramid = STAGED_KEYSET_PLACEHOLDER_PARAMID;
+
+		staged_clause = copyObject(saop);
+		lsecond(staged_clause->args) = param;
+
+		if (!is_foreign_expr(root, outerrel, (Expr *) staged_clause))
+			return;
+
+		/*
+		 * Staging costs a few more round trips, and transferring the keys
+		 * costs about as much as transferring as many result rows.
+		 */
+		staging_cost = fpinfo->fdw_startup_cost +
+			nkeys * fpinfo->fdw_tuple_cost;
+
+		add_keyset_hashjoin_path(root, joinrel, outerrel, jointype, extra,
+								 hashclauses, local_path, frac, staging_cost,
+								 lappend(list_make5(makeBoolean(false),
+													makeBoolean(false),
+													keyset_clause,
+													local_key,
+													bloom_clause),
+										 staged_clause));
+	}
+}
+
+/*
+ * keyset_local_rel_is_volatile
+ *		Might the rows produced by a local plan for rel differ from one run to
+ *		the next, because of volatile functions or set-returning functions?
+ *
+ * We look at the conditions and target list of rel and of each base relation
+ * it contains, and at the subqueries, functions and VALUES lists those scan.
+ */
+static bool
+keyset_local_rel_is_volatile(PlannerInfo *root, RelOptInfo *rel)
+{
+	int			relid;
+
+	if (contain_volatile_functions((Node *) rel->baserestrictinfo) ||
+		contain_volatile_functions((Node *) rel->joininfo) ||
+		contain_volatile_functions((Node *) rel->reltarget->exprs) ||
+		expression_returns_set((Node *) rel->reltarget->exprs))
+		return true;
+
+	relid = -1;
+	while ((relid = bms_next_member(rel->relids, relid)) >= 0)
+	{
+		RelOptInfo *baserel;
+		RangeTblEntry *rte;
+
+		/* Skip outer-join relids, which have no RelOptInfo */
+		if (relid >= root->simple_rel_array_size ||
+			root->simple_rel_array[relid] == NULL)
+			continue;
+		baserel = root->simple_rel_array[relid];
+		if (baserel != rel &&
+			(contain_volatile_functions((Node *) baserel->baserestrictinfo) ||
+			 contain_volatile_functions((Node *) baserel->joininfo) ||
+			 contain_volatile_functions((Node *) baserel->reltarget->exprs) ||
+			 expression_returns_set((Node *) baserel->reltarget->exprs)))
+			return true;
+
+		rte = root->simple_rte_array[relid];
+		switch (rte->rtekind)
+		{
+			case RTE_SUBQUERY:
+				if (contain_volatile_functions((Node *) rte->subquery) ||
+					rte->subquery->hasTargetSRFs)
+					return true;
+				break;
+			case RTE_FUNCTION:
+				if (contain_volatile_functions((Node *) rte->functions))
+					return true;
+				break;
+			case RTE_VALUES:
+				if (contain_volatile_functions((Node *) rte->values_lists))
+					return true;
+				break;
+			default:
+				break;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * add_keyset_hashjoin_path
+ *		Add a hash join path for a key-set semi-join, given the fdw_private
+ *		list of the foreign scan path, the estimated fraction of remote rows
+ *		passing its key-set condition, and the extra cost of shipping the keys.
+ */
+static void
+add_keyset_hashjoin_path(PlannerInfo *root,
+						 RelOptInfo *joinrel,
+						 RelOptInfo *outerrel,
+						 JoinType jointype,
+						 JoinPathExtraData *extra,
+						 List *hashclauses,
+						 Path *local_path,
+						 Selectivity filter_sel,
+						 Cost shipping_cost,
+						 List *fdw_private)
+{
+	PgFdwPathExtraData *fpextra;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	Path		sort_path;		/* dummy for result of cost_sort */
+	ForeignPath *keyset_path;
+	JoinCostWorkspace workspace;
+
+	/* Estimate the cost of the filtered foreign scan */
+	fpextra = (PgFdwPathExtraData *) palloc0(sizeof(PgFdwPathExtraData));
+	fpextra->target = outerrel->reltarget;
+	fpextra->filter_sel = filter_sel;
+	estimate_path_cost_size(root, outerrel, NIL, NIL, fpextra,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/*
+	 * The local plan, the sort of its keys and their shipping have to be
+	 * done before the remote query can be sent.
+	 */
+	cost_sort(&sort_path, root, NIL, 0.0, local_path->rows,
+			  local_path->pathtarget->width, 0.0, work_mem, -1.0);
+	startup_cost += local_path->total_cost + sort_path.total_cost +
+		shipping_cost;
+	total_cost += local_path->total_cost + sort_path.total_cost +
+		shipping_cost;
+
+	keyset_path = create_foreignscan_path(root, outerrel,
+										  NULL, /* default pathtarget */
+										  rows,
+										  startup_cost,
+										  total_cost,
+										  NIL,	/* no pathkeys */
+										  NULL, /* no outer rel either */
+										  local_path,
+										  NIL,	/* no fdw_restrictinfo list */
+										  fdw_private);
+	keyset_path->path.parallel_safe = false;
+
+	/* Hash the local relation and probe it with the filtered scan */
+	initial_cost_hashjoin(root, &workspace, jointype, hashclauses,
+						  (Path *) keyset_path, local_path, extra, false);
+	if (!add_path_precheck(joinrel, workspace.startup_cost,
+						   workspace.total_cost, NIL, NULL))
+		return;
+
+	add_path(joinrel, (Path *)
+			 create_hashjoin_path(root,
+								  joinrel,
+								  jointype,
+								  &workspace,
+								  extra,
+								  (Path *) keyset_path,
+								  local_path,
+								  false,	/* parallel_hash */
+								  extra->restrictlist,
+								  NULL, /* no required_outer */
+								  hashclauses));
+}
+
+/*
+ * make_bloom_filter_clause
+ *		Build the Bloom filter condition of a key-set semi-join, if possible.
+ *
+ * This requires pgfdw_plus_bloom_match() to be shippable, that is, the
+ * postgres_fdw_plus extension must be listed in the server's "extensions"
+ * option.  Also, since both servers hash the keys, the local and remote keys
+ * must be of the same type and must not use a nondefault collation.
+ */
+static Expr *
+make_bloom_filter_clause(PlannerInfo *root, RelOptInfo *baserel,
+						 Expr *foreign_key, Expr *local_key)
+{
+	Oid			keytype = exprType((Node *) foreign_key);
+	Oid			keycollid = exprCollation((Node *) foreign_key);
+	Oid			extoid;
+	char	   *nspname;
+	Oid			funcargtypes[2] = {BYTEAOID, ANYELEMENTOID};
+	Oid			funcid;
+	Param	   *param;
+	NullTest   *nulltest;
+	FuncExpr   *funcexpr;
+	Expr	   *clause;
+
+	if (pgfdw_bloom_filter_max_size <= 0)
+		return NULL;
+
+	if (exprType((Node *) local_key) != keytype ||
+		exprCollation((Node *) local_key) != keycollid ||
+		(OidIsValid(keycollid) && keycollid != DEFAULT_COLLATION_OID))
+		return NULL;
+	if (!OidIsValid(lookup_type_cache(keytype,
+									  TYPECACHE_HASH_EXTENDED_PROC)->hash_extended_proc))
+		return NULL;
+
+	/* Look up the probe function in the extension's schema */
+	extoid = get_extension_oid("postgres_fdw_plus", true);
+	if (!OidIsValid(extoid))
+		return NULL;
+	nspname = get_namespace_name(get_extension_schema(extoid));
+	funcid = LookupFuncName(list_make2(makeString(nspname),
+									   makeString("pgfdw_plus_bloom_match")),
+							2, funcargtypes, true);
+	if (!OidIsValid(funcid))
+		return NULL;
+
+	param = makeNode(Param);
+	param->paramkind = PARAM_EXEC;
+	param->paramid = BLOOM_PLACEHOLDER_PARAMID;
+	param->paramtype = BYTEAOID;
+	param->paramtypmod = -1;
+	param->paramcollid = InvalidOid;
+	param->location = -1;
+
+	nulltest = makeNode(NullTest);
+	nulltest->arg = (Expr *) param;
+	nulltest->nulltesttype = IS_NULL;
+	nulltest->argisrow = false;
+	nulltest->location = -1;
+
+	funcexpr = makeFuncExpr(funcid, BOOLOID,
+							list_make2(param, copyObject(foreign_key)),
+							InvalidOid, keycollid, COERCE_EXPLICIT_CALL);
+
+	clause = make_orclause(list_make2(nulltest, funcexpr));
+	if (!is_foreign_expr(root, baserel, clause))
+		return NULL;
+
+	return clause;
+}
+
+/*
+ * Assess whether the aggregation, grouping and having operations can be pushed
+ * down to the foreign server.  As a side effect, save information we obtain in
+ * this function to PgFdwRelationInfo of the input relation.
+ */
+static bool
+foreign_grouping_ok(PlannerInfo *root, RelOptInfo *grouped_rel,
+					Node *havingQual)
+{
+	Query	   *query = root->parse;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) grouped_rel->fdw_private;
+	PathTarget *grouping_target = grouped_rel->reltarget;
+	PgFdwRelationInfo *ofpinfo;
+	ListCell   *lc;
+	int			i;
+	List	   *tlist = NIL;
+
+	/* Get the fpinfo of the underlying scan relation. */
+	ofpinfo = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+	/*
+	 * If underlying scan relation has any local conditions, those conditions
+	 * are required to be applied before performing aggregation.  Hence the
+	 * aggregate cannot be pushed down.
+	 */
+	if (ofpinfo->local_conds)
+		return false;
+
+	/*
+	 * Examine grouping expressions, as well as other expressions we'd need to
+	 * compute, and check whether they are safe to push down to the foreign
+	 * server.  All GROUP BY expressions will be part of the grouping target
+	 * and thus there is no need to search for them separately.  Add grouping
+	 * expressions into target list which will be passed to foreign server.
+	 *
+	 * A tricky fine point is that we must not put any expression into the
+	 * target list that is just a foreign param (that is, something that
+	 * deparse.c would conclude has to be sent to the foreign server).  If we
+	 * do, the expression will also appear in the fdw_exprs list of the plan
+	 * node, and setrefs.c will get confused and decide that the fdw_exprs
+	 * entry is actually a reference to the fdw_scan_tlist entry, resulting in
+	 * a broken plan.  Somewhat oddly, it's OK if the expression contains such
+	 * a node, as long as it's not at top level; then no match is possible.
+	 */
+	i = 0;
+	foreach(lc, grouping_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		Index		sgref = get_pathtarget_sortgroupref(grouping_target, i);
+		ListCell   *l;
+
+		/*
+		 * Check whether this expression is part of GROUP BY clause.  Note we
+		 * check the whole GROUP BY clause not just processed_groupClause,
+		 * because we will ship all of it, cf. appendGroupByClause.
+		 */
+		if (sgref && get_sortgroupref_clause_noerr(sgref, query->groupClause))
+		{
+			TargetEntry *tle;
+
+			/*
+			 * If any GROUP BY expression is not shippable, then we cannot
+			 * push down aggregation to the foreign server.
+			 */
+			if (!is_foreign_expr(root, grouped_rel, expr))
+				return false;
+
+			/*
+			 * If it would be a foreign param, we can't put it into the tlist,
+			 * so we have to fail.
+			 */
+			if (is_foreign_param(root, grouped_rel, expr))
+				return false;
+
+			/*
+			 * Pushable, so add to tlist.  We need to create a TLE for this
+			 * expression and apply the sortgroupref to it.  We cannot use
+			 * add_to_flat_tlist() here because that avoids making duplicate
+			 * entries in the tlist.  If there are duplicate entries with
+			 * distinct sortgrouprefs, we have to duplicate that situation in
+			 * the output tlist.
+			 */
+			tle = makeTargetEntry(expr, list_length(tlist) + 1, NULL, false);
+			tle->ressortgroupref = sgref;
+			tlist = lappend(tlist, tle);
+		}
+		else
+		{
+			/*
+			 * Non-grouping expression we need to compute.  Can we ship it
+			 * as-is to the foreign server?
+			 */
+			if (is_foreign_expr(root, grouped_rel, expr) &&
+				!is_foreign_param(root, grouped_rel, expr))
+			{
+				/* Yes, so add to tlist as-is; OK to suppress duplicates */
+				tlist = add_to_flat_tlist(tlist, list_make1(expr));
+			}
+			else
+			{
+				/* Not pushable as a whole; extract its Vars and aggregates */
+				List	   *aggvars;
+
+				aggvars = pull_var_clause((Node *) expr,
+										  PVC_INCLUDE_AGGREGATES);
+
+				/*
+				 * If any aggregate expression is not shippable, then we
+				 * cannot push down aggregation to the foreign server.  (We
+				 * don't have to check is_foreign_param, since that certainly
+				 * won't return true for any such expression.)
+				 */
+				if (!is_foreign_expr(root, grouped_rel, (Expr *) aggvars))
+					return false;
+
+				/*
+				 * Add aggregates and GROUPING() calls, if any, into the
+				 * targetlist.  Plain Vars outside an aggregate can be
+				 * ignored, because they should be either same as some GROUP
+				 * BY column or part of some GROUP BY expression.  In either
+				 * case, they are already part of the targetlist and thus no
+				 * need to add them again.  In fact including plain Vars in
+				 * the tlist when they do not match a GROUP BY column would
+				 * cause the foreign server to complain that the shipped query
+				 * is invalid.
+				 */
+				foreach(l, aggvars)
+				{
+					Expr	   *aggref = (Expr *) lfirst(l);
+
+					if (IsA(aggref, Aggref) || IsA(aggref, GroupingFunc))
+						tlist = add_to_flat_tlist(tlist, list_make1(aggref));
+				}
+			}
+		}
+
+		i++;
+	}
+
+	/*
+	 * Classify the pushable and non-pushable HAVING clauses and save them in
+	 * remote_conds and local_conds of the grouped rel's fpinfo.
+	 */
+	if (havingQual)
+	{
+		foreach(lc, (List *) havingQual)
+		{
+			Expr	   *expr = (Expr *) lfirst(lc);
+			RestrictInfo *rinfo;
+
+			/*
+			 * Currently, the core code doesn't wrap havingQuals in
+			 * RestrictInfos, so we must make our own.
+			 */
+			Assert(!IsA(expr, RestrictInfo));
+			rinfo = make_restrictinfo(root,
+									  expr,
+									  true,
+									  false,
+									  false,
+									  false,
+									  root->qual_security_level,
+									  grouped_rel->relids,
+									  NULL,
+									  NULL);
+			if (is_foreign_expr(root, grouped_rel, expr))
+				fpinfo->remote_conds = lappend(fpinfo->remote_conds, rinfo);
+			else
+				fpinfo->local_conds = lappend(fpinfo->local_conds, rinfo);
+		}
+	}
+
+	/*
+	 * If there are any local conditions, pull Vars and aggregates from it and
+	 * check whether they are safe to pushdown or not.
+	 */
+	if (fpinfo->local_conds)
+	{
+		List	   *aggvars = NIL;
+
+		foreach(lc, fpinfo->local_conds)
+		{
+			RestrictInfo *rinfo = lfirst_node(RestrictInfo, lc);
+
+			aggvars = list_concat(aggvars,
+								  pull_var_clause((Node *) rinfo->clause,
+												  PVC_INCLUDE_AGGREGATES));
+		}
+
+		foreach(lc, aggvars)
+		{
+			Expr	   *expr = (Expr *) lfirst(lc);
+
+			/*
+			 * If aggregates within local conditions are not safe to push
+			 * down, then we cannot push down the query.  Vars are already
+			 * part of GROUP BY clause which are checked above, so no need to
+			 * access them again here.  Again, we need not check
+			 * is_foreign_param for a foreign aggregate.  GROUPING() calls
+			 * are handled the same way as aggregates.
+			 */
+			if (IsA(expr, Aggref) || IsA(expr, GroupingFunc))
+			{
+				if (!is_foreign_expr(root, grouped_rel, expr))
+					return false;
+
+				tlist = add_to_flat_tlist(tlist, list_make1(expr));
+			}
+		}
+	}
+
+	/* Store generated targetlist */
+	fpinfo->grouped_tlist = tlist;
+
+	/* Safe to pushdown */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Set # of retrieved rows and cached relation costs to some negative
+	 * value, so that we can detect when they are set to some sensible values,
+	 * during one (usually the first) of the calls to estimate_path_cost_size.
+	 */
+	fpinfo->retrieved_rows = -1;
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this grouped relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.  Note that the decoration we add
+	 * to the base relation name mustn't include any digits, or it'll confuse
+	 * postgresExplainForeignScan.
+	 */
+	if (fpinfo->stage == UPPERREL_PARTIAL_GROUP_AGG)
+		fpinfo->relation_name = psprintf("Partial Aggregate on (%s)",
+										 ofpinfo->relation_name);
+	else
+		fpinfo->relation_name = psprintf("Aggregate on (%s)",
+										 ofpinfo->relation_name);
+
+	return true;
+}
+
+/*
+ * Assess whether the window functions computed by the given window relation
+ * can be pushed down to the foreign server.  As a side effect, save the
+ * targetlist to be sent to the foreign server in the window relation's
+ * PgFdwRelationInfo.
+ *
+ * We only support window functions evaluated directly over a base or join
+ * relation; windows over grouped relations would need the grouping step to
+ * be deparsed as a subquery, which we don't do yet.
+ */
+static bool
+foreign_window_ok(PlannerInfo *root, RelOptInfo *window_rel)
+{
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) window_rel->fdw_private;
+	PathTarget *window_target = window_rel->reltarget;
+	PgFdwRelationInfo *ofpinfo;
+	ListCell   *lc;
+	List	   *tlist = NIL;
+
+	/* Get the fpinfo of the underlying scan relation. */
+	ofpinfo = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+	if (!IS_SIMPLE_REL(fpinfo->outerrel) && !IS_JOIN_REL(fpinfo->outerrel))
+		return false;
+
+	/*
+	 * If underlying scan relation has any local conditions, those conditions
+	 * are required to be applied before computing the window functions.
+	 */
+	if (ofpinfo->local_conds)
+		return false;
+
+	/*
+	 * Examine the expressions we'd need to compute, and check whether they
+	 * are safe to push down.  As in foreign_grouping_ok(), an expression that
+	 * is just a foreign param must not be put into the target list.
+	 */
+	foreach(lc, window_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+
+		if (is_foreign_expr(root, window_rel, expr) &&
+			!is_foreign_param(root, window_rel, expr))
+		{
+			/* Yes, so add to tlist as-is; OK to suppress duplicates */
+			tlist = add_to_flat_tlist(tlist, list_make1(expr));
+		}
+		else
+		{
+			/* Not pushable as a whole; extract its Vars and window functions */
+			List	   *wfuncvars;
+			ListCell   *l;
+
+			wfuncvars = pull_var_clause((Node *) expr,
+										PVC_INCLUDE_WINDOWFUNCS |
+										PVC_RECURSE_PLACEHOLDERS);
+
+			/*
+			 * If any window function is not shippable, then we cannot push
+			 * down the window functions to the foreign server.
+			 */
+			if (!is_foreign_expr(root, window_rel, (Expr *) wfuncvars))
+				return false;
+
+			/*
+			 * Unlike the grouping case, plain Vars are valid in the remote
+			 * query's SELECT list, so add them as well as window functions.
+			 */
+			foreach(l, wfuncvars)
+			{
+				Expr	   *wexpr = (Expr *) lfirst(l);
+
+				if (is_foreign_param(root, window_rel, wexpr))
+					return false;
+				tlist = add_to_flat_tlist(tlist, list_make1(wexpr));
+			}
+		}
+	}
+
+	/* Store generated targetlist */
+	fpinfo->grouped_tlist = tlist;
+
+	/* Safe to pushdown */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Set # of retrieved rows and cached relation costs to some negative
+	 * value, so that we can detect when they are set to some sensible values,
+	 * during one (usually the first) of the calls to estimate_path_cost_size.
+	 */
+	fpinfo->retrieved_rows = -1;
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this window relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.  As for grouped relations, the
+	 * decoration mustn't include any digits.
+	 */
+	fpinfo->relation_name = psprintf("WindowAgg on (%s)",
+									 ofpinfo->relation_name);
+
+	return true;
+}
+
+/*
+ * Assess whether the DISTINCT or DISTINCT ON clause of the query can be
+ * pushed down to the foreign server.  As a side effect, save the targetlist
+ * to be sent to the foreign server in the distinct relation's
+ * PgFdwRelationInfo.
+ *
+ * As with window functions, only a base or join relation is supported as
+ * the input of the duplicate elimination.
+ */
+static bool
+foreign_distinct_ok(PlannerInfo *root, RelOptInfo *distinct_rel)
+{
+	Query	   *query = root->parse;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) distinct_rel->fdw_private;
+	PathTarget *distinct_target = distinct_rel->reltarget;
+	PgFdwRelationInfo *ofpinfo;
+	ListCell   *lc;
+	int			i;
+	List	   *tlist = NIL;
+
+	/* Get the fpinfo of the underlying scan relation. */
+	ofpinfo = (PgFdwRelationInfo *) fpinfo->outerrel->fdw_private;
+
+	if (!IS_SIMPLE_REL(fpinfo->outerrel) && !IS_JOIN_REL(fpinfo->outerrel))
+		return false;
+
+	/*
+	 * If underlying scan relation has any local conditions, those conditions
+	 * are required to be applied before eliminating duplicates.
+	 */
+	if (ofpinfo->local_conds)
+		return false;
+
+	/*
+	 * Every expression we'd need to compute must be shippable as a whole, and
+	 * must not be a foreign param (see foreign_grouping_ok()).  For a plain
+	 * DISTINCT, the remote server eliminates duplicates over all the columns
+	 * of the remote SELECT list, so every one of them must be a DISTINCT
+	 * column as well.
+	 */
+	i = 0;
+	foreach(lc, distinct_target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc);
+		Index		sgref = get_pathtarget_sortgroupref(distinct_target, i);
+		TargetEntry *tle;
+
+		if (!is_foreign_expr(root, distinct_rel, expr) ||
+			is_foreign_param(root, distinct_rel, expr))
+			return false;
+
+		if (!query->hasDistinctOn &&
+			(!sgref ||
+			 !get_sortgroupref_clause_noerr(sgref, query->distinctClause)))
+			return false;
+
+		tle = makeTargetEntry(expr, list_length(tlist) + 1, NULL, false);
+		tle->ressortgroupref = sgref;
+		tlist = lappend(tlist, tle);
+
+		i++;
+	}
+
+	/*
+	 * For DISTINCT ON, which row of each group is returned depends on the
+	 * ORDER BY clause, so that has to be sent along with the DISTINCT ON.
+	 * It's deparsed from the query's sortClause rather than from the
+	 * pathkeys (see appendDistinctOnOrderByClause()), so its expressions must
+	 * be in the targetlist and its operators must be shippable as well.
+	 */
+	if (query->hasDistinctOn)
+	{
+		foreach(lc, root->sort_pathkeys)
+		{
+			PathKey    *pathkey = (PathKey *) lfirst(lc);
+
+			if (!is_foreign_pathkey(root, fpinfo->outerrel, pathkey))
+				return false;
+		}
+
+		foreach(lc, query->sortClause)
+		{
+			SortGroupClause *srt = (SortGroupClause *) lfirst(lc);
+			ListCell   *lc2;
+
+			if (!is_shippable(srt->sortop, OperatorRelationId, fpinfo))
+				return false;
+
+			foreach(lc2, tlist)
+			{
+				if (lfirst_node(TargetEntry, lc2)->ressortgroupref ==
+					srt->tleSortGroupRef)
+					break;
+			}
+			if (lc2 == NULL)
+				return false;
+		}
+	}
+
+	/* Store generated targetlist */
+	fpinfo->grouped_tlist = tlist;
+
+	/* Safe to pushdown */
+	fpinfo->pushdown_safe = true;
+
+	/*
+	 * Set # of retrieved rows and cached relation costs to some negative
+	 * value, so that we can detect when they are set to some sensible values,
+	 * during one (usually the first) of the calls to estimate_path_cost_size.
+	 */
+	fpinfo->retrieved_rows = -1;
+	fpinfo->rel_startup_cost = -1;
+	fpinfo->rel_total_cost = -1;
+
+	/*
+	 * Set the string describing this distinct relation to be used in EXPLAIN
+	 * output of corresponding ForeignScan.
+	 */
+	fpinfo->relation_name = psprintf("Unique on (%s)",
+									 ofpinfo->relation_name);
+
+	return true;
+}
+
+/*
+ * postgresGetForeignUpperPaths
+ *		Add paths for post-join operations like aggregation, grouping etc. if
+ *		corresponding operations are safe to push down.
+ */
+static void
+postgresGetForeignUpperPaths(PlannerInfo *root, UpperRelationKind stage,
+							 RelOptInfo *input_rel, RelOptInfo *output_rel,
+							 void *extra)
+{
+	PgFdwRelationInfo *fpinfo;
+
+	/*
+	 * If input rel is not safe to pushdown, then simply return as we cannot
+	 * perform any post-join operations on the foreign server.
+	 */
+	if (!input_rel->fdw_private ||
+		!((PgFdwRelationInfo *) input_rel->fdw_private)->pushdown_safe)
+		return;
+
+	/* Ignore stages we don't support; and skip any duplicate calls. */
+	if ((stage != UPPERREL_GROUP_AGG &&
+		 stage != UPPERREL_PARTIAL_GROUP_AGG &&
+		 stage != UPPERREL_WINDOW &&
+		 stage != UPPERREL_DISTINCT &&
+		 stage != UPPERREL_ORDERED &&
+		 stage != UPPERREL_FINAL) ||
+		output_rel->fdw_private)
+		return;
+
+	fpinfo = (PgFdwRelationInfo *) palloc0(sizeof(PgFdwRelationInfo));
+	fpinfo->pushdown_safe = false;
+	fpinfo->stage = stage;
+	output_rel->fdw_private = fpinfo;
+
+	switch (stage)
+	{
+		case UPPERREL_GROUP_AGG:
+		case UPPERREL_PARTIAL_GROUP_AGG:
+			add_foreign_grouping_paths(root, input_rel, output_rel,
+									   (GroupPathExtraData *) extra);
+			break;
+		case UPPERREL_WINDOW:
+			add_foreign_window_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_DISTINCT:
+			add_foreign_distinct_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_ORDERED:
+			add_foreign_ordered_paths(root, input_rel, output_rel);
+			break;
+		case UPPERREL_FINAL:
+			add_foreign_final_paths(root, input_rel, output_rel,
+									(FinalPathExtraData *) extra);
+			break;
+		default:
+			elog(ERROR, "unexpected upper relation: %d", (int) stage);
+			break;
+	}
+}
+
+/*
+ * add_foreign_grouping_paths
+ *		Add foreign path for grouping and/or aggregation.
+ *
+ * Given input_rel represents the underlying scan.  The paths are added to the
+ * given grouped_rel, which is either a fully grouped relation or, when
+ * partitionwise aggregation can only aggregate partially per partition, a
+ * partially grouped relation whose output is combined locally.
+ */
+static void
+add_foreign_grouping_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						   RelOptInfo *grouped_rel,
+						   GroupPathExtraData *extra)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = grouped_rel->fdw_private;
+	Node	   *havingQual = extra->havingQual;
+	ForeignPath *grouppath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* Nothing to be done, if there is no grouping or aggregation required. */
+	if (!parse->groupClause && !parse->groupingSets && !parse->hasAggs &&
+		!root->hasHavingQual)
+		return;
+
+	/*
+	 * The HAVING qual can only be checked once the partial aggregates are
+	 * combined, so it's not part of the partial aggregation step.
+	 */
+	if (fpinfo->stage == UPPERREL_PARTIAL_GROUP_AGG)
+		havingQual = NULL;
+	else
+		Assert(extra->patype == PARTITIONWISE_AGGREGATE_NONE ||
+			   extra->patype == PARTITIONWISE_AGGREGATE_FULL);
+
+	/* save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/*
+	 * Assess if it is safe to push down aggregation and grouping.
+	 *
+	 * Use HAVING qual from extra. In case of child partition, it will have
+	 * translated Vars.
+	 */
+	if (!foreign_grouping_ok(root, grouped_rel, havingQual))
+		return;
+
+	/*
+	 * Compute the selectivity and cost of the local_conds, so we don't have
+	 * to do it over again for each path.  (Currently we create just a single
+	 * path here, but in future it would be possible that we build more paths
+	 * such as pre-sorted paths as in postgresGetForeignPaths and
+	 * postgresGetForeignJoinPaths.)  The best we can do for these conditions
+	 * is to estimate selectivity on the basis of local statistics.
+	 */
+	fpinfo->local_conds_sel = clauselist_selectivity(root,
+													 fpinfo->local_conds,
+													 0,
+													 JOIN_INNER,
+													 NULL);
+
+	cost_qual_eval(&fpinfo->local_conds_cost, fpinfo->local_conds, root);
+
+	/* Estimate the cost of push down */
+	estimate_path_cost_size(root, grouped_rel, NIL, NIL, NULL,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/* Now update this information in the fpinfo */
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/* Create and add foreign path to the grouping relation. */
+	grouppath = create_foreign_upper_path(root,
+										  grouped_rel,
+										  grouped_rel->reltarget,
+										  rows,
+										  startup_cost,
+										  total_cost,
+										  NIL,	/* no pathkeys */
+										  NULL,
+										  NIL,	/* no fdw_restrictinfo list */
+										  NIL); /* no fdw_private */
+
+	/* Add generated path into grouped_rel by add_path(). */
+	add_path(grouped_rel, (Path *) grouppath);
+}
+
+/*
+ * add_foreign_window_paths
+ *		Add foreign path for computing window functions.
+ *
+ * Given input_rel represents the underlying scan or join.  The paths are
+ * added to the given window_rel.
+ */
+static void
+add_foreign_window_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						 RelOptInfo *window_rel)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = window_rel->fdw_private;
+	ForeignPath *windowpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* Shouldn't get here unless the query has window functions */
+	Assert(parse->hasWindowFuncs);
+
+	/* We don't support cases where there are any SRFs in the targetlist */
+	if (parse->hasTargetSRFs)
+		return;
+
+	/* save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/* Assess if it is safe to push down the window functions. */
+	if (!foreign_window_ok(root, window_rel))
+		return;
+
+	/* There are no local conditions to apply on top of the window rel. */
+	fpinfo->local_conds_sel = 1.0;
+
+	/* Estimate the cost of push down */
+	estimate_path_cost_size(root, window_rel, NIL, NIL, NULL,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/* Now update this information in the fpinfo */
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/* Create and add foreign path to the window relation. */
+	windowpath = create_foreign_upper_path(root,
+										   window_rel,
+										   window_rel->reltarget,
+										   rows,
+										   startup_cost,
+										   total_cost,
+										   NIL, /* no pathkeys */
+										   NULL,
+										   NIL, /* no fdw_restrictinfo list */
+										   NIL);	/* no fdw_private */
+
+	/* Add generated path into window_rel by add_path(). */
+	add_path(window_rel, (Path *) windowpath);
+}
+
+/*
+ * add_foreign_distinct_paths
+ *		Add foreign path for performing DISTINCT or DISTINCT ON remotely.
+ *
+ * Given input_rel represents the underlying scan or join.  The paths are
+ * added to the given distinct_rel.
+ */
+static void
+add_foreign_distinct_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						   RelOptInfo *distinct_rel)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = distinct_rel->fdw_private;
+	List	   *pathkeys = NIL;
+	ForeignPath *distinctpath;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+
+	/* Shouldn't get here unless the query has DISTINCT */
+	Assert(parse->distinctClause);
+
+	/* We don't support cases where there are any SRFs in the targetlist */
+	if (parse->hasTargetSRFs)
+		return;
+
+	/* save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/* Assess if it is safe to push down the duplicate elimination. */
+	if (!foreign_distinct_ok(root, distinct_rel))
+		return;
+
+	/* There are no local conditions to apply on top of the distinct rel. */
+	fpinfo->local_conds_sel = 1.0;
+
+	/* Estimate the cost of push down */
+	estimate_path_cost_size(root, distinct_rel, NIL, NIL, NULL,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/* Now update this information in the fpinfo */
+	fpinfo->rows = rows;
+	fpinfo->width = width;
+	fpinfo->startup_cost = startup_cost;
+	fpinfo->total_cost = total_cost;
+
+	/*
+	 * For DISTINCT ON, the remote query carries the query's ORDER BY clause
+	 * (see foreign_distinct_ok()), so the path is sorted by that; re-estimate
+	 * the cost of producing the sorted output.
+	 */
+	if (parse->hasDistinctOn && root->sort_pathkeys != NIL)
+	{
+		pathkeys = root->sort_pathkeys;
+		estimate_path_cost_size(root, distinct_rel, NIL, pathkeys, NULL,
+								&rows, &width, &startup_cost, &total_cost);
+	}
+
+	/* Create and add foreign path to the distinct relation. */
+	distinctpath = create_foreign_upper_path(root,
+											 distinct_rel,
+											 distinct_rel->reltarget,
+											 rows,
+											 startup_cost,
+											 total_cost,
+											 pathkeys,
+											 NULL,
+											 NIL,	/* no fdw_restrictinfo
+													 * list */
+											 NIL);	/* no fdw_private */
+
+	/* Add generated path into distinct_rel by add_path(). */
+	add_path(distinct_rel, (Path *) distinctpath);
+}
+
+/*
+ * add_foreign_ordered_paths
+ *		Add foreign paths for performing the final sort remotely.
+ *
+ * Given input_rel contains the source-data Paths.  The paths are added to the
+ * given ordered_rel.
+ */
+static void
+add_foreign_ordered_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						  RelOptInfo *ordered_rel)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = ordered_rel->fdw_private;
+	PgFdwPathExtraData *fpextra;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	List	   *fdw_private;
+	ForeignPath *ordered_path;
+	ListCell   *lc;
+
+	/* Shouldn't get here unless the query has ORDER BY */
+	Assert(parse->sortClause);
+
+	/* We don't support cases where there are any SRFs in the targetlist */
+	if (parse->hasTargetSRFs)
+		return;
+
+	/* Save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/*
+	 * If the input_rel is a base or join relation, we would already have
+	 * considered pushing down the final sort to the remote server when
+	 * creating pre-sorted foreign paths for that relation, because the
+	 * query_pathkeys is set to the root->sort_pathkeys in that case (see
+	 * standard_qp_callback()).
+	 */
+	if (input_rel->reloptkind == RELOPT_BASEREL ||
+		input_rel->reloptkind == RELOPT_JOINREL)
+	{
+		Assert(root->query_pathkeys == root->sort_pathkeys);
+
+		/* Safe to push down if the query_pathkeys is safe to push down */
+		fpinfo->pushdown_safe = ifpinfo->qp_is_pushdown_safe;
+
+		return;
+	}
+
+	/* The input_rel should be a grouping, window or distinct relation */
+	Assert(input_rel->reloptkind == RELOPT_UPPER_REL &&
+		   (ifpinfo->stage == UPPERREL_GROUP_AGG ||
+			ifpinfo->stage == UPPERREL_WINDOW ||
+			ifpinfo->stage == UPPERREL_DISTINCT));
+
+	/*
+	 * We try to create a path below by extending a simple foreign path for
+	 * the underlying grouping relation to perform the final sort remotely,
+	 * which is stored into the fdw_private list of the resulting path.
+	 */
+
+	/* Assess if it is safe to push down the final sort */
+	foreach(lc, root->sort_pathkeys)
+	{
+		PathKey    *pathkey = (PathKey *) lfirst(lc);
+		EquivalenceClass *pathkey_ec = pathkey->pk_eclass;
+
+		/*
+		 * is_foreign_expr would detect volatile expressions as well, but
+		 * checking ec_has_volatile here saves some cycles.
+		 */
+		if (pathkey_ec->ec_has_volatile)
+			return;
+
+		/*
+		 * Can't push down the sort if pathkey's opfamily is not shippable.
+		 */
+		if (!is_shippable(pathkey->pk_opfamily, OperatorFamilyRelationId,
+						  fpinfo))
+			return;
+
+		/*
+		 * The EC must contain a shippable EM that is computed in input_rel's
+		 * reltarget, else we can't push down the sort.
+		 */
+		if (find_em_for_rel_target(root,
+								   pathkey_ec,
+								   input_rel) == NULL)
+			return;
+	}
+
+	/* Safe to push down */
+	fpinfo->pushdown_safe = true;
+
+	/* Construct PgFdwPathExtraData */
+	fpextra = (PgFdwPathExtraData *) palloc0(sizeof(PgFdwPathExtraData));
+	fpextra->target = root->upper_targets[UPPERREL_ORDERED];
+	fpextra->has_final_sort = true;
+
+	/* Estimate the costs of performing the final sort remotely */
+	estimate_path_cost_size(root, input_rel, NIL, root->sort_pathkeys, fpextra,
+							&rows, &width, &startup_cost, &total_cost);
+
+	/*
+	 * Build the fdw_private list that will be used by postgresGetForeignPlan.
+	 * Items in the list must match order in enum FdwPathPrivateIndex.
+	 */
+	fdw_private = list_make2(makeBoolean(true), makeBoolean(false));
+
+	/* Create foreign ordering path */
+	ordered_path = create_foreign_upper_path(root,
+											 input_rel,
+											 root->upper_targets[UPPERREL_ORDERED],
+											 rows,
+											 startup_cost,
+											 total_cost,
+											 root->sort_pathkeys,
+											 NULL,	/* no extra plan */
+											 NIL,	/* no fdw_restrictinfo
+													 * list */
+											 fdw_private);
+
+	/* and add it to the ordered_rel */
+	add_path(ordered_rel, (Path *) ordered_path);
+}
+
+/*
+ * add_foreign_final_paths
+ *		Add foreign paths for performing the final processing remotely.
+ *
+ * Given input_rel contains the source-data Paths.  The paths are added to the
+ * given final_rel.
+ */
+static void
+add_foreign_final_paths(PlannerInfo *root, RelOptInfo *input_rel,
+						RelOptInfo *final_rel,
+						FinalPathExtraData *extra)
+{
+	Query	   *parse = root->parse;
+	PgFdwRelationInfo *ifpinfo = (PgFdwRelationInfo *) input_rel->fdw_private;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) final_rel->fdw_private;
+	bool		has_final_sort = false;
+	List	   *pathkeys = NIL;
+	PgFdwPathExtraData *fpextra;
+	bool		save_use_remote_estimate = false;
+	double		rows;
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+	List	   *fdw_private;
+	ForeignPath *final_path;
+
+	/*
+	 * Currently, we only support this for SELECT commands
+	 */
+	if (parse->commandType != CMD_SELECT)
+		return;
+
+	/*
+	 * No work if there is no FOR UPDATE/SHARE clause and if there is no need
+	 * to add a LIMIT node
+	 */
+	if (!parse->rowMarks && !extra->limit_needed)
+		return;
+
+	/* We don't support cases where there are any SRFs in the targetlist */
+	if (parse->hasTargetSRFs)
+		return;
+
+	/* Save the input_rel as outerrel in fpinfo */
+	fpinfo->outerrel = input_rel;
+
+	/*
+	 * Copy foreign table, foreign server, user mapping, FDW options etc.
+	 * details from the input relation's fpinfo.
+	 */
+	fpinfo->table = ifpinfo->table;
+	fpinfo->server = ifpinfo->server;
+	fpinfo->user = ifpinfo->user;
+	merge_fdw_options(fpinfo, ifpinfo, NULL);
+
+	/*
+	 * If there is no need to add a LIMIT node, there might be a ForeignPath
+	 * in the input_rel's pathlist that implements all behavior of the query.
+	 * Note: we would already have accounted for the query's FOR UPDATE/SHARE
+	 * (if any) before we get here.
+	 */
+	if (!extra->limit_needed)
+	{
+		ListCell   *lc;
+
+		Assert(parse->rowMarks);
+
+		/*
+		 * Grouping and aggregation are not supported with FOR UPDATE/SHARE,
+		 * so the input_rel should be a base, join, or ordered relation; and
+		 * if it's an ordered relation, its input relation should be a base or
+		 * join relation.
+		 */
+		Assert(input_rel->reloptkind == RELOPT_BASEREL ||
+			   input_rel->reloptkind == RELOPT_JOINREL ||
+			   (input_rel->reloptkind == RELOPT_UPPER_REL &&
+				ifpinfo->stage == UPPERREL_ORDERED &&
+				(ifpinfo->outerrel->reloptkind == RELOPT_BASEREL ||
+				 ifpinfo->outerrel->reloptkind == RELOPT_JOINREL)));
+
+		foreach(lc, input_rel->pathlist)
+		{
+			Path	   *path = (Path *) lfirst(lc);
+
+			/*
+			 * apply_scanjoin_target_to_paths() uses create_projection_path()
+			 * to adjust each of its input paths if needed, whereas
+			 * create_ordered_paths() uses apply_projection_to_path() to do
+			 * that.  So the former might have put a ProjectionPath on top of
+			 * the ForeignPath; look through ProjectionPath and see if the
+			 * path underneath it is ForeignPath.
+			 */
+			if (IsA(path, ForeignPath) ||
+				(IsA(path, ProjectionPath) &&
+				 IsA(((ProjectionPath *) path)->subpath, ForeignPath)))
+			{
+				/*
+				 * Create foreign final path; this gets rid of a
+				 * no-longer-needed outer plan (if any), which makes the
+				 * EXPLAIN output look cleaner
+				 */
+				final_path = create_foreign_upper_path(root,
+													   path->parent,
+													   path->pathtarget,
+													   path->rows,
+													   path->startup_cost,
+													   path->total_cost,
+													   path->pathkeys,
+													   NULL,	/* no extra plan */
+													   NIL, /* no fdw_restrictinfo
+															 * list */
+													   NIL);	/* no fdw_private */
+
+				/* and add it to the final_rel */
+				add_path(final_rel, (Path *) final_path);
+
+				/* Safe to push down */
+				fpinfo->pushdown_safe = true;
+
+				return;
+			}
+		}
+
+		/*
+		 * If we get here it means no ForeignPaths; since we would already
+		 * have considered pushing down all operations for the query to the
+		 * remote server, give up on it.
+		 */
+		return;
+	}
+
+	Assert(extra->limit_needed);
+
+	/*
+	 * If the input_rel is an ordered relation, replace the input_rel with its
+	 * input relation
+	 */
+	if (input_rel->reloptkind == RELOPT_UPPER_REL &&
+		ifpinfo->stage == UPPERREL_ORDERED)
+	{
+		input_rel = ifpinfo->outerrel;
+		ifpinfo = (PgFdwRelationInfo *) input_rel->fdw_private;
+		has_final_sort = true;
+		pathkeys = root->sort_pathkeys;
+	}
+
+	/*
+	 * The input_rel should be a base, join, grouping, window, or distinct
+	 * relation
+	 */
+	Assert(input_rel->reloptkind == RELOPT_BASEREL ||
+		   input_rel->reloptkind == RELOPT_JOINREL ||
+		   (input_rel->reloptkind == RELOPT_UPPER_REL &&
+			(ifpinfo->stage == UPPERREL_GROUP_AGG ||
+			 ifpinfo->stage == UPPERREL_WINDOW ||
+			 ifpinfo->stage == UPPERREL_DISTINCT)));
+
+	/*
+	 * We try to create a path below by extending a simple foreign path for
+	 * the underlying base, join, or grouping relation to perform the final
+	 * sort (if has_final_sort) and the LIMIT restriction remotely, which is
+	 * stored into the fdw_private list of the resulting path.  (We
+	 * re-estimate the costs of sorting the underlying relation, if
+	 * has_final_sort.)
+	 */
+
+	/*
+	 * Assess if it is safe to push down the LIMIT and OFFSET to the remote
+	 * server
+	 */
+
+	/*
+	 * If the underlying relation has any local conditions, the LIMIT/OFFSET
+	 * cannot be pushed down.
+	 */
+	if (ifpinfo->local_conds)
+		return;
+
+	/*
+	 * Also, the LIMIT/OFFSET cannot be pushed down, if their expressions are
+	 * not safe to remote.
+	 */
+	if (!is_foreign_expr(root, input_rel, (Expr *) parse->limitOffset) ||
+		!is_foreign_expr(root, input_rel, (Expr *) parse->limitCount))
+		return;
+
+	/* Safe to push down */
+	fpinfo->pushdown_safe = true;
+
+	/* Construct PgFdwPathExtraData */
+	fpextra = (PgFdwPathExtraData *) palloc0(sizeof(PgFdwPathExtraData));
+	fpextra->target = root->upper_targets[UPPERREL_FINAL];
+	fpextra->has_final_sort = has_final_sort;
+	fpextra->has_limit = extra->limit_needed;
+	fpextra->limit_tuples = extra->limit_tuples;
+	fpextra->count_est = extra->count_est;
+	fpextra->offset_est = extra->offset_est;
+
+	/*
+	 * Estimate the costs of performing the final sort and the LIMIT
+	 * restriction remotely.  If has_final_sort is false, we wouldn't need to
+	 * execute EXPLAIN anymore if use_remote_estimate, since the costs can be
+	 * roughly estimated using the costs we already have for the underlying
+	 * relation, in the same way as when use_remote_estimate is false.  Since
+	 * it's pretty expensive to execute EXPLAIN, force use_remote_estimate to
+	 * false in that case.
+	 */
+	if (!fpextra->has_final_sort)
+	{
+		save_use_remote_estimate = ifpinfo->use_remote_estimate;
+		ifpinfo->use_remote_estimate = false;
+	}
+	estimate_path_cost_size(root, input_rel, NIL, pathkeys, fpextra,
+							&rows, &width, &startup_cost, &total_cost);
+	if (!fpextra->has_final_sort)
+		ifpinfo->use_remote_estimate = save_use_remote_estimate;
+
+	/*
+	 * Build the fdw_private list that will be used by postgresGetForeignPlan.
+	 * Items in the list must match order in enum FdwPathPrivateIndex.
+	 */
+	fdw_private = list_make2(makeBoolean(has_final_sort),
+							 makeBoolean(extra->limit_needed));
+
+	/*
+	 * Create foreign final path; this gets rid of a no-longer-needed outer
+	 * plan (if any), which makes the EXPLAIN output look cleaner
+	 */
+	final_path = create_foreign_upper_path(root,
+										   input_rel,
+										   root->upper_targets[UPPERREL_FINAL],
+										   rows,
+										   startup_cost,
+										   total_cost,
+										   pathkeys,
+										   NULL,	/* no extra plan */
+										   NIL, /* no fdw_restrictinfo list */
+										   fdw_private);
+
+	/* and add it to the final_rel */
+	add_path(final_rel, (Path *) final_path);
+}
+
+/*
+ * postgresIsForeignPathAsyncCapable
+ *		Check whether a given ForeignPath node is async-capable.
+ */
+static bool
+postgresIsForeignPathAsyncCapable(ForeignPath *path)
+{
+	RelOptInfo *rel = ((Path *) path)->parent;
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+
+	return fpinfo->async_capable;
+}
+
+/*
+ * postgresForeignAsyncRequest
+ *		Asynchronously request next tuple from a foreign PostgreSQL table.
+ */
+static void
+postgresForeignAsyncRequest(AsyncRequest *areq)
+{
+	produce_tuple_asynchronously(areq, true);
+}
+
+/*
+ * postgresForeignAsyncConfigureWait
+ *		Configure a file descriptor event for which we wish to wait.
+ */
+static void
+postgresForeignAsyncConfigureWait(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	AsyncRequest *pendingAreq = fsstate->conn_state->pendingAreq;
+	AppendState *requestor = (AppendState *) areq->requestor;
+	WaitEventSet *set = requestor->as_eventset;
+
+	/* This should not be called unless callback_pending */
+	Assert(areq->callback_pending);
+
+	/*
+	 * If process_pending_request() has been invoked on the given request
+	 * before we get here, we might have some tuples already; in which case
+	 * complete the request
+	 */
+	if (fsstate->next_tuple < fsstate->num_tuples)
+	{
+		complete_pending_request(areq);
+		if (areq->request_complete)
+			return;
+		Assert(areq->callback_pending);
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* The core code would have registered postmaster death event */
+	Assert(GetNumRegisteredWaitEvents(set) >= 1);
+
+	/* Begin an asynchronous data fetch if not already done */
+	if (!pendingAreq)
+		fetch_more_data_begin(areq);
+	else if (pendingAreq->requestor != areq->requestor)
+	{
+		/*
+		 * This is the case when the in-process request was made by another
+		 * Append.  Note that it might be useless to process the request,
+		 * because the query might not need tuples from that Append anymore.
+		 * If there are any child subplans of the same parent that are ready
+		 * for new requests, skip the given request.  Likewise, if there are
+		 * any configured events other than the postmaster death event, skip
+		 * it.  Otherwise, process the in-process request, then begin a fetch
+		 * to configure the event below, because we might otherwise end up
+		 * with no configured events other than the postmaster death event.
+		 */
+		if (!bms_is_empty(requestor->as_needrequest))
+			return;
+		if (GetNumRegisteredWaitEvents(set) > 1)
+			return;
+		process_pending_request(pendingAreq);
+		fetch_more_data_begin(areq);
+	}
+	else if (pendingAreq->requestee != areq->requestee)
+	{
+		/*
+		 * This is the case when the in-process request was made by the same
+		 * parent but for a different child.  Since we configure only the
+		 * event for the request made for that child, skip the given request.
+		 */
+		return;
+	}
+	else
+		Assert(pendingAreq == areq);
+
+	AddWaitEventToSet(set, WL_SOCKET_READABLE, PQsocket(fsstate->conn),
+					  NULL, areq);
+}
+
+/*
+ * postgresForeignAsyncNotify
+ *		Fetch some more tuples from a file descriptor that becomes ready,
+ *		requesting next tuple.
+ */
+static void
+postgresForeignAsyncNotify(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* The core code would have initialized the callback_pending flag */
+	Assert(!areq->callback_pending);
+
+	/*
+	 * If process_pending_request() has been invoked on the given request
+	 * before we get here, we might have some tuples already; in which case
+	 * produce the next tuple
+	 */
+	if (fsstate->next_tuple < fsstate->num_tuples)
+	{
+		produce_tuple_asynchronously(areq, true);
+		return;
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* The request should be currently in-process */
+	Assert(fsstate->conn_state->pendingAreq == areq);
+
+	/* On error, report the original query, not the FETCH. */
+	if (!PQconsumeInput(fsstate->conn))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+
+	fetch_more_data(node);
+
+	produce_tuple_asynchronously(areq, true);
+}
+
+/*
+ * Asynchronously produce next tuple from a foreign PostgreSQL table.
+ */
+static void
+produce_tuple_asynchronously(AsyncRequest *areq, bool fetch)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	AsyncRequest *pendingAreq = fsstate->conn_state->pendingAreq;
+	TupleTableSlot *result;
+
+	/* This should not be called if the request is currently in-process */
+	Assert(areq != pendingAreq);
+
+	/* Fetch some more tuples, if we've run out */
+	if (fsstate->next_tuple >= fsstate->num_tuples)
+	{
+		/* No point in another fetch if we already detected EOF, though */
+		if (!fsstate->eof_reached)
+		{
+			/* Mark the request as pending for a callback */
+			ExecAsyncRequestPending(areq);
+			/* Begin another fetch if requested and if no pending request */
+			if (fetch && !pendingAreq)
+				fetch_more_data_begin(areq);
+		}
+		else
+		{
+			/* There's nothing more to do; just return a NULL pointer */
+			result = NULL;
+			/* Mark the request as complete */
+			ExecAsyncRequestDone(areq, result);
+		}
+		return;
+	}
+
+	/* Get a tuple from the ForeignScan node */
+	result = areq->requestee->ExecProcNodeReal(areq->requestee);
+	if (!TupIsNull(result))
+	{
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, result);
+		return;
+	}
+
+	/* We must have run out of tuples */
+	Assert(fsstate->next_tuple >= fsstate->num_tuples);
+
+	/* Fetch some more tuples, if we've not detected EOF yet */
+	if (!fsstate->eof_reached)
+	{
+		/* Mark the request as pending for a callback */
+		ExecAsyncRequestPending(areq);
+		/* Begin another fetch if requested and if no pending request */
+		if (fetch && !pendingAreq)
+			fetch_more_data_begin(areq);
+	}
+	else
+	{
+		/* There's nothing more to do; just return a NULL pointer */
+		result = NULL;
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, result);
+	}
+}
+
+/*
+ * Begin an asynchronous data fetch.
+ *
+ * Note: this function assumes there is no currently-in-progress asynchronous
+ * data fetch.
+ *
+ * Note: fetch_more_data must be called to fetch the result.
+ */
+static void
+fetch_more_data_begin(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+	char		sql[64];
+
+	Assert(!fsstate->conn_state->pendingAreq);
+
+	/* Create the cursor synchronously. */
+	if (!fsstate->cursor_exists)
+		create_cursor(node);
+
+	/* We will send this query, but not wait for the response. */
+	snprintf(sql, sizeof(sql), "FETCH %d FROM c%u",
+			 fsstate->fetch_size, fsstate->cursor_number);
+
+	if (!PQsendQuery(fsstate->conn, sql))
+		pgfdw_report_error(ERROR, NULL, fsstate->conn, false, fsstate->query);
+
+	/* Remember that the request is in process */
+	fsstate->conn_state->pendingAreq = areq;
+}
+
+/*
+ * Process a pending asynchronous request.
+ */
+void
+process_pending_request(AsyncRequest *areq)
+{
+	ForeignScanState *node = (ForeignScanState *) areq->requestee;
+	PgFdwScanState *fsstate = (PgFdwScanState *) node->fdw_state;
+
+	/* The request would have been pending for a callback */
+	Assert(areq->callback_pending);
+
+	/* The request should be currently in-process */
+	Assert(fsstate->conn_state->pendingAreq == areq);
+
+	fetch_more_data(node);
+
+	/*
+	 * If we didn't get any tuples, must be end of data; complete the request
+	 * now.  Otherwise, we postpone completing the request until we are called
+	 * from postgresForeignAsyncConfigureWait()/postgresForeignAsyncNotify().
+	 */
+	if (fsstate->next_tuple >= fsstate->num_tuples)
+	{
+		/* Unlike AsyncNotify, we unset callback_pending ourselves */
+		areq->callback_pending = false;
+		/* Mark the request as complete */
+		ExecAsyncRequestDone(areq, NULL);
+		/* Unlike AsyncNotify, we call ExecAsyncResponse ourselves */
+		ExecAsyncResponse(areq);
+	}
+}
+
+/*
+ * Complete a pending asynchronous request.
+ */
+static void
+complete_pending_request(AsyncRequest *areq)
+{
+	/* The request would have been pending for a callback */
+	Assert(areq->callback_pending);
+
+	/* Unlike AsyncNotify, we unset callback_pending ourselves */
+	areq->callback_pending = false;
+
+	/* We begin a fetch afterwards if necessary; don't fetch */
+	produce_tuple_asynchronously(areq, false);
+
+	/* Unlike AsyncNotify, we call ExecAsyncResponse ourselves */
+	ExecAsyncResponse(areq);
+
+	/* Also, we do instrumentation ourselves, if required */
+	if (areq->requestee->instrument)
+		InstrUpdateTupleCount(areq->requestee->instrument,
+							  TupIsNull(areq->result) ? 0.0 : 1.0);
+}
+
+/*
+ * Create a tuple from the specified row of the PGresult.
+ *
+ * rel is the local representation of the foreign table, attinmeta is
+ * conversion data for the rel's tupdesc, and retrieved_attrs is an
+ * integer list of the table column numbers present in the PGresult.
+ * fsstate is the ForeignScan plan node's execution state.
+ * temp_context is a working context that can be reset after each tuple.
+ *
+ * Note: either rel or fsstate, but not both, can be NULL.  rel is NULL
+ * if we're processing a remote join, while fsstate is NULL in a non-query
+ * context such as ANALYZE, or if we're processing a non-scan query node.
+ */
+static HeapTuple
+make_tuple_from_result_row(PGresult *res,
+						   int row,
+						   Relation rel,
+						   AttInMetadata *attinmeta,
+						   List *retrieved_attrs,
+						   ForeignScanState *fsstate,
+						   MemoryContext temp_context)
+{
+	HeapTuple	tuple;
+	TupleDesc	tupdesc;
+	Datum	   *values;
+	bool	   *nulls;
+	ItemPointer ctid = NULL;
+	ConversionLocation errpos;
+	ErrorContextCallback errcallback;
+	MemoryContext oldcontext;
+	ListCell   *lc;
+	int			j;
+
+	Assert(row < PQntuples(res));
+
+	/*
+	 * Do the following work in a temp context that we reset after each tuple.
+	 * This cleans up not only the data we have direct access to, but any
+	 * cruft the I/O functions might leak.
+	 */
+	oldcontext = MemoryContextSwitchTo(temp_context);
+
+	/*
+	 * Get the tuple descriptor for the row.  Use the rel's tupdesc if rel is
+	 * provided, otherwise look to the scan node's ScanTupleSlot.
+	 */
+	if (rel)
+		tupdesc = RelationGetDescr(rel);
+	else
+	{
+		Assert(fsstate);
+		tupdesc = fsstate->ss.ss_ScanTupleSlot->tts_tupleDescriptor;
+	}
+
+	values = (Datum *) palloc0(tupdesc->natts * sizeof(Datum));
+	nulls = (bool *) palloc(tupdesc->natts * sizeof(bool));
+	/* Initialize to nulls for any columns not present in result */
+	memset(nulls, true, tupdesc->natts * sizeof(bool));
+
+	/*
+	 * Set up and install callback to report where conversion error occurs.
+	 */
+	errpos.cur_attno = 0;
+	errpos.rel = rel;
+	errpos.fsstate = fsstate;
+	errcallback.callback = conversion_error_callback;
+	errcallback.arg = (void *) &errpos;
+	errcallback.previous = error_context_stack;
+	error_context_stack = &errcallback;
+
+	/*
+	 * i indexes columns in the relation, j indexes columns in the PGresult.
+	 */
+	j = 0;
+	foreach(lc, retrieved_attrs)
+	{
+		int			i = lfirst_int(lc);
+		char	   *valstr;
+
+		/* fetch next column's textual value */
+		if (PQgetisnull(res, row, j))
+			valstr = NULL;
+		else
+			valstr = PQgetvalue(res, row, j);
+
+		/*
+		 * convert value to internal representation
+		 *
+		 * Note: we ignore system columns other than ctid and oid in result
+		 */
+		errpos.cur_attno = i;
+		if (i > 0)
+		{
+			/* ordinary column */
+			Assert(i <= tupdesc->natts);
+			nulls[i - 1] = (valstr == NULL);
+			/* Apply the input function even to nulls, to support domains */
+			values[i - 1] = InputFunctionCall(&attinmeta->attinfuncs[i - 1],
+											  valstr,
+											  attinmeta->attioparams[i - 1],
+											  attinmeta->atttypmods[i - 1]);
+		}
+		else if (i == SelfItemPointerAttributeNumber)
+		{
+			/* ctid */
+			if (valstr != NULL)
+			{
+				Datum		datum;
+
+				datum = DirectFunctionCall1(tidin, CStringGetDatum(valstr));
+				ctid = (ItemPointer) DatumGetPointer(datum);
+			}
+		}
+		errpos.cur_attno = 0;
+
+		j++;
+	}
+
+	/* Uninstall error context callback. */
+	error_context_stack = errcallback.previous;
+
+	/*
+	 * Check we got the expected number of columns.  Note: j == 0 and
+	 * PQnfields == 1 is expected, since deparse emits a NULL if no columns.
+	 */
+	if (j > 0 && j != PQnfields(res))
+		elog(ERROR, "remote query result does not match the foreign table");
+
+	/*
+	 * Build the result tuple in caller's memory context.
+	 */
+	MemoryContextSwitchTo(oldcontext);
+
+	tuple = heap_form_tuple(tupdesc, values, nulls);
+
+	/*
+	 * If we have a CTID to return, install it in both t_self and t_ctid.
+	 * t_self is the normal place, but if the tuple is converted to a
+	 * composite Datum, t_self will be lost; setting t_ctid allows CTID to be
+	 * preserved during EvalPlanQual re-evaluations (see ROW_MARK_COPY code).
+	 */
+	if (ctid)
+		tuple->t_self = tuple->t_data->t_ctid = *ctid;
+
+	/*
+	 * Stomp on the xmin, xmax, and cmin fields from the tuple created by
+	 * heap_form_tuple.  heap_form_tuple actually creates the tuple with
+	 * DatumTupleFields, not HeapTupleFields, but the executor expects
+	 * HeapTupleFields and will happily extract system columns on that
+	 * assumption.  If we don't do this then, for example, the tuple length
+	 * ends up in the xmin field, which isn't what we want.
+	 */
+	HeapTupleHeaderSetXmax(tuple->t_data, InvalidTransactionId);
+	HeapTupleHeaderSetXmin(tuple->t_data, InvalidTransactionId);
+	HeapTupleHeaderSetCmin(tuple->t_data, InvalidTransactionId);
+
+	/* Clean up */
+	MemoryContextReset(temp_context);
+
+	return tuple;
+}
+
+/*
+ * Callback function which is called when error occurs during column value
+ * conversion.  Print names of column and relation.
+ *
+ * Note that this function mustn't do any catalog lookups, since we are in
+ * an already-failed transaction.  Fortunately, we can get the needed info
+ * from the relation or the query's rangetable instead.
+ */
+static void
+conversion_error_callback(void *arg)
+{
+	ConversionLocation *errpos = (ConversionLocation *) arg;
+	Relation	rel = errpos->rel;
+	ForeignScanState *fsstate = errpos->fsstate;
+	const char *attname = NULL;
+	const char *relname = NULL;
+	bool		is_wholerow = false;
+
+	/*
+	 * If we're in a scan node, always use aliases from the rangetable, for
+	 * consistency between the simple-relation and remote-join cases.  Look at
+	 * the relation's tupdesc only if we're not in a scan node.
+	 */
+	if (fsstate)
+	{
+		/* ForeignScan case */
+		ForeignScan *fsplan = castNode(ForeignScan, fsstate->ss.ps.plan);
+		int			varno = 0;
+		AttrNumber	colno = 0;
+
+		if (fsplan->scan.scanrelid > 0)
+		{
+			/* error occurred in a scan against a foreign table */
+			varno = fsplan->scan.scanrelid;
+			colno = errpos->cur_attno;
+		}
+		else
+		{
+			/* error occurred in a scan against a foreign join */
+			TargetEntry *tle;
+
+			tle = list_nth_node(TargetEntry, fsplan->fdw_scan_tlist,
+								errpos->cur_attno - 1);
+
+			/*
+			 * Target list can have Vars and expressions.  For Vars, we can
+			 * get some information, however for expressions we can't.  Thus
+			 * for expressions, just show generic context message.
+			 */
+			if (IsA(tle->expr, Var))
+			{
+				Var		   *var = (Var *) tle->expr;
+
+				varno = var->varno;
+				colno = var->varattno;
+			}
+		}
+
+		if (varno > 0)
+		{
+			EState	   *estate = fsstate->ss.ps.state;
+			RangeTblEntry *rte = exec_rt_fetch(varno, estate);
+
+			relname = rte->eref->aliasname;
+
+			if (colno == 0)
+				is_wholerow = true;
+			else if (colno > 0 && colno <= list_length(rte->eref->colnames))
+				attname = strVal(list_nth(rte->eref->colnames, colno - 1));
+			else if (colno == SelfItemPointerAttributeNumber)
+				attname = "ctid";
+		}
+	}
+	else if (rel)
+	{
+		/* Non-ForeignScan case (we should always have a rel here) */
+		TupleDesc	tupdesc = RelationGetDescr(rel);
+
+		relname = RelationGetRelationName(rel);
+		if (errpos->cur_attno > 0 && errpos->cur_attno <= tupdesc->natts)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc,
+												   errpos->cur_attno - 1);
+
+			attname = NameStr(attr->attname);
+		}
+		else if (errpos->cur_attno == SelfItemPointerAttributeNumber)
+			attname = "ctid";
+	}
+
+	if (relname && is_wholerow)
+		errcontext("whole-row reference to foreign table \"%s\"", relname);
+	else if (relname && attname)
+		errcontext("column \"%s\" of foreign table \"%s\"", attname, relname);
+	else
+		errcontext("processing expression at position %d in select list",
+				   errpos->cur_attno);
+}
+
+/*
+ * Given an EquivalenceClass and a foreign relation, find an EC member
+ * that can be used to sort the relation remotely according to a pathkey
+ * using this EC.
+ *
+ * If there is more than one suitable candidate, return an arbitrary
+ * one of them.  If there is none, return NULL.
+ *
+ * This checks that the EC member expression uses only Vars from the given
+ * rel and is shippable.  Caller must separately verify that the pathkey's
+ * ordering operator is shippable.
+ */
+EquivalenceMember *
+find_em_for_rel(PlannerInfo *root, EquivalenceClass *ec, RelOptInfo *rel)
+{
+	ListCell   *lc;
+
+	PgFdwRelationInfo *fpinfo = (PgFdwRelationInfo *) rel->fdw_private;
+
+	foreach(lc, ec->ec_members)
+	{
+		EquivalenceMember *em = (EquivalenceMember *) lfirst(lc);
+
+		/*
+		 * Note we require !bms_is_empty, else we'd accept constant
+		 * expressions which are not suitable for the purpose.
+		 */
+		if (bms_is_subset(em->em_relids, rel->relids) &&
+			!bms_is_empty(em->em_relids) &&
+			bms_is_empty(bms_intersect(em->em_relids, fpinfo->hidden_subquery_rels)) &&
+			is_foreign_expr(root, rel, em->em_expr))
+			return em;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find an EquivalenceClass member that is to be computed as a sort column
+ * in the given rel's reltarget, and is shippable.
+ *
+ * If there is more than one suitable candidate, return an arbitrary
+ * one of them.  If there is none, return NULL.
+ *
+ * This checks that the EC member expression uses only Vars from the given
+ * rel and is shippable.  Caller must separately verify that the pathkey's
+ * ordering operator is shippable.
+ */
+EquivalenceMember *
+find_em_for_rel_target(PlannerInfo *root, EquivalenceClass *ec,
+					   RelOptInfo *rel)
+{
+	PathTarget *target = rel->reltarget;
+	ListCell   *lc1;
+	int			i;
+
+	i = 0;
+	foreach(lc1, target->exprs)
+	{
+		Expr	   *expr = (Expr *) lfirst(lc1);
+		Index		sgref = get_pathtarget_sortgroupref(target, i);
+		ListCell   *lc2;
+
+		/* Ignore non-sort expressions */
+		if (sgref == 0 ||
+			get_sortgroupref_clause_noerr(sgref,
+										  root->parse->sortClause) == NULL)
+		{
+			i++;
+			continue;
+		}
+
+		/* We ignore binary-compatible relabeling on both ends */
+		while (expr && IsA(expr, RelabelType))
+			expr = ((RelabelType *) expr)->arg;
+
+		/* Locate an EquivalenceClass member matching this expr, if any */
+		foreach(lc2, ec->ec_members)
+		{
+			EquivalenceMember *em = (EquivalenceMember *) lfirst(lc2);
+			Expr	   *em_expr;
+
+			/* Don't match constants */
+			if (em->em_is_const)
+				continue;
+
+			/* Ignore child members */
+			if (em->em_is_child)
+				continue;
+
+			/* Match if same expression (after stripping relabel) */
+			em_expr = em->em_expr;
+			while (em_expr && IsA(em_expr, RelabelType))
+				em_expr = ((RelabelType *) em_expr)->arg;
+
+			if (!equal(em_expr, expr))
+				continue;
+
+			/* Check that expression (including relabels!) is shippable */
+			if (is_foreign_expr(root, rel, em->em_expr))
+				return em;
+		}
+
+		i++;
+	}
+
+	return NULL;
+}
+
+/*
+ * Determine batch size for a given foreign table. The option specified for
+ * a table has precedence.
+ */
+static int
+get_batch_size_option(Relation rel)
+{
+	return get_relation_settings(RelationGetRelid(rel))->batch_size;
+}
+
+/*
+ * Determine how to send batches of rows inserted into a given foreign table.
+ * The option specified for a table has precedence.
+ */
+static PgFdwBatchInsertMethod
+get_batch_insert_method(Relation rel)
+{
+	return get_relation_settings(RelationGetRelid(rel))->batch_insert_method;
+}
+
+/*
+ * Determine the target size of the parameters of a statement sending a batch
+ * of inserts into a given foreign table, or 0 if batches are not sized
+ * adaptively.  The option specified for a table has precedence.
+ */
+static int
+get_batch_target_size(Relation rel)
+{
+	return get_relation_settings(RelationGetRelid(rel))->batch_target_size;
+}
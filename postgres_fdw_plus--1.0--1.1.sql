@@ -0,0 +1,13 @@
+/* contrib/postgres_fdw_plus/postgres_fdw_plus--1.0--1.1.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION postgres_fdw_plus UPDATE TO '1.1'" to load this file. \quit
+
+/*
+ * Test whether given value may be contained in Bloom filter that
+ * key-set semi-join ships to remote server.
+ */
+CREATE FUNCTION pgfdw_plus_bloom_match (filter bytea, value anyelement)
+RETURNS boolean
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT IMMUTABLE PARALLEL SAFE;
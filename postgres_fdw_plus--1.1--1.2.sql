@@ -0,0 +1,71 @@
+/* contrib/postgres_fdw_plus/postgres_fdw_plus--1.1--1.2.sql */
+
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION postgres_fdw_plus UPDATE TO '1.2'" to load this file. \quit
+
+/*
+ * User-defined functions and operators that were checked by
+ * pgfdw_plus_discover_shippable() to be shippable or not to
+ * foreign servers, with the hash of their definitions at that time.
+ */
+CREATE TABLE pgfdw_plus.shippable (
+  serverid oid,
+  classid oid,
+  objid oid,
+  shippable boolean NOT NULL,
+  defhash text,
+  PRIMARY KEY (serverid, classid, objid)
+);
+
+/*
+ * Discover user-defined functions and operators that exist with
+ * the same definition on given server, so that they are shippable to it.
+ */
+CREATE FUNCTION pgfdw_plus_discover_shippable (server name,
+    OUT object_type text, OUT object text, OUT shippable boolean)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL UNSAFE;
+
+REVOKE ALL ON FUNCTION pgfdw_plus_discover_shippable (name) FROM PUBLIC;
+
+/*
+ * Btree indexes of the remote tables of foreign tables, imported by
+ * pgfdw_plus_import_remote_indexes() or IMPORT FOREIGN SCHEMA with
+ * import_indexes option. indkey lists the attribute numbers
+ * of the foreign table columns that the leading key columns of the index
+ * correspond to, and indoption their flags like pg_index.indoption.
+ */
+CREATE TABLE pgfdw_plus.remote_indexes (
+  ftrelid oid,
+  indexname name,
+  indisunique boolean NOT NULL,
+  indkey int2[] NOT NULL,
+  indoption int2[] NOT NULL,
+  PRIMARY KEY (ftrelid, indexname)
+);
+
+/*
+ * Import the definitions of the remote indexes for the foreign tables
+ * on given server, so that the planner can take them into account.
+ */
+CREATE FUNCTION pgfdw_plus_import_remote_indexes (server name,
+    OUT foreign_table regclass, OUT index_name name,
+    OUT is_unique boolean, OUT columns text)
+RETURNS SETOF record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL UNSAFE;
+
+REVOKE ALL ON FUNCTION pgfdw_plus_import_remote_indexes (name) FROM PUBLIC;
+
+/*
+ * Measure the network round-trip time and bandwidth to given server,
+ * and record them for the network cost model.
+ */
+CREATE FUNCTION pgfdw_plus_calibrate_network (server name,
+    OUT round_trip_ms float8, OUT megabytes_per_sec float8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT PARALLEL UNSAFE;
+
+REVOKE ALL ON FUNCTION pgfdw_plus_calibrate_network (name) FROM PUBLIC;
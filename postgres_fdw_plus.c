@@ -1,21 +1,81 @@
 #include "postgres.h"
 
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/multixact.h"
 #include "access/table.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "catalog/dependency.h"
 #include "catalog/indexing.h"
 #include "catalog/namespace.h"
+#include "catalog/pg_am.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_database.h"
+#include "catalog/pg_enum.h"
+#include "catalog/pg_foreign_table.h"
+#include "catalog/pg_index.h"
+#include "catalog/pg_inherits.h"
+#include "catalog/pg_language.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_proc.h"
+#include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
+#include "commands/defrem.h"
+#include "commands/proclang.h"
+#include "commands/vacuum.h"
+#include "common/hashfn.h"
+#include "common/md5.h"
+#include "executor/spi.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "port/atomics.h"
+#include "portability/instr_time.h"
 #include "postgres_fdw_plus.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "tcop/tcopprot.h"
+#include "tcop/utility.h"
+#include "utils/array.h"
+#include "utils/backend_status.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
 #include "utils/guc.h"
+#include "utils/inval.h"
 #include "utils/lsyscache.h"
+#include "utils/regproc.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/typcache.h"
+#include "utils/wait_event.h"
 #include "utils/xid8.h"
 
 /*
  * GUC parameters
  */
-static bool		pgfdw_two_phase_commit = false;
+bool		pgfdw_two_phase_commit = false;
 static bool		pgfdw_skip_commit_phase = false;
 static bool		pgfdw_track_xact_commits = true;
 static bool		pgfdw_use_read_committed = false;
+static int	pgfdw_remote_estimate_cache_size = 0;
+static int	pgfdw_remote_estimate_cache_ttl = 60;
+static double pgfdw_network_cost_per_ms = 100.0;
+static char *pgfdw_auto_analyze_database = NULL;
+static int	pgfdw_auto_analyze_naptime = 60;
+static int	pgfdw_auto_analyze_threshold = 50;
+static double pgfdw_auto_analyze_scale_factor = 0.1;
 
 /*
  * Global variables
@@ -30,6 +90,46 @@ static bool		pgfdw_use_read_committed = false;
  */
 bool		pgfdw_use_read_committed_in_xact = false;
 
+/*
+ * Maximum number of distinct local join keys that are shipped to the remote
+ * server as an array parameter by a key-set semi-join.  Zero disables
+ * key-set semi-joins.
+ */
+int			pgfdw_keyset_join_max_keys = 0;
+
+/*
+ * Maximum size, in kilobytes, of a Bloom filter that a key-set semi-join
+ * ships to the remote server instead of the keys themselves when there are
+ * too many of them.  Zero disables Bloom filters.
+ */
+int			pgfdw_bloom_filter_max_size = 1024;
+
+/*
+ * Whether key-set semi-joins may stage the local join keys in a remote
+ * temporary table, instead of shipping them as a query parameter.
+ */
+bool		pgfdw_keyset_join_staging = false;
+
+/*
+ * Whether stable subexpressions that don't depend on the scanned rows are
+ * evaluated locally and sent to the remote server as query parameters.
+ */
+bool		pgfdw_preevaluate_stable_exprs = false;
+
+/*
+ * Planning budget for remote estimates: the maximum number of remote
+ * EXPLAINs issued, and the maximum time in milliseconds spent on them,
+ * while planning a query.  -1 means no limit.
+ */
+int			pgfdw_remote_estimate_max_count = -1;
+int			pgfdw_remote_estimate_max_time = -1;
+
+/*
+ * Whether ANALYZE of a parent table acquires the sample rows of all its
+ * foreign children at once.
+ */
+bool		pgfdw_analyze_concurrently = false;
+
 /*
  * This saves the command ID that was retrieved the last time a PGconn
  * was obtained, i.e., GetConnection() is called. The saved command ID
@@ -53,6 +153,136 @@ static CommandId	pgfdw_last_cid = InvalidCommandId;
 			 (Oid) entry->key, MyProcPid,	\
 			 (*cluster_name == '\0') ? "null" : cluster_name)
 
+/*
+ * A user-defined function or operator checked by
+ * pgfdw_plus_discover_shippable()
+ */
+typedef struct ShippableCandidate
+{
+	Oid			classid;		/* OID of its catalog (pg_proc, etc) */
+	Oid			objid;			/* function/operator OID */
+	char	   *signature;		/* schema-qualified signature */
+	bool		shippable;		/* verified to be shippable? */
+	char		defhash[33];	/* MD5 hash of local definition, or "" */
+
+	/* for functions */
+	char		srchash[33];	/* MD5 hash of prosrc */
+	char	   *lanname;		/* name of its language */
+	bool		strict;			/* proisstrict */
+	bool		retset;			/* proretset */
+	char	   *rettype;		/* schema-qualified name of return type */
+	char	   *config;			/* proconfig in text form, or NULL */
+
+	/* for operators */
+	Oid			oprcode;		/* OID of underlying function */
+	char	   *codesig;		/* schema-qualified signature of it */
+} ShippableCandidate;
+
+/*
+ * A foreign table with the names of its remote table and columns, whose
+ * remote indexes or statistics are imported
+ */
+typedef struct ForeignTableColumns
+{
+	Oid			relid;			/* OID of the foreign table */
+	char	   *nspname;		/* remote schema name */
+	char	   *relname;		/* remote table name */
+	int			natts;			/* number of attributes */
+	char	  **colnames;		/* remote column names, NULL if dropped */
+} ForeignTableColumns;
+
+/*
+ * A remote index imported by pgfdw_plus_import_remote_indexes()
+ */
+typedef struct RemoteIndex
+{
+	ForeignTableColumns *table; /* foreign table for the indexed table */
+	char	   *indexname;		/* remote index name */
+	bool		indisunique;	/* unique on the recorded key columns? */
+	int			nkeys;			/* number of recorded key columns */
+	int16	   *indkey;			/* their attnums in the foreign table */
+	int16	   *indoption;		/* their pg_index.indoption flags */
+} RemoteIndex;
+
+/*
+ * Hash key of the shared-memory cache of remote estimates
+ *
+ * The EXPLAIN command is identified by its hash value and length, rather
+ * than stored as a whole, to keep the entries fixed-size.  Since Params and
+ * other-relation Vars are replaced by dummy values of the same types in the
+ * command, the same command is used for all the parameter values.
+ */
+typedef struct RemoteEstimateKey
+{
+	Oid			serverid;		/* foreign server OID */
+	Oid			umid;			/* user mapping OID */
+	uint64		sqlhash;		/* hash value of the EXPLAIN command */
+	int			sqllen;			/* length of the EXPLAIN command */
+} RemoteEstimateKey;
+
+/*
+ * Entry of the shared-memory cache of remote estimates
+ */
+typedef struct RemoteEstimateEntry
+{
+	RemoteEstimateKey key;		/* hash key (must be first) */
+	uint64		epoch;			/* invalidation epoch when it was cached */
+	TimestampTz cached_at;		/* when it was cached */
+	double		rows;			/* estimates obtained from the remote EXPLAIN */
+	int			width;
+	Cost		startup_cost;
+	Cost		total_cost;
+} RemoteEstimateEntry;
+
+/*
+ * Shared state of postgres_fdw_plus
+ */
+typedef struct RemoteEstimateCacheState
+{
+	LWLock	   *lock;			/* protects the remote estimate hash table */
+	pg_atomic_uint64 epoch;		/* entries of older epochs are invalid */
+	LWLock	   *network_lock;	/* protects the network stats hash table */
+} RemoteEstimateCacheState;
+
+/* Links to the cache of remote estimates in shared memory */
+static RemoteEstimateCacheState *remote_estimate_state = NULL;
+static HTAB *remote_estimate_hash = NULL;
+
+/*
+ * Network statistics of a foreign server, used by the network cost model
+ *
+ * The round-trip time is updated on every remote transaction start, so it's
+ * kept in an atomic variable (as the bits of a double) that can be updated
+ * while holding the lock only in shared mode.  ms_per_byte is only changed
+ * while holding it in exclusive mode.
+ */
+typedef struct NetworkStatsEntry
+{
+	Oid			serverid;		/* hash key (must be first) */
+	pg_atomic_uint64 rtt_ms;	/* round-trip time in milliseconds */
+	double		ms_per_byte;	/* transfer time per byte, or 0 if unknown */
+	pg_atomic_uint64 nsamples;	/* number of round trips measured */
+} NetworkStatsEntry;
+
+/* Maximum number of foreign servers whose network statistics are kept */
+#define PGFDW_MAX_NETWORK_STATS		1024
+
+/*
+ * Weight of a new round-trip time measured passively, in the moving
+ * average of them
+ */
+#define PGFDW_RTT_SAMPLE_WEIGHT		0.2
+
+/*
+ * Network statistics of foreign servers, in shared memory if postgres_fdw_plus
+ * is loaded via shared_preload_libraries, or else in backend-local memory
+ */
+static HTAB *network_stats_hash = NULL;
+
+/* Saved hook values in case of unload */
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
 /*
  * Private functions
  */
@@ -69,6 +299,55 @@ static void pgfdw_finish_commit_prepared_cleanup(
 static bool pgfdw_rollback_prepared(ConnCacheEntry *entry);
 static void pgfdw_deallocate_all(ConnCacheEntry *entry);
 static void pgfdw_insert_xact_commits(List *umids);
+static void pgfdw_bloom_filter_shape(double nelems, uint64 *nbits,
+									 int *nhashes);
+static List *pgfdw_collect_candidate_functions(void);
+static List *pgfdw_collect_candidate_operators(List *funcs);
+static void pgfdw_verify_candidates(PGconn *conn, List *candidates,
+									Oid classid);
+static void pgfdw_store_discovered_shippable(Oid serverid,
+											 List *candidates);
+static List *pgfdw_collect_foreign_tables(Oid serverid);
+static ForeignTableColumns *pgfdw_describe_foreign_table(Oid relid);
+static List *pgfdw_fetch_remote_indexes(PGconn *conn, List *tables);
+static void pgfdw_store_remote_indexes(List *tables, List *indexes);
+static Relation pgfdw_open_remote_indexes(void);
+static void pgfdw_insert_remote_indexes(Relation rel, List *indexes);
+static bool pgfdw_trust_remote_unique(Oid foreigntableid);
+static IndexOptInfo *pgfdw_build_remote_index(RelOptInfo *baserel,
+											  Oid foreigntableid,
+											  bool unique, Datum *indkey,
+											  Datum *indoption, int nkeys);
+static void pgfdw_shmem_request(void);
+static void pgfdw_shmem_startup(void);
+static void pgfdw_remote_estimate_inval_callback(Datum arg, int cacheid,
+												 uint32 hashvalue);
+static void pgfdw_remote_estimate_key(RemoteEstimateKey *key,
+									  UserMapping *user, const char *sql);
+static bool pgfdw_remote_estimate_is_valid(RemoteEstimateEntry *entry,
+										   TimestampTz now);
+static void pgfdw_evict_remote_estimates(TimestampTz now);
+static NetworkStatsEntry *pgfdw_network_stats_entry(Oid serverid,
+													bool create);
+static double pgfdw_measure_query(PGconn *conn, const char *sql);
+static char *pgfdw_remote_stats_mismatch(Form_pg_attribute attr,
+										 PGresult *res, int row);
+static void pgfdw_deparse_remote_stats_query(StringInfo buf, List *tables,
+											 int server_version_num);
+static char *pgfdw_apply_remote_stats(Relation relation,
+									  ForeignTableColumns *table,
+									  PGresult *res, int first, int nrows);
+static void pgfdw_store_remote_stats(Relation relation,
+									 Form_pg_attribute attr, bool inh,
+									 PGresult *res, int row);
+static void pgfdw_fill_stats_slot(Datum *values, bool *nulls, int k,
+								  int16 kind, Oid opr, Oid coll,
+								  char *numbers, char *vals, Oid valtype);
+
+PG_FUNCTION_INFO_V1(pgfdw_plus_bloom_match);
+PG_FUNCTION_INFO_V1(pgfdw_plus_discover_shippable);
+PG_FUNCTION_INFO_V1(pgfdw_plus_import_remote_indexes);
+PG_FUNCTION_INFO_V1(pgfdw_plus_calibrate_network);
 
 /*
  * Define GUC parameters for postgres_fdw_plus.
@@ -119,6 +398,180 @@ DefineCustomVariablesForPgFdwPlus(void)
 							 NULL,
 							 NULL,
 							 NULL);
+
+	DefineCustomIntVariable("postgres_fdw.keyset_join_max_keys",
+							"Sets the maximum number of local join keys shipped to the remote server by a key-set semi-join.",
+							"Zero disables key-set semi-joins.",
+							&pgfdw_keyset_join_max_keys,
+							0,
+							0,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("postgres_fdw.bloom_filter_max_size",
+							"Sets the maximum size of a Bloom filter shipped to the remote server by a key-set semi-join.",
+							"Zero disables Bloom filters.",
+							&pgfdw_bloom_filter_max_size,
+							1024,
+							0,
+							MAX_KILOBYTES,
+							PGC_USERSET,
+							GUC_UNIT_KB,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomBoolVariable("postgres_fdw.keyset_join_staging",
+							 "Allows key-set semi-joins to stage local join keys in a remote temporary table.",
+							 NULL,
+							 &pgfdw_keyset_join_staging,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("postgres_fdw.preevaluate_stable_exprs",
+							 "Evaluates stable subexpressions locally to push down conditions using them.",
+							 NULL,
+							 &pgfdw_preevaluate_stable_exprs,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("postgres_fdw.analyze_concurrently",
+							 "Acquires sample rows from all foreign children of a parent table at once.",
+							 NULL,
+							 &pgfdw_analyze_concurrently,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomRealVariable("postgres_fdw.network_cost_per_ms",
+							 "Sets the planner's estimate of the cost of a millisecond spent on the network.",
+							 "Used for foreign servers with use_network_cost enabled.",
+							 &pgfdw_network_cost_per_ms,
+							 100.0,
+							 0.0,
+							 DBL_MAX,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("postgres_fdw.remote_estimate_max_count",
+							"Sets the maximum number of remote EXPLAINs issued to plan a query.",
+							"-1 means no limit.",
+							&pgfdw_remote_estimate_max_count,
+							-1,
+							-1,
+							INT_MAX,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("postgres_fdw.remote_estimate_max_time",
+							"Sets the maximum time spent on remote EXPLAINs to plan a query.",
+							"-1 means no limit.",
+							&pgfdw_remote_estimate_max_time,
+							-1,
+							-1,
+							INT_MAX,
+							PGC_USERSET,
+							GUC_UNIT_MS,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("postgres_fdw.remote_estimate_cache_size",
+							"Sets the maximum number of remote estimates cached in shared memory.",
+							"Zero disables the cache.",
+							&pgfdw_remote_estimate_cache_size,
+							0,
+							0,
+							INT_MAX / 2,
+							PGC_POSTMASTER,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("postgres_fdw.remote_estimate_cache_ttl",
+							"Sets the time for which cached remote estimates are used.",
+							"Zero disables the use of the cache.",
+							&pgfdw_remote_estimate_cache_ttl,
+							60,
+							0,
+							INT_MAX / 1000,
+							PGC_USERSET,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomStringVariable("postgres_fdw.auto_analyze_database",
+							   "Sets the database whose foreign tables are analyzed automatically.",
+							   "An empty string disables auto-analyze of foreign tables.",
+							   &pgfdw_auto_analyze_database,
+							   "",
+							   PGC_POSTMASTER,
+							   0,
+							   NULL,
+							   NULL,
+							   NULL);
+
+	DefineCustomIntVariable("postgres_fdw.auto_analyze_naptime",
+							"Sets the time to sleep between checks of foreign tables for changes.",
+							NULL,
+							&pgfdw_auto_analyze_naptime,
+							60,
+							1,
+							INT_MAX / 1000,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomIntVariable("postgres_fdw.auto_analyze_threshold",
+							"Sets the minimum number of remote changes before analyzing a foreign table.",
+							NULL,
+							&pgfdw_auto_analyze_threshold,
+							50,
+							0,
+							INT_MAX,
+							PGC_SIGHUP,
+							0,
+							NULL,
+							NULL,
+							NULL);
+
+	DefineCustomRealVariable("postgres_fdw.auto_analyze_scale_factor",
+							 "Sets the number of remote changes before analyzing a foreign table as a fraction of its rows.",
+							 NULL,
+							 &pgfdw_auto_analyze_scale_factor,
+							 0.1,
+							 0.0,
+							 100.0,
+							 PGC_SIGHUP,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
 }
 
 /*
@@ -570,7 +1023,6 @@ pgfdw_deallocate_all(ConnCacheEntry *entry)
 }
 
 /* Macros for pgfdw_plus.xact_commits table to track transaction commits */
-#define PGFDW_PLUS_SCHEMA	"pgfdw_plus"
 #define PGFDW_PLUS_XACT_COMMITS_TABLE	"xact_commits"
 #define PGFDW_PLUS_XACT_COMMITS_COLS	2
 
@@ -644,3 +1096,3527 @@ pgfdw_insert_xact_commits(List *umids)
 
 	table_close(rel, NoLock);
 }
+
+/*
+ * Bloom filters for key-set semi-joins
+ *
+ * When a key-set semi-join collects more local join keys than can be
+ * shipped as an array, it ships a Bloom filter of them instead, which the
+ * remote server probes with pgfdw_plus_bloom_match().  The filter is a bytea
+ * whose first byte is the number of hash functions, followed by the bitmap.
+ * The number of bits is always a power of two.
+ *
+ * The i-th bit position of a key is derived from the 64-bit extended hash of
+ * the key (with seed 0) by double hashing.  Both servers must therefore
+ * compute the same hash for the same value, which holds for the same data
+ * type and a deterministic collation.
+ */
+#define PGFDW_BLOOM_BITS_PER_ELEMENT	10
+#define PGFDW_BLOOM_MIN_BITS			64
+#define PGFDW_BLOOM_MAX_HASHES			16
+
+/*
+ * Choose the number of bits and hash functions of a Bloom filter for the
+ * given number of elements, within postgres_fdw.bloom_filter_max_size.
+ */
+static void
+pgfdw_bloom_filter_shape(double nelems, uint64 *nbits, int *nhashes)
+{
+	uint64		maxbits = (uint64) pgfdw_bloom_filter_max_size * 1024 * BITS_PER_BYTE;
+	double		wanted;
+	int			k;
+
+	nelems = Max(nelems, 1.0);
+	wanted = nelems * PGFDW_BLOOM_BITS_PER_ELEMENT;
+
+	*nbits = PGFDW_BLOOM_MIN_BITS;
+	while (*nbits < wanted && *nbits * 2 <= maxbits)
+		*nbits *= 2;
+
+	k = (int) rint((double) *nbits / nelems * M_LN2);
+	*nhashes = Max(1, Min(k, PGFDW_BLOOM_MAX_HASHES));
+}
+
+/*
+ * Estimate the false positive rate of a Bloom filter built by
+ * pgfdw_bloom_filter_create() for the given number of distinct elements.
+ */
+double
+pgfdw_bloom_filter_false_positive_rate(double nelems)
+{
+	uint64		nbits;
+	int			nhashes;
+
+	pgfdw_bloom_filter_shape(nelems, &nbits, &nhashes);
+	return pow(1.0 - exp(-(double) nhashes * Max(nelems, 1.0) / nbits),
+			   nhashes);
+}
+
+/*
+ * Build a Bloom filter containing the given extended hash values.
+ *
+ * nhashvals is used to size the filter, so duplicates in hashvals only make
+ * the filter larger than necessary.
+ */
+bytea *
+pgfdw_bloom_filter_create(const uint64 *hashvals, int nhashvals)
+{
+	uint64		nbits;
+	int			nhashes;
+	bytea	   *filter;
+	unsigned char *bitmap;
+	int			i;
+
+	pgfdw_bloom_filter_shape(nhashvals, &nbits, &nhashes);
+
+	filter = (bytea *) palloc0(VARHDRSZ + 1 + nbits / BITS_PER_BYTE);
+	SET_VARSIZE(filter, VARHDRSZ + 1 + nbits / BITS_PER_BYTE);
+	*((unsigned char *) VARDATA(filter)) = (unsigned char) nhashes;
+	bitmap = (unsigned char *) VARDATA(filter) + 1;
+
+	for (i = 0; i < nhashvals; i++)
+	{
+		uint32		h1 = (uint32) hashvals[i];
+		uint32		h2 = (uint32) (hashvals[i] >> 32) | 1;
+		int			j;
+
+		for (j = 0; j < nhashes; j++)
+		{
+			uint64		bit = ((uint64) h1 + (uint64) j * h2) & (nbits - 1);
+
+			bitmap[bit / BITS_PER_BYTE] |= 1 << (bit % BITS_PER_BYTE);
+		}
+	}
+
+	return filter;
+}
+
+/*
+ * pgfdw_plus_bloom_match
+ *		Test whether a value may be contained in a Bloom filter built by
+ *		pgfdw_bloom_filter_create().
+ */
+Datum
+pgfdw_plus_bloom_match(PG_FUNCTION_ARGS)
+{
+	bytea	   *filter = PG_GETARG_BYTEA_PP(0);
+	Datum		value = PG_GETARG_DATUM(1);
+	TypeCacheEntry *typentry = (TypeCacheEntry *) fcinfo->flinfo->fn_extra;
+	unsigned char *bitmap;
+	uint64		nbits;
+	int			nhashes;
+	uint64		hashval;
+	uint32		h1;
+	uint32		h2;
+	int			j;
+
+	if (typentry == NULL)
+	{
+		Oid			typid = get_fn_expr_argtype(fcinfo->flinfo, 1);
+
+		typentry = lookup_type_cache(typid,
+									 TYPECACHE_HASH_EXTENDED_PROC_FINFO);
+		if (!OidIsValid(typentry->hash_extended_proc_finfo.fn_oid))
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_FUNCTION),
+					 errmsg("could not identify an extended hash function for type %s",
+							format_type_be(typid))));
+		fcinfo->flinfo->fn_extra = (void *) typentry;
+	}
+
+	if (VARSIZE_ANY_EXHDR(filter) < 2)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid Bloom filter")));
+	nhashes = *((unsigned char *) VARDATA_ANY(filter));
+	bitmap = (unsigned char *) VARDATA_ANY(filter) + 1;
+	nbits = (uint64) (VARSIZE_ANY_EXHDR(filter) - 1) * BITS_PER_BYTE;
+	if ((nbits & (nbits - 1)) != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("invalid Bloom filter")));
+
+	hashval = DatumGetUInt64(FunctionCall2Coll(&typentry->hash_extended_proc_finfo,
+											   PG_GET_COLLATION(),
+											   value,
+											   UInt64GetDatum(0)));
+	h1 = (uint32) hashval;
+	h2 = (uint32) (hashval >> 32) | 1;
+
+	for (j = 0; j < nhashes; j++)
+	{
+		uint64		bit = ((uint64) h1 + (uint64) j * h2) & (nbits - 1);
+
+		if ((bitmap[bit / BITS_PER_BYTE] & (1 << (bit % BITS_PER_BYTE))) == 0)
+			PG_RETURN_BOOL(false);
+	}
+
+	PG_RETURN_BOOL(true);
+}
+
+/*
+ * Discovery of shippable user-defined functions and operators
+ *
+ * pgfdw_plus_discover_shippable() checks which of the user-defined
+ * functions and operators that don't belong to any extension exist with
+ * the same definition on the given server, and records the results in
+ * pgfdw_plus.shippable table, which is_shippable() consults.
+ *
+ * Only immutable functions written in SQL or PL/pgSQL are candidates, as
+ * we can't compare the definitions of functions in other languages.  Such
+ * a function is considered to be the same remotely if the function of the
+ * same signature there has the same language, return type, volatility,
+ * strictness and configuration settings, and its body has the same MD5
+ * hash.  An operator is
+ * considered to be the same if the operator of the same signature there is
+ * implemented by the function of the same signature, which must be
+ * built-in or itself found to be the same.
+ *
+ * The hash of the local definition of each candidate is recorded with the
+ * result, so that load_discovered_shippable() can ignore the results for
+ * the objects changed afterwards.
+ */
+
+/*
+ * pgfdw_plus_discover_shippable
+ *		Discover user-defined functions and operators shippable to the given
+ *		server, and return the results of the check.
+ */
+Datum
+pgfdw_plus_discover_shippable(PG_FUNCTION_ARGS)
+{
+	char	   *servername = NameStr(*PG_GETARG_NAME(0));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	ForeignServer *server;
+	ForeignDataWrapper *fdw;
+	UserMapping *user;
+	PGconn	   *conn;
+	List	   *funcs;
+	List	   *opers;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	server = GetForeignServerByName(servername, false);
+	fdw = GetForeignDataWrapper(server->fdwid);
+	if (strcmp(fdw->fdwname, "postgres_fdw") != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("foreign data wrapper of specified server must be \"postgres_fdw\"")));
+
+	funcs = pgfdw_collect_candidate_functions();
+
+	user = GetUserMapping(GetUserId(), server->serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/* Operators depend on the results for the functions */
+	pgfdw_verify_candidates(conn, funcs, ProcedureRelationId);
+	opers = pgfdw_collect_candidate_operators(funcs);
+	pgfdw_verify_candidates(conn, opers, OperatorRelationId);
+
+	ReleaseConnection(conn);
+
+	funcs = list_concat(funcs, opers);
+	pgfdw_store_discovered_shippable(server->serverid, funcs);
+
+	foreach(lc, funcs)
+	{
+		ShippableCandidate *cand = (ShippableCandidate *) lfirst(lc);
+		Datum		values[3];
+		bool		nulls[3] = {0};
+
+		values[0] = CStringGetTextDatum(cand->classid == ProcedureRelationId ?
+										"function" : "operator");
+		values[1] = CStringGetTextDatum(cand->signature);
+		values[2] = BoolGetDatum(cand->shippable);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Collect the user-defined functions that are candidates for discovery.
+ */
+static List *
+pgfdw_collect_candidate_functions(void)
+{
+	List	   *result = NIL;
+	Oid			plpgsql = get_language_oid("plpgsql", true);
+	Relation	rel;
+	SysScanDesc scan;
+	HeapTuple	tup;
+
+	rel = table_open(ProcedureRelationId, AccessShareLock);
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_proc proc = (Form_pg_proc) GETSTRUCT(tup);
+		ShippableCandidate *cand;
+		Datum		prosrc;
+		Datum		proconfig;
+		text	   *src;
+		bool		isnull;
+		const char *errstr = NULL;
+
+		if (proc->oid < FirstNormalObjectId ||
+			proc->prokind != PROKIND_FUNCTION ||
+			proc->provolatile != PROVOLATILE_IMMUTABLE)
+			continue;
+		if (proc->prolang != SQLlanguageId &&
+			(!OidIsValid(plpgsql) || proc->prolang != plpgsql))
+			continue;
+
+		/* SQL-standard function bodies are not stored as text */
+		if (!heap_attisnull(tup, Anum_pg_proc_prosqlbody,
+							RelationGetDescr(rel)))
+			continue;
+		prosrc = heap_getattr(tup, Anum_pg_proc_prosrc,
+							  RelationGetDescr(rel), &isnull);
+		if (isnull)
+			continue;
+
+		/* Members of extensions are handled by "extensions" option */
+		if (OidIsValid(getExtensionOfObject(ProcedureRelationId, proc->oid)))
+			continue;
+
+		cand = (ShippableCandidate *) palloc0(sizeof(ShippableCandidate));
+		cand->classid = ProcedureRelationId;
+		cand->objid = proc->oid;
+		cand->signature = format_procedure_qualified(proc->oid);
+		src = DatumGetTextPP(prosrc);
+		if (!pg_md5_hash(VARDATA_ANY(src), VARSIZE_ANY_EXHDR(src),
+						 cand->srchash, &errstr))
+			ereport(ERROR,
+					(errcode(ERRCODE_OUT_OF_MEMORY),
+					 errmsg("could not compute MD5 hash: %s", errstr)));
+		cand->lanname = get_language_name(proc->prolang, false);
+		cand->strict = proc->proisstrict;
+		cand->retset = proc->proretset;
+		cand->rettype = format_type_be_qualified(proc->prorettype);
+		proconfig = heap_getattr(tup, Anum_pg_proc_proconfig,
+								 RelationGetDescr(rel), &isnull);
+		if (!isnull)
+			cand->config = DatumGetCString(OidFunctionCall1(F_ARRAY_OUT,
+															proconfig));
+		if (!pgfdw_shippable_definition_hash(ProcedureRelationId, proc->oid,
+											 cand->defhash))
+			cand->defhash[0] = '\0';
+		result = lappend(result, cand);
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Collect the user-defined operators that are candidates for discovery.
+ * Operators whose underlying functions are neither built-in nor found to be
+ * shippable in funcs are included, but already marked as not shippable.
+ */
+static List *
+pgfdw_collect_candidate_operators(List *funcs)
+{
+	List	   *result = NIL;
+	Relation	rel;
+	SysScanDesc scan;
+	HeapTuple	tup;
+
+	rel = table_open(OperatorRelationId, AccessShareLock);
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_operator oper = (Form_pg_operator) GETSTRUCT(tup);
+		ShippableCandidate *cand;
+		bool		code_shippable;
+		ListCell   *lc;
+
+		if (oper->oid < FirstNormalObjectId || !OidIsValid(oper->oprcode))
+			continue;
+		if (OidIsValid(getExtensionOfObject(OperatorRelationId, oper->oid)))
+			continue;
+
+		code_shippable = is_builtin(oper->oprcode);
+		foreach(lc, funcs)
+		{
+			ShippableCandidate *func = (ShippableCandidate *) lfirst(lc);
+
+			if (func->objid == oper->oprcode)
+			{
+				code_shippable = func->shippable;
+				break;
+			}
+		}
+
+		cand = (ShippableCandidate *) palloc0(sizeof(ShippableCandidate));
+		cand->classid = OperatorRelationId;
+		cand->objid = oper->oid;
+		cand->signature = format_operator_qualified(oper->oid);
+		cand->oprcode = code_shippable ? oper->oprcode : InvalidOid;
+		if (code_shippable)
+			cand->codesig = format_procedure_qualified(oper->oprcode);
+		if (!pgfdw_shippable_definition_hash(OperatorRelationId, oper->oid,
+											 cand->defhash))
+			cand->defhash[0] = '\0';
+		result = lappend(result, cand);
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Check on the remote server which of the given candidates in the given
+ * catalog have the same definition there, and mark them as shippable.
+ */
+static void
+pgfdw_verify_candidates(PGconn *conn, List *candidates, Oid classid)
+{
+	PGresult   *volatile res = NULL;
+	StringInfoData buf;
+	bool		first = true;
+	ListCell   *lc;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf, "SELECT v.i FROM (VALUES ");
+	foreach(lc, candidates)
+	{
+		ShippableCandidate *cand = (ShippableCandidate *) lfirst(lc);
+
+		/* Operators on non-shippable functions needn't be checked */
+		if (classid == OperatorRelationId && !OidIsValid(cand->oprcode))
+			continue;
+
+		if (!first)
+			appendStringInfoString(&buf, ", ");
+		first = false;
+
+		appendStringInfo(&buf, "(%d, ", foreach_current_index(lc));
+		deparseStringLiteral(&buf, cand->signature);
+		if (classid == ProcedureRelationId)
+		{
+			appendStringInfoString(&buf, ", ");
+			deparseStringLiteral(&buf, cand->srchash);
+			appendStringInfoString(&buf, ", ");
+			deparseStringLiteral(&buf, cand->lanname);
+			appendStringInfo(&buf, ", %s, %s, ",
+							 cand->strict ? "true" : "false",
+							 cand->retset ? "true" : "false");
+			deparseStringLiteral(&buf, cand->rettype);
+			appendStringInfoString(&buf, ", ");
+			if (cand->config)
+				deparseStringLiteral(&buf, cand->config);
+			else
+				appendStringInfoString(&buf, "NULL::text");
+		}
+		else
+		{
+			appendStringInfoString(&buf, ", ");
+			deparseStringLiteral(&buf, cand->codesig);
+		}
+		appendStringInfoChar(&buf, ')');
+	}
+	if (first)
+		return;
+
+	if (classid == ProcedureRelationId)
+		appendStringInfoString(&buf,
+							   ") v(i, sig, srchash, lanname, strict, retset, rettype, config)"
+							   " WHERE EXISTS (SELECT 1 FROM pg_catalog.pg_proc p"
+							   " JOIN pg_catalog.pg_language l ON l.oid = p.prolang"
+							   " WHERE p.oid = pg_catalog.to_regprocedure(v.sig)"
+							   " AND p.prosqlbody IS NULL"
+							   " AND pg_catalog.md5(p.prosrc) = v.srchash"
+							   " AND l.lanname = v.lanname"
+							   " AND p.provolatile = 'i'"
+							   " AND p.proisstrict = v.strict"
+							   " AND p.proretset = v.retset"
+							   " AND p.prorettype = pg_catalog.to_regtype(v.rettype)"
+							   " AND p.proconfig IS NOT DISTINCT FROM v.config::pg_catalog.text[])");
+	else
+		appendStringInfoString(&buf,
+							   ") v(i, sig, codesig)"
+							   " WHERE EXISTS (SELECT 1 FROM pg_catalog.pg_operator o"
+							   " WHERE o.oid = pg_catalog.to_regoperator(v.sig)"
+							   " AND o.oprcode = pg_catalog.to_regprocedure(v.codesig))");
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		int			i;
+
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+		for (i = 0; i < PQntuples(res); i++)
+		{
+			ShippableCandidate *cand;
+
+			cand = (ShippableCandidate *)
+				list_nth(candidates, atoi(PQgetvalue(res, i, 0)));
+			cand->shippable = true;
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	pfree(buf.data);
+}
+
+/*
+ * Replace the shippability decisions recorded for the given server with the
+ * results for the given candidates.
+ */
+static void
+pgfdw_store_discovered_shippable(Oid serverid, List *candidates)
+{
+	Oid			namespaceId;
+	Oid			relId;
+	Relation	rel;
+	ScanKeyData skey;
+	SysScanDesc scan;
+	HeapTuple	tup;
+	ListCell   *lc;
+
+	/*
+	 * Look up the table to store the decisions.  Note that we don't verify
+	 * we have enough permissions on it, nor run object access hooks for it,
+	 * as in pgfdw_insert_xact_commits().
+	 */
+	namespaceId = get_namespace_oid(PGFDW_PLUS_SCHEMA, false);
+	relId = get_relname_relid(PGFDW_PLUS_SHIPPABLE_TABLE, namespaceId);
+	if (!OidIsValid(relId))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("relation \"%s.%s\" does not exist",
+						PGFDW_PLUS_SCHEMA,
+						PGFDW_PLUS_SHIPPABLE_TABLE)));
+
+	rel = table_open(relId, RowExclusiveLock);
+
+	ScanKeyInit(&skey,
+				Anum_pgfdw_plus_shippable_serverid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(serverid));
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 1, &skey);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+		CatalogTupleDelete(rel, &tup->t_self);
+	systable_endscan(scan);
+
+	foreach(lc, candidates)
+	{
+		ShippableCandidate *cand = (ShippableCandidate *) lfirst(lc);
+		Datum		values[PGFDW_PLUS_SHIPPABLE_COLS];
+		bool		nulls[PGFDW_PLUS_SHIPPABLE_COLS];
+
+		MemSet(nulls, 0, sizeof(nulls));
+		values[Anum_pgfdw_plus_shippable_serverid - 1] =
+			ObjectIdGetDatum(serverid);
+		values[Anum_pgfdw_plus_shippable_classid - 1] =
+			ObjectIdGetDatum(cand->classid);
+		values[Anum_pgfdw_plus_shippable_objid - 1] =
+			ObjectIdGetDatum(cand->objid);
+		values[Anum_pgfdw_plus_shippable_shippable - 1] =
+			BoolGetDatum(cand->shippable);
+		if (cand->defhash[0] != '\0')
+			values[Anum_pgfdw_plus_shippable_defhash - 1] =
+				CStringGetTextDatum(cand->defhash);
+		else
+			nulls[Anum_pgfdw_plus_shippable_defhash - 1] = true;
+
+		tup = heap_form_tuple(RelationGetDescr(rel), values, nulls);
+		CatalogTupleInsert(rel, tup);
+		heap_freetuple(tup);
+	}
+
+	/* Make backends reload the decisions into their shippability caches */
+	CacheInvalidateRelcache(rel);
+
+	table_close(rel, NoLock);
+}
+
+/*
+ * Import of remote index metadata
+ *
+ * pgfdw_plus_import_remote_indexes() fetches the definitions of the btree
+ * indexes of the remote tables of all the foreign tables on the given
+ * server, and records them in pgfdw_plus.remote_indexes table, in terms of
+ * the columns of the foreign tables.  pgfdw_get_remote_indexes() turns
+ * them into hypothetical indexes on the foreign tables for the planner.
+ *
+ * Only the leading key columns of an index that are plain columns of the
+ * remote table using their default operator classes and collations are
+ * recorded, since only those can be matched with the local columns.  Partial
+ * indexes, and indexes not valid yet, are ignored.  An index is recorded as
+ * unique only if it is a non-deferrable unique index all of whose key
+ * columns are recorded.  Even then, the planner is told that it's unique
+ * only if the trust_remote_unique option is enabled, since nothing keeps
+ * the remote index from being dropped or changed afterwards, and wrong
+ * uniqueness leads to wrong results of join removal and unique joins.
+ */
+
+/*
+ * pgfdw_plus_import_remote_indexes
+ *		Import the definitions of the remote indexes for the foreign tables on
+ *		the given server, and return them.
+ */
+Datum
+pgfdw_plus_import_remote_indexes(PG_FUNCTION_ARGS)
+{
+	char	   *servername = NameStr(*PG_GETARG_NAME(0));
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	ForeignServer *server;
+	ForeignDataWrapper *fdw;
+	UserMapping *user;
+	PGconn	   *conn;
+	List	   *tables;
+	List	   *indexes = NIL;
+	ListCell   *lc;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	server = GetForeignServerByName(servername, false);
+	fdw = GetForeignDataWrapper(server->fdwid);
+	if (strcmp(fdw->fdwname, "postgres_fdw") != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("foreign data wrapper of specified server must be \"postgres_fdw\"")));
+
+	tables = pgfdw_collect_foreign_tables(server->serverid);
+
+	if (tables != NIL)
+	{
+		user = GetUserMapping(GetUserId(), server->serverid);
+		conn = GetConnection(user, false, NULL);
+		indexes = pgfdw_fetch_remote_indexes(conn, tables);
+		ReleaseConnection(conn);
+	}
+
+	pgfdw_store_remote_indexes(tables, indexes);
+
+	foreach(lc, indexes)
+	{
+		RemoteIndex *index = (RemoteIndex *) lfirst(lc);
+		ForeignTableColumns *table = index->table;
+		Datum		values[4];
+		bool		nulls[4] = {0};
+		NameData	indexname;
+		StringInfoData buf;
+		int			i;
+
+		initStringInfo(&buf);
+		for (i = 0; i < index->nkeys; i++)
+		{
+			AttrNumber	attnum = index->indkey[i];
+
+			if (i > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfoString(&buf,
+								   quote_identifier(get_attname(table->relid,
+																attnum,
+																false)));
+			if (index->indoption[i] & INDOPTION_DESC)
+				appendStringInfoString(&buf, " DESC");
+			if ((index->indoption[i] & INDOPTION_NULLS_FIRST) &&
+				!(index->indoption[i] & INDOPTION_DESC))
+				appendStringInfoString(&buf, " NULLS FIRST");
+			if (!(index->indoption[i] & INDOPTION_NULLS_FIRST) &&
+				(index->indoption[i] & INDOPTION_DESC))
+				appendStringInfoString(&buf, " NULLS LAST");
+		}
+
+		namestrcpy(&indexname, index->indexname);
+		values[0] = ObjectIdGetDatum(table->relid);
+		values[1] = NameGetDatum(&indexname);
+		values[2] = BoolGetDatum(index->indisunique);
+		values[3] = CStringGetTextDatum(buf.data);
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+							 values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+/*
+ * Collect the foreign tables on the given server, with the names of their
+ * remote tables and columns.
+ */
+static List *
+pgfdw_collect_foreign_tables(Oid serverid)
+{
+	List	   *result = NIL;
+	Relation	rel;
+	ScanKeyData skey;
+	SysScanDesc scan;
+	HeapTuple	tup;
+
+	rel = table_open(ForeignTableRelationId, AccessShareLock);
+	ScanKeyInit(&skey,
+				Anum_pg_foreign_table_ftserver,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(serverid));
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 1, &skey);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_foreign_table ftform = (Form_pg_foreign_table) GETSTRUCT(tup);
+
+		result = lappend(result, pgfdw_describe_foreign_table(ftform->ftrelid));
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Describe the given foreign table with the names of its remote table and
+ * columns.
+ */
+static ForeignTableColumns *
+pgfdw_describe_foreign_table(Oid relid)
+{
+	ForeignTableColumns *table;
+	ForeignTable *ftable;
+	Relation	ftrel;
+	TupleDesc	tupdesc;
+	ListCell   *lc;
+	int			i;
+
+	table = (ForeignTableColumns *) palloc0(sizeof(ForeignTableColumns));
+	table->relid = relid;
+	table->nspname = get_namespace_name(get_rel_namespace(table->relid));
+	table->relname = get_rel_name(table->relid);
+
+	/* Use the remote names from the options, as deparseRelation() does */
+	ftable = GetForeignTable(table->relid);
+	foreach(lc, ftable->options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "schema_name") == 0)
+			table->nspname = defGetString(def);
+		else if (strcmp(def->defname, "table_name") == 0)
+			table->relname = defGetString(def);
+	}
+
+	ftrel = table_open(table->relid, AccessShareLock);
+	tupdesc = RelationGetDescr(ftrel);
+	table->natts = tupdesc->natts;
+	table->colnames = (char **) palloc0(table->natts * sizeof(char *));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		List	   *options;
+
+		if (attr->attisdropped)
+			continue;
+
+		table->colnames[i] = pstrdup(NameStr(attr->attname));
+		options = GetForeignColumnOptions(table->relid, attr->attnum);
+		foreach(lc, options)
+		{
+			DefElem    *def = (DefElem *) lfirst(lc);
+
+			if (strcmp(def->defname, "column_name") == 0)
+				table->colnames[i] = defGetString(def);
+		}
+	}
+	table_close(ftrel, AccessShareLock);
+
+	return table;
+}
+
+/*
+ * Fetch the definitions of the btree indexes of the remote tables of the
+ * given foreign tables.
+ */
+static List *
+pgfdw_fetch_remote_indexes(PGconn *conn, List *tables)
+{
+	List	   *result = NIL;
+	PGresult   *volatile res = NULL;
+	StringInfoData buf;
+	ListCell   *lc;
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf,
+						   "SELECT v.i, ic.relname,"
+						   " x.indisunique AND x.indimmediate, k.n,"
+						   " CASE WHEN opc.opcdefault AND"
+						   " (x.indcollation[k.n - 1] = 0 OR"
+						   " x.indcollation[k.n - 1] = a.attcollation)"
+						   " THEN a.attname END,"
+						   " x.indoption[k.n - 1]"
+						   " FROM (VALUES ");
+	foreach(lc, tables)
+	{
+		ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+
+		if (foreach_current_index(lc) > 0)
+			appendStringInfoString(&buf, ", ");
+		appendStringInfo(&buf, "(%d, ", foreach_current_index(lc));
+		deparseStringLiteral(&buf, table->nspname);
+		appendStringInfoString(&buf, ", ");
+		deparseStringLiteral(&buf, table->relname);
+		appendStringInfoChar(&buf, ')');
+	}
+	appendStringInfo(&buf,
+					 ") v(i, nspname, relname)"
+					 " JOIN pg_catalog.pg_namespace n ON n.nspname = v.nspname"
+					 " JOIN pg_catalog.pg_class t ON t.relnamespace = n.oid"
+					 " AND t.relname = v.relname"
+					 " JOIN pg_catalog.pg_index x ON x.indrelid = t.oid"
+					 " JOIN pg_catalog.pg_class ic ON ic.oid = x.indexrelid"
+					 " JOIN pg_catalog.pg_am am ON am.oid = ic.relam"
+					 " CROSS JOIN LATERAL pg_catalog.generate_series(1, x.%s) k(n)"
+					 " LEFT JOIN pg_catalog.pg_attribute a ON a.attrelid = t.oid"
+					 " AND a.attnum = x.indkey[k.n - 1]"
+					 " LEFT JOIN pg_catalog.pg_opclass opc"
+					 " ON opc.oid = x.indclass[k.n - 1]"
+					 " WHERE am.amname = 'btree' AND x.indisvalid"
+					 " AND x.indpred IS NULL"
+					 " ORDER BY v.i, ic.relname, k.n",
+					 PQserverVersion(conn) >= 110000 ? "indnkeyatts" : "indnatts");
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		RemoteIndex *index = NULL;
+		bool		usable = false;
+		int			i;
+
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+		for (i = 0; i < PQntuples(res); i++)
+		{
+			ForeignTableColumns *table;
+			int			keyno = atoi(PQgetvalue(res, i, 3));
+			AttrNumber	attnum = InvalidAttrNumber;
+
+			table = (ForeignTableColumns *)
+				list_nth(tables, atoi(PQgetvalue(res, i, 0)));
+
+			/* The first key column starts a new index */
+			if (keyno == 1)
+			{
+				index = (RemoteIndex *) palloc0(sizeof(RemoteIndex));
+				index->table = table;
+				index->indexname = pstrdup(PQgetvalue(res, i, 1));
+				index->indisunique = (strcmp(PQgetvalue(res, i, 2), "t") == 0);
+				index->indkey = (int16 *) palloc0(INDEX_MAX_KEYS * sizeof(int16));
+				index->indoption = (int16 *) palloc0(INDEX_MAX_KEYS * sizeof(int16));
+				usable = true;
+			}
+			if (!usable || keyno > INDEX_MAX_KEYS)
+				continue;
+
+			/* Look up the foreign table column mapped to the key column */
+			if (!PQgetisnull(res, i, 4))
+			{
+				char	   *attname = PQgetvalue(res, i, 4);
+				int			j;
+
+				for (j = 0; j < table->natts; j++)
+				{
+					if (table->colnames[j] &&
+						strcmp(table->colnames[j], attname) == 0)
+					{
+						attnum = j + 1;
+						break;
+					}
+				}
+			}
+
+			/* The rest of the key columns are useless without this one */
+			if (attnum == InvalidAttrNumber)
+			{
+				index->indisunique = false;
+				usable = false;
+				continue;
+			}
+
+			index->indkey[index->nkeys] = attnum;
+			index->indoption[index->nkeys] = atoi(PQgetvalue(res, i, 5));
+			if (index->nkeys++ == 0)
+				result = lappend(result, index);
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	pfree(buf.data);
+
+	return result;
+}
+
+/*
+ * Replace the remote indexes recorded for the given foreign tables with the
+ * given ones.
+ */
+static void
+pgfdw_store_remote_indexes(List *tables, List *indexes)
+{
+	Relation	rel;
+	SysScanDesc scan;
+	HeapTuple	tup;
+	ListCell   *lc;
+
+	rel = pgfdw_open_remote_indexes();
+
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		bool		isnull;
+		Datum		ftrelid;
+
+		ftrelid = heap_getattr(tup, Anum_pgfdw_plus_remote_indexes_ftrelid,
+							   RelationGetDescr(rel), &isnull);
+		if (isnull)
+			continue;
+
+		/* Remove the leftovers of dropped foreign tables too */
+		if (get_rel_relkind(DatumGetObjectId(ftrelid)) != RELKIND_FOREIGN_TABLE)
+		{
+			CatalogTupleDelete(rel, &tup->t_self);
+			continue;
+		}
+
+		foreach(lc, tables)
+		{
+			ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+
+			if (table->relid == DatumGetObjectId(ftrelid))
+			{
+				CatalogTupleDelete(rel, &tup->t_self);
+				break;
+			}
+		}
+	}
+	systable_endscan(scan);
+
+	pgfdw_insert_remote_indexes(rel, indexes);
+
+	/* Make backends replan the queries on the foreign tables */
+	foreach(lc, tables)
+	{
+		ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+
+		CacheInvalidateRelcacheByRelid(table->relid);
+	}
+
+	table_close(rel, NoLock);
+}
+
+/*
+ * Open pgfdw_plus.remote_indexes table to modify it.
+ */
+static Relation
+pgfdw_open_remote_indexes(void)
+{
+	Oid			namespaceId;
+	Oid			relId;
+
+	/*
+	 * Look up the table to store the indexes.  Note that we don't verify we
+	 * have enough permissions on it, nor run object access hooks for it, as
+	 * in pgfdw_insert_xact_commits().
+	 */
+	namespaceId = get_namespace_oid(PGFDW_PLUS_SCHEMA, false);
+	relId = get_relname_relid(PGFDW_PLUS_REMOTE_INDEXES_TABLE, namespaceId);
+	if (!OidIsValid(relId))
+		ereport(ERROR,
+				(errcode(ERRCODE_UNDEFINED_TABLE),
+				 errmsg("relation \"%s.%s\" does not exist",
+						PGFDW_PLUS_SCHEMA,
+						PGFDW_PLUS_REMOTE_INDEXES_TABLE)));
+
+	return table_open(relId, RowExclusiveLock);
+}
+
+/*
+ * Record the given remote indexes in pgfdw_plus.remote_indexes table.
+ */
+static void
+pgfdw_insert_remote_indexes(Relation rel, List *indexes)
+{
+	ListCell   *lc;
+
+	foreach(lc, indexes)
+	{
+		RemoteIndex *index = (RemoteIndex *) lfirst(lc);
+		Datum		values[PGFDW_PLUS_REMOTE_INDEXES_COLS];
+		bool		nulls[PGFDW_PLUS_REMOTE_INDEXES_COLS];
+		Datum	   *indkey;
+		Datum	   *indoption;
+		NameData	indexname;
+		HeapTuple	tup;
+		int			i;
+
+		indkey = (Datum *) palloc(index->nkeys * sizeof(Datum));
+		indoption = (Datum *) palloc(index->nkeys * sizeof(Datum));
+		for (i = 0; i < index->nkeys; i++)
+		{
+			indkey[i] = Int16GetDatum(index->indkey[i]);
+			indoption[i] = Int16GetDatum(index->indoption[i]);
+		}
+
+		MemSet(nulls, 0, sizeof(nulls));
+		namestrcpy(&indexname, index->indexname);
+		values[Anum_pgfdw_plus_remote_indexes_ftrelid - 1] =
+			ObjectIdGetDatum(index->table->relid);
+		values[Anum_pgfdw_plus_remote_indexes_indexname - 1] =
+			NameGetDatum(&indexname);
+		values[Anum_pgfdw_plus_remote_indexes_indisunique - 1] =
+			BoolGetDatum(index->indisunique);
+		values[Anum_pgfdw_plus_remote_indexes_indkey - 1] =
+			PointerGetDatum(construct_array_builtin(indkey, index->nkeys,
+													INT2OID));
+		values[Anum_pgfdw_plus_remote_indexes_indoption - 1] =
+			PointerGetDatum(construct_array_builtin(indoption, index->nkeys,
+													INT2OID));
+
+		tup = heap_form_tuple(RelationGetDescr(rel), values, nulls);
+		CatalogTupleInsert(rel, tup);
+		heap_freetuple(tup);
+	}
+}
+
+/*
+ * pgfdw_get_remote_indexes
+ *		Return the remote indexes recorded for the given foreign table as a
+ *		list of hypothetical IndexOptInfos for baserel.
+ *
+ * We use them to consider sort orders and parameterized paths the remote
+ * server can support without remote estimates.  If the trust_remote_unique
+ * option is enabled, the planner can also use the unique ones to prove the
+ * uniqueness of the columns, e.g., for join estimation and join removal.
+ * Since the indexes are marked hypothetical, nothing tries to access them
+ * locally.
+ */
+List *
+pgfdw_get_remote_indexes(RelOptInfo *baserel, Oid foreigntableid)
+{
+	List	   *result = NIL;
+	Oid			namespaceId;
+	Oid			relId;
+	Oid			indexId;
+	bool		trust_unique;
+	Relation	rel;
+	ScanKeyData skey;
+	SysScanDesc scan;
+	HeapTuple	tup;
+
+	namespaceId = get_namespace_oid(PGFDW_PLUS_SCHEMA, true);
+	if (!OidIsValid(namespaceId))
+		return NIL;
+	relId = get_relname_relid(PGFDW_PLUS_REMOTE_INDEXES_TABLE, namespaceId);
+	if (!OidIsValid(relId))
+		return NIL;
+
+	/*
+	 * This is done for every foreign table in every query being planned, so
+	 * look up the rows through the primary key on (ftrelid, indexname).
+	 */
+	indexId = get_relname_relid(PGFDW_PLUS_REMOTE_INDEXES_PKEY, namespaceId);
+	trust_unique = pgfdw_trust_remote_unique(foreigntableid);
+
+	rel = table_open(relId, AccessShareLock);
+	ScanKeyInit(&skey,
+				Anum_pgfdw_plus_remote_indexes_ftrelid,
+				BTEqualStrategyNumber, F_OIDEQ,
+				ObjectIdGetDatum(foreigntableid));
+	scan = systable_beginscan(rel, indexId, OidIsValid(indexId),
+							  NULL, 1, &skey);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Datum		values[PGFDW_PLUS_REMOTE_INDEXES_COLS];
+		bool		nulls[PGFDW_PLUS_REMOTE_INDEXES_COLS];
+		Datum	   *indkey;
+		Datum	   *indoption;
+		int			nkeys;
+		int			noptions;
+		IndexOptInfo *info;
+
+		heap_deform_tuple(tup, RelationGetDescr(rel), values, nulls);
+		if (nulls[Anum_pgfdw_plus_remote_indexes_indisunique - 1] ||
+			nulls[Anum_pgfdw_plus_remote_indexes_indkey - 1] ||
+			nulls[Anum_pgfdw_plus_remote_indexes_indoption - 1])
+			continue;
+
+		deconstruct_array_builtin(DatumGetArrayTypeP(values[Anum_pgfdw_plus_remote_indexes_indkey - 1]),
+								  INT2OID, &indkey, NULL, &nkeys);
+		deconstruct_array_builtin(DatumGetArrayTypeP(values[Anum_pgfdw_plus_remote_indexes_indoption - 1]),
+								  INT2OID, &indoption, NULL, &noptions);
+		if (nkeys != noptions)
+			continue;
+
+		info = pgfdw_build_remote_index(baserel, foreigntableid,
+										trust_unique &&
+										DatumGetBool(values[Anum_pgfdw_plus_remote_indexes_indisunique - 1]),
+										indkey, indoption, nkeys);
+		if (info)
+			result = lappend(result, info);
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	return result;
+}
+
+/*
+ * Return the value of the trust_remote_unique option for the given foreign
+ * table; the option specified for the table takes precedence over that for
+ * its server.
+ */
+static bool
+pgfdw_trust_remote_unique(Oid foreigntableid)
+{
+	ForeignTable *table = GetForeignTable(foreigntableid);
+	ForeignServer *server = GetForeignServer(table->serverid);
+	List	   *options;
+	bool		trust_unique = false;
+	ListCell   *lc;
+
+	options = list_concat(list_copy(server->options), table->options);
+	foreach(lc, options)
+	{
+		DefElem    *def = (DefElem *) lfirst(lc);
+
+		if (strcmp(def->defname, "trust_remote_unique") == 0)
+			trust_unique = defGetBoolean(def);
+	}
+	list_free(options);
+
+	return trust_unique;
+}
+
+/*
+ * Build a hypothetical btree IndexOptInfo for baserel on the given columns
+ * of the foreign table.  The index is truncated before any column that no
+ * longer exists or has no default btree operator class (and then it's no
+ * longer unique); NULL is returned if nothing is left.
+ */
+static IndexOptInfo *
+pgfdw_build_remote_index(RelOptInfo *baserel, Oid foreigntableid,
+						 bool unique, Datum *indkey, Datum *indoption,
+						 int nkeys)
+{
+	IndexOptInfo *info = makeNode(IndexOptInfo);
+	int			ncolumns = 0;
+	int			i;
+
+	info->indexoid = InvalidOid;
+	info->reltablespace = InvalidOid;
+	info->rel = baserel;
+	info->tree_height = -1;
+	info->relam = BTREE_AM_OID;
+	info->indexkeys = (int *) palloc(sizeof(int) * nkeys);
+	info->indexcollations = (Oid *) palloc(sizeof(Oid) * nkeys);
+	info->opfamily = (Oid *) palloc(sizeof(Oid) * nkeys);
+	info->opcintype = (Oid *) palloc(sizeof(Oid) * nkeys);
+	info->canreturn = (bool *) palloc0(sizeof(bool) * nkeys);
+	info->reverse_sort = (bool *) palloc(sizeof(bool) * nkeys);
+	info->nulls_first = (bool *) palloc(sizeof(bool) * nkeys);
+
+	for (i = 0; i < nkeys; i++)
+	{
+		AttrNumber	attnum = DatumGetInt16(indkey[i]);
+		int16		option = DatumGetInt16(indoption[i]);
+		HeapTuple	atttup;
+		Form_pg_attribute attform;
+		Oid			opclass;
+		Var		   *var;
+
+		atttup = SearchSysCacheAttNum(foreigntableid, attnum);
+		if (!HeapTupleIsValid(atttup))
+			break;
+		attform = (Form_pg_attribute) GETSTRUCT(atttup);
+		opclass = GetDefaultOpClass(attform->atttypid, BTREE_AM_OID);
+		if (!OidIsValid(opclass))
+		{
+			ReleaseSysCache(atttup);
+			break;
+		}
+
+		info->indexkeys[ncolumns] = attnum;
+		info->indexcollations[ncolumns] = attform->attcollation;
+		info->opfamily[ncolumns] = get_opclass_family(opclass);
+		info->opcintype[ncolumns] = get_opclass_input_type(opclass);
+		info->reverse_sort[ncolumns] = (option & INDOPTION_DESC) != 0;
+		info->nulls_first[ncolumns] = (option & INDOPTION_NULLS_FIRST) != 0;
+
+		var = makeVar(baserel->relid, attnum, attform->atttypid,
+					  attform->atttypmod, attform->attcollation, 0);
+		info->indextlist = lappend(info->indextlist,
+								   makeTargetEntry((Expr *) var,
+												   ncolumns + 1,
+												   NULL,
+												   false));
+		ReleaseSysCache(atttup);
+		ncolumns++;
+	}
+
+	if (ncolumns == 0)
+		return NULL;
+
+	info->ncolumns = info->nkeycolumns = ncolumns;
+
+	/* btree indexes use the same operator families for sorting */
+	info->sortopfamily = info->opfamily;
+
+	info->unique = unique && ncolumns == nkeys;
+	info->immediate = true;
+	info->hypothetical = true;
+
+	/* Describe what the remote btree index can do */
+	info->amoptionalkey = true;
+	info->amsearcharray = true;
+	info->amsearchnulls = true;
+	info->amhasgettuple = true;
+	info->amhasgetbitmap = true;
+	info->amcanparallel = true;
+	info->amcanmarkpos = true;
+
+	return info;
+}
+
+/*
+ * Shared-memory cache of remote estimates
+ *
+ * With use_remote_estimate, the planner runs a remote EXPLAIN for every
+ * candidate path of foreign scans, joins and upper relations.  To avoid
+ * repeating them in every backend and for every execution of the same
+ * query, their results are cached in shared memory for
+ * postgres_fdw.remote_estimate_cache_ttl, keyed by the foreign server, the
+ * user mapping and the EXPLAIN command.  All the cached estimates are
+ * invalidated when a foreign table is analyzed, or when the options of a
+ * foreign server, user mapping or foreign table are changed.
+ *
+ * The cache is available only when postgres_fdw_plus is loaded via
+ * shared_preload_libraries and postgres_fdw.remote_estimate_cache_size is
+ * more than zero.
+ */
+
+/*
+ * Install the hooks to set up the shared memory of postgres_fdw_plus, for
+ * the cache of remote estimates and the network statistics of foreign
+ * servers.
+ */
+void
+InstallShmemHooksForPgFdwPlus(void)
+{
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = pgfdw_shmem_request;
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = pgfdw_shmem_startup;
+
+	if (pgfdw_remote_estimate_cache_size <= 0)
+		return;
+
+	/*
+	 * Register the callbacks invalidating the cache.  Those are inherited by
+	 * all the backends, so that the backend changing the options always
+	 * invalidates the cache by itself.
+	 */
+	CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+								  pgfdw_remote_estimate_inval_callback,
+								  (Datum) 0);
+	CacheRegisterSyscacheCallback(USERMAPPINGOID,
+								  pgfdw_remote_estimate_inval_callback,
+								  (Datum) 0);
+	CacheRegisterSyscacheCallback(FOREIGNTABLEREL,
+								  pgfdw_remote_estimate_inval_callback,
+								  (Datum) 0);
+}
+
+/*
+ * Request the shared memory and the locks of postgres_fdw_plus.
+ */
+static void
+pgfdw_shmem_request(void)
+{
+	Size		size;
+
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	size = MAXALIGN(sizeof(RemoteEstimateCacheState));
+	if (pgfdw_remote_estimate_cache_size > 0)
+		size = add_size(size,
+						hash_estimate_size(pgfdw_remote_estimate_cache_size,
+										   sizeof(RemoteEstimateEntry)));
+	size = add_size(size, hash_estimate_size(PGFDW_MAX_NETWORK_STATS,
+											 sizeof(NetworkStatsEntry)));
+	RequestAddinShmemSpace(size);
+	RequestNamedLWLockTranche("postgres_fdw_plus", 2);
+}
+
+/*
+ * Create or attach to the shared memory of postgres_fdw_plus.
+ */
+static void
+pgfdw_shmem_startup(void)
+{
+	HASHCTL		ctl;
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	remote_estimate_state =
+		ShmemInitStruct("postgres_fdw_plus remote estimate cache",
+						sizeof(RemoteEstimateCacheState), &found);
+	if (!found)
+	{
+		LWLockPadded *locks = GetNamedLWLockTranche("postgres_fdw_plus");
+
+		remote_estimate_state->lock = &locks[0].lock;
+		remote_estimate_state->network_lock = &locks[1].lock;
+		pg_atomic_init_u64(&remote_estimate_state->epoch, 0);
+	}
+
+	if (pgfdw_remote_estimate_cache_size > 0)
+	{
+		ctl.keysize = sizeof(RemoteEstimateKey);
+		ctl.entrysize = sizeof(RemoteEstimateEntry);
+		remote_estimate_hash =
+			ShmemInitHash("postgres_fdw_plus remote estimate hash",
+						  pgfdw_remote_estimate_cache_size,
+						  pgfdw_remote_estimate_cache_size,
+						  &ctl, HASH_ELEM | HASH_BLOBS);
+	}
+
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(NetworkStatsEntry);
+	network_stats_hash =
+		ShmemInitHash("postgres_fdw_plus network stats hash",
+					  PGFDW_MAX_NETWORK_STATS, PGFDW_MAX_NETWORK_STATS,
+					  &ctl, HASH_ELEM | HASH_BLOBS);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+/*
+ * Invalidate all the cached remote estimates.
+ */
+void
+pgfdw_invalidate_remote_estimates(void)
+{
+	if (remote_estimate_state != NULL)
+		pg_atomic_fetch_add_u64(&remote_estimate_state->epoch, 1);
+}
+
+/*
+ * Syscache invalidation callback for the cache of remote estimates.
+ *
+ * We don't bother to find out which estimates depend on the changed object;
+ * changes of foreign servers, user mappings and foreign tables are rare
+ * enough to just invalidate all of them.
+ */
+static void
+pgfdw_remote_estimate_inval_callback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	pgfdw_invalidate_remote_estimates();
+}
+
+/*
+ * Look up the estimates of the given remote EXPLAIN command in the cache.
+ *
+ * Returns true and sets the estimates if valid ones are found.
+ */
+bool
+pgfdw_lookup_remote_estimate(UserMapping *user, const char *sql,
+							 double *rows, int *width,
+							 Cost *startup_cost, Cost *total_cost)
+{
+	RemoteEstimateKey key;
+	RemoteEstimateEntry *entry;
+	TimestampTz now;
+	bool		found = false;
+
+	if (remote_estimate_hash == NULL || pgfdw_remote_estimate_cache_ttl <= 0)
+		return false;
+
+	pgfdw_remote_estimate_key(&key, user, sql);
+	now = GetCurrentTimestamp();
+
+	LWLockAcquire(remote_estimate_state->lock, LW_SHARED);
+	entry = (RemoteEstimateEntry *) hash_search(remote_estimate_hash, &key,
+												HASH_FIND, NULL);
+	if (entry != NULL && pgfdw_remote_estimate_is_valid(entry, now))
+	{
+		*rows = entry->rows;
+		*width = entry->width;
+		*startup_cost = entry->startup_cost;
+		*total_cost = entry->total_cost;
+		found = true;
+	}
+	LWLockRelease(remote_estimate_state->lock);
+
+	return found;
+}
+
+/*
+ * Store the estimates of the given remote EXPLAIN command in the cache.
+ *
+ * epoch must be the value returned by pgfdw_remote_estimate_epoch() before
+ * the remote EXPLAIN was run, so that the estimates are not cached as valid
+ * if the cache was invalidated in the meantime.
+ */
+void
+pgfdw_store_remote_estimate(UserMapping *user, const char *sql, uint64 epoch,
+							double rows, int width,
+							Cost startup_cost, Cost total_cost)
+{
+	RemoteEstimateKey key;
+	RemoteEstimateEntry *entry;
+	TimestampTz now;
+
+	if (remote_estimate_hash == NULL || pgfdw_remote_estimate_cache_ttl <= 0)
+		return;
+
+	pgfdw_remote_estimate_key(&key, user, sql);
+	now = GetCurrentTimestamp();
+
+	LWLockAcquire(remote_estimate_state->lock, LW_EXCLUSIVE);
+	entry = (RemoteEstimateEntry *) hash_search(remote_estimate_hash, &key,
+												HASH_FIND, NULL);
+	if (entry == NULL)
+	{
+		/* Make room for the new entry if the cache is full */
+		if (hash_get_num_entries(remote_estimate_hash) >=
+			pgfdw_remote_estimate_cache_size)
+			pgfdw_evict_remote_estimates(now);
+		entry = (RemoteEstimateEntry *) hash_search(remote_estimate_hash,
+													&key, HASH_ENTER_NULL,
+													NULL);
+	}
+	if (entry != NULL)
+	{
+		entry->epoch = epoch;
+		entry->cached_at = now;
+		entry->rows = rows;
+		entry->width = width;
+		entry->startup_cost = startup_cost;
+		entry->total_cost = total_cost;
+	}
+	LWLockRelease(remote_estimate_state->lock);
+}
+
+/*
+ * Return the current invalidation epoch of the cache of remote estimates.
+ */
+uint64
+pgfdw_remote_estimate_epoch(void)
+{
+	if (remote_estimate_state == NULL)
+		return 0;
+	return pg_atomic_read_u64(&remote_estimate_state->epoch);
+}
+
+/*
+ * Build the hash key of the given remote EXPLAIN command.
+ */
+static void
+pgfdw_remote_estimate_key(RemoteEstimateKey *key, UserMapping *user,
+						  const char *sql)
+{
+	/* Zero the padding bytes, as the key is hashed as a blob */
+	memset(key, 0, sizeof(RemoteEstimateKey));
+	key->serverid = user->serverid;
+	key->umid = user->umid;
+	key->sqllen = strlen(sql);
+	key->sqlhash = hash_bytes_extended((const unsigned char *) sql,
+									   key->sqllen, 0);
+}
+
+/*
+ * Is the cached entry neither invalidated nor expired?
+ */
+static bool
+pgfdw_remote_estimate_is_valid(RemoteEstimateEntry *entry, TimestampTz now)
+{
+	return entry->epoch == pg_atomic_read_u64(&remote_estimate_state->epoch) &&
+		!TimestampDifferenceExceeds(entry->cached_at, now,
+									pgfdw_remote_estimate_cache_ttl * 1000);
+}
+
+/*
+ * Remove the invalidated and expired entries from the cache, or the oldest
+ * entry if there's none.  The caller must hold the lock exclusively.
+ */
+static void
+pgfdw_evict_remote_estimates(TimestampTz now)
+{
+	HASH_SEQ_STATUS scan;
+	RemoteEstimateEntry *entry;
+	RemoteEstimateKey oldest;
+	TimestampTz oldest_at = DT_NOEND;
+	bool		removed = false;
+
+	hash_seq_init(&scan, remote_estimate_hash);
+	while ((entry = (RemoteEstimateEntry *) hash_seq_search(&scan)) != NULL)
+	{
+		if (!pgfdw_remote_estimate_is_valid(entry, now))
+		{
+			hash_search(remote_estimate_hash, &entry->key, HASH_REMOVE, NULL);
+			removed = true;
+		}
+		else if (entry->cached_at < oldest_at)
+		{
+			oldest = entry->key;
+			oldest_at = entry->cached_at;
+		}
+	}
+
+	if (!removed && oldest_at != DT_NOEND)
+		hash_search(remote_estimate_hash, &oldest, HASH_REMOVE, NULL);
+}
+
+/*
+ * Network cost model
+ *
+ * The round-trip time and the bandwidth of the network link to each foreign
+ * server are measured by pgfdw_plus_calibrate_network(), and the round-trip
+ * time also passively whenever a remote transaction is started.  For the
+ * servers with use_network_cost enabled, estimate_path_cost_size() uses them
+ * to cost the round trips and the bytes transferred by a foreign scan,
+ * instead of fdw_startup_cost and fdw_tuple_cost.
+ */
+
+/*
+ * Overhead, in bytes, of transferring a row in addition to its data: the
+ * header of a DataRow message and the lengths of a few columns
+ */
+#define PGFDW_ROW_TRANSFER_OVERHEAD		24
+
+/* Number of bytes transferred to measure the bandwidth */
+#define PGFDW_CALIBRATION_BYTES			(4 * 1024 * 1024)
+
+/* Number of times each measurement is repeated, to take the best one */
+#define PGFDW_CALIBRATION_ROUNDS		5
+
+/*
+ * pgfdw_plus_calibrate_network
+ *
+ * Measure the round-trip time and the bandwidth of the network link to the
+ * given foreign server, and record them for the network cost model.
+ */
+Datum
+pgfdw_plus_calibrate_network(PG_FUNCTION_ARGS)
+{
+	char	   *servername = NameStr(*PG_GETARG_NAME(0));
+	ForeignServer *server;
+	ForeignDataWrapper *fdw;
+	UserMapping *user;
+	PGconn	   *conn;
+	TupleDesc	tupdesc;
+	Datum		values[2];
+	bool		nulls[2] = {0};
+	double		rtt_ms = -1;
+	double		transfer_ms = -1;
+	double		ms_per_byte;
+	char		sql[64];
+	int			i;
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	server = GetForeignServerByName(servername, false);
+	fdw = GetForeignDataWrapper(server->fdwid);
+	if (strcmp(fdw->fdwname, "postgres_fdw") != 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("foreign data wrapper of specified server must be \"postgres_fdw\"")));
+
+	user = GetUserMapping(GetUserId(), server->serverid);
+	conn = GetConnection(user, false, NULL);
+
+	/*
+	 * Take the shortest times of a trivial query and of a query returning
+	 * a large value, which are the least disturbed by other activity.
+	 */
+	snprintf(sql, sizeof(sql), "SELECT pg_catalog.repeat('x', %d)",
+			 PGFDW_CALIBRATION_BYTES);
+	for (i = 0; i < PGFDW_CALIBRATION_ROUNDS; i++)
+	{
+		double		ms;
+
+		ms = pgfdw_measure_query(conn, "SELECT 1");
+		if (rtt_ms < 0 || ms < rtt_ms)
+			rtt_ms = ms;
+		ms = pgfdw_measure_query(conn, sql);
+		if (transfer_ms < 0 || ms < transfer_ms)
+			transfer_ms = ms;
+	}
+
+	ReleaseConnection(conn);
+
+	ms_per_byte = Max(transfer_ms - rtt_ms, 0.001) / PGFDW_CALIBRATION_BYTES;
+	pgfdw_store_network_stats(server->serverid, rtt_ms, ms_per_byte);
+
+	values[0] = Float8GetDatum(rtt_ms);
+	values[1] = Float8GetDatum(1000.0 / (ms_per_byte * 1024 * 1024));
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values,
+													  nulls)));
+}
+
+/*
+ * Run the given query on the remote server, and return the elapsed time in
+ * milliseconds.
+ */
+static double
+pgfdw_measure_query(PGconn *conn, const char *sql)
+{
+	PGresult   *res;
+	instr_time	start;
+	instr_time	duration;
+
+	INSTR_TIME_SET_CURRENT(start);
+	res = pgfdw_exec_query(conn, sql, NULL);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	if (PQresultStatus(res) != PGRES_TUPLES_OK)
+		pgfdw_report_error(ERROR, res, conn, true, sql);
+	PQclear(res);
+
+	return INSTR_TIME_GET_MILLISEC(duration);
+}
+
+/*
+ * Convert between a double and the bits of it kept in a pg_atomic_uint64.
+ */
+static inline uint64
+pgfdw_double_to_bits(double value)
+{
+	uint64		bits;
+
+	StaticAssertStmt(sizeof(bits) == sizeof(value),
+					 "double must be 64 bits wide");
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static inline double
+pgfdw_bits_to_double(uint64 bits)
+{
+	double		value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+/*
+ * Look up the network statistics of the given foreign server, creating the
+ * entry if requested.  The caller must hold the lock if they are in shared
+ * memory.
+ */
+static NetworkStatsEntry *
+pgfdw_network_stats_entry(Oid serverid, bool create)
+{
+	NetworkStatsEntry *entry;
+	HASHACTION	action;
+	bool		found;
+
+	/* Use backend-local memory if not set up in shared memory */
+	if (network_stats_hash == NULL)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(NetworkStatsEntry);
+		network_stats_hash = hash_create("postgres_fdw_plus network stats",
+										 16, &ctl,
+										 HASH_ELEM | HASH_BLOBS);
+	}
+
+	/* HASH_ENTER_NULL works only for the hash table in shared memory */
+	if (!create)
+		action = HASH_FIND;
+	else if (remote_estimate_state != NULL)
+		action = HASH_ENTER_NULL;
+	else
+		action = HASH_ENTER;
+
+	entry = (NetworkStatsEntry *)
+		hash_search(network_stats_hash, &serverid, action, &found);
+	if (entry != NULL && !found)
+	{
+		pg_atomic_init_u64(&entry->rtt_ms, pgfdw_double_to_bits(0));
+		entry->ms_per_byte = 0;
+		pg_atomic_init_u64(&entry->nsamples, 0);
+	}
+
+	return entry;
+}
+
+/*
+ * Record the network statistics measured for the given foreign server.
+ */
+void
+pgfdw_store_network_stats(Oid serverid, double rtt_ms, double ms_per_byte)
+{
+	NetworkStatsEntry *entry;
+
+	if (remote_estimate_state != NULL)
+		LWLockAcquire(remote_estimate_state->network_lock, LW_EXCLUSIVE);
+	entry = pgfdw_network_stats_entry(serverid, true);
+	if (entry != NULL)
+	{
+		pg_atomic_write_u64(&entry->rtt_ms, pgfdw_double_to_bits(rtt_ms));
+		entry->ms_per_byte = ms_per_byte;
+		pg_atomic_fetch_add_u64(&entry->nsamples, 1);
+	}
+	if (remote_estimate_state != NULL)
+		LWLockRelease(remote_estimate_state->network_lock);
+}
+
+/*
+ * Record a round-trip time measured passively for the given foreign server,
+ * as a moving average of them.
+ *
+ * This is done on every remote transaction start, so the lock is taken in
+ * shared mode, which is enough to update an existing entry atomically;
+ * exclusive mode is needed only to create the entry.
+ */
+void
+pgfdw_record_round_trip(Oid serverid, double ms)
+{
+	NetworkStatsEntry *entry;
+
+	if (remote_estimate_state != NULL)
+		LWLockAcquire(remote_estimate_state->network_lock, LW_SHARED);
+	entry = pgfdw_network_stats_entry(serverid, false);
+	if (entry == NULL && remote_estimate_state != NULL)
+	{
+		LWLockRelease(remote_estimate_state->network_lock);
+		LWLockAcquire(remote_estimate_state->network_lock, LW_EXCLUSIVE);
+	}
+	if (entry == NULL)
+		entry = pgfdw_network_stats_entry(serverid, true);
+	if (entry != NULL)
+	{
+		bool		first = (pg_atomic_read_u64(&entry->nsamples) == 0);
+		uint64		oldbits = pg_atomic_read_u64(&entry->rtt_ms);
+		double		rtt_ms;
+
+		/* Retry if someone else has updated it concurrently */
+		do
+		{
+			rtt_ms = pgfdw_bits_to_double(oldbits);
+			if (first)
+				rtt_ms = ms;
+			else
+				rtt_ms += (ms - rtt_ms) * PGFDW_RTT_SAMPLE_WEIGHT;
+		} while (!pg_atomic_compare_exchange_u64(&entry->rtt_ms, &oldbits,
+												 pgfdw_double_to_bits(rtt_ms)));
+		pg_atomic_fetch_add_u64(&entry->nsamples, 1);
+	}
+	if (remote_estimate_state != NULL)
+		LWLockRelease(remote_estimate_state->network_lock);
+}
+
+/*
+ * Estimate the network costs of a foreign scan on the given server,
+ * retrieving the given number of rows of the given width, fetch_size rows
+ * at a time.
+ *
+ * The startup cost covers two round trips, to declare the cursor and to
+ * fetch the first rows, and the run cost the remaining fetches and the
+ * transfer of the rows.  If the bandwidth is unknown, the transfer of each
+ * row costs fdw_tuple_cost.  Returns false if the round-trip time is unknown.
+ */
+bool
+pgfdw_network_cost(Oid serverid, double retrieved_rows, int width,
+				   int fetch_size, Cost fdw_tuple_cost,
+				   Cost *startup_cost, Cost *run_cost)
+{
+	NetworkStatsEntry *entry;
+	double		rtt_ms = 0;
+	double		ms_per_byte = 0;
+	bool		found = false;
+	double		nfetches;
+
+	if (remote_estimate_state != NULL)
+		LWLockAcquire(remote_estimate_state->network_lock, LW_SHARED);
+	entry = pgfdw_network_stats_entry(serverid, false);
+	if (entry != NULL && pg_atomic_read_u64(&entry->nsamples) > 0)
+	{
+		rtt_ms = pgfdw_bits_to_double(pg_atomic_read_u64(&entry->rtt_ms));
+		ms_per_byte = entry->ms_per_byte;
+		found = true;
+	}
+	if (remote_estimate_state != NULL)
+		LWLockRelease(remote_estimate_state->network_lock);
+
+	if (!found)
+		return false;
+
+	nfetches = ceil(retrieved_rows / Max(fetch_size, 1));
+	*startup_cost = 2 * rtt_ms * pgfdw_network_cost_per_ms;
+	*run_cost = Max(nfetches - 1, 0) * rtt_ms * pgfdw_network_cost_per_ms;
+	if (ms_per_byte > 0)
+		*run_cost += retrieved_rows * (width + PGFDW_ROW_TRANSFER_OVERHEAD) *
+			ms_per_byte * pgfdw_network_cost_per_ms;
+	else
+		*run_cost += retrieved_rows * fdw_tuple_cost;
+
+	return true;
+}
+
+/*
+ * Import of remote statistics
+ *
+ * With analyze_sampling = 'import', ANALYZE copies the column statistics
+ * and the row count of the remote table from its pg_stats and pg_class,
+ * instead of acquiring sample rows and computing them locally.
+ */
+
+/* Columns of the query built by pgfdw_deparse_remote_stats_query() */
+enum RemoteStatsColumn
+{
+	RS_TABLE,
+	RS_RELTUPLES,
+	RS_RELPAGES,
+	RS_ATTNAME,
+	RS_TYPNSP,
+	RS_TYPNAME,
+	RS_ENUMLABELS,
+	RS_COLLPROVIDER,
+	RS_COLLCOLLATE,
+	RS_COLLLOCALE,
+	RS_NULL_FRAC,
+	RS_AVG_WIDTH,
+	RS_N_DISTINCT,
+	RS_MOST_COMMON_VALS,
+	RS_MOST_COMMON_FREQS,
+	RS_HISTOGRAM_BOUNDS,
+	RS_CORRELATION,
+	RS_MOST_COMMON_ELEMS,
+	RS_MOST_COMMON_ELEM_FREQS,
+	RS_ELEM_COUNT_HISTOGRAM,
+	RS_NUM_COLUMNS
+};
+
+/*
+ * pgfdw_import_remote_stats
+ *
+ * Import the statistics of the remote table of the given foreign table into
+ * pg_statistic, and return the number of its rows into *totalrows.
+ *
+ * Returns false without changing anything if the remote statistics are
+ * missing or don't fit the foreign table, e.g., a column has a different
+ * type or collation there, so the caller should sample rows instead.  We
+ * also sample rows when the foreign table is analyzed as a child of its
+ * parent or has children of its own, which need statistics computed from
+ * the rows of all of them.
+ */
+bool
+pgfdw_import_remote_stats(Relation relation, PGconn *conn, int elevel,
+						  double *totalrows)
+{
+	ForeignTableColumns *table;
+	PGresult   *volatile res = NULL;
+	StringInfoData buf;
+	volatile bool imported = false;
+
+	if (pgfdw_analyze_target() != RelationGetRelid(relation) ||
+		relation->rd_rel->relhassubclass)
+		return false;
+
+	table = pgfdw_describe_foreign_table(RelationGetRelid(relation));
+
+	initStringInfo(&buf);
+	pgfdw_deparse_remote_stats_query(&buf, list_make1(table),
+									 PQserverVersion(conn));
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		char	   *mismatch;
+
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+		if (PQnfields(res) != RS_NUM_COLUMNS)
+			elog(ERROR, "unexpected result from remote statistics query");
+
+		mismatch = pgfdw_apply_remote_stats(relation, table, res,
+											0, PQntuples(res));
+		if (mismatch != NULL)
+			ereport(elevel,
+					(errmsg("\"%s\": could not import remote statistics, sampling rows instead",
+							RelationGetRelationName(relation)),
+					 errdetail_internal("%s", mismatch)));
+		else
+		{
+			*totalrows = strtod(PQgetvalue(res, 0, RS_RELTUPLES), NULL);
+			imported = true;
+
+			ereport(elevel,
+					(errmsg("\"%s\": table contains %.0f rows, imported remote statistics",
+							RelationGetRelationName(relation),
+							*totalrows)));
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	pfree(buf.data);
+
+	return imported;
+}
+
+/*
+ * Build the query to fetch the remote statistics of the given tables in
+ * one go.  The rows of each table are numbered by its position in the list
+ * in the RS_TABLE column, and are ordered by it.
+ *
+ * Prefer the statistics including the inheritance children, since the
+ * remote queries scan them too.  The remote search_path contains only
+ * pg_catalog, so the names in pg_stats are matched in the same way.
+ *
+ * Along with the type of each column, fetch the labels of the enum type
+ * that it or its elements are of in their sort order, and the provider and
+ * locale of its collation, or of the database for the default collation.
+ * The column holding the ICU or builtin locale was renamed in v17, and the
+ * provider of the database can't be other than libc before v15.
+ */
+static void
+pgfdw_deparse_remote_stats_query(StringInfo buf, List *tables,
+								 int server_version_num)
+{
+	ListCell   *lc;
+
+	appendStringInfo(buf,
+					 "SELECT v.i, c.reltuples, c.relpages, s.attname,"
+					 " tn.nspname, t.typname,"
+					 " (SELECT pg_catalog.array_agg(e.enumlabel"
+					 " ORDER BY e.enumsortorder)"
+					 " FROM pg_catalog.pg_enum e"
+					 " WHERE e.enumtypid IN (t.oid, t.typelem)),"
+					 " CASE co.collprovider WHEN 'd' THEN %s"
+					 " ELSE co.collprovider END,"
+					 " CASE co.collprovider WHEN 'd' THEN d.datcollate::pg_catalog.text"
+					 " ELSE co.collcollate END,"
+					 " CASE co.collprovider WHEN 'd' THEN %s ELSE %s END,",
+					 server_version_num >= 150000 ? "d.datlocprovider" :
+					 "'c'::pg_catalog.\"char\"",
+					 server_version_num >= 170000 ? "d.datlocale" :
+					 server_version_num >= 150000 ? "d.daticulocale" : "NULL",
+					 server_version_num >= 170000 ? "co.colllocale" :
+					 server_version_num >= 150000 ? "co.colliculocale" : "NULL");
+	appendStringInfoString(buf,
+						   " s.null_frac, s.avg_width, s.n_distinct,"
+						   " s.most_common_vals, s.most_common_freqs,"
+						   " s.histogram_bounds, s.correlation,"
+						   " s.most_common_elems, s.most_common_elem_freqs,"
+						   " s.elem_count_histogram"
+						   " FROM (VALUES ");
+	foreach(lc, tables)
+	{
+		ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+
+		if (foreach_current_index(lc) > 0)
+			appendStringInfoString(buf, ", ");
+		appendStringInfo(buf, "(%d, ", foreach_current_index(lc));
+		deparseStringLiteral(buf, table->nspname);
+		appendStringInfoString(buf, ", ");
+		deparseStringLiteral(buf, table->relname);
+		appendStringInfoChar(buf, ')');
+	}
+	appendStringInfoString(buf,
+						   ") v(i, nspname, relname)"
+						   " JOIN pg_catalog.pg_namespace n"
+						   " ON n.nspname = v.nspname"
+						   " JOIN pg_catalog.pg_class c"
+						   " ON c.relnamespace = n.oid AND c.relname = v.relname"
+						   " JOIN pg_catalog.pg_database d"
+						   " ON d.datname = pg_catalog.current_database()"
+						   " LEFT JOIN LATERAL (SELECT DISTINCT ON (s.attname) s.*"
+						   " FROM pg_catalog.pg_stats s"
+						   " WHERE s.schemaname = n.nspname"
+						   " AND s.tablename = c.relname"
+						   " ORDER BY s.attname, s.inherited DESC) s ON true"
+						   " LEFT JOIN pg_catalog.pg_attribute a"
+						   " ON a.attrelid = c.oid AND a.attname = s.attname"
+						   " LEFT JOIN pg_catalog.pg_type t ON t.oid = a.atttypid"
+						   " LEFT JOIN pg_catalog.pg_namespace tn"
+						   " ON tn.oid = t.typnamespace"
+						   " LEFT JOIN pg_catalog.pg_collation co"
+						   " ON co.oid = a.attcollation"
+						   " ORDER BY v.i");
+}
+
+/*
+ * Store the remote statistics in the given rows of the result into
+ * pg_statistic for the columns of the given relation, described by table.
+ *
+ * Returns a description of the reason if the remote statistics are missing
+ * or don't fit the relation, without storing anything.  Otherwise returns
+ * NULL.  The statistics of a partitioned table are stored as the ones
+ * including its children.
+ */
+static char *
+pgfdw_apply_remote_stats(Relation relation, ForeignTableColumns *table,
+						 PGresult *res, int first, int nrows)
+{
+	TupleDesc	tupdesc = RelationGetDescr(relation);
+	bool		inh = (relation->rd_rel->relkind == RELKIND_PARTITIONED_TABLE);
+	char	   *mismatch = NULL;
+	int		   *rows;
+	int			i;
+
+	/* Find the remote statistics of each column, and check them */
+	rows = (int *) palloc(tupdesc->natts * sizeof(int));
+	if (nrows == 0)
+		mismatch = psprintf("remote table \"%s.%s\" does not exist",
+							table->nspname, table->relname);
+	else if (strtod(PQgetvalue(res, first, RS_RELTUPLES), NULL) < 0)
+		mismatch = psprintf("remote table \"%s.%s\" has never been analyzed",
+							table->nspname, table->relname);
+	for (i = 0; i < tupdesc->natts && mismatch == NULL; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+		int			j;
+
+		if (attr->attisdropped)
+			continue;
+
+		rows[i] = -1;
+		for (j = first; j < first + nrows; j++)
+		{
+			if (!PQgetisnull(res, j, RS_ATTNAME) &&
+				strcmp(PQgetvalue(res, j, RS_ATTNAME),
+					   table->colnames[i]) == 0)
+			{
+				rows[i] = j;
+				break;
+			}
+		}
+
+		if (rows[i] < 0)
+			mismatch = psprintf("remote column \"%s\" has no statistics",
+								table->colnames[i]);
+		else
+			mismatch = pgfdw_remote_stats_mismatch(attr, res, rows[i]);
+	}
+
+	if (mismatch == NULL)
+	{
+		for (i = 0; i < tupdesc->natts; i++)
+		{
+			Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+			if (!attr->attisdropped)
+				pgfdw_store_remote_stats(relation, attr, inh, res, rows[i]);
+		}
+	}
+
+	pfree(rows);
+
+	return mismatch;
+}
+
+/*
+ * The foreign table named by the ANALYZE command being run, if that's the
+ * only relation it analyzes.  See pgfdw_process_utility().
+ */
+static Oid	explicit_analyze_target = InvalidOid;
+
+/*
+ * Return the OID of the relation being analyzed, which is the parent of the
+ * foreign table if it's analyzed as a child, or InvalidOid if unknown.
+ *
+ * ANALYZE doesn't tell that to the FDW.  If the command names a single
+ * foreign table without children, that's the one; otherwise we check the
+ * progress reporting.  If that's disabled, we can't tell, and the callers
+ * fall back to what they'd do for a table analyzed as a child.
+ */
+Oid
+pgfdw_analyze_target(void)
+{
+	if (OidIsValid(explicit_analyze_target))
+		return explicit_analyze_target;
+
+	if (MyBEEntry == NULL || !pgstat_track_activities)
+	{
+		elog(DEBUG1, "cannot determine the relation being analyzed because track_activities is off");
+		return InvalidOid;
+	}
+	if (MyBEEntry->st_progress_command != PROGRESS_COMMAND_ANALYZE)
+		return InvalidOid;
+	return MyBEEntry->st_progress_command_target;
+}
+
+/*
+ * Return the foreign table the given ANALYZE or VACUUM (ANALYZE) command
+ * analyzes, if it names only one and that has no children, else InvalidOid.
+ * The name is looked up without a lock; ANALYZE looks it up again itself.
+ */
+static Oid
+pgfdw_explicit_analyze_target(VacuumStmt *vstmt)
+{
+	bool		analyze = !vstmt->is_vacuumcmd;
+	VacuumRelation *vrel;
+	Oid			relid;
+	ListCell   *lc;
+
+	foreach(lc, vstmt->options)
+	{
+		DefElem    *opt = (DefElem *) lfirst(lc);
+
+		if (strcmp(opt->defname, "analyze") == 0)
+			analyze = defGetBoolean(opt);
+	}
+	if (!analyze || list_length(vstmt->rels) != 1)
+		return InvalidOid;
+
+	vrel = linitial_node(VacuumRelation, vstmt->rels);
+	relid = RangeVarGetRelid(vrel->relation, NoLock, true);
+	if (!OidIsValid(relid) ||
+		get_rel_relkind(relid) != RELKIND_FOREIGN_TABLE ||
+		has_subclass(relid))
+		return InvalidOid;
+
+	return relid;
+}
+
+/*
+ * Return true if the value in the given row and column of the remote result
+ * matches the given local value, counting two NULLs as equal.
+ */
+static bool
+pgfdw_remote_value_matches(PGresult *res, int row, int col, const char *value)
+{
+	if (PQgetisnull(res, row, col))
+		return (value == NULL);
+	return (value != NULL && strcmp(PQgetvalue(res, row, col), value) == 0);
+}
+
+/* qsort comparator for pg_enum tuples, by their sort order */
+static int
+pgfdw_enum_sortorder_cmp(const void *a, const void *b)
+{
+	Form_pg_enum ea = (Form_pg_enum) GETSTRUCT(*(const HeapTuple *) a);
+	Form_pg_enum eb = (Form_pg_enum) GETSTRUCT(*(const HeapTuple *) b);
+
+	if (ea->enumsortorder < eb->enumsortorder)
+		return -1;
+	if (ea->enumsortorder > eb->enumsortorder)
+		return 1;
+	return 0;
+}
+
+/*
+ * Return the labels of the given enum type in their sort order, formatted
+ * as the remote statistics query does, or NULL if it has none.
+ */
+static char *
+pgfdw_enum_labels(Oid enumtypid)
+{
+	CatCList   *list;
+	HeapTuple  *tuples;
+	Datum	   *labels;
+	ArrayType  *arr;
+	char	   *result = NULL;
+	int			i;
+
+	list = SearchSysCacheList1(ENUMTYPOIDNAME, ObjectIdGetDatum(enumtypid));
+	if (list->n_members > 0)
+	{
+		tuples = (HeapTuple *) palloc(list->n_members * sizeof(HeapTuple));
+		for (i = 0; i < list->n_members; i++)
+			tuples[i] = &list->members[i]->tuple;
+		qsort(tuples, list->n_members, sizeof(HeapTuple),
+			  pgfdw_enum_sortorder_cmp);
+
+		labels = (Datum *) palloc(list->n_members * sizeof(Datum));
+		for (i = 0; i < list->n_members; i++)
+		{
+			Form_pg_enum en = (Form_pg_enum) GETSTRUCT(tuples[i]);
+
+			labels[i] = NameGetDatum(&en->enumlabel);
+		}
+		arr = construct_array_builtin(labels, list->n_members, NAMEOID);
+		result = OidOutputFunctionCall(F_ARRAY_OUT, PointerGetDatum(arr));
+		pfree(arr);
+		pfree(labels);
+		pfree(tuples);
+	}
+	ReleaseCatCacheList(list);
+
+	return result;
+}
+
+/*
+ * Return the enum type that the values of the given type or its elements
+ * are of, or InvalidOid if none.
+ */
+static Oid
+pgfdw_stats_enum_type(Oid typid)
+{
+	Oid			elemtypid;
+
+	if (type_is_enum(typid))
+		return typid;
+	elemtypid = get_element_type(typid);
+	if (OidIsValid(elemtypid) && type_is_enum(elemtypid))
+		return elemtypid;
+	return InvalidOid;
+}
+
+/*
+ * Get the provider and locale settings of the given collation, or of the
+ * database for the default collation, in the same way as the remote
+ * statistics query does.  The returned strings can be NULL.
+ */
+static void
+pgfdw_collation_locale(Oid collid, char *provider, char **collate,
+					   char **locale)
+{
+	HeapTuple	tup;
+	Datum		datum;
+	bool		isnull;
+
+	tup = SearchSysCache1(COLLOID, ObjectIdGetDatum(collid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for collation %u", collid);
+	*provider = ((Form_pg_collation) GETSTRUCT(tup))->collprovider;
+
+	if (*provider != COLLPROVIDER_DEFAULT)
+	{
+		datum = SysCacheGetAttr(COLLOID, tup, Anum_pg_collation_collcollate,
+								&isnull);
+		*collate = isnull ? NULL : TextDatumGetCString(datum);
+		datum = SysCacheGetAttr(COLLOID, tup, Anum_pg_collation_colllocale,
+								&isnull);
+		*locale = isnull ? NULL : TextDatumGetCString(datum);
+		ReleaseSysCache(tup);
+		return;
+	}
+	ReleaseSysCache(tup);
+
+	tup = SearchSysCache1(DATABASEOID, ObjectIdGetDatum(MyDatabaseId));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for database %u", MyDatabaseId);
+	*provider = ((Form_pg_database) GETSTRUCT(tup))->datlocprovider;
+	datum = SysCacheGetAttr(DATABASEOID, tup, Anum_pg_database_datcollate,
+							&isnull);
+	*collate = isnull ? NULL : TextDatumGetCString(datum);
+	datum = SysCacheGetAttr(DATABASEOID, tup, Anum_pg_database_datlocale,
+							&isnull);
+	*locale = isnull ? NULL : TextDatumGetCString(datum);
+	ReleaseSysCache(tup);
+}
+
+/*
+ * Check whether the remote statistics in the given row of the result fit
+ * the given column of the foreign table.  Returns a description of the
+ * mismatch, or NULL if they fit.
+ *
+ * The values in the statistics can be read locally only if the remote
+ * column has the type of the same name.  If the values are of an enum type,
+ * it must have the same labels in the same sort order, and if the column is
+ * collatable, its collation must have the same provider and locale, so that
+ * the values are ordered in the same way on both sides.  Domains over enum
+ * types are never trusted, as their labels aren't fetched.
+ */
+static char *
+pgfdw_remote_stats_mismatch(Form_pg_attribute attr, PGresult *res, int row)
+{
+	HeapTuple	tup;
+	Form_pg_type typform;
+	char	   *typnsp;
+	Oid			enumtypid;
+	bool		match;
+
+	if (PQgetisnull(res, row, RS_TYPNAME))
+		return psprintf("remote column \"%s\" does not exist",
+						PQgetvalue(res, row, RS_ATTNAME));
+
+	tup = SearchSysCache1(TYPEOID, ObjectIdGetDatum(attr->atttypid));
+	if (!HeapTupleIsValid(tup))
+		elog(ERROR, "cache lookup failed for type %u", attr->atttypid);
+	typform = (Form_pg_type) GETSTRUCT(tup);
+	typnsp = get_namespace_name(typform->typnamespace);
+	match = (strcmp(typnsp, PQgetvalue(res, row, RS_TYPNSP)) == 0 &&
+			 strcmp(NameStr(typform->typname),
+					PQgetvalue(res, row, RS_TYPNAME)) == 0);
+	ReleaseSysCache(tup);
+	if (!match)
+		return psprintf("remote column \"%s\" is of type %s.%s, but local column \"%s\" is of type %s",
+						PQgetvalue(res, row, RS_ATTNAME),
+						PQgetvalue(res, row, RS_TYPNSP),
+						PQgetvalue(res, row, RS_TYPNAME),
+						NameStr(attr->attname),
+						format_type_be_qualified(attr->atttypid));
+
+	if (getBaseType(attr->atttypid) != attr->atttypid &&
+		OidIsValid(pgfdw_stats_enum_type(getBaseType(attr->atttypid))))
+		return psprintf("local column \"%s\" is of a domain over an enum type",
+						NameStr(attr->attname));
+
+	enumtypid = pgfdw_stats_enum_type(attr->atttypid);
+	if (OidIsValid(enumtypid))
+		match = pgfdw_remote_value_matches(res, row, RS_ENUMLABELS,
+										   pgfdw_enum_labels(enumtypid));
+	else
+		match = PQgetisnull(res, row, RS_ENUMLABELS);
+	if (!match)
+		return psprintf("remote column \"%s\" has enum labels different from local column \"%s\"",
+						PQgetvalue(res, row, RS_ATTNAME),
+						NameStr(attr->attname));
+
+	if (!OidIsValid(attr->attcollation))
+		match = PQgetisnull(res, row, RS_COLLPROVIDER);
+	else
+	{
+		char		provider;
+		char	   *collate;
+		char	   *locale;
+
+		pgfdw_collation_locale(attr->attcollation, &provider, &collate,
+							   &locale);
+		match = (!PQgetisnull(res, row, RS_COLLPROVIDER) &&
+				 PQgetvalue(res, row, RS_COLLPROVIDER)[0] == provider &&
+				 pgfdw_remote_value_matches(res, row, RS_COLLCOLLATE, collate) &&
+				 pgfdw_remote_value_matches(res, row, RS_COLLLOCALE, locale));
+	}
+	if (!match)
+		return psprintf("remote column \"%s\" has a collation of a different provider or locale from local column \"%s\"",
+						PQgetvalue(res, row, RS_ATTNAME),
+						NameStr(attr->attname));
+
+	return NULL;
+}
+
+/*
+ * Store the remote statistics in the given row of the result into
+ * pg_statistic for the given column of the relation, in the same way as
+ * update_attstats() does for the statistics computed by ANALYZE.  inh tells
+ * whether they are the statistics including the children of the relation.
+ *
+ * The slots are filled as the standard typanalyze functions do, since that's
+ * how the remote server has computed what pg_stats shows.
+ */
+static void
+pgfdw_store_remote_stats(Relation relation, Form_pg_attribute attr, bool inh,
+						 PGresult *res, int row)
+{
+	Datum		values[Natts_pg_statistic];
+	bool		nulls[Natts_pg_statistic];
+	bool		replaces[Natts_pg_statistic];
+	TypeCacheEntry *typentry;
+	Oid			elemtype;
+	Oid			elemeqopr = InvalidOid;
+	Oid			elemcoll = attr->attcollation;
+	Relation	sd;
+	HeapTuple	oldtup;
+	HeapTuple	stup;
+	int			k = 0;
+
+	typentry = lookup_type_cache(attr->atttypid,
+								 TYPECACHE_EQ_OPR | TYPECACHE_LT_OPR);
+
+	/* The elements of tsvector are stored as text, see ts_typanalyze() */
+	if (attr->atttypid == TSVECTOROID)
+	{
+		elemtype = TEXTOID;
+		elemcoll = DEFAULT_COLLATION_OID;
+	}
+	else
+		elemtype = get_base_element_type(attr->atttypid);
+	if (OidIsValid(elemtype))
+		elemeqopr = lookup_type_cache(elemtype, TYPECACHE_EQ_OPR)->eq_opr;
+
+	memset(nulls, false, sizeof(nulls));
+	memset(replaces, true, sizeof(replaces));
+
+	values[Anum_pg_statistic_starelid - 1] =
+		ObjectIdGetDatum(RelationGetRelid(relation));
+	values[Anum_pg_statistic_staattnum - 1] = Int16GetDatum(attr->attnum);
+	values[Anum_pg_statistic_stainherit - 1] = BoolGetDatum(inh);
+	values[Anum_pg_statistic_stanullfrac - 1] =
+		Float4GetDatum(strtod(PQgetvalue(res, row, RS_NULL_FRAC), NULL));
+	values[Anum_pg_statistic_stawidth - 1] =
+		Int32GetDatum(atoi(PQgetvalue(res, row, RS_AVG_WIDTH)));
+	values[Anum_pg_statistic_stadistinct - 1] =
+		Float4GetDatum(strtod(PQgetvalue(res, row, RS_N_DISTINCT), NULL));
+
+	if (!PQgetisnull(res, row, RS_MOST_COMMON_VALS) &&
+		!PQgetisnull(res, row, RS_MOST_COMMON_FREQS) &&
+		OidIsValid(typentry->eq_opr))
+		pgfdw_fill_stats_slot(values, nulls, k++,
+							  STATISTIC_KIND_MCV, typentry->eq_opr,
+							  attr->attcollation,
+							  PQgetvalue(res, row, RS_MOST_COMMON_FREQS),
+							  PQgetvalue(res, row, RS_MOST_COMMON_VALS),
+							  attr->atttypid);
+	if (!PQgetisnull(res, row, RS_HISTOGRAM_BOUNDS) &&
+		OidIsValid(typentry->lt_opr))
+		pgfdw_fill_stats_slot(values, nulls, k++,
+							  STATISTIC_KIND_HISTOGRAM, typentry->lt_opr,
+							  attr->attcollation, NULL,
+							  PQgetvalue(res, row, RS_HISTOGRAM_BOUNDS),
+							  attr->atttypid);
+	if (!PQgetisnull(res, row, RS_CORRELATION) &&
+		OidIsValid(typentry->lt_opr))
+		pgfdw_fill_stats_slot(values, nulls, k++,
+							  STATISTIC_KIND_CORRELATION, typentry->lt_opr,
+							  attr->attcollation,
+							  psprintf("{%s}",
+									   PQgetvalue(res, row, RS_CORRELATION)),
+							  NULL, InvalidOid);
+	if (!PQgetisnull(res, row, RS_MOST_COMMON_ELEMS) &&
+		!PQgetisnull(res, row, RS_MOST_COMMON_ELEM_FREQS) &&
+		OidIsValid(elemeqopr))
+		pgfdw_fill_stats_slot(values, nulls, k++,
+							  STATISTIC_KIND_MCELEM, elemeqopr, elemcoll,
+							  PQgetvalue(res, row, RS_MOST_COMMON_ELEM_FREQS),
+							  PQgetvalue(res, row, RS_MOST_COMMON_ELEMS),
+							  elemtype);
+	if (!PQgetisnull(res, row, RS_ELEM_COUNT_HISTOGRAM) &&
+		OidIsValid(elemeqopr))
+		pgfdw_fill_stats_slot(values, nulls, k++,
+							  STATISTIC_KIND_DECHIST, elemeqopr, elemcoll,
+							  PQgetvalue(res, row, RS_ELEM_COUNT_HISTOGRAM),
+							  NULL, InvalidOid);
+	for (; k < STATISTIC_NUM_SLOTS; k++)
+		pgfdw_fill_stats_slot(values, nulls, k, 0, InvalidOid, InvalidOid,
+							  NULL, NULL, InvalidOid);
+
+	/* Is there already a pg_statistic tuple for this attribute? */
+	sd = table_open(StatisticRelationId, RowExclusiveLock);
+	oldtup = SearchSysCache3(STATRELATTINH,
+							 ObjectIdGetDatum(RelationGetRelid(relation)),
+							 Int16GetDatum(attr->attnum),
+							 BoolGetDatum(inh));
+	if (HeapTupleIsValid(oldtup))
+	{
+		/* Yes, replace it */
+		stup = heap_modify_tuple(oldtup, RelationGetDescr(sd),
+								 values, nulls, replaces);
+		ReleaseSysCache(oldtup);
+		CatalogTupleUpdate(sd, &stup->t_self, stup);
+	}
+	else
+	{
+		/* No, insert new tuple */
+		stup = heap_form_tuple(RelationGetDescr(sd), values, nulls);
+		CatalogTupleInsert(sd, stup);
+	}
+	heap_freetuple(stup);
+	table_close(sd, RowExclusiveLock);
+}
+
+/*
+ * Fill the k'th slot of the pg_statistic tuple being built, reading the
+ * stanumbers and stavalues arrays from their text representations.  Either
+ * of them can be NULL if the kind of statistics doesn't use it.
+ */
+static void
+pgfdw_fill_stats_slot(Datum *values, bool *nulls, int k,
+					  int16 kind, Oid opr, Oid coll,
+					  char *numbers, char *vals, Oid valtype)
+{
+	Assert(k < STATISTIC_NUM_SLOTS);
+
+	values[Anum_pg_statistic_stakind1 - 1 + k] = Int16GetDatum(kind);
+	values[Anum_pg_statistic_staop1 - 1 + k] = ObjectIdGetDatum(opr);
+	values[Anum_pg_statistic_stacoll1 - 1 + k] = ObjectIdGetDatum(coll);
+	if (numbers != NULL)
+		values[Anum_pg_statistic_stanumbers1 - 1 + k] =
+			OidInputFunctionCall(F_ARRAY_IN, numbers, FLOAT4OID, -1);
+	else
+		nulls[Anum_pg_statistic_stanumbers1 - 1 + k] = true;
+	if (vals != NULL)
+		values[Anum_pg_statistic_stavalues1 - 1 + k] =
+			OidInputFunctionCall(F_ARRAY_IN, vals, valtype, -1);
+	else
+		nulls[Anum_pg_statistic_stavalues1 - 1 + k] = true;
+}
+
+/*
+ * Import of metadata by IMPORT FOREIGN SCHEMA
+ *
+ * With import_statistics, import_indexes or import_partitions option,
+ * postgresImportForeignSchema() calls pgfdw_import_schema_metadata(), which
+ * creates the local partitioned tables with their partitions if requested,
+ * and fetches the remote statistics and the remote indexes of all the
+ * imported tables with one query each.  The foreign tables that the core
+ * code creates from the commands returned by postgresImportForeignSchema()
+ * don't exist yet then, so their metadata is kept in import_state until
+ * the ProcessUtility hook sees them created.
+ */
+
+/*
+ * The metadata of an imported table, waiting for the table to be created
+ */
+typedef struct ImportMetadataEntry
+{
+	char		relname[NAMEDATALEN];	/* hash key: local table name */
+	ForeignTableColumns *table; /* table and its remote names */
+	int			stats_row;		/* first row of its remote statistics */
+	int			stats_nrows;	/* number of those rows */
+	List	   *indexes;		/* its remote indexes, list of RemoteIndex */
+	bool		applied;		/* already stored for the table? */
+} ImportMetadataEntry;
+
+/*
+ * State of IMPORT FOREIGN SCHEMA importing metadata
+ */
+typedef struct ImportMetadataState
+{
+	char	   *servername;		/* foreign server imported from */
+	char	   *local_schema;	/* local schema imported into */
+	HTAB	   *entries;		/* hash table of ImportMetadataEntry */
+	PGresult   *stats_res;		/* remote statistics, or NULL */
+} ImportMetadataState;
+
+/* IMPORT FOREIGN SCHEMA in progress, if it imports metadata */
+static ImportMetadataState *import_state = NULL;
+
+/* Saved hook value in case of unload */
+static ProcessUtility_hook_type prev_ProcessUtility_hook = NULL;
+
+static List *pgfdw_create_imported_partitions(PGconn *conn,
+											  ImportForeignSchemaStmt *stmt,
+											  ForeignServer *server,
+											  List *tables);
+static void pgfdw_execute_import_command(const char *sql);
+static ForeignTableColumns *pgfdw_describe_local_table(Oid relid,
+													   char *nspname,
+													   char *relname);
+static void pgfdw_apply_import_metadata(ImportMetadataEntry *entry,
+										Oid relid);
+static void pgfdw_forget_import_metadata(void *arg);
+static void pgfdw_process_utility(PlannedStmt *pstmt, const char *queryString,
+								  bool readOnlyTree,
+								  ProcessUtilityContext context,
+								  ParamListInfo params,
+								  QueryEnvironment *queryEnv,
+								  DestReceiver *dest, QueryCompletion *qc);
+
+/*
+ * pgfdw_import_schema_metadata
+ *
+ * Import the metadata of the given tables being imported by the given
+ * IMPORT FOREIGN SCHEMA command.  The partitioned tables among them are
+ * created here together with all their partitions, as local partitioned
+ * tables and foreign tables respectively.
+ */
+void
+pgfdw_import_schema_metadata(PGconn *conn, ImportForeignSchemaStmt *stmt,
+							 ForeignServer *server, List *tables,
+							 bool import_statistics, bool import_indexes)
+{
+	ImportMetadataState *state;
+	MemoryContextCallback *cb;
+	HASHCTL		ctl;
+	List	   *described;
+	List	   *foreign_tables = NIL;
+	List	   *indexes = NIL;
+	ListCell   *index_cell;
+	ListCell   *lc;
+	int			row = 0;
+
+	/* Forget the state when IMPORT FOREIGN SCHEMA is done */
+	state = (ImportMetadataState *) palloc0(sizeof(ImportMetadataState));
+	state->servername = pstrdup(server->servername);
+	state->local_schema = pstrdup(stmt->local_schema);
+	ctl.keysize = NAMEDATALEN;
+	ctl.entrysize = sizeof(ImportMetadataEntry);
+	ctl.hcxt = CurrentMemoryContext;
+	state->entries = hash_create("postgres_fdw imported tables",
+								 Max(list_length(tables), 16), &ctl,
+								 HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+
+	cb = (MemoryContextCallback *) palloc0(sizeof(MemoryContextCallback));
+	cb->func = pgfdw_forget_import_metadata;
+	cb->arg = state;
+	MemoryContextRegisterResetCallback(CurrentMemoryContext, cb);
+	import_state = state;
+
+	/*
+	 * Create the partitioned tables and their partitions first, and describe
+	 * them in terms of their local columns.  The other tables are going to
+	 * be created from their remote columns in the same order.
+	 */
+	described = pgfdw_create_imported_partitions(conn, stmt, server, tables);
+	foreach(lc, tables)
+	{
+		PgFdwImportedTable *imported = (PgFdwImportedTable *) lfirst(lc);
+		ForeignTableColumns *table;
+		ListCell   *lc2;
+
+		if (imported->command != NULL)
+			continue;
+
+		table = (ForeignTableColumns *) palloc0(sizeof(ForeignTableColumns));
+		table->relid = InvalidOid;
+		table->nspname = stmt->remote_schema;
+		table->relname = imported->relname;
+		table->natts = list_length(imported->colnames);
+		table->colnames = (char **) palloc(table->natts * sizeof(char *));
+		foreach(lc2, imported->colnames)
+			table->colnames[foreach_current_index(lc2)] = lfirst(lc2);
+		described = lappend(described, table);
+	}
+
+	foreach(lc, described)
+	{
+		ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+
+		if (!OidIsValid(table->relid) ||
+			get_rel_relkind(table->relid) == RELKIND_FOREIGN_TABLE)
+			foreign_tables = lappend(foreign_tables, table);
+	}
+
+	/* Fetch the remote statistics of all the tables */
+	if (import_statistics && described != NIL)
+	{
+		StringInfoData buf;
+
+		initStringInfo(&buf);
+		pgfdw_deparse_remote_stats_query(&buf, described,
+										 PQserverVersion(conn));
+
+		/* The callback above frees the result */
+		state->stats_res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(state->stats_res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, state->stats_res, conn, false, buf.data);
+		if (PQnfields(state->stats_res) != RS_NUM_COLUMNS)
+			elog(ERROR, "unexpected result from remote statistics query");
+		pfree(buf.data);
+	}
+
+	/* Fetch the remote indexes of all the foreign tables */
+	if (import_indexes && foreign_tables != NIL)
+		indexes = pgfdw_fetch_remote_indexes(conn, foreign_tables);
+
+	/*
+	 * Assign the metadata to each table.  Both results are ordered in the
+	 * same way as the tables.
+	 */
+	index_cell = list_head(indexes);
+	foreach(lc, described)
+	{
+		ForeignTableColumns *table = (ForeignTableColumns *) lfirst(lc);
+		ImportMetadataEntry *entry;
+		ImportMetadataEntry local_entry;
+
+		if (OidIsValid(table->relid))
+		{
+			memset(&local_entry, 0, sizeof(local_entry));
+			entry = &local_entry;
+		}
+		else
+		{
+			bool		found;
+
+			entry = (ImportMetadataEntry *) hash_search(state->entries,
+														table->relname,
+														HASH_ENTER, &found);
+			Assert(!found);
+			entry->indexes = NIL;
+			entry->applied = false;
+		}
+		entry->table = table;
+
+		entry->stats_row = row;
+		while (state->stats_res != NULL &&
+			   row < PQntuples(state->stats_res) &&
+			   atoi(PQgetvalue(state->stats_res, row, RS_TABLE)) ==
+			   foreach_current_index(lc))
+			row++;
+		entry->stats_nrows = row - entry->stats_row;
+
+		while (index_cell != NULL &&
+			   ((RemoteIndex *) lfirst(index_cell))->table == table)
+		{
+			entry->indexes = lappend(entry->indexes, lfirst(index_cell));
+			index_cell = lnext(indexes, index_cell);
+		}
+
+		/* The tables created above can have their metadata right away */
+		if (OidIsValid(table->relid))
+			pgfdw_apply_import_metadata(entry, table->relid);
+	}
+}
+
+/*
+ * Create the partitioned tables among the given tables being imported by the
+ * given IMPORT FOREIGN SCHEMA command, together with all their partitions,
+ * and return the descriptions of all of them.
+ *
+ * The partitions are attached with the same bounds as the remote ones.  The
+ * leaf partitions are created as foreign tables on the same server, and
+ * the partitioned ones as local partitioned tables with the same partition
+ * keys as the remote ones.  The partitions listed in EXCEPT are skipped
+ * together with their own partitions.
+ *
+ * All the partitions are created in the local schema, even the ones in other
+ * remote schemas, so we make sure up front that their names clash neither
+ * with each other, nor with the other tables being imported, which the given
+ * list contains in that case, nor with the existing relations.
+ */
+static List *
+pgfdw_create_imported_partitions(PGconn *conn, ImportForeignSchemaStmt *stmt,
+								 ForeignServer *server, List *tables)
+{
+	List	   *result = NIL;
+	PGresult   *volatile res = NULL;
+	StringInfoData buf;
+	HTAB	   *names;
+	HASHCTL		ctl;
+	Oid			nspid;
+	bool		first_item = true;
+	ListCell   *lc;
+
+	ctl.keysize = NAMEDATALEN;
+	ctl.entrysize = NAMEDATALEN;
+	ctl.hcxt = CurrentMemoryContext;
+	names = hash_create("postgres_fdw imported table names",
+						Max(list_length(tables), 16), &ctl,
+						HASH_ELEM | HASH_STRINGS | HASH_CONTEXT);
+
+	initStringInfo(&buf);
+	appendStringInfoString(&buf,
+						   "WITH RECURSIVE p(oid, parent, level) AS ("
+						   "SELECT c.oid, 0::pg_catalog.oid, 0"
+						   " FROM pg_catalog.pg_class c"
+						   " JOIN pg_catalog.pg_namespace n"
+						   " ON n.oid = c.relnamespace"
+						   " WHERE n.nspname = ");
+	deparseStringLiteral(&buf, stmt->remote_schema);
+	appendStringInfoString(&buf, " AND c.relname IN (");
+
+	foreach(lc, tables)
+	{
+		PgFdwImportedTable *imported = (PgFdwImportedTable *) lfirst(lc);
+
+		hash_search(names, imported->relname, HASH_ENTER, NULL);
+		if (imported->command == NULL)
+			continue;
+
+		if (first_item)
+			first_item = false;
+		else
+			appendStringInfoString(&buf, ", ");
+		deparseStringLiteral(&buf, imported->relname);
+	}
+	if (first_item)
+	{
+		hash_destroy(names);
+		pfree(buf.data);
+		return NIL;
+	}
+
+	appendStringInfoString(&buf,
+						   ") UNION ALL "
+						   "SELECT i.inhrelid, i.inhparent, p.level + 1"
+						   " FROM pg_catalog.pg_inherits i"
+						   " JOIN p ON i.inhparent = p.oid");
+	if (stmt->list_type == FDW_IMPORT_SCHEMA_EXCEPT)
+	{
+		appendStringInfoString(&buf,
+							   " JOIN pg_catalog.pg_class ic"
+							   " ON ic.oid = i.inhrelid"
+							   " WHERE ic.relname NOT IN (");
+		foreach(lc, stmt->table_list)
+		{
+			RangeVar   *rv = (RangeVar *) lfirst(lc);
+
+			if (foreach_current_index(lc) > 0)
+				appendStringInfoString(&buf, ", ");
+			deparseStringLiteral(&buf, rv->relname);
+		}
+		appendStringInfoChar(&buf, ')');
+	}
+	appendStringInfoString(&buf,
+						   ") "
+						   "SELECT n.nspname, c.relname, c.relkind, pc.relname,"
+						   " pg_catalog.pg_get_expr(c.relpartbound, c.oid),"
+						   " pg_catalog.pg_get_partkeydef(c.oid)"
+						   " FROM p JOIN pg_catalog.pg_class c ON c.oid = p.oid"
+						   " JOIN pg_catalog.pg_namespace n"
+						   " ON n.oid = c.relnamespace"
+						   " JOIN pg_catalog.pg_class pc ON pc.oid = p.parent"
+						   " ORDER BY p.level, c.relname");
+
+	nspid = get_namespace_oid(stmt->local_schema, false);
+
+	/* In what follows, do not risk leaking any PGresults. */
+	PG_TRY();
+	{
+		int			i;
+
+		res = pgfdw_exec_query(conn, buf.data, NULL);
+		if (PQresultStatus(res) != PGRES_TUPLES_OK)
+			pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+		/* Check the names of the partitions before creating anything */
+		for (i = 0; i < PQntuples(res); i++)
+		{
+			char	   *nspname = PQgetvalue(res, i, 0);
+			char	   *relname = PQgetvalue(res, i, 1);
+			bool		found;
+
+			hash_search(names, relname, HASH_ENTER, &found);
+			if (found)
+				ereport(ERROR,
+						(errcode(ERRCODE_DUPLICATE_TABLE),
+						 errmsg("cannot import partition \"%s.%s\" as \"%s.%s\"",
+								nspname, relname,
+								stmt->local_schema, relname),
+						 errdetail("Another table named \"%s\" is imported into the same schema.",
+								   relname),
+						 errhint("Use EXCEPT to skip one of them.")));
+			if (OidIsValid(get_relname_relid(relname, nspid)))
+				ereport(ERROR,
+						(errcode(ERRCODE_DUPLICATE_TABLE),
+						 errmsg("cannot import partition \"%s.%s\" as \"%s.%s\"",
+								nspname, relname,
+								stmt->local_schema, relname),
+						 errdetail("Relation \"%s\" already exists in schema \"%s\".",
+								   relname, stmt->local_schema)));
+		}
+
+		/* Create the partitioned tables themselves */
+		foreach(lc, tables)
+		{
+			PgFdwImportedTable *imported = (PgFdwImportedTable *) lfirst(lc);
+			Oid			relid;
+
+			if (imported->command == NULL)
+				continue;
+
+			pgfdw_execute_import_command(imported->command);
+			relid = get_relname_relid(imported->relname, nspid);
+			result = lappend(result,
+							 pgfdw_describe_local_table(relid,
+														stmt->remote_schema,
+														imported->relname));
+		}
+
+		/* Parents come before their partitions */
+		for (i = 0; i < PQntuples(res); i++)
+		{
+			char	   *nspname = PQgetvalue(res, i, 0);
+			char	   *relname = PQgetvalue(res, i, 1);
+			char		relkind = *PQgetvalue(res, i, 2);
+			char	   *parent = PQgetvalue(res, i, 3);
+			char	   *bound = PQgetvalue(res, i, 4);
+			Oid			relid;
+
+			resetStringInfo(&buf);
+			appendStringInfo(&buf, "CREATE %sTABLE %s.%s PARTITION OF %s.%s %s",
+							 relkind == RELKIND_PARTITIONED_TABLE ? "" : "FOREIGN ",
+							 quote_identifier(stmt->local_schema),
+							 quote_identifier(relname),
+							 quote_identifier(stmt->local_schema),
+							 quote_identifier(parent),
+							 bound);
+			if (relkind == RELKIND_PARTITIONED_TABLE)
+				appendStringInfo(&buf, " PARTITION BY %s",
+								 PQgetvalue(res, i, 5));
+			else
+			{
+				appendStringInfo(&buf, " SERVER %s OPTIONS (schema_name ",
+								 quote_identifier(server->servername));
+				deparseStringLiteral(&buf, nspname);
+				appendStringInfoString(&buf, ", table_name ");
+				deparseStringLiteral(&buf, relname);
+				appendStringInfoChar(&buf, ')');
+			}
+			pgfdw_execute_import_command(buf.data);
+
+			relid = get_relname_relid(relname, nspid);
+			if (relkind == RELKIND_PARTITIONED_TABLE)
+				result = lappend(result,
+								 pgfdw_describe_local_table(relid,
+															pstrdup(nspname),
+															pstrdup(relname)));
+			else
+				result = lappend(result, pgfdw_describe_foreign_table(relid));
+		}
+	}
+	PG_FINALLY();
+	{
+		PQclear(res);
+	}
+	PG_END_TRY();
+
+	hash_destroy(names);
+	pfree(buf.data);
+
+	return result;
+}
+
+/*
+ * Execute a command creating a table imported by IMPORT FOREIGN SCHEMA.
+ */
+static void
+pgfdw_execute_import_command(const char *sql)
+{
+	if (SPI_connect() != SPI_OK_CONNECT)
+		elog(ERROR, "SPI_connect failed");
+	if (SPI_execute(sql, false, 0) != SPI_OK_UTILITY)
+		elog(ERROR, "SPI_execute failed: %s", sql);
+	SPI_finish();
+}
+
+/*
+ * Describe the given local table of the given remote table, with the same
+ * column names as the remote ones.
+ */
+static ForeignTableColumns *
+pgfdw_describe_local_table(Oid relid, char *nspname, char *relname)
+{
+	ForeignTableColumns *table;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	int			i;
+
+	table = (ForeignTableColumns *) palloc0(sizeof(ForeignTableColumns));
+	table->relid = relid;
+	table->nspname = nspname;
+	table->relname = relname;
+
+	rel = table_open(relid, AccessShareLock);
+	tupdesc = RelationGetDescr(rel);
+	table->natts = tupdesc->natts;
+	table->colnames = (char **) palloc0(table->natts * sizeof(char *));
+	for (i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (!attr->attisdropped)
+			table->colnames[i] = pstrdup(NameStr(attr->attname));
+	}
+	table_close(rel, AccessShareLock);
+
+	return table;
+}
+
+/*
+ * Store the imported metadata into the local catalogs for the given table,
+ * which has just been created.
+ *
+ * The remote statistics that don't fit the table, e.g., because the remote
+ * table has never been analyzed, are just skipped, since ANALYZE can
+ * compute them later.
+ */
+static void
+pgfdw_apply_import_metadata(ImportMetadataEntry *entry, Oid relid)
+{
+	PGresult   *res = import_state->stats_res;
+	Relation	rel;
+
+	entry->table->relid = relid;
+	rel = table_open(relid, ShareUpdateExclusiveLock);
+
+	if (res != NULL)
+	{
+		char	   *mismatch;
+
+		mismatch = pgfdw_apply_remote_stats(rel, entry->table, res,
+											entry->stats_row,
+											entry->stats_nrows);
+		if (mismatch != NULL)
+			ereport(DEBUG1,
+					(errmsg("\"%s\": could not import remote statistics",
+							RelationGetRelationName(rel)),
+					 errdetail_internal("%s", mismatch)));
+		else
+		{
+			BlockNumber relpages;
+			double		reltuples;
+
+			relpages = (BlockNumber) strtoul(PQgetvalue(res, entry->stats_row,
+														RS_RELPAGES),
+											 NULL, 10);
+			reltuples = strtod(PQgetvalue(res, entry->stats_row,
+										  RS_RELTUPLES), NULL);
+			vac_update_relstats(rel, relpages, reltuples, 0, false,
+								InvalidTransactionId, InvalidMultiXactId,
+								NULL, NULL, true);
+		}
+	}
+
+	if (entry->indexes != NIL)
+	{
+		Relation	indrel = pgfdw_open_remote_indexes();
+
+		pgfdw_insert_remote_indexes(indrel, entry->indexes);
+		table_close(indrel, NoLock);
+	}
+
+	entry->applied = true;
+	table_close(rel, NoLock);
+}
+
+/*
+ * Forget the state of IMPORT FOREIGN SCHEMA importing metadata.
+ */
+static void
+pgfdw_forget_import_metadata(void *arg)
+{
+	ImportMetadataState *state = (ImportMetadataState *) arg;
+
+	PQclear(state->stats_res);
+	if (import_state == state)
+		import_state = NULL;
+}
+
+/*
+ * Install the hook that stores the imported metadata for the foreign tables
+ * created by IMPORT FOREIGN SCHEMA.
+ */
+void
+InstallProcessUtilityHookForPgFdwPlus(void)
+{
+	prev_ProcessUtility_hook = ProcessUtility_hook;
+	ProcessUtility_hook = pgfdw_process_utility;
+}
+
+/*
+ * Execute a utility command, and if it creates a foreign table imported by
+ * IMPORT FOREIGN SCHEMA importing metadata, store the metadata for it.
+ *
+ * The core code runs the commands returned by postgresImportForeignSchema()
+ * as subcommands with the local schema name filled in, so we only need to
+ * look at those.
+ */
+static void
+pgfdw_process_utility(PlannedStmt *pstmt, const char *queryString,
+					  bool readOnlyTree, ProcessUtilityContext context,
+					  ParamListInfo params, QueryEnvironment *queryEnv,
+					  DestReceiver *dest, QueryCompletion *qc)
+{
+	Node	   *parsetree = pstmt->utilityStmt;
+	Oid			save_analyze_target = explicit_analyze_target;
+
+	/*
+	 * Tell pgfdw_analyze_target() which foreign table ANALYZE is going to
+	 * analyze, if we know that from the command itself.
+	 */
+	if (IsA(parsetree, VacuumStmt))
+		explicit_analyze_target =
+			pgfdw_explicit_analyze_target((VacuumStmt *) parsetree);
+
+	PG_TRY();
+	{
+		if (prev_ProcessUtility_hook)
+			prev_ProcessUtility_hook(pstmt, queryString, readOnlyTree,
+									 context, params, queryEnv, dest, qc);
+		else
+			standard_ProcessUtility(pstmt, queryString, readOnlyTree,
+									context, params, queryEnv, dest, qc);
+	}
+	PG_FINALLY();
+	{
+		explicit_analyze_target = save_analyze_target;
+	}
+	PG_END_TRY();
+
+	if (import_state != NULL && context == PROCESS_UTILITY_SUBCOMMAND &&
+		IsA(parsetree, CreateForeignTableStmt))
+	{
+		CreateForeignTableStmt *cstmt = (CreateForeignTableStmt *) parsetree;
+		RangeVar   *relation = cstmt->base.relation;
+		ImportMetadataEntry *entry;
+
+		if (relation->schemaname == NULL ||
+			strcmp(relation->schemaname, import_state->local_schema) != 0 ||
+			strcmp(cstmt->servername, import_state->servername) != 0)
+			return;
+
+		entry = (ImportMetadataEntry *) hash_search(import_state->entries,
+													relation->relname,
+													HASH_FIND, NULL);
+		if (entry != NULL && !entry->applied)
+		{
+			/* Make the new table visible */
+			CommandCounterIncrement();
+			pgfdw_apply_import_metadata(entry,
+										RangeVarGetRelid(relation, NoLock,
+														 false));
+		}
+	}
+}
+
+/*
+ * Auto-analyze of foreign tables
+ *
+ * Autovacuum doesn't analyze foreign tables, so a background worker does
+ * that for the postgres_fdw foreign tables in the database specified by
+ * postgres_fdw.auto_analyze_database.  It periodically polls the change
+ * counters of their remote tables, with one query per foreign server and
+ * user mapping, and runs ANALYZE on the foreign tables whose remote tables
+ * have changed enough, like autovacuum does with its own thresholds.
+ *
+ * The worker connects to the database as the bootstrap superuser, so it can
+ * analyze any foreign table, while the remote servers are accessed with the
+ * user mappings of the table owners, as ANALYZE command does.  A table whose
+ * ANALYZE fails is not tried again for a number of naptimes doubling with
+ * each consecutive failure, up to AUTO_ANALYZE_MAX_BACKOFF.
+ */
+
+/*
+ * A foreign table checked by the auto-analyze worker
+ */
+typedef struct AutoAnalyzeTable
+{
+	ForeignTableColumns *table; /* foreign table and its remote names */
+	char	   *nspname;		/* local schema name */
+	char	   *relname;		/* local table name */
+	double		reltuples;		/* local reltuples, -1 if never analyzed */
+	double		nmods;			/* # of remote changes ever, -1 if unknown */
+} AutoAnalyzeTable;
+
+/*
+ * The foreign tables on a foreign server with the same owner, which are
+ * checked with the same user mapping
+ */
+typedef struct AutoAnalyzeGroup
+{
+	Oid			serverid;
+	Oid			userid;
+	List	   *tables;			/* list of AutoAnalyzeTable */
+} AutoAnalyzeGroup;
+
+/*
+ * Remote change counter of a foreign table at its last auto-analyze, or
+ * when it was first checked, and the failures of auto-analyze since then
+ */
+typedef struct AutoAnalyzeBaseline
+{
+	Oid			relid;			/* hash key */
+	double		nmods;			/* # of remote changes ever */
+	int			nfailures;		/* # of consecutive failures */
+	TimestampTz retry_time;		/* don't analyze before this time */
+} AutoAnalyzeBaseline;
+
+/* Maximum delay before retrying a failing table, in naptimes */
+#define AUTO_ANALYZE_MAX_BACKOFF	64
+
+static HTAB *auto_analyze_baselines = NULL;
+
+static List *pgfdw_auto_analyze_collect(void);
+static List *pgfdw_auto_analyze_check(AutoAnalyzeGroup *group);
+static void pgfdw_auto_analyze_table(AutoAnalyzeTable *aatable);
+
+/*
+ * Register the auto-analyze worker, if enabled.
+ */
+void
+RegisterAutoAnalyzeWorkerForPgFdwPlus(void)
+{
+	BackgroundWorker worker;
+
+	if (!process_shared_preload_libraries_in_progress ||
+		pgfdw_auto_analyze_database == NULL ||
+		pgfdw_auto_analyze_database[0] == '\0')
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS |
+		BGWORKER_BACKEND_DATABASE_CONNECTION;
+	worker.bgw_start_time = BgWorkerStart_RecoveryFinished;
+	worker.bgw_restart_time = 60;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "postgres_fdw_plus");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN,
+			 "pgfdw_plus_auto_analyze_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN,
+			 "postgres_fdw_plus auto-analyze worker");
+	snprintf(worker.bgw_type, BGW_MAXLEN,
+			 "postgres_fdw_plus auto-analyze worker");
+	RegisterBackgroundWorker(&worker);
+}
+
+/*
+ * Main entry point of the auto-analyze worker
+ */
+void
+pgfdw_plus_auto_analyze_main(Datum main_arg)
+{
+	MemoryContext round_cxt;
+	HASHCTL		ctl;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	BackgroundWorkerInitializeConnection(pgfdw_auto_analyze_database,
+										 NULL, 0);
+
+	ctl.keysize = sizeof(Oid);
+	ctl.entrysize = sizeof(AutoAnalyzeBaseline);
+	auto_analyze_baselines = hash_create("postgres_fdw_plus auto-analyze",
+										 256, &ctl,
+										 HASH_ELEM | HASH_BLOBS);
+	round_cxt = AllocSetContextCreate(TopMemoryContext,
+									  "postgres_fdw_plus auto-analyze",
+									  ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		List	   *groups;
+		List	   *targets = NIL;
+		ListCell   *lc;
+
+		CHECK_FOR_INTERRUPTS();
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/*
+		 * Check the foreign tables on each server, and analyze those changed
+		 * enough.  Each step runs in its own transaction, so that a failure
+		 * of one server or table doesn't affect the others.
+		 */
+		MemoryContextSwitchTo(round_cxt);
+		groups = pgfdw_auto_analyze_collect();
+		foreach(lc, groups)
+			targets = list_concat(targets,
+								  pgfdw_auto_analyze_check((AutoAnalyzeGroup *) lfirst(lc)));
+		foreach(lc, targets)
+			pgfdw_auto_analyze_table((AutoAnalyzeTable *) lfirst(lc));
+		MemoryContextSwitchTo(TopMemoryContext);
+		MemoryContextReset(round_cxt);
+
+		pgstat_report_activity(STATE_IDLE, NULL);
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 pgfdw_auto_analyze_naptime * 1000L,
+						 PG_WAIT_EXTENSION);
+		ResetLatch(MyLatch);
+	}
+}
+
+/*
+ * Collect the postgres_fdw foreign tables in the database, grouped by their
+ * servers and owners.
+ */
+static List *
+pgfdw_auto_analyze_collect(void)
+{
+	MemoryContext cxt = CurrentMemoryContext;
+	List	   *groups = NIL;
+	Relation	rel;
+	SysScanDesc scan;
+	HeapTuple	tup;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, "collecting foreign tables");
+
+	rel = table_open(ForeignTableRelationId, AccessShareLock);
+	scan = systable_beginscan(rel, InvalidOid, false, NULL, 0, NULL);
+	while (HeapTupleIsValid(tup = systable_getnext(scan)))
+	{
+		Form_pg_foreign_table ftform = (Form_pg_foreign_table) GETSTRUCT(tup);
+		ForeignServer *server = GetForeignServer(ftform->ftserver);
+		ForeignDataWrapper *fdw = GetForeignDataWrapper(server->fdwid);
+		MemoryContext oldcxt;
+		AutoAnalyzeTable *aatable;
+		AutoAnalyzeGroup *group = NULL;
+		HeapTuple	reltup;
+		Form_pg_class relform;
+		ListCell   *lc;
+
+		if (strcmp(fdw->fdwname, "postgres_fdw") != 0)
+			continue;
+
+		reltup = SearchSysCache1(RELOID, ObjectIdGetDatum(ftform->ftrelid));
+		if (!HeapTupleIsValid(reltup))
+			continue;
+		relform = (Form_pg_class) GETSTRUCT(reltup);
+
+		/* The results have to survive the transaction */
+		oldcxt = MemoryContextSwitchTo(cxt);
+
+		aatable = (AutoAnalyzeTable *) palloc0(sizeof(AutoAnalyzeTable));
+		aatable->table = pgfdw_describe_foreign_table(ftform->ftrelid);
+		aatable->nspname = get_namespace_name(relform->relnamespace);
+		aatable->relname = pstrdup(NameStr(relform->relname));
+		aatable->reltuples = relform->reltuples;
+		aatable->nmods = -1;
+
+		foreach(lc, groups)
+		{
+			AutoAnalyzeGroup *g = (AutoAnalyzeGroup *) lfirst(lc);
+
+			if (g->serverid == server->serverid &&
+				g->userid == relform->relowner)
+			{
+				group = g;
+				break;
+			}
+		}
+		if (group == NULL)
+		{
+			group = (AutoAnalyzeGroup *) palloc0(sizeof(AutoAnalyzeGroup));
+			group->serverid = server->serverid;
+			group->userid = relform->relowner;
+			groups = lappend(groups, group);
+		}
+		group->tables = lappend(group->tables, aatable);
+
+		MemoryContextSwitchTo(oldcxt);
+		ReleaseSysCache(reltup);
+	}
+	systable_endscan(scan);
+	table_close(rel, AccessShareLock);
+
+	PopActiveSnapshot();
+	CommitTransactionCommand();
+	MemoryContextSwitchTo(cxt);
+
+	return groups;
+}
+
+/*
+ * Poll the remote change counters of the foreign tables in the given group,
+ * and return those changed enough to be analyzed.
+ *
+ * The number of changes since the last auto-analyze is counted from the
+ * cumulative counters of inserted, updated and deleted rows.  For a table
+ * not seen before, n_mod_since_analyze of the remote table is used instead.
+ * A change of the row count from the local reltuples is also counted, which
+ * covers the remote tables without those counters, e.g., partitioned ones.
+ */
+static List *
+pgfdw_auto_analyze_check(AutoAnalyzeGroup *group)
+{
+	MemoryContext cxt = CurrentMemoryContext;
+	List	   *volatile targets = NIL;
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, "checking foreign tables for changes");
+
+	PG_TRY();
+	{
+		UserMapping *user = GetUserMapping(group->userid, group->serverid);
+		PGconn	   *conn = GetConnection(user, false, NULL);
+		PGresult   *volatile res = NULL;
+		StringInfoData buf;
+		ListCell   *lc;
+
+		initStringInfo(&buf);
+		appendStringInfoString(&buf,
+							   "SELECT v.i, c.reltuples, s.n_mod_since_analyze,"
+							   " s.n_tup_ins + s.n_tup_upd + s.n_tup_del"
+							   " FROM (VALUES ");
+		foreach(lc, group->tables)
+		{
+			AutoAnalyzeTable *aatable = (AutoAnalyzeTable *) lfirst(lc);
+
+			if (foreach_current_index(lc) > 0)
+				appendStringInfoString(&buf, ", ");
+			appendStringInfo(&buf, "(%d, ", foreach_current_index(lc));
+			deparseStringLiteral(&buf, aatable->table->nspname);
+			appendStringInfoString(&buf, ", ");
+			deparseStringLiteral(&buf, aatable->table->relname);
+			appendStringInfoChar(&buf, ')');
+		}
+		appendStringInfoString(&buf,
+							   ") v(i, nspname, relname)"
+							   " JOIN pg_catalog.pg_namespace n ON n.nspname = v.nspname"
+							   " JOIN pg_catalog.pg_class c ON c.relnamespace = n.oid"
+							   " AND c.relname = v.relname"
+							   " LEFT JOIN pg_catalog.pg_stat_all_tables s"
+							   " ON s.relid = c.oid");
+
+		/* In what follows, do not risk leaking any PGresults. */
+		PG_TRY();
+		{
+			int			i;
+
+			res = pgfdw_exec_query(conn, buf.data, NULL);
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+			for (i = 0; i < PQntuples(res); i++)
+			{
+				AutoAnalyzeTable *aatable;
+				AutoAnalyzeBaseline *baseline;
+				double		reltuples;
+				double		changes = 0;
+				bool		found;
+
+				aatable = (AutoAnalyzeTable *)
+					list_nth(group->tables, atoi(PQgetvalue(res, i, 0)));
+				reltuples = strtod(PQgetvalue(res, i, 1), NULL);
+				if (!PQgetisnull(res, i, 3))
+					aatable->nmods = strtod(PQgetvalue(res, i, 3), NULL);
+
+				baseline = (AutoAnalyzeBaseline *)
+					hash_search(auto_analyze_baselines,
+								&aatable->table->relid, HASH_ENTER, &found);
+				if (!found)
+				{
+					baseline->nfailures = 0;
+					baseline->retry_time = 0;
+				}
+				if (found && aatable->nmods >= baseline->nmods &&
+					baseline->nmods >= 0)
+					changes = aatable->nmods - baseline->nmods;
+				else if (!PQgetisnull(res, i, 2))
+					changes = strtod(PQgetvalue(res, i, 2), NULL);
+				if (!found || baseline->nmods < 0)
+					baseline->nmods = aatable->nmods;
+
+				/* Leave alone the tables backing off after failures */
+				if (baseline->retry_time > GetCurrentTimestamp())
+					continue;
+
+				if (aatable->reltuples >= 0 && reltuples >= 0)
+					changes = Max(changes, fabs(reltuples - aatable->reltuples));
+
+				/* Never analyzed tables are always analyzed */
+				if (aatable->reltuples < 0 ||
+					changes > pgfdw_auto_analyze_threshold +
+					pgfdw_auto_analyze_scale_factor * Max(reltuples, 0))
+				{
+					MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+					targets = lappend(targets, aatable);
+					MemoryContextSwitchTo(oldcxt);
+				}
+			}
+		}
+		PG_FINALLY();
+		{
+			PQclear(res);
+		}
+		PG_END_TRY();
+
+		ReleaseConnection(conn);
+
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+	}
+	PG_CATCH();
+	{
+		/* Report the error, and go on with the other servers */
+		HOLD_INTERRUPTS();
+		EmitErrorReport();
+		AbortOutOfAnyTransaction();
+		FlushErrorState();
+		RESUME_INTERRUPTS();
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(cxt);
+
+	return targets;
+}
+
+/*
+ * Analyze the given foreign table, in the same way as ANALYZE command.
+ */
+static void
+pgfdw_auto_analyze_table(AutoAnalyzeTable *aatable)
+{
+	MemoryContext cxt = CurrentMemoryContext;
+	char	   *sql;
+
+	sql = psprintf("ANALYZE %s",
+				   quote_qualified_identifier(aatable->nspname,
+											  aatable->relname));
+
+	SetCurrentStatementStartTimestamp();
+	StartTransactionCommand();
+	PushActiveSnapshot(GetTransactionSnapshot());
+	pgstat_report_activity(STATE_RUNNING, sql);
+
+	PG_TRY();
+	{
+		AutoAnalyzeBaseline *baseline;
+
+		if (SPI_connect() != SPI_OK_CONNECT)
+			elog(ERROR, "SPI_connect failed");
+		if (SPI_execute(sql, false, 0) != SPI_OK_UTILITY)
+			elog(ERROR, "SPI_execute failed: %s", sql);
+		SPI_finish();
+
+		PopActiveSnapshot();
+		CommitTransactionCommand();
+
+		/* Count the remote changes from now on */
+		baseline = (AutoAnalyzeBaseline *)
+			hash_search(auto_analyze_baselines, &aatable->table->relid,
+						HASH_ENTER, NULL);
+		baseline->nmods = aatable->nmods;
+		baseline->nfailures = 0;
+		baseline->retry_time = 0;
+	}
+	PG_CATCH();
+	{
+		AutoAnalyzeBaseline *baseline;
+		bool		found;
+		int64		delay;
+		int			i;
+
+		/* Report the error, and go on with the other tables */
+		HOLD_INTERRUPTS();
+		EmitErrorReport();
+		AbortOutOfAnyTransaction();
+		FlushErrorState();
+		RESUME_INTERRUPTS();
+
+		/* Back off, rather than failing again at every naptime */
+		baseline = (AutoAnalyzeBaseline *)
+			hash_search(auto_analyze_baselines, &aatable->table->relid,
+						HASH_ENTER, &found);
+		if (!found)
+		{
+			baseline->nmods = -1;
+			baseline->nfailures = 0;
+		}
+		baseline->nfailures++;
+		delay = pgfdw_auto_analyze_naptime;
+		for (i = 0; i < baseline->nfailures &&
+			 delay < (int64) AUTO_ANALYZE_MAX_BACKOFF * pgfdw_auto_analyze_naptime; i++)
+			delay *= 2;
+		baseline->retry_time = TimestampTzPlusSeconds(GetCurrentTimestamp(),
+													  delay);
+		ereport(LOG,
+				(errmsg("will not auto-analyze foreign table \"%s.%s\" for %lld seconds after %d failures",
+						aatable->nspname, aatable->relname,
+						(long long) delay, baseline->nfailures)));
+	}
+	PG_END_TRY();
+
+	MemoryContextSwitchTo(cxt);
+}
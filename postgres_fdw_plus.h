@@ -3,12 +3,63 @@
 
 #include "access/xact.h"
 #include "miscadmin.h"
-#include "postgres_fdw/postgres_fdw.h"
+#include "postgres_fdw.h"
 
 /*
  * Global variables
  */
 extern bool pgfdw_use_read_committed_in_xact;
+extern bool pgfdw_two_phase_commit;
+extern int	pgfdw_keyset_join_max_keys;
+extern int	pgfdw_bloom_filter_max_size;
+extern bool pgfdw_keyset_join_staging;
+extern bool pgfdw_preevaluate_stable_exprs;
+extern int	pgfdw_remote_estimate_max_count;
+extern int	pgfdw_remote_estimate_max_time;
+extern bool pgfdw_analyze_concurrently;
+
+/*
+ * paramids of the placeholder Params that stand for the values computed by
+ * a key-set semi-join scan itself until the plan is created: the key array,
+ * the Bloom filter, and the key set staged in a remote temporary table
+ */
+#define KEYSET_PLACEHOLDER_PARAMID			(-1)
+#define BLOOM_PLACEHOLDER_PARAMID			(-2)
+#define STAGED_KEYSET_PLACEHOLDER_PARAMID	(-3)
+
+/*
+ * Name of the remote temporary table where key-set semi-join scans stage
+ * their key sets
+ */
+#define PGFDW_PLUS_KEYSET_TABLE		"pgfdw_plus_keysets"
+
+/* Schema containing the tables of postgres_fdw_plus */
+#define PGFDW_PLUS_SCHEMA	"pgfdw_plus"
+
+/*
+ * Macros for pgfdw_plus.shippable table to record user-defined objects
+ * discovered to be shippable (or not) to foreign servers
+ */
+#define PGFDW_PLUS_SHIPPABLE_TABLE	"shippable"
+#define PGFDW_PLUS_SHIPPABLE_COLS	5
+#define Anum_pgfdw_plus_shippable_serverid	1
+#define Anum_pgfdw_plus_shippable_classid	2
+#define Anum_pgfdw_plus_shippable_objid		3
+#define Anum_pgfdw_plus_shippable_shippable	4
+#define Anum_pgfdw_plus_shippable_defhash	5
+
+/*
+ * Macros for pgfdw_plus.remote_indexes table to record the indexes of the
+ * remote tables of foreign tables
+ */
+#define PGFDW_PLUS_REMOTE_INDEXES_TABLE	"remote_indexes"
+#define PGFDW_PLUS_REMOTE_INDEXES_PKEY	"remote_indexes_pkey"
+#define PGFDW_PLUS_REMOTE_INDEXES_COLS	5
+#define Anum_pgfdw_plus_remote_indexes_ftrelid		1
+#define Anum_pgfdw_plus_remote_indexes_indexname	2
+#define Anum_pgfdw_plus_remote_indexes_indisunique	3
+#define Anum_pgfdw_plus_remote_indexes_indkey		4
+#define Anum_pgfdw_plus_remote_indexes_indoption	5
 
 /*
  * Connection cache hash table entry
@@ -61,6 +112,19 @@ extern HTAB *ConnectionHash;
  */
 #define CONNECTION_CLEANUP_TIMEOUT	30000
 
+/*
+ * A remote table imported by IMPORT FOREIGN SCHEMA, whose metadata is
+ * imported by pgfdw_import_schema_metadata().  A partitioned table imported
+ * with its partitions is created by the CREATE TABLE command in "command",
+ * instead of the core code.
+ */
+typedef struct PgFdwImportedTable
+{
+	char	   *relname;		/* name of the remote and local tables */
+	List	   *colnames;		/* names of the columns, in order */
+	char	   *command;		/* CREATE TABLE command, or NULL */
+} PgFdwImportedTable;
+
 /* Macro for constructing abort command to be sent */
 #define CONSTRUCT_ABORT_COMMAND(sql, entry, toplevel) \
 	do { \
@@ -80,6 +144,9 @@ extern void do_sql_command_end(PGconn *conn, const char *sql,
 extern void pgfdw_reject_incomplete_xact_state_change(ConnCacheEntry *entry);
 extern void pgfdw_reset_xact_state(ConnCacheEntry *entry, bool toplevel);
 extern bool pgfdw_cancel_query(PGconn *conn);
+extern PGresult *pgfdw_get_next_result(PGconn *conn);
+extern bool pgfdw_put_copy_data(PGconn *conn, const char *buffer, int nbytes);
+extern bool pgfdw_put_copy_end(PGconn *conn, const char *errormsg);
 extern bool pgfdw_exec_cleanup_query(PGconn *conn, const char *query,
 									 bool ignore_errors);
 extern bool pgfdw_exec_cleanup_query_begin(PGconn *conn, const char *query);
@@ -94,10 +161,52 @@ extern void pgfdw_finish_abort_cleanup(List *pending_entries,
 									   List *cancel_requested,
 									   bool toplevel);
 
+/* postgres_fdw.c */
+extern void InstallJoinPathlistHookForPgFdwPlus(void);
+extern void InstallRelationInfoHookForPgFdwPlus(void);
+extern void InstallPlannerHookForPgFdwPlus(void);
+
 /* postgres_fdw_plus.c */
 extern void DefineCustomVariablesForPgFdwPlus(void);
 extern void pgfdw_abort_cleanup(ConnCacheEntry *entry, bool toplevel);
 extern void pgfdw_arrange_read_committed(bool xact_got_connection);
 extern bool pgfdw_xact_two_phase(XactEvent event);
+extern double pgfdw_bloom_filter_false_positive_rate(double nelems);
+extern bytea *pgfdw_bloom_filter_create(const uint64 *hashvals,
+										int nhashvals);
+extern List *pgfdw_get_remote_indexes(RelOptInfo *baserel,
+									  Oid foreigntableid);
+extern void InstallShmemHooksForPgFdwPlus(void);
+extern void InstallProcessUtilityHookForPgFdwPlus(void);
+extern void RegisterAutoAnalyzeWorkerForPgFdwPlus(void);
+extern PGDLLEXPORT void pgfdw_plus_auto_analyze_main(Datum main_arg);
+extern void pgfdw_invalidate_remote_estimates(void);
+extern uint64 pgfdw_remote_estimate_epoch(void);
+extern bool pgfdw_lookup_remote_estimate(UserMapping *user, const char *sql,
+										 double *rows, int *width,
+										 Cost *startup_cost,
+										 Cost *total_cost);
+extern void pgfdw_store_remote_estimate(UserMapping *user, const char *sql,
+										uint64 epoch, double rows, int width,
+										Cost startup_cost, Cost total_cost);
+extern Oid	pgfdw_analyze_target(void);
+extern bool pgfdw_import_remote_stats(Relation relation, PGconn *conn,
+									  int elevel, double *totalrows);
+extern void pgfdw_import_schema_metadata(PGconn *conn,
+										 ImportForeignSchemaStmt *stmt,
+										 ForeignServer *server, List *tables,
+										 bool import_statistics,
+										 bool import_indexes);
+extern void pgfdw_store_network_stats(Oid serverid, double rtt_ms,
+									  double ms_per_byte);
+extern void pgfdw_record_round_trip(Oid serverid, double ms);
+extern bool pgfdw_network_cost(Oid serverid, double retrieved_rows, int width,
+							   int fetch_size, Cost fdw_tuple_cost,
+							   Cost *startup_cost, Cost *run_cost);
+
+/* shippable.c */
+extern bool is_shippable_collation(Oid collid, PgFdwRelationInfo *fpinfo);
+extern bool pgfdw_shippable_definition_hash(Oid classid, Oid objid,
+											char *hash);
 
 #endif							/* POSTGRES_FDW_PLUS_H */
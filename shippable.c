@@ -0,0 +1,726 @@
+/*-------------------------------------------------------------------------
+ *
+ * shippable.c
+ *	  Determine which database objects are shippable to a remote server.
+ *
+ * We need to determine whether particular functions, operators, and indeed
+ * data types are shippable to a remote server for execution --- that is,
+ * do they exist and have the same behavior remotely as they do locally?
+ * Built-in objects are generally considered shippable.  Other objects can
+ * be shipped if they are declared as such by the user, or if they have been
+ * found to exist with the same definition on the remote server by
+ * pgfdw_plus_discover_shippable().
+ *
+ * Note: there are additional filter rules that prevent shipping mutable
+ * functions or functions using nonportable collations.  Those considerations
+ * need not be accounted for here.
+ *
+ * Portions Copyright (c) 1996-2024, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *	  contrib/postgres_fdw/shippable.c
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/genam.h"
+#include "access/htup_details.h"
+#include "access/table.h"
+#include "access/transam.h"
+#include "access/xact.h"
+#include "catalog/dependency.h"
+#include "catalog/namespace.h"
+#include "catalog/pg_collation.h"
+#include "catalog/pg_operator.h"
+#include "catalog/pg_proc.h"
+#include "common/md5.h"
+#include "mb/pg_wchar.h"
+#include "postgres_fdw_plus.h"
+#include "utils/builtins.h"
+#include "utils/fmgroids.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/pg_locale.h"
+#include "utils/rel.h"
+#include "utils/resowner.h"
+#include "utils/syscache.h"
+
+/* Hash table for caching the results of shippability lookups */
+static HTAB *ShippableCacheHash = NULL;
+
+/* OID of pgfdw_plus.shippable table, once we have looked it up */
+static Oid	ShippableTableRelid = InvalidOid;
+
+/*
+ * Hash key for shippability lookups.  We include the FDW server OID because
+ * decisions may differ per-server.  Otherwise, objects are identified by
+ * their (local!) OID and catalog OID.
+ */
+typedef struct
+{
+	/* XXX we assume this struct contains no padding bytes */
+	Oid			objid;			/* function/operator/type OID */
+	Oid			classid;		/* OID of its catalog (pg_proc, etc) */
+	Oid			serverid;		/* FDW server we are concerned with */
+} ShippableCacheKey;
+
+typedef struct
+{
+	ShippableCacheKey key;		/* hash key - must be first */
+	bool		shippable;
+	uint32		hashvalue;		/* syscache hash value of a function or
+								 * operator, else 0 */
+} ShippableCacheEntry;
+
+
+/*
+ * Flush cache entries when pg_foreign_server, pg_proc or pg_operator is
+ * updated.
+ *
+ * We do this because of the possibility of ALTER SERVER being used to change
+ * a server's extensions option, and of CREATE OR REPLACE FUNCTION or ALTER
+ * FUNCTION being used to change a function discovered to be shippable, which
+ * load_discovered_shippable() must then check again.  We do not currently
+ * bother to check whether objects' extension membership changes once a
+ * shippability decision has been made for them, however.
+ *
+ * An update of a server flushes the entries for that server.  An update of a
+ * function or operator flushes its own entries, and the entries recording
+ * that the discovered decisions have been loaded, so that they are checked
+ * again; the rest, notably the remote checks of collations, are kept.  A
+ * hash value of 0 means that everything is to be flushed.
+ */
+static void
+InvalidateShippableCacheCallback(Datum arg, int cacheid, uint32 hashvalue)
+{
+	HASH_SEQ_STATUS status;
+	ShippableCacheEntry *entry;
+
+	hash_seq_init(&status, ShippableCacheHash);
+	while ((entry = (ShippableCacheEntry *) hash_seq_search(&status)) != NULL)
+	{
+		if (hashvalue != 0)
+		{
+			if (cacheid == FOREIGNSERVEROID)
+			{
+				if (GetSysCacheHashValue1(FOREIGNSERVEROID,
+										  ObjectIdGetDatum(entry->key.serverid)) != hashvalue)
+					continue;
+			}
+			else if (entry->key.classid != InvalidOid &&
+					 (entry->key.classid !=
+					  (cacheid == PROCOID ? ProcedureRelationId : OperatorRelationId) ||
+					  entry->hashvalue != hashvalue))
+				continue;
+		}
+
+		if (hash_search(ShippableCacheHash,
+						&entry->key,
+						HASH_REMOVE,
+						NULL) == NULL)
+			elog(ERROR, "hash table corrupted");
+	}
+}
+
+/*
+ * Return the syscache hash value that invalidations of the given function or
+ * operator come with, or 0 for other objects.
+ */
+static uint32
+shippable_object_hash_value(Oid classid, Oid objid)
+{
+	if (classid == ProcedureRelationId)
+		return GetSysCacheHashValue1(PROCOID, ObjectIdGetDatum(objid));
+	if (classid == OperatorRelationId)
+		return GetSysCacheHashValue1(OPEROID, ObjectIdGetDatum(objid));
+	return 0;
+}
+
+/*
+ * Flush cache entries when pgfdw_plus.shippable is updated by
+ * pgfdw_plus_discover_shippable().
+ */
+static void
+InvalidateShippableCacheRelcacheCallback(Datum arg, Oid relid)
+{
+	if (relid == InvalidOid || relid == ShippableTableRelid)
+		InvalidateShippableCacheCallback(arg, FOREIGNSERVEROID, 0);
+}
+
+/*
+ * Initialize the backend-lifespan cache of shippability decisions.
+ */
+static void
+InitializeShippableCache(void)
+{
+	HASHCTL		ctl;
+
+	/* Create the hash table. */
+	ctl.keysize = sizeof(ShippableCacheKey);
+	ctl.entrysize = sizeof(ShippableCacheEntry);
+	ShippableCacheHash =
+		hash_create("Shippability cache", 256, &ctl, HASH_ELEM | HASH_BLOBS);
+
+	/* Set up invalidation callbacks on pg_foreign_server etc. */
+	CacheRegisterSyscacheCallback(FOREIGNSERVEROID,
+								  InvalidateShippableCacheCallback,
+								  (Datum) 0);
+	CacheRegisterSyscacheCallback(PROCOID,
+								  InvalidateShippableCacheCallback,
+								  (Datum) 0);
+	CacheRegisterSyscacheCallback(OPEROID,
+								  InvalidateShippableCacheCallback,
+								  (Datum) 0);
+
+	/* Set up invalidation callback on pgfdw_plus.shippable. */
+	CacheRegisterRelcacheCallback(InvalidateShippableCacheRelcacheCallback,
+								  (Datum) 0);
+}
+
+/*
+ * Append the parts of the definition of the given function or operator that
+ * pgfdw_plus_discover_shippable() compares with the remote server to buf.
+ * Returns false if the object doesn't exist anymore.
+ */
+static bool
+append_shippable_definition(StringInfo buf, Oid classid, Oid objid)
+{
+	HeapTuple	tp;
+	Form_pg_proc proc;
+	Datum		datum;
+	bool		isnull;
+
+	if (classid == OperatorRelationId)
+	{
+		Oid			oprcode;
+
+		tp = SearchSysCache1(OPEROID, ObjectIdGetDatum(objid));
+		if (!HeapTupleIsValid(tp))
+			return false;
+		oprcode = ((Form_pg_operator) GETSTRUCT(tp))->oprcode;
+		ReleaseSysCache(tp);
+
+		/* The operator is only as good as its underlying function */
+		appendStringInfo(buf, "%u\n", oprcode);
+		if (!OidIsValid(oprcode) || is_builtin(oprcode))
+			return true;
+		return append_shippable_definition(buf, ProcedureRelationId, oprcode);
+	}
+
+	tp = SearchSysCache1(PROCOID, ObjectIdGetDatum(objid));
+	if (!HeapTupleIsValid(tp))
+		return false;
+	proc = (Form_pg_proc) GETSTRUCT(tp);
+
+	appendStringInfo(buf, "%u %c %c %c %u\n",
+					 proc->prolang, proc->provolatile,
+					 proc->proisstrict ? 't' : 'f',
+					 proc->proretset ? 't' : 'f',
+					 proc->prorettype);
+	datum = SysCacheGetAttr(PROCOID, tp, Anum_pg_proc_proconfig, &isnull);
+	if (!isnull)
+		appendStringInfoString(buf,
+							   DatumGetCString(OidFunctionCall1(F_ARRAY_OUT,
+																datum)));
+	appendStringInfoChar(buf, '\n');
+	datum = SysCacheGetAttr(PROCOID, tp, Anum_pg_proc_prosrc, &isnull);
+	if (!isnull)
+		appendStringInfoString(buf, TextDatumGetCString(datum));
+
+	ReleaseSysCache(tp);
+	return true;
+}
+
+/*
+ * Compute the MD5 hash of the current definition of the given function or
+ * operator into hash, which must have room for 33 bytes, as recorded in
+ * pgfdw_plus.shippable.  That covers the language, volatility, strictness,
+ * return type, configuration settings such as search_path, and body of a
+ * function, and the underlying function of an operator.  Returns false if
+ * the object doesn't exist anymore.
+ */
+bool
+pgfdw_shippable_definition_hash(Oid classid, Oid objid, char *hash)
+{
+	StringInfoData buf;
+	const char *errstr = NULL;
+	bool		found;
+
+	initStringInfo(&buf);
+	found = append_shippable_definition(&buf, classid, objid);
+	if (found && !pg_md5_hash(buf.data, buf.len, hash, &errstr))
+		ereport(ERROR,
+				(errcode(ERRCODE_OUT_OF_MEMORY),
+				 errmsg("could not compute MD5 hash: %s", errstr)));
+	pfree(buf.data);
+
+	return found;
+}
+
+/*
+ * Load the shippability decisions that pgfdw_plus_discover_shippable() has
+ * recorded for the given server into the cache, if not done yet, and return
+ * true if any object has been found shippable.
+ *
+ * A decision is ignored if the object has been changed since it was made,
+ * that is, the hash of its definition recorded with it doesn't match the
+ * current one any more.  The object is then looked up by lookup_shippable()
+ * as if it had never been discovered, until the discovery is done again.
+ *
+ * Whether the decisions have been loaded is remembered by a cache entry for
+ * the server with invalid object and catalog OIDs, whose shippable flag is
+ * the result of this function.
+ */
+static bool
+load_discovered_shippable(Oid serverid)
+{
+	ShippableCacheKey key;
+	ShippableCacheEntry *entry;
+	ShippableCacheKey *keys = NULL;
+	bool	   *shippables = NULL;
+	int			nentries = 0;
+	bool		any_shippable = false;
+	Oid			namespaceId;
+	int			i;
+
+	key.objid = InvalidOid;
+	key.classid = InvalidOid;
+	key.serverid = serverid;
+
+	entry = (ShippableCacheEntry *)
+		hash_search(ShippableCacheHash, &key, HASH_FIND, NULL);
+	if (entry)
+		return entry->shippable;
+
+	/*
+	 * Read the decisions for the server, if the table exists.  As in
+	 * is_shippable(), we don't make cache entries until we have read all of
+	 * them, as the catalog lookups might trigger a cache invalidation.
+	 */
+	namespaceId = get_namespace_oid(PGFDW_PLUS_SCHEMA, true);
+	if (OidIsValid(namespaceId))
+		ShippableTableRelid = get_relname_relid(PGFDW_PLUS_SHIPPABLE_TABLE,
+												namespaceId);
+	if (OidIsValid(namespaceId) && OidIsValid(ShippableTableRelid))
+	{
+		Relation	rel;
+		ScanKeyData skey;
+		SysScanDesc scan;
+		HeapTuple	tup;
+		int			maxentries = 64;
+
+		keys = (ShippableCacheKey *)
+			palloc(maxentries * sizeof(ShippableCacheKey));
+		shippables = (bool *) palloc(maxentries * sizeof(bool));
+
+		rel = table_open(ShippableTableRelid, AccessShareLock);
+		ScanKeyInit(&skey,
+					Anum_pgfdw_plus_shippable_serverid,
+					BTEqualStrategyNumber, F_OIDEQ,
+					ObjectIdGetDatum(serverid));
+		scan = systable_beginscan(rel, InvalidOid, false, NULL, 1, &skey);
+		while (HeapTupleIsValid(tup = systable_getnext(scan)))
+		{
+			Datum		values[PGFDW_PLUS_SHIPPABLE_COLS];
+			bool		nulls[PGFDW_PLUS_SHIPPABLE_COLS];
+			Oid			classid;
+			Oid			objid;
+			char	   *defhash;
+			char		curhash[33];
+
+			heap_deform_tuple(tup, RelationGetDescr(rel), values, nulls);
+			if (nulls[Anum_pgfdw_plus_shippable_classid - 1] ||
+				nulls[Anum_pgfdw_plus_shippable_objid - 1] ||
+				nulls[Anum_pgfdw_plus_shippable_shippable - 1] ||
+				nulls[Anum_pgfdw_plus_shippable_defhash - 1])
+				continue;
+
+			classid =
+				DatumGetObjectId(values[Anum_pgfdw_plus_shippable_classid - 1]);
+			objid =
+				DatumGetObjectId(values[Anum_pgfdw_plus_shippable_objid - 1]);
+			defhash =
+				TextDatumGetCString(values[Anum_pgfdw_plus_shippable_defhash - 1]);
+			if (!pgfdw_shippable_definition_hash(classid, objid, curhash) ||
+				strcmp(defhash, curhash) != 0)
+				continue;
+
+			if (nentries >= maxentries)
+			{
+				maxentries *= 2;
+				keys = (ShippableCacheKey *)
+					repalloc(keys, maxentries * sizeof(ShippableCacheKey));
+				shippables = (bool *)
+					repalloc(shippables, maxentries * sizeof(bool));
+			}
+			keys[nentries].objid = objid;
+			keys[nentries].classid = classid;
+			keys[nentries].serverid = serverid;
+			shippables[nentries] =
+				DatumGetBool(values[Anum_pgfdw_plus_shippable_shippable - 1]);
+			nentries++;
+		}
+		systable_endscan(scan);
+		table_close(rel, AccessShareLock);
+	}
+
+	for (i = 0; i < nentries; i++)
+	{
+		entry = (ShippableCacheEntry *)
+			hash_search(ShippableCacheHash, &keys[i], HASH_ENTER, NULL);
+		entry->shippable = shippables[i];
+		entry->hashvalue = shippable_object_hash_value(keys[i].classid,
+													   keys[i].objid);
+		if (shippables[i])
+			any_shippable = true;
+	}
+
+	entry = (ShippableCacheEntry *)
+		hash_search(ShippableCacheHash, &key, HASH_ENTER, NULL);
+	entry->shippable = any_shippable;
+	entry->hashvalue = 0;
+
+	if (keys)
+	{
+		pfree(keys);
+		pfree(shippables);
+	}
+
+	return any_shippable;
+}
+
+/*
+ * Returns true if given object (operator/function/type) is shippable
+ * according to the server options.
+ *
+ * Right now "shippability" is exclusively a function of whether the object
+ * belongs to an extension declared by the user.  In the future we could
+ * additionally have a list of functions/operators declared one at a time.
+ * (Objects discovered by pgfdw_plus_discover_shippable() don't get here, as
+ * load_discovered_shippable() has already made cache entries for them.)
+ */
+static bool
+lookup_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo)
+{
+	Oid			extensionOid;
+
+	/*
+	 * Is object a member of some extension?  (Note: this is a fairly
+	 * expensive lookup, which is why we try to cache the results.)
+	 */
+	extensionOid = getExtensionOfObject(classId, objectId);
+
+	/* If so, is that extension in fpinfo->shippable_extensions? */
+	if (OidIsValid(extensionOid) &&
+		list_member_oid(fpinfo->shippable_extensions, extensionOid))
+		return true;
+
+	return false;
+}
+
+/*
+ * Return true if given object is one of PostgreSQL's built-in objects.
+ *
+ * We use FirstGenbkiObjectId as the cutoff, so that we only consider
+ * objects with hand-assigned OIDs to be "built in", not for instance any
+ * function or type defined in the information_schema.
+ *
+ * Our constraints for dealing with types are tighter than they are for
+ * functions or operators: we want to accept only types that are in pg_catalog,
+ * else deparse_type_name might incorrectly fail to schema-qualify their names.
+ * Thus we must exclude information_schema types.
+ *
+ * XXX there is a problem with this, which is that the set of built-in
+ * objects expands over time.  Something that is built-in to us might not
+ * be known to the remote server, if it's of an older version.  But keeping
+ * track of that would be a huge exercise.
+ */
+bool
+is_builtin(Oid objectId)
+{
+	return (objectId < FirstGenbkiObjectId);
+}
+
+/*
+ * is_shippable
+ *	   Is this object (function/operator/type) shippable to foreign server?
+ */
+bool
+is_shippable(Oid objectId, Oid classId, PgFdwRelationInfo *fpinfo)
+{
+	ShippableCacheKey key;
+	ShippableCacheEntry *entry;
+
+	/* Built-in objects are presumed shippable. */
+	if (is_builtin(objectId))
+		return true;
+
+	/* Initialize cache if first time through. */
+	if (!ShippableCacheHash)
+		InitializeShippableCache();
+
+	/*
+	 * Load the objects discovered to be shippable or not to the server, if
+	 * not done yet.  Give up if there is none, and user hasn't specified any
+	 * shippable extensions.
+	 */
+	if (!load_discovered_shippable(fpinfo->server->serverid) &&
+		fpinfo->shippable_extensions == NIL)
+		return false;
+
+	/* Set up cache hash key */
+	key.objid = objectId;
+	key.classid = classId;
+	key.serverid = fpinfo->server->serverid;
+
+	/* See if we already cached the result. */
+	entry = (ShippableCacheEntry *)
+		hash_search(ShippableCacheHash, &key, HASH_FIND, NULL);
+
+	if (!entry)
+	{
+		/* Not found in cache, so perform shippability lookup. */
+		bool		shippable = lookup_shippable(objectId, classId, fpinfo);
+
+		/*
+		 * Don't create a new hash entry until *after* we have the shippable
+		 * result in hand, as the underlying catalog lookups might trigger a
+		 * cache invalidation.
+		 */
+		entry = (ShippableCacheEntry *)
+			hash_search(ShippableCacheHash, &key, HASH_ENTER, NULL);
+
+		entry->shippable = shippable;
+		entry->hashvalue = shippable_object_hash_value(classId, objectId);
+	}
+
+	return entry->shippable;
+}
+
+/*
+ * Return true if the value of a pg_collation column fetched from the remote
+ * server matches the given local value, counting two NULLs as equal.
+ */
+static bool
+remote_collation_attr_matches(PGresult *res, int col, const char *value)
+{
+	if (PQgetisnull(res, 0, col))
+		return (value == NULL);
+	return (value != NULL && strcmp(PQgetvalue(res, 0, col), value) == 0);
+}
+
+/*
+ * Check whether the remote server has a collation with the same name as the
+ * given local collation, which sorts and compares exactly as the local one
+ * does: it must use the same provider and locale settings, have the same
+ * determinism and the same actual version of the underlying library, and
+ * be in a database with the same encoding as ours.
+ *
+ * If the remote server can't be asked, *failed is set and false is returned.
+ */
+static bool
+lookup_shippable_collation(Oid collid, PgFdwRelationInfo *fpinfo,
+						   bool *failed)
+{
+	MemoryContext oldcontext = CurrentMemoryContext;
+	ResourceOwner oldowner = CurrentResourceOwner;
+	HeapTuple	tp;
+	Form_pg_collation collform;
+	Datum		datum;
+	bool		isnull;
+	char	   *collname;
+	char	   *nspname;
+	char		collprovider;
+	bool		collisdeterministic;
+	char	   *collcollate = NULL;
+	char	   *collctype = NULL;
+	char	   *colllocale = NULL;
+	char	   *verlocale;
+	char	   *collversion = NULL;
+	PGconn	   *conn;
+	PGresult   *volatile res = NULL;
+	StringInfoData buf;
+	int			server_version_num;
+	bool		shippable = false;
+
+	tp = SearchSysCache1(COLLOID, ObjectIdGetDatum(collid));
+	if (!HeapTupleIsValid(tp))
+		elog(ERROR, "cache lookup failed for collation %u", collid);
+	collform = (Form_pg_collation) GETSTRUCT(tp);
+
+	collname = pstrdup(NameStr(collform->collname));
+	nspname = get_namespace_name(collform->collnamespace);
+	collprovider = collform->collprovider;
+	collisdeterministic = collform->collisdeterministic;
+
+	datum = SysCacheGetAttr(COLLOID, tp, Anum_pg_collation_collcollate,
+							&isnull);
+	if (!isnull)
+		collcollate = TextDatumGetCString(datum);
+	datum = SysCacheGetAttr(COLLOID, tp, Anum_pg_collation_collctype,
+							&isnull);
+	if (!isnull)
+		collctype = TextDatumGetCString(datum);
+	datum = SysCacheGetAttr(COLLOID, tp, Anum_pg_collation_colllocale,
+							&isnull);
+	if (!isnull)
+		colllocale = TextDatumGetCString(datum);
+
+	ReleaseSysCache(tp);
+
+	/* Same as what pg_collation_actual_version() reports */
+	verlocale = (collprovider == COLLPROVIDER_LIBC) ? collcollate : colllocale;
+	if (verlocale)
+		collversion = get_collation_actual_version(collprovider, verlocale);
+
+	/*
+	 * Ask the remote server in a subtransaction, so that if we can't connect
+	 * or the query fails, we can just treat the collation as not shippable;
+	 * the remote work is then rolled back to a savepoint, too.
+	 */
+	BeginInternalSubTransaction(NULL);
+	MemoryContextSwitchTo(oldcontext);
+
+	PG_TRY();
+	{
+		conn = GetConnection(fpinfo->user, false, NULL);
+		server_version_num = PQserverVersion(conn);
+
+		/*
+		 * The column holding the ICU or builtin locale was renamed in v17,
+		 * and nondeterministic collations don't exist before v12.
+		 */
+		initStringInfo(&buf);
+		appendStringInfo(&buf,
+						 "SELECT c.collprovider, c.collcollate, c.collctype, %s, %s,"
+						 " pg_catalog.pg_collation_actual_version(c.oid),"
+						 " pg_catalog.getdatabaseencoding()"
+						 " FROM pg_catalog.pg_collation c"
+						 " JOIN pg_catalog.pg_namespace n ON n.oid = c.collnamespace"
+						 " WHERE n.nspname = ",
+						 server_version_num >= 170000 ? "c.colllocale" :
+						 server_version_num >= 150000 ? "c.colliculocale" : "NULL",
+						 server_version_num >= 120000 ? "c.collisdeterministic" : "true");
+		deparseStringLiteral(&buf, nspname);
+		appendStringInfoString(&buf, " AND c.collname = ");
+		deparseStringLiteral(&buf, collname);
+		appendStringInfoString(&buf,
+							   " AND c.collencoding IN (-1, pg_catalog.pg_char_to_encoding(pg_catalog.getdatabaseencoding()))");
+
+		/* In what follows, do not risk leaking any PGresults. */
+		PG_TRY();
+		{
+			res = pgfdw_exec_query(conn, buf.data, NULL);
+			if (PQresultStatus(res) != PGRES_TUPLES_OK)
+				pgfdw_report_error(ERROR, res, conn, false, buf.data);
+
+			if (PQntuples(res) == 1 &&
+				PQgetvalue(res, 0, 0)[0] == collprovider &&
+				remote_collation_attr_matches(res, 1, collcollate) &&
+				remote_collation_attr_matches(res, 2, collctype) &&
+				remote_collation_attr_matches(res, 3, colllocale) &&
+				strcmp(PQgetvalue(res, 0, 4), collisdeterministic ? "t" : "f") == 0 &&
+				remote_collation_attr_matches(res, 5, collversion) &&
+				strcmp(PQgetvalue(res, 0, 6), GetDatabaseEncodingName()) == 0)
+				shippable = true;
+		}
+		PG_FINALLY();
+		{
+			PQclear(res);
+		}
+		PG_END_TRY();
+
+		ReleaseConnection(conn);
+		pfree(buf.data);
+
+		ReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+	}
+	PG_CATCH();
+	{
+		ErrorData  *edata;
+
+		MemoryContextSwitchTo(oldcontext);
+		edata = CopyErrorData();
+		FlushErrorState();
+
+		RollbackAndReleaseCurrentSubTransaction();
+		MemoryContextSwitchTo(oldcontext);
+		CurrentResourceOwner = oldowner;
+
+		ereport(DEBUG1,
+				(errmsg_internal("could not look up collation \"%s\" on foreign server \"%s\": %s",
+								 collname, fpinfo->server->servername,
+								 edata->message)));
+		FreeErrorData(edata);
+
+		*failed = true;
+		shippable = false;
+	}
+	PG_END_TRY();
+
+	return shippable;
+}
+
+/*
+ * is_shippable_collation
+ *	   Can an expression with this non-default collation be shipped to the
+ *	   foreign server, labeled with an explicit COLLATE clause?
+ *
+ * Only when the server's verify_collations option is on, and the remote
+ * collation of the same name has been found to behave identically.
+ */
+bool
+is_shippable_collation(Oid collid, PgFdwRelationInfo *fpinfo)
+{
+	ShippableCacheKey key;
+	ShippableCacheEntry *entry;
+
+	if (!fpinfo->verify_collations)
+		return false;
+
+	/* Initialize cache if first time through. */
+	if (!ShippableCacheHash)
+		InitializeShippableCache();
+
+	/* Set up cache hash key */
+	key.objid = collid;
+	key.classid = CollationRelationId;
+	key.serverid = fpinfo->server->serverid;
+
+	/* See if we already cached the result. */
+	entry = (ShippableCacheEntry *)
+		hash_search(ShippableCacheHash, &key, HASH_FIND, NULL);
+
+	if (!entry)
+	{
+		bool		shippable;
+		bool		failed = false;
+
+		/*
+		 * Not found in cache, so ask the remote server, but only if the
+		 * planner has identified the user who will run the query, as the
+		 * connection to use depends on it.
+		 */
+		if (fpinfo->user == NULL)
+			return false;
+		shippable = lookup_shippable_collation(collid, fpinfo, &failed);
+
+		/* Don't remember a failure; the server might be back next time */
+		if (failed)
+			return false;
+
+		/* As in is_shippable(), enter the result only now. */
+		entry = (ShippableCacheEntry *)
+			hash_search(ShippableCacheHash, &key, HASH_ENTER, NULL);
+
+		entry->shippable = shippable;
+		entry->hashvalue = 0;
+	}
+
+	return entry->shippable;
+}
@@ -275,6 +275,10 @@ EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft1 t1 WHERE c1 = 101 FOR UPDATE;
 SELECT * FROM ft1 t1 WHERE c1 = 101 FOR UPDATE;
 EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft1 t1 WHERE c1 = 102 FOR SHARE;
 SELECT * FROM ft1 t1 WHERE c1 = 102 FOR SHARE;
+-- with wait policies, along with LIMIT
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft1 t1 WHERE c1 > 100 ORDER BY c1 LIMIT 2 FOR UPDATE SKIP LOCKED;
+SELECT * FROM ft1 t1 WHERE c1 > 100 ORDER BY c1 LIMIT 2 FOR UPDATE SKIP LOCKED;
+EXPLAIN (VERBOSE, COSTS OFF) SELECT * FROM ft1 t1 WHERE c1 = 102 FOR SHARE NOWAIT;
 -- aggregate
 SELECT COUNT(*) FROM ft1 t1;
 -- subquery
@@ -689,6 +693,36 @@ SELECT * FROM local_tbl LEFT JOIN (SELECT ft1.* FROM ft1 INNER JOIN ft2 ON (ft1.
 ALTER SERVER loopback OPTIONS (DROP fdw_startup_cost);
 ALTER SERVER loopback OPTIONS (ADD extensions 'postgres_fdw_plus');
 
+-- key-set semi-join: the local join keys are shipped to the remote server
+CREATE TABLE keyset_tbl (c1 int);
+INSERT INTO keyset_tbl VALUES (1), (5), (5), (NULL), (1000), (2000);
+ANALYZE keyset_tbl;
+SET postgres_fdw.keyset_join_max_keys = 100;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+-- a Bloom filter is shipped if there are more keys than the limit
+SET postgres_fdw.keyset_join_max_keys = 2;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+RESET postgres_fdw.keyset_join_max_keys;
+-- the keys can be staged in a remote temporary table instead
+SET postgres_fdw.keyset_join_staging = on;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+-- but not in read-only transactions
+BEGIN READ ONLY;
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) ORDER BY ft2.c1;
+COMMIT;
+RESET postgres_fdw.keyset_join_staging;
+-- not if the local plan has volatile functions, as it would run twice
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) WHERE keyset_tbl.c1 + random() > 0 ORDER BY ft2.c1;
+SELECT ft2.c1, ft2.c2 FROM ft2 JOIN keyset_tbl ON (ft2.c1 = keyset_tbl.c1) WHERE keyset_tbl.c1 + random() > 0 ORDER BY ft2.c1;
+DROP TABLE keyset_tbl;
+
 DROP TABLE local_tbl;
 
 -- check join pushdown in situations where multiple userids are involved
@@ -1082,8 +1116,7 @@ select sum(q.a), count(q.b) from ft4 left join (select 13, avg(ft1.c1), sum(ft2.
 select sum(q.a), count(q.b) from ft4 left join (select 13, avg(ft1.c1), sum(ft2.c1) from ft1 right join ft2 on (ft1.c1 = ft2.c1)) q(a, b, c) on (ft4.c1 <= q.b);
 
 
--- Not supported cases
--- Grouping sets
+-- Grouping sets and GROUPING() are pushed down
 explain (verbose, costs off)
 select c2, sum(c1) from ft1 where c2 < 3 group by rollup(c2) order by 1 nulls last;
 select c2, sum(c1) from ft1 where c2 < 3 group by rollup(c2) order by 1 nulls last;
@@ -1097,6 +1130,11 @@ explain (verbose, costs off)
 select c2, sum(c1), grouping(c2) from ft1 where c2 < 3 group by c2 order by 1 nulls last;
 select c2, sum(c1), grouping(c2) from ft1 where c2 < 3 group by c2 order by 1 nulls last;
 
+explain (verbose, costs off)
+select c2, c6, sum(c1), grouping(c2, c6) from ft1 where c2 < 3 group by rollup(c2, c6) having grouping(c6) = 1 order by 1 nulls last, 2 nulls last;
+select c2, c6, sum(c1), grouping(c2, c6) from ft1 where c2 < 3 group by rollup(c2, c6) having grouping(c6) = 1 order by 1 nulls last, 2 nulls last;
+
+-- Not supported cases
 -- DISTINCT itself is not pushed down, whereas underneath aggregate is pushed
 explain (verbose, costs off)
 select distinct sum(c1)/1000 s from ft2 where c2 < 6 group by c2 order by 1;
@@ -1113,6 +1151,21 @@ explain (verbose, costs off)
 select c2, array_agg(c2) over (partition by c2%2 order by c2 range between current row and unbounded following) from ft1 where c2 < 10 group by c2 order by 1;
 select c2, array_agg(c2) over (partition by c2%2 order by c2 range between current row and unbounded following) from ft1 where c2 < 10 group by c2 order by 1;
 
+-- WindowAgg and DISTINCT over a scan relation are pushed down
+explain (verbose, costs off)
+select c1, c2, rank() over (partition by c2 order by c1 desc) from ft1 where c1 <= 12;
+select c1, c2, rank() over (partition by c2 order by c1 desc) from ft1 where c1 <= 12 order by 1;
+explain (verbose, costs off)
+select distinct c2 from ft1 where c1 < 100;
+select distinct c2 from ft1 where c1 < 100 order by 1;
+explain (verbose, costs off)
+select distinct on (c2) c2, c1 from ft1 where c1 < 100 order by c2, c1 desc;
+select distinct on (c2) c2, c1 from ft1 where c1 < 100 order by c2, c1 desc;
+-- the remote ORDER BY has the constant keys left out of the pathkeys
+explain (verbose, costs off)
+select distinct on (c2, c3) c2, c3, c1 from ft1 where c1 < 40 and c2 = 3 order by c2, c3, c1 desc;
+select distinct on (c2, c3) c2, c3, c1 from ft1 where c1 < 40 and c2 = 3 order by c2, c3, c1 desc;
+
 
 -- ===================================================================
 -- parameterized queries
@@ -1136,6 +1189,12 @@ PREPARE st3(int) AS SELECT * FROM ft1 t1 WHERE t1.c1 < $2 AND t1.c3 IN (SELECT c
 EXPLAIN (VERBOSE, COSTS OFF) EXECUTE st3(10, 20);
 EXECUTE st3(10, 20);
 EXECUTE st3(20, 30);
+-- stable subexpressions can be evaluated locally and sent as parameters
+SET postgres_fdw.preevaluate_stable_exprs = on;
+EXPLAIN (VERBOSE, COSTS OFF)
+SELECT c1, c2 FROM ft1 WHERE c1 = current_setting('max_identifier_length')::int AND c4 < now();
+SELECT c1, c2 FROM ft1 WHERE c1 = current_setting('max_identifier_length')::int AND c4 < now();
+RESET postgres_fdw.preevaluate_stable_exprs;
 -- custom plan should be chosen initially
 PREPARE st4(int) AS SELECT * FROM ft1 t1 WHERE t1.c1 = $1;
 EXPLAIN (VERBOSE, COSTS OFF) EXECUTE st4(1);
@@ -1304,6 +1363,11 @@ explain (verbose, costs off) select * from ft3 where f2 COLLATE "C" = 'foo';
 explain (verbose, costs off) select * from ft3 where f2 = 'foo' COLLATE "C";
 explain (verbose, costs off) select * from ft3 f, loct3 l
   where f.f3 = l.f3 COLLATE "POSIX" and l.f1 = 'foo';
+-- can be sent to remote once the collations are verified identical
+alter server loopback options (add verify_collations 'true');
+explain (verbose, costs off) select * from ft3 where f2 COLLATE "C" = 'foo';
+explain (verbose, costs off) select * from ft3 where f2 = 'foo' COLLATE "C";
+alter server loopback options (drop verify_collations);
 
 -- ===================================================================
 -- test SEMI-JOIN pushdown
@@ -3156,9 +3220,11 @@ EXPLAIN (VERBOSE, COSTS OFF)
 SELECT a, count(t1) FROM pagg_tab t1 GROUP BY a HAVING avg(b) < 22 ORDER BY 1;
 SELECT a, count(t1) FROM pagg_tab t1 GROUP BY a HAVING avg(b) < 22 ORDER BY 1;
 
--- When GROUP BY clause does not match with PARTITION KEY.
+-- When GROUP BY clause does not match with PARTITION KEY, aggregates are
+-- partially computed on the remote server and combined locally.
 EXPLAIN (COSTS OFF)
 SELECT b, avg(a), max(a), count(*) FROM pagg_tab GROUP BY b HAVING sum(a) < 700 ORDER BY 1;
+SELECT b, avg(a), max(a), count(*) FROM pagg_tab GROUP BY b HAVING sum(a) < 700 ORDER BY 1;
 
 -- ===================================================================
 -- access rights and superuser
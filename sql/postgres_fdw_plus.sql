@@ -374,6 +374,436 @@ SET ROLE regress_pgfdw_local_super1;
 SELECT count(*) FROM pgfdw_plus_resolve_foreign_prepared_xacts_all();
 SELECT count(*) FROM pgfdw_plus_vacuum_xact_commits();
 
+-- ===================================================================
+-- Test discovery of shippable functions and operators
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE FUNCTION pgfdw_plus_test_inc(int) RETURNS int
+    AS $$ BEGIN RETURN $1 + 1; END $$ LANGUAGE plpgsql IMMUTABLE;
+CREATE OPERATOR ==== (LEFTARG = int, RIGHTARG = int, FUNCTION = int4eq);
+
+-- User-defined objects are not shippable by default.
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT * FROM ft2 WHERE pgfdw_plus_test_inc(c1) ==== 101;
+
+-- They become shippable once they are found on the remote server.
+SELECT * FROM pgfdw_plus_discover_shippable('pgfdw_plus_loopback2')
+    WHERE object LIKE 'regress_pgfdw_plus.%' ORDER BY object_type, object;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT * FROM ft2 WHERE pgfdw_plus_test_inc(c1) ==== 101;
+
+-- A decision is ignored while the object differs from when it was made.
+ALTER FUNCTION pgfdw_plus_test_inc(int) SET search_path = pg_catalog;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT * FROM ft2 WHERE pgfdw_plus_test_inc(c1) ==== 101;
+ALTER FUNCTION pgfdw_plus_test_inc(int) RESET search_path;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT * FROM ft2 WHERE pgfdw_plus_test_inc(c1) ==== 101;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test import of remote indexes
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+
+-- The primary key of t2 is imported for ft2.
+SELECT * FROM pgfdw_plus_import_remote_indexes('pgfdw_plus_loopback2')
+    ORDER BY 1, 2;
+
+-- The sort order it provides is pushed down without remote estimates.
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT c1 FROM ft2 ORDER BY c1 DESC;
+
+-- Its leading column is used for parameterized scans of ft2, but ft2 is
+-- not known to be unique on c1 by default, so the join isn't removed.
+SET enable_hashjoin TO false;
+SET enable_mergejoin TO false;
+SET enable_material TO false;
+SET enable_memoize TO false;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT t0.c1 FROM t0 LEFT JOIN ft2 ON t0.c1 = ft2.c1;
+RESET enable_hashjoin;
+RESET enable_mergejoin;
+RESET enable_material;
+RESET enable_memoize;
+
+-- The join to ft2 can be removed once the uniqueness is trusted.
+ALTER FOREIGN TABLE ft2 OPTIONS (ADD trust_remote_unique 'true');
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT t0.c1 FROM t0 LEFT JOIN ft2 ON t0.c1 = ft2.c1;
+ALTER FOREIGN TABLE ft2 OPTIONS (DROP trust_remote_unique);
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test planning budget for remote estimates
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (ADD use_remote_estimate 'true');
+SET postgres_fdw.remote_estimate_max_count TO 1;
+
+-- The scan of ft2 is always estimated remotely, but the sorted scan is
+-- estimated locally once the budget is exhausted.  It's still pushed down
+-- as the order is provided by the remote index imported above.
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT c1 FROM ft2 ORDER BY c1;
+
+RESET postgres_fdw.remote_estimate_max_count;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (DROP use_remote_estimate);
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test batching of remote estimates
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (ADD use_remote_estimate 'true');
+
+-- The parameterized scans of ft2 for t0 and for t1 are estimated by remote
+-- EXPLAINs sent together.
+SET client_min_messages TO debug1;
+DO $$
+BEGIN
+    EXECUTE 'EXPLAIN SELECT * FROM t0, t1, ft2
+             WHERE ft2.c1 = t0.c1 AND ft2.c1 > t1.c1';
+END
+$$;
+RESET client_min_messages;
+
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (DROP use_remote_estimate);
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test cache of remote estimates
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (ADD use_remote_estimate 'true');
+SET postgres_fdw.remote_estimate_cache_ttl TO 600;
+SET postgres_fdw.remote_estimate_max_count TO 100;
+
+-- Planning the same query again finds the remote estimate in the cache, but
+-- not after ANALYZE or a change of the options of the foreign table.
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ANALYZE ft2;
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ALTER FOREIGN TABLE ft2 OPTIONS (ADD fetch_size '100');
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ALTER FOREIGN TABLE ft2 OPTIONS (DROP fetch_size);
+
+RESET postgres_fdw.remote_estimate_max_count;
+RESET postgres_fdw.remote_estimate_cache_ttl;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (DROP use_remote_estimate);
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test that changes of FDW options take effect in the same session
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+SET postgres_fdw.remote_estimate_max_count TO 100;
+
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (ADD use_remote_estimate 'true');
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ALTER FOREIGN TABLE ft2 OPTIONS (ADD use_remote_estimate 'false');
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+ALTER FOREIGN TABLE ft2 OPTIONS (DROP use_remote_estimate);
+EXPLAIN (VERBOSE, COSTS OFF) INSERT INTO ft2 VALUES (1);
+ALTER FOREIGN TABLE ft2 OPTIONS (ADD batch_size '10');
+EXPLAIN (VERBOSE, COSTS OFF) INSERT INTO ft2 VALUES (1);
+ALTER FOREIGN TABLE ft2 OPTIONS (DROP batch_size);
+
+-- The remote estimates are made as the new user after the user mapping
+-- is changed, which fails for a user that doesn't exist.
+ALTER USER MAPPING FOR CURRENT_USER SERVER pgfdw_plus_loopback2
+    OPTIONS (SET user 'regress_pgfdw_nonexistent');
+\set VERBOSITY terse
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+\set VERBOSITY default
+ALTER USER MAPPING FOR CURRENT_USER SERVER pgfdw_plus_loopback2
+    OPTIONS (SET user 'regress_pgfdw_remote_super2');
+EXPLAIN (COSTS OFF) SELECT c1 FROM ft2;
+
+ALTER SERVER pgfdw_plus_loopback2 OPTIONS (DROP use_remote_estimate);
+RESET postgres_fdw.remote_estimate_max_count;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test network cost model
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+SELECT round_trip_ms >= 0 AS round_trip, megabytes_per_sec > 0 AS bandwidth
+    FROM pgfdw_plus_calibrate_network('pgfdw_plus_loopback1');
+ALTER SERVER pgfdw_plus_loopback1 OPTIONS (ADD use_network_cost 'maybe');
+ALTER SERVER pgfdw_plus_loopback1 OPTIONS (ADD use_network_cost 'true');
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT c1 FROM ft1 WHERE c1 = 1;
+
+-- The network costs decide between a nested loop with parameterized scans,
+-- which takes a round trip per outer row, and a hash join with one scan.
+CREATE SCHEMA regress_pgfdw_net_remote;
+CREATE TABLE regress_pgfdw_net_remote.tn (c1 int PRIMARY KEY);
+INSERT INTO regress_pgfdw_net_remote.tn SELECT generate_series(1, 20000);
+ANALYZE regress_pgfdw_net_remote.tn;
+CREATE SCHEMA regress_pgfdw_net_local;
+IMPORT FOREIGN SCHEMA regress_pgfdw_net_remote
+    FROM SERVER pgfdw_plus_loopback1 INTO regress_pgfdw_net_local
+    OPTIONS (import_statistics 'true', import_indexes 'true');
+ALTER FOREIGN TABLE regress_pgfdw_net_local.tn
+    OPTIONS (ADD fetch_size '100000');
+CREATE TABLE tl (c1 int);
+INSERT INTO tl SELECT i * 400 FROM generate_series(1, 50) i;
+ANALYZE tl;
+SET enable_mergejoin TO false;
+SET enable_memoize TO false;
+SET postgres_fdw.network_cost_per_ms TO 0;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT tl.c1 FROM tl JOIN regress_pgfdw_net_local.tn ftn ON ftn.c1 = tl.c1;
+SET postgres_fdw.network_cost_per_ms TO 1000000;
+EXPLAIN (VERBOSE, COSTS OFF)
+    SELECT tl.c1 FROM tl JOIN regress_pgfdw_net_local.tn ftn ON ftn.c1 = tl.c1;
+RESET postgres_fdw.network_cost_per_ms;
+RESET enable_mergejoin;
+RESET enable_memoize;
+DELETE FROM pgfdw_plus.remote_indexes
+    WHERE ftrelid = 'regress_pgfdw_net_local.tn'::regclass;
+DROP FOREIGN TABLE regress_pgfdw_net_local.tn;
+DROP SCHEMA regress_pgfdw_net_local;
+DROP TABLE regress_pgfdw_net_remote.tn;
+DROP SCHEMA regress_pgfdw_net_remote;
+DROP TABLE tl;
+ALTER SERVER pgfdw_plus_loopback1 OPTIONS (DROP use_network_cost);
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test import of remote statistics
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+ANALYZE t1;
+ALTER FOREIGN TABLE ft1 OPTIONS (ADD analyze_sampling 'import');
+ANALYZE ft1;
+SELECT f.null_frac IS NOT DISTINCT FROM t.null_frac AS null_frac,
+    f.n_distinct IS NOT DISTINCT FROM t.n_distinct AS n_distinct,
+    f.histogram_bounds::text IS NOT DISTINCT FROM
+        t.histogram_bounds::text AS histogram_bounds,
+    f.correlation IS NOT DISTINCT FROM t.correlation AS correlation
+    FROM pg_stats f, pg_stats t
+    WHERE f.schemaname = 'regress_pgfdw_plus' AND f.tablename = 'ft1'
+    AND t.schemaname = 'regress_pgfdw_plus' AND t.tablename = 't1'
+    AND f.attname = 'c1' AND t.attname = 'c1';
+SELECT f.reltuples = t.reltuples AS reltuples
+    FROM pg_class f, pg_class t
+    WHERE f.oid = 'ft1'::regclass AND t.oid = 't1'::regclass;
+ALTER FOREIGN TABLE ft1 OPTIONS (DROP analyze_sampling);
+
+-- The statistics of an enum column are imported if the labels match,
+-- so the rows added after the remote ANALYZE aren't counted.
+CREATE TYPE pgfdw_plus_mood AS ENUM ('sad', 'ok', 'happy');
+CREATE TABLE te (c1 pgfdw_plus_mood);
+INSERT INTO te SELECT (ARRAY['sad', 'ok', 'happy'])[i % 3 + 1]::pgfdw_plus_mood
+    FROM generate_series(1, 30) i;
+ANALYZE te;
+INSERT INTO te SELECT 'happy' FROM generate_series(1, 30);
+CREATE FOREIGN TABLE fte (c1 pgfdw_plus_mood) SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'te',
+             analyze_sampling 'import');
+ANALYZE fte;
+SELECT reltuples FROM pg_class WHERE oid = 'fte'::regclass;
+DROP FOREIGN TABLE fte;
+DROP TABLE te;
+DROP TYPE pgfdw_plus_mood;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test concurrent ANALYZE of foreign partitions
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE TABLE pt (c1 int) PARTITION BY RANGE (c1);
+CREATE FOREIGN TABLE pt1 PARTITION OF pt FOR VALUES FROM (MINVALUE) TO (1000)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 't1');
+CREATE FOREIGN TABLE pt2 PARTITION OF pt FOR VALUES FROM (1000) TO (MAXVALUE)
+    SERVER pgfdw_plus_loopback2
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 't2');
+SET postgres_fdw.analyze_concurrently TO true;
+ANALYZE pt;
+SELECT tablename, inherited FROM pg_stats
+    WHERE schemaname = 'regress_pgfdw_plus' AND tablename = 'pt';
+RESET postgres_fdw.analyze_concurrently;
+DROP TABLE pt;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test import of metadata by IMPORT FOREIGN SCHEMA
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE SCHEMA regress_pgfdw_import_remote;
+CREATE TABLE regress_pgfdw_import_remote.ti (c1 int PRIMARY KEY, c2 text);
+INSERT INTO regress_pgfdw_import_remote.ti
+    SELECT i, 'val' || i FROM generate_series(1, 100) i;
+CREATE TABLE regress_pgfdw_import_remote.tp (c1 int PRIMARY KEY, c2 text)
+    PARTITION BY RANGE (c1);
+CREATE TABLE regress_pgfdw_import_remote.tp1
+    PARTITION OF regress_pgfdw_import_remote.tp FOR VALUES FROM (0) TO (50);
+CREATE TABLE regress_pgfdw_import_remote.tp2
+    PARTITION OF regress_pgfdw_import_remote.tp FOR VALUES FROM (50) TO (100);
+INSERT INTO regress_pgfdw_import_remote.tp
+    SELECT i, 'val' || i FROM generate_series(0, 99) i;
+ANALYZE regress_pgfdw_import_remote.ti, regress_pgfdw_import_remote.tp;
+CREATE SCHEMA regress_pgfdw_import_local;
+IMPORT FOREIGN SCHEMA regress_pgfdw_import_remote
+    FROM SERVER pgfdw_plus_loopback1 INTO regress_pgfdw_import_local
+    OPTIONS (import_statistics 'true', import_indexes 'true',
+             import_partitions 'true');
+SELECT relname, relkind, pg_get_expr(relpartbound, oid) AS bound, reltuples
+    FROM pg_class
+    WHERE relnamespace = 'regress_pgfdw_import_local'::regnamespace
+    ORDER BY relname;
+SELECT tablename, attname, inherited, n_distinct FROM pg_stats
+    WHERE schemaname = 'regress_pgfdw_import_local'
+    ORDER BY tablename, attname;
+SELECT c.relname, i.indexname, i.indisunique, i.indkey
+    FROM pgfdw_plus.remote_indexes i JOIN pg_class c ON c.oid = i.ftrelid
+    WHERE c.relnamespace = 'regress_pgfdw_import_local'::regnamespace
+    ORDER BY c.relname;
+SELECT count(*) FROM regress_pgfdw_import_local.tp WHERE c1 >= 50;
+DELETE FROM pgfdw_plus.remote_indexes i USING pg_class c
+    WHERE c.oid = i.ftrelid
+    AND c.relnamespace = 'regress_pgfdw_import_local'::regnamespace;
+DROP FOREIGN TABLE regress_pgfdw_import_local.ti;
+DROP TABLE regress_pgfdw_import_local.tp;
+DROP SCHEMA regress_pgfdw_import_local;
+-- Partitions from other remote schemas must not clash with the other tables
+CREATE SCHEMA regress_pgfdw_import_remote2;
+CREATE TABLE regress_pgfdw_import_remote2.ti
+    PARTITION OF regress_pgfdw_import_remote.tp FOR VALUES FROM (100) TO (200);
+CREATE SCHEMA regress_pgfdw_import_local;
+IMPORT FOREIGN SCHEMA regress_pgfdw_import_remote
+    FROM SERVER pgfdw_plus_loopback1 INTO regress_pgfdw_import_local
+    OPTIONS (import_partitions 'true');
+IMPORT FOREIGN SCHEMA regress_pgfdw_import_remote EXCEPT (ti, tp2)
+    FROM SERVER pgfdw_plus_loopback1 INTO regress_pgfdw_import_local
+    OPTIONS (import_partitions 'true');
+SELECT relname, relkind FROM pg_class
+    WHERE relnamespace = 'regress_pgfdw_import_local'::regnamespace
+    ORDER BY relname;
+DROP TABLE regress_pgfdw_import_local.tp;
+DROP SCHEMA regress_pgfdw_import_local;
+DROP TABLE regress_pgfdw_import_remote.ti, regress_pgfdw_import_remote.tp;
+DROP SCHEMA regress_pgfdw_import_remote, regress_pgfdw_import_remote2;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test batch insert with COPY
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE TABLE tc (c1 int, c2 text, c3 int GENERATED ALWAYS AS (c1 * 2) STORED);
+CREATE FOREIGN TABLE ftc (c1 int, c2 text,
+    c3 int GENERATED ALWAYS AS (c1 * 2) STORED)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'tc',
+             batch_size '10');
+ALTER FOREIGN TABLE ftc OPTIONS (ADD batch_insert_method 'bulk');
+ALTER FOREIGN TABLE ftc OPTIONS (ADD batch_insert_method 'binary_copy');
+EXPLAIN (ANALYZE, VERBOSE, COSTS OFF, TIMING OFF, SUMMARY OFF)
+    INSERT INTO ftc (c1, c2) SELECT i, i::text FROM generate_series(1, 25) i;
+ALTER FOREIGN TABLE ftc OPTIONS (SET batch_insert_method 'copy');
+INSERT INTO ftc (c1, c2) VALUES (26, E'a\tb\\c\nd'), (27, NULL);
+SELECT count(*), sum(c3) FROM tc;
+SELECT c1, c2 = E'a\tb\\c\nd' AS escaped, c2 IS NULL AS c2_null
+    FROM tc WHERE c1 > 25 ORDER BY c1;
+DROP FOREIGN TABLE ftc;
+DROP TABLE tc;
+-- binary format is used only if the remote columns are of the same types
+CREATE TABLE tc (c1 bigint, c2 float8);
+CREATE FOREIGN TABLE ftc (c1 int, c2 float8)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'tc',
+             batch_size '10', batch_insert_method 'binary_copy');
+EXPLAIN (ANALYZE, VERBOSE, COSTS OFF, TIMING OFF, SUMMARY OFF)
+    INSERT INTO ftc SELECT i, i::float8 / 2 FROM generate_series(1, 5) i;
+SELECT * FROM tc ORDER BY c1;
+DROP FOREIGN TABLE ftc;
+DROP TABLE tc;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test binary transmission of parameters
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE TABLE tb (c1 int PRIMARY KEY, c2 numeric, c3 timestamp, c4 bigint);
+CREATE FOREIGN TABLE ftb (c1 int, c2 numeric, c3 timestamp, c4 int)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'tb',
+             batch_size '10');
+INSERT INTO ftb SELECT i, i * 1.5, '2024-01-01'::timestamp + i * interval '1h', i
+    FROM generate_series(1, 20) i;
+UPDATE ftb SET c2 = c2 * 2, c4 = c4 + 1 WHERE c1 = 10 AND random() >= 0;
+SELECT * FROM tb WHERE c1 = 10;
+PREPARE st(numeric, timestamp) AS
+    SELECT c1 FROM ftb WHERE c2 > $1 AND c3 < $2 ORDER BY c1;
+SET plan_cache_mode TO force_generic_plan;
+EXECUTE st(20, '2024-01-01 18:00');
+RESET plan_cache_mode;
+DEALLOCATE st;
+DROP FOREIGN TABLE ftb;
+DROP TABLE tb;
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test insert with RETURNING into a table with batch_size
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE TABLE tr (c1 int, c2 text);
+CREATE FUNCTION tr_trigfunc() RETURNS trigger LANGUAGE plpgsql AS $$
+BEGIN
+    IF NEW.c1 = 9 THEN
+        RETURN NULL;
+    END IF;
+    NEW.c2 := upper(NEW.c2);
+    RETURN NEW;
+END
+$$;
+CREATE TRIGGER tr_trigger BEFORE INSERT ON tr
+    FOR EACH ROW EXECUTE FUNCTION tr_trigfunc();
+CREATE FOREIGN TABLE ftr (c1 int, c2 text)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'tr',
+             batch_size '3');
+INSERT INTO ftr SELECT i, 'v' || i FROM generate_series(1, 7) i RETURNING *;
+WITH t AS (
+    INSERT INTO ftr VALUES (10, 'a'), (11, 'b') RETURNING c1
+)
+SELECT count(*) FROM t;
+-- A row the remote server skips is just not returned
+INSERT INTO ftr VALUES (8, 'v8'), (9, 'v9') RETURNING c1;
+SELECT * FROM tr ORDER BY c1;
+DROP FOREIGN TABLE ftr;
+DROP TABLE tr;
+DROP FUNCTION tr_trigfunc();
+RESET postgres_fdw.two_phase_commit;
+
+-- ===================================================================
+-- Test adaptive sizing of batch inserts
+-- ===================================================================
+SET postgres_fdw.two_phase_commit TO false;
+CREATE FOREIGN TABLE ftr (c1 int, c2 text)
+    SERVER pgfdw_plus_loopback1
+    OPTIONS (schema_name 'regress_pgfdw_plus', table_name 'tr',
+             batch_size '100', batch_target_size '1MB');
+ALTER FOREIGN TABLE ftr OPTIONS (SET batch_target_size '-1');
+ALTER FOREIGN TABLE ftr OPTIONS (SET batch_target_size '1kB');
+CREATE TABLE tr (c1 int, c2 text);
+INSERT INTO ftr SELECT i, repeat('x', i) FROM generate_series(1, 250) i;
+WITH t AS (
+    INSERT INTO ftr SELECT i, 'v' || i FROM generate_series(251, 270) i
+    RETURNING c1
+)
+SELECT count(*), sum(c1) FROM t;
+SELECT count(*), sum(c1), sum(length(c2)) FROM tr;
+DROP FOREIGN TABLE ftr;
+DROP TABLE tr;
+RESET postgres_fdw.two_phase_commit;
+
 -- ===================================================================
 -- Reset global settings
 -- ===================================================================